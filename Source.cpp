@@ -20,6 +20,16 @@
 #include <regex> 
 #include <cstring>
 #include "resource.h"
+#include "core/Encoding.h"
+#include "core/PieceTable.h"
+#include "core/Edit.h"
+#include "core/MappedFile.h"
+#include "core/LineIndex.h"
+#include "core/Search.h"
+#include "core/Document.h"
+#include "core/Trace.h"
+#include "core/Watchdog.h"
+#include "core/ThreadPool.h"
 #pragma comment(lib, "d2d1.lib")
 #pragma comment(lib, "dwrite.lib")
 #pragma comment(lib, "imm32.lib")
@@ -28,53 +38,11 @@
 #pragma comment(lib, "dwmapi.lib")
 #pragma comment(lib, "uxtheme.lib")
 const std::wstring APP_VERSION = L"miu v1.0.13";
-enum Encoding {
-    ENC_UTF8_NOBOM = 0,
-    ENC_UTF8_BOM,
-    ENC_UTF16LE,
-    ENC_UTF16BE,
-    ENC_ANSI
-};
-static void SwapBytes(wchar_t* buf, size_t count) {
-    for (size_t i = 0; i < count; ++i) {
-        unsigned short x = (unsigned short)buf[i];
-        buf[i] = (wchar_t)((x >> 8) | (x << 8));
-    }
-}
-static bool IsValidUtf8(const char* buf, size_t len) {
-    if (len > 4096) len = 4096;
-    int ret = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, buf, (int)len, NULL, 0);
-    return ret > 0;
-}
-static Encoding DetectEncoding(const char* buf, size_t len) {
-    if (len >= 3 && (unsigned char)buf[0] == 0xEF && (unsigned char)buf[1] == 0xBB && (unsigned char)buf[2] == 0xBF) {
-        return ENC_UTF8_BOM;
-    }
-    if (len >= 2) {
-        if ((unsigned char)buf[0] == 0xFF && (unsigned char)buf[1] == 0xFE) {
-            return ENC_UTF16LE;
-        }
-        if ((unsigned char)buf[0] == 0xFE && (unsigned char)buf[1] == 0xFF) {
-            return ENC_UTF16BE;
-        }
-    }
-    if (IsValidUtf8(buf, len)) {
-        return ENC_UTF8_NOBOM;
-    }
-    return ENC_ANSI;
-}
-static std::string AnsiToUtf8(const char* data, size_t len) {
-    if (len == 0) return "";
-    int wLen = MultiByteToWideChar(CP_ACP, 0, data, (int)len, NULL, 0);
-    if (wLen <= 0) return "";
-    std::vector<wchar_t> wBuf(wLen);
-    MultiByteToWideChar(CP_ACP, 0, data, (int)len, wBuf.data(), wLen);
-    int uLen = WideCharToMultiByte(CP_UTF8, 0, wBuf.data(), wLen, NULL, 0, NULL, NULL);
-    if (uLen <= 0) return "";
-    std::string ret; ret.resize(uLen);
-    WideCharToMultiByte(CP_UTF8, 0, wBuf.data(), wLen, &ret[0], uLen, NULL, NULL);
-    return ret;
-}
+// ワーカーの結果が g_uiTasks に溜まったことを UI スレッドへ知らせる
+static const UINT WM_APP_TASKDONE = WM_APP + 1;
+static const UINT_PTR COMPACT_TIMER_ID = 2;
+static const UINT_PTR BRACKET_TIMER_ID = 3;
+static const UINT_PTR SYNTAX_TIMER_ID = 4;
 static std::wstring UTF8ToW(const std::string& s) {
     if (s.empty()) return {};
     int n = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), NULL, 0);
@@ -83,40 +51,6 @@ static std::wstring UTF8ToW(const std::string& s) {
     MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), &w[0], n);
     return w;
 }
-static std::string Utf8ToAnsi(const std::string& utf8) {
-    if (utf8.empty()) return "";
-    std::wstring w = UTF8ToW(utf8);
-    int len = WideCharToMultiByte(CP_ACP, 0, w.c_str(), (int)w.size(), NULL, 0, NULL, NULL);
-    if (len <= 0) return "";
-    std::string ret; ret.resize(len);
-    WideCharToMultiByte(CP_ACP, 0, w.c_str(), (int)w.size(), &ret[0], len, NULL, NULL);
-    return ret;
-}
-static std::string Utf16ToUtf8(const char* data, size_t len, bool isBigEndian) {
-    if (len < 2) return "";
-    const wchar_t* wData = (const wchar_t*)(data + 2);
-    size_t wLen = (len - 2) / sizeof(wchar_t);
-    if (wLen == 0) return "";
-    std::vector<wchar_t> wBuf(wData, wData + wLen);
-    if (isBigEndian) {
-        SwapBytes(wBuf.data(), wBuf.size());
-    }
-    int uLen = WideCharToMultiByte(CP_UTF8, 0, wBuf.data(), (int)wBuf.size(), NULL, 0, NULL, NULL);
-    if (uLen <= 0) return "";
-    std::string ret;
-    ret.resize(uLen);
-    WideCharToMultiByte(CP_UTF8, 0, wBuf.data(), (int)wBuf.size(), &ret[0], uLen, NULL, NULL);
-    return ret;
-}
-static std::wstring Utf8ToUtf16(const std::string& utf8) {
-    if (utf8.empty()) return L"";
-    int wLen = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), NULL, 0);
-    if (wLen <= 0) return L"";
-    std::wstring ret;
-    ret.resize(wLen);
-    MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), &ret[0], wLen);
-    return ret;
-}
 static std::wstring GetResString(UINT id) {
     const wchar_t* pBuf = nullptr;
     int len = LoadStringW(GetModuleHandle(NULL), id, (LPWSTR)&pBuf, 0);
@@ -133,165 +67,34 @@ static std::string WToUTF8(const std::wstring& w) {
     WideCharToMultiByte(CP_UTF8, 0, w.data(), (int)w.size(), &s[0], n, NULL, NULL);
     return s;
 }
-static std::string UnescapeString(const std::string& s, const std::string& newline) {
-    std::string out;
-    out.reserve(s.size());
-    for (size_t i = 0; i < s.size(); ++i) {
-        if (s[i] == '\\' && i + 1 < s.size()) {
-            switch (s[i + 1]) {
-            case 'n': out += newline; break;
-            case 'r': out += '\r'; break;
-            case 't': out += '\t'; break;
-            case '\\': out += '\\'; break;
-            default: out += s[i]; out += s[i + 1]; break;
-            }
-            i++;
-        }
-        else {
-            out += s[i];
-        }
-    }
-    return out;
+static const char* WatchdogMessageName(unsigned m) {
+    switch (m) {
+    case WM_KEYDOWN: return "WM_KEYDOWN"; case WM_SYSKEYDOWN: return "WM_SYSKEYDOWN"; case WM_CHAR: return "WM_CHAR";
+    case WM_PAINT: return "WM_PAINT"; case WM_TIMER: return "WM_TIMER"; case WM_COMMAND: return "WM_COMMAND";
+    case WM_LBUTTONDOWN: return "WM_LBUTTONDOWN"; case WM_LBUTTONUP: return "WM_LBUTTONUP"; case WM_MOUSEMOVE: return "WM_MOUSEMOVE"; case WM_MOUSEWHEEL: return "WM_MOUSEWHEEL";
+    case WM_IME_COMPOSITION: return "WM_IME_COMPOSITION"; case WM_DROPFILES: return "WM_DROPFILES"; case WM_APP_TASKDONE: return "WM_APP_TASKDONE";
+    }
+    return nullptr;
 }
-struct Piece { bool isOriginal; size_t start; size_t len; };
-struct PieceTable {
-    const char* origPtr = nullptr; size_t origSize = 0;
-    std::string addBuf; std::vector<Piece> pieces;
-    void initFromFile(const char* data, size_t size) { origPtr = data; origSize = size; pieces.clear(); addBuf.clear(); if (size > 0) pieces.push_back({ true, 0, size }); }
-    void initEmpty() { origPtr = nullptr; origSize = 0; pieces.clear(); addBuf.clear(); }
-    size_t length() const { size_t s = 0; for (auto& p : pieces) s += p.len; return s; }
-    std::string getRange(size_t pos, size_t count) const {
-        std::string out; out.reserve(std::min(count, (size_t)4096));
-        size_t cur = 0;
-        for (const auto& p : pieces) {
-            if (cur + p.len <= pos) { cur += p.len; continue; }
-            size_t localStart = (pos > cur) ? (pos - cur) : 0;
-            size_t take = std::min(p.len - localStart, count - out.size());
-            if (take == 0) break;
-            if (p.isOriginal) out.append(origPtr + p.start + localStart, take);
-            else out.append(addBuf.data() + p.start + localStart, take);
-            if (out.size() >= count) break;
-            cur += p.len;
-        }
-        return out;
-    }
-    void insert(size_t pos, const std::string& s) {
-        if (s.empty()) return;
-        size_t cur = 0; size_t idx = 0;
-        while (idx < pieces.size() && cur + pieces[idx].len < pos) { cur += pieces[idx].len; ++idx; }
-        if (idx < pieces.size()) {
-            Piece p = pieces[idx];
-            size_t offsetInPiece = pos - cur;
-            if (offsetInPiece > 0 && offsetInPiece < p.len) {
-                pieces[idx] = { p.isOriginal, p.start, offsetInPiece };
-                pieces.insert(pieces.begin() + idx + 1, { p.isOriginal, p.start + offsetInPiece, p.len - offsetInPiece });
-                idx++;
-            }
-            else if (offsetInPiece == p.len) idx++;
-        }
-        else idx = pieces.size();
-        size_t addStart = addBuf.size(); addBuf.append(s);
-        pieces.insert(pieces.begin() + idx, { false, addStart, s.size() });
-        coalesceAround(idx);
-    }
-    void erase(size_t pos, size_t count) {
-        if (count == 0) return;
-        size_t cur = 0; size_t idx = 0;
-        while (idx < pieces.size() && cur + pieces[idx].len <= pos) { cur += pieces[idx].len; ++idx; }
-        size_t remaining = count;
-        if (idx >= pieces.size()) return;
-        if (pos > cur) {
-            Piece p = pieces[idx]; size_t leftLen = pos - cur;
-            pieces[idx] = { p.isOriginal, p.start, leftLen };
-            pieces.insert(pieces.begin() + idx + 1, { p.isOriginal, p.start + leftLen, p.len - leftLen });
-            idx++;
-        }
-        while (idx < pieces.size() && remaining > 0) {
-            if (pieces[idx].len <= remaining) { remaining -= pieces[idx].len; pieces.erase(pieces.begin() + idx); }
-            else { pieces[idx].start += remaining; pieces[idx].len -= remaining; remaining = 0; }
-        }
-        coalesceAround(idx > 0 ? idx - 1 : 0);
-    }
-    void coalesceAround(size_t idx) {
-        if (pieces.empty()) return;
-        if (idx >= pieces.size()) idx = pieces.size() - 1;
-        if (idx > 0) {
-            Piece& a = pieces[idx - 1]; Piece& b = pieces[idx];
-            if (!a.isOriginal && !b.isOriginal && (a.start + a.len == b.start)) { a.len += b.len; pieces.erase(pieces.begin() + idx); idx--; }
-        }
-        if (idx + 1 < pieces.size()) {
-            Piece& a = pieces[idx]; Piece& b = pieces[idx + 1];
-            if (!a.isOriginal && !b.isOriginal && (a.start + a.len == b.start)) { a.len += b.len; pieces.erase(pieces.begin() + idx + 1); }
-        }
-    }
-    char charAt(size_t pos) const {
-        size_t cur = 0;
-        for (const auto& p : pieces) {
-            if (cur + p.len <= pos) { cur += p.len; continue; }
-            size_t local = pos - cur;
-            if (p.isOriginal) return origPtr[p.start + local]; else return addBuf[p.start + local];
-        }
-        return ' ';
-    }
-};
-struct Cursor {
-    size_t head; size_t anchor; float desiredX;
-    size_t start() const { return std::min(head, anchor); }
-    size_t end() const { return std::max(head, anchor); }
-    bool hasSelection() const { return head != anchor; }
-    void clearSelection() { anchor = head; }
-};
-struct EditOp { enum Type { Insert, Erase } type; size_t pos; std::string text; };
-struct EditBatch { std::vector<EditOp> ops; std::vector<Cursor> beforeCursors; std::vector<Cursor> afterCursors; };
-struct UndoManager {
-    std::vector<EditBatch> undoStack; std::vector<EditBatch> redoStack; int savePoint = 0;
-    void clear() { undoStack.clear(); redoStack.clear(); savePoint = 0; }
-    void markSaved() { savePoint = (int)undoStack.size(); }
-    bool isModified() const { return (int)undoStack.size() != savePoint; }
-    void push(const EditBatch& batch) { if (savePoint > (int)undoStack.size()) savePoint = -1; undoStack.push_back(batch); redoStack.clear(); }
-    bool canUndo() const { return !undoStack.empty(); }
-    bool canRedo() const { return !redoStack.empty(); }
-    EditBatch popUndo() { EditBatch e = undoStack.back(); undoStack.pop_back(); redoStack.push_back(e); return e; }
-    EditBatch popRedo() { EditBatch e = redoStack.back(); redoStack.pop_back(); undoStack.push_back(e); return e; }
-};
-struct MappedFile {
-    HANDLE hFile = INVALID_HANDLE_VALUE; HANDLE hMap = NULL; const char* ptr = nullptr; size_t size = 0;
-    bool open(const wchar_t* path) {
-        hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (hFile == INVALID_HANDLE_VALUE) return false;
-        LARGE_INTEGER li; if (!GetFileSizeEx(hFile, &li)) return false; size = (size_t)li.QuadPart;
-        if (size == 0) { ptr = nullptr; return true; }
-        hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
-        if (!hMap) return false; ptr = (const char*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0); return !!ptr;
-    }
-    void close() { if (ptr) { UnmapViewOfFile(ptr); ptr = nullptr; } if (hMap) { CloseHandle(hMap); hMap = NULL; } if (hFile != INVALID_HANDLE_VALUE) { CloseHandle(hFile); hFile = INVALID_HANDLE_VALUE; } }
-    ~MappedFile() { close(); }
-};
-struct Editor {
+Watchdog g_watchdog;
+MainThreadQueue g_uiTasks;
+struct Editor : Document {
     HWND hwnd = NULL;
     HWND hFindDlg = NULL;
-    PieceTable pt;
-    UndoManager undo;
-    std::unique_ptr<MappedFile> fileMap;
     std::wstring currentFilePath;
     bool isDirty = false;
+    // タイトルバーに出している改行の種類 (変わったときだけ書き直す)
+    std::string newlineLabel;
     UINT cfMsDevCol = 0;
     UINT cfMsDevLine = 0;
-    std::string searchQuery;
-    std::string replaceQuery;
-    bool searchMatchCase = false;
-    bool searchWholeWord = false;
-    bool searchRegex = false;
     bool isReplaceMode = false;
     bool showHelpPopup = false;
-    std::vector<Cursor> cursors;
-    EditBatch pendingPadding;
     bool isDragging = false; bool isRectSelecting = false;
     float rectAnchorX = 0, rectAnchorY = 0; float rectHeadX = 0, rectHeadY = 0;
     bool isDragMovePending = false; bool isDragMoving = false;
     size_t dragMoveSourceStart = 0; size_t dragMoveSourceEnd = 0; size_t dragMoveDestPos = 0;
     wchar_t highSurrogate = 0; std::string imeComp;
-    int vScrollPos = 0; int hScrollPos = 0; std::vector<size_t> lineStarts;
+    int vScrollPos = 0; int hScrollPos = 0;
     float maxLineWidth = 100.0f; float gutterWidth = 50.0f;
     DWORD lastClickTime = 0; int clickCount = 0; int lastClickX = 0, lastClickY = 0;
     float currentFontSize = 21.0f; DWORD64 zoomPopupEndTime = 0; std::wstring zoomPopupText;
@@ -308,60 +111,13 @@ struct Editor {
     WINDOWPLACEMENT prevPlacement = { sizeof(WINDOWPLACEMENT) };
     std::wstring helpTextStr;
     D2D1::ColorF autoHlColor = D2D1::ColorF(0.8f, 0.8f, 0.8f, 0.35f);
+    D2D1::ColorF bracketColor = D2D1::ColorF(0.4f, 0.4f, 0.4f, 0.9f);
+    // TokenKind ごとの文字色 (TOKEN_TEXT は textColor のまま)
+    D2D1_COLOR_F syntaxColors[TOKEN_COUNT] = {};
     D2D1::ColorF caretColor = D2D1::ColorF(0.0f, 0.0f, 0.0f, 1.0f);
     bool isDarkMode = false;
-    bool isOverwriteMode = false;
-    Encoding currentEncoding = ENC_UTF8_NOBOM;
-    std::string convertedBuffer;
-    std::string newlineStr = "\r\n";
-    std::string preprocessRegexQuery(const std::string& query) {
-        std::string processed;
-        processed.reserve(query.size() * 4);
-        for (size_t i = 0; i < query.size(); ++i) {
-            char c = query[i];
-            if (c == '\\') {
-                if (i + 1 < query.size()) {
-                    char next = query[i + 1];
-                    if (next == 'n') {
-                        bool isPrecededByCR = (i >= 2 && query[i - 2] == '\\' && query[i - 1] == 'r');
-                        if (!isPrecededByCR) {
-                            processed += "(?:\\r\\n|[\\r\\n])";
-                            i++; continue;
-                        }
-                    }
-                    processed += c; processed += next; i++; continue;
-                }
-            }
-            else if (c == '^') {
-                bool inClass = false;
-                if (i > 0 && query[i - 1] == '[') inClass = true;
-                if (!inClass) {
-                    processed += "(?:^|(?:\\r\\n|[\\r\\n]))";
-                    continue;
-                }
-            }
-            processed += c;
-        }
-        return processed;
-    }
-    void detectNewlineStyle(const char* buf, size_t len) {
-        size_t checkLen = (len > 4096) ? 4096 : len;
-        for (size_t i = 0; i < checkLen; ++i) {
-            if (buf[i] == '\r') {
-                if (i + 1 < checkLen && buf[i + 1] == '\n') {
-                    newlineStr = "\r\n";
-                    return;
-                }
-                newlineStr = "\r";
-                return;
-            }
-            else if (buf[i] == '\n') {
-                newlineStr = "\n";
-                return;
-            }
-        }
-        newlineStr = "\r\n";
-    }
+    std::wstring tracePath;
+    size_t lastFrameBytes = 0;
     bool checkSystemDarkMode() {
         HKEY hKey;
         DWORD val = 1;
@@ -382,6 +138,7 @@ struct Editor {
             selColor = D2D1::ColorF(0.26f, 0.4f, 0.6f, 1.0f);
             highlightColor = D2D1::ColorF(0.4f, 0.4f, 0.0f, 0.6f);
             autoHlColor = D2D1::ColorF(0.35f, 0.35f, 0.35f, 0.6f);
+            bracketColor = D2D1::ColorF(0.7f, 0.7f, 0.7f, 0.9f);
             caretColor = D2D1::ColorF(1.0f, 1.0f, 1.0f, 1.0f);
         }
         else {
@@ -392,8 +149,12 @@ struct Editor {
             selColor = D2D1::ColorF(0.7f, 0.8f, 1.0f, 1.0f);
             highlightColor = D2D1::ColorF(1.0f, 1.0f, 0.0f, 0.4f);
             autoHlColor = D2D1::ColorF(0.8f, 0.8f, 0.8f, 0.35f);
+            bracketColor = D2D1::ColorF(0.4f, 0.4f, 0.4f, 0.9f);
             caretColor = D2D1::ColorF(0.0f, 0.0f, 0.0f, 1.0f);
         }
+        static const UINT32 kLightSyntax[TOKEN_COUNT] = { 0x000000, 0x0000FF, 0xA31515, 0x098658, 0x008000, 0xAF00DB, 0x0451A5, 0x800000, 0x0000FF, 0xE51400, 0xBF8803, 0x1A85FF, 0x808080 };
+        static const UINT32 kDarkSyntax[TOKEN_COUNT] = { 0xE6E6E6, 0x569CD6, 0xCE9178, 0xB5CEA8, 0x6A9955, 0xC586C0, 0x9CDCFE, 0x4EC9B0, 0x569CD6, 0xF14C4C, 0xCCA700, 0x3794FF, 0x8B8B8B };
+        for (int k = 0; k < TOKEN_COUNT; ++k) syntaxColors[k] = D2D1::ColorF(isDarkMode ? kDarkSyntax[k] : kLightSyntax[k]);
         BOOL dark = isDarkMode;
         DwmSetWindowAttribute(hwnd, 20, &dark, sizeof(dark));
         if (isDarkMode) {
@@ -431,14 +192,10 @@ struct Editor {
         size_t pos = c.head;
         size_t len = pt.length();
         if (pos > len) pos = len;
-        bool charRight = (pos < len && isWordChar(pt.charAt(pos)));
-        bool charLeft = (pos > 0 && isWordChar(pt.charAt(pos - 1)));
+        bool charRight = IsWordClass(WordClassAt(pt, pos));
+        bool charLeft = IsWordClass(WordClassBefore(pt, pos));
         if (!charRight && !charLeft) return { "", true };
-        size_t start = pos;
-        size_t end = pos;
-        if (!charRight && charLeft) start--;
-        while (start > 0 && isWordChar(pt.charAt(start - 1))) start--;
-        while (end < len && isWordChar(pt.charAt(end))) end++;
+        size_t start, end; WordRangeAt(pt, charRight ? pos : PrevGraphemeBoundary(pt, pos), start, end);
         if (end > start) return { pt.getRange(start, end - start), true };
         return { "", true };
     }
@@ -502,74 +259,70 @@ struct Editor {
         std::wstring appName = GetResString(IDS_APP_TITLE);
         std::wstring title;
         if (isDirty) title = L"*";
-        if (currentFilePath.empty()) {
-            title += GetResString(IDS_UNTITLED) + L" - " + appName;
-        }
-        else {
-            title += currentFilePath + L" - " + appName;
-        }
+        title += currentFilePath.empty() ? GetResString(IDS_UNTITLED) : currentFilePath;
+        // 改行が混ざっていれば種類ごとの数も出す
+        newlineLabel = newlineCounts.describe();
+        if (!newlineLabel.empty()) title += L" (" + UTF8ToW(newlineLabel) + L")";
+        title += L" - " + appName;
         SetWindowTextW(hwnd, title.c_str());
     }
-    void updateDirtyFlag() { bool newDirty = undo.isModified(); if (isDirty != newDirty) { isDirty = newDirty; updateTitleBar(); } }
+    void updateDirtyFlag() override {
+        bool newDirty = undo.isModified(); if (isDirty != newDirty) { isDirty = newDirty; updateTitleBar(); }
+        // 編集が 0.5 秒止まったらピースの整理を始める (編集のたびにタイマーを掛け直す)
+        if (hwnd && pt.needsCompaction()) SetTimer(hwnd, COMPACT_TIMER_ID, 500, NULL);
+    }
+    void invalidate() override { InvalidateRect(hwnd, NULL, FALSE); }
+    MemoryStats memoryUsage() const override { MemoryStats m = Document::memoryUsage(); m.renderCaches = lastFrameBytes; return m; }
+    std::string diagnosticsContext() const { char b[160]; snprintf(b, sizeof(b), "document %zu bytes, %zu pieces, %zu cursors, %zu lines, undo %zu", pt.length(), pt.pieces.size(), cursors.size(), lineStarts.size(), undo.undoStack.size()); return b; }
+    // 行の並べ替え・空白や改行の書き換え等をコマンドリンクの一覧から選ぶ。保存時に行末の空白を消すかもここで切り替える
+    void showLineOperations() {
+        enum { REARRANGE, WHITESPACE, NEWLINES, FILTER };
+        static const struct { UINT res; int kind; int arg; } items[] = {
+            { IDS_LINES_SORT, REARRANGE, LINES_SORT }, { IDS_LINES_SORT_ICASE, REARRANGE, LINES_SORT_ICASE }, { IDS_LINES_SORT_NUMERIC, REARRANGE, LINES_SORT_NUMERIC }, { IDS_LINES_UNIQUE, REARRANGE, LINES_UNIQUE }, { IDS_LINES_REVERSE, REARRANGE, LINES_REVERSE }, { IDS_LINES_SHUFFLE, REARRANGE, LINES_SHUFFLE },
+            { IDS_WS_TRIM_TRAILING, WHITESPACE, WS_TRIM_TRAILING }, { IDS_WS_TABS_TO_SPACES, WHITESPACE, WS_TABS_TO_SPACES }, { IDS_WS_SPACES_TO_TABS, WHITESPACE, WS_SPACES_TO_TABS },
+            { IDS_NEWLINES_CRLF, NEWLINES, 0 }, { IDS_NEWLINES_LF, NEWLINES, 1 }, { IDS_NEWLINES_CR, NEWLINES, 2 },
+            { IDS_LINES_KEEP_MATCHING, FILTER, 1 }, { IDS_LINES_REMOVE_MATCHING, FILTER, 0 } };
+        // 検索語がなければ、それに一致する行を残す・消す項目 (末尾の 2 つ) は出さない
+        const int total = (int)(sizeof(items) / sizeof(items[0])); const int count = searchQuery.empty() ? total - 2 : total; const int firstId = 100;
+        std::wstring labels[total]; TASKDIALOG_BUTTON buttons[total];
+        for (int i = 0; i < count; ++i) { labels[i] = GetResString(items[i].res); buttons[i] = { firstId + i, labels[i].c_str() }; }
+        std::wstring title = GetResString(IDS_LINEOPS_TITLE), prompt = GetResString(IDS_LINEOPS_PROMPT), trimLabel = GetResString(IDS_TRIM_ON_SAVE);
+        Watchdog::Pause wp(g_watchdog);
+        TASKDIALOGCONFIG c = { 0 }; c.cbSize = sizeof(c); c.hwndParent = hwnd; c.hInstance = GetModuleHandle(NULL); c.dwFlags = TDF_ALLOW_DIALOG_CANCELLATION | TDF_POSITION_RELATIVE_TO_WINDOW | TDF_USE_COMMAND_LINKS; c.pszWindowTitle = title.c_str(); c.pszMainInstruction = prompt.c_str(); c.pButtons = buttons; c.cButtons = count; c.dwCommonButtons = TDCBF_CANCEL_BUTTON;
+        c.pszVerificationText = trimLabel.c_str(); if (trimTrailingOnSave) c.dwFlags |= TDF_VERIFICATION_FLAG_CHECKED;
+        int n = 0; BOOL trim = trimTrailingOnSave; TaskDialogIndirect(&c, &n, NULL, &trim);
+        trimTrailingOnSave = trim != FALSE;
+        if (n < firstId || n >= firstId + count) return;
+        int arg = items[n - firstId].arg;
+        switch (items[n - firstId].kind) {
+        case REARRANGE: rearrangeLines((LineOperation)arg, arg == LINES_SHUFFLE ? GetTickCount64() * 0x9E3779B97F4A7C15ull : 0); break;
+        case WHITESPACE: transformWhitespace((WhitespaceOperation)arg); break;
+        case NEWLINES: convertNewlines(arg == 1 ? "\n" : arg == 2 ? "\r" : "\r\n"); break;
+        case FILTER: filterLines(arg != 0); break;
+        }
+    }
+    // 検索語に一致する行だけの表示と通常の表示を切り替える。先頭に見えていた行はなるべくそのまま
+    void toggleLineFilter() {
+        int topLine = viewLineAt(vScrollPos);
+        if (!setLineFilter(!lineFilter.active)) { MessageBeep(MB_ICONWARNING); return; }
+        vScrollPos = std::max(0, std::min(viewRowOf(topLine), viewLineCount() - 1));
+        ensureCaretVisible();
+    }
+    void showMemoryStats() { MemoryStats m = sampleMemory(); ShowTaskDialog(GetResString(IDS_MEMORY_TITLE).c_str(), GetResString(IDS_MEMORY_TITLE).c_str(), UTF8ToW(FormatMemoryStats(m, memoryPeak, memoryPeakTotal)).c_str(), TDCBF_OK_BUTTON, TD_INFORMATION_ICON); }
     void updateGutterWidth() {
         if (suppressUI) return;
         int lines = (int)lineStarts.size(); int digits = 1; while (lines >= 10) { lines /= 10; digits++; }
         float digitWidth = 10.0f * (currentFontSize / 14.0f); gutterWidth = (float)(digits * digitWidth + 20.0f);
     }
-    void rebuildLineStarts() {
-        lineStarts.clear();
-        size_t totalLen = pt.length();
-        if (totalLen > 0) lineStarts.reserve(totalLen / 40 + 1);
-        lineStarts.push_back(0);
-        size_t globalOffset = 0;
-        size_t maxBytes = 0;
-        for (const auto& p : pt.pieces) {
-            const char* buf = p.isOriginal ? (pt.origPtr + p.start) : (pt.addBuf.data() + p.start);
-            const char* ptr = buf;
-            const char* end = buf + p.len;
-            while (ptr < end) {
-                char c = *ptr;
-                if (c == '\n') {
-                    size_t offsetInPiece = ptr - buf;
-                    size_t nextLineStart = globalOffset + offsetInPiece + 1;
-                    size_t currentLineLen = nextLineStart - lineStarts.back();
-                    if (currentLineLen > maxBytes) maxBytes = currentLineLen;
-                    lineStarts.push_back(nextLineStart);
-                    ptr++;
-                }
-                else if (c == '\r') {
-                    size_t offsetInPiece = ptr - buf;
-                    size_t step = 1;
-                    if (ptr + 1 < end && *(ptr + 1) == '\n') {
-                        step = 2;
-                    }
-                    size_t nextLineStart = globalOffset + offsetInPiece + step;
-                    size_t currentLineLen = nextLineStart - lineStarts.back();
-                    if (currentLineLen > maxBytes) maxBytes = currentLineLen;
-                    lineStarts.push_back(nextLineStart);
-                    ptr += step;
-                }
-                else {
-                    ptr++;
-                }
-            }
-            globalOffset += p.len;
-        }
-        size_t lastStart = lineStarts.back();
-        if (lastStart < totalLen) {
-            size_t lastLineLen = totalLen - lastStart;
-            if (lastLineLen > maxBytes) maxBytes = lastLineLen;
-        }
-        maxLineWidth = maxBytes * charWidth + 100.0f;
+    void lineStartsChanged() override {
+        maxLineWidth = maxLineBytes * charWidth + 100.0f;
         updateGutterWidth();
         updateScrollBars();
+        if (newlineCounts.describe() != newlineLabel) updateTitleBar();
+        // 大きな文書の括弧の索引は、その場で作らずアイドル時に続きを作る
+        if (hwnd && !bracketIndex.complete) SetTimer(hwnd, BRACKET_TIMER_ID, 200, NULL);
     }
-    int getLineIdx(size_t pos) {
-        if (lineStarts.empty()) return 0;
-        auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), pos); int idx = (int)std::distance(lineStarts.begin(), it) - 1;
-        if (idx < 0) idx = 0; if (idx >= (int)lineStarts.size()) idx = (int)lineStarts.size() - 1; return idx;
-    }
-    float getXFromPos(size_t pos) {
+    float getXFromPos(size_t pos) override {
         int lineIdx = getLineIdx(pos); size_t start = lineStarts[lineIdx];
         size_t end = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : pt.length(); size_t len = (end > start) ? (end - start) : 0;
         std::string lineStr = pt.getRange(start, len); std::wstring wLine = UTF8ToW(lineStr);
@@ -590,7 +343,7 @@ struct Editor {
         }
         return x;
     }
-    size_t getPosFromLineAndX(int lineIdx, float targetX) {
+    size_t getPosFromLineAndX(int lineIdx, float targetX) override {
         if (lineIdx < 0 || lineIdx >= (int)lineStarts.size()) return cursors.empty() ? 0 : cursors.back().head;
         size_t start = lineStarts[lineIdx];
         size_t end = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : pt.length();
@@ -625,22 +378,22 @@ struct Editor {
         float clientH = (rc.bottom - rc.top) / dpiScaleY; float clientW = (rc.right - rc.left) / dpiScaleX - gutterWidth; if (clientW < 0) clientW = 0;
         int linesVisible = (int)(clientH / lineHeight);
         SCROLLINFO si = {}; si.cbSize = sizeof(SCROLLINFO); si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS;
-        si.nMin = 0; si.nMax = (int)lineStarts.size() + linesVisible - 2; if (si.nMax < 0) si.nMax = 0; si.nPage = linesVisible; si.nPos = vScrollPos; SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
+        si.nMin = 0; si.nMax = viewLineCount() + linesVisible - 2; if (si.nMax < 0) si.nMax = 0; si.nPage = linesVisible; si.nPos = vScrollPos; SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
         si.nMin = 0; si.nMax = (int)maxLineWidth; si.nPage = (int)clientW; si.nPos = hScrollPos; SetScrollInfo(hwnd, SB_HORZ, &si, TRUE);
     }
     void getCaretPoint(float& x, float& y) {
         if (cursors.empty()) { x = 0; y = 0; return; }
-        size_t pos = cursors.back().head; int line = getLineIdx(pos); float docY = line * lineHeight; float localX = getXFromPos(pos);
+        size_t pos = cursors.back().head; int row = viewRowOf(getLineIdx(pos)); float docY = row * lineHeight; float localX = getXFromPos(pos);
         x = (localX - hScrollPos + gutterWidth) * dpiScaleX; y = (docY - vScrollPos * lineHeight) * dpiScaleY;
     }
-    void ensureCaretVisible() {
+    void ensureCaretVisible() override {
         if (cursors.empty()) return;
         Cursor& mainCursor = cursors.back();
         RECT rc; GetClientRect(hwnd, &rc);
         float clientH = (rc.bottom - rc.top) / dpiScaleY;
         float clientW = (rc.right - rc.left) / dpiScaleX;
         int linesVisible = (int)(clientH / lineHeight);
-        int caretLine = getLineIdx(mainCursor.head);
+        int caretLine = viewRowOf(getLineIdx(mainCursor.head));
         if (caretLine < vScrollPos) vScrollPos = caretLine;
         else if (caretLine >= vScrollPos + linesVisible - 1) vScrollPos = caretLine - linesVisible + 2;
         if (vScrollPos < 0) vScrollPos = 0;
@@ -658,305 +411,30 @@ struct Editor {
         updateScrollBars();
         InvalidateRect(hwnd, NULL, FALSE);
     }
-    std::string buildVisibleText(int numLines) {
-        if (lineStarts.empty()) return "";
-        size_t startOffset = (vScrollPos < (int)lineStarts.size()) ? lineStarts[vScrollPos] : lineStarts.back();
-        size_t endOffset = pt.length(); int endLineIdx = vScrollPos + numLines; if (endLineIdx < (int)lineStarts.size()) endOffset = lineStarts[endLineIdx];
-        return pt.getRange(startOffset, (endOffset > startOffset) ? (endOffset - startOffset) : 0);
-    }
+    std::string buildVisibleText(int numLines, std::vector<VisibleSpan>& spans) { return visibleText((size_t)std::max(vScrollPos, 0), numLines, &spans); }
     size_t getDocPosFromPoint(int x, int y) {
         float dipX = x / dpiScaleX; float dipY = y / dpiScaleY; if (dipX < gutterWidth) dipX = gutterWidth;
         float virtualX = dipX - gutterWidth + hScrollPos; float virtualY = dipY;
         RECT rc; GetClientRect(hwnd, &rc); float clientH = (rc.bottom - rc.top) / dpiScaleY; float clientW = (rc.right - rc.left) / dpiScaleX - gutterWidth;
-        int linesVisible = (int)(clientH / lineHeight) + 2; std::string text = buildVisibleText(linesVisible); std::wstring wtext = UTF8ToW(text);
+        int linesVisible = (int)(clientH / lineHeight) + 2; std::vector<VisibleSpan> spans; std::string text = buildVisibleText(linesVisible, spans); std::wstring wtext = UTF8ToW(text);
         float layoutWidth = maxLineWidth + clientW;
         IDWriteTextLayout* layout = nullptr; HRESULT hr = dwFactory->CreateTextLayout(wtext.c_str(), (UINT32)wtext.size(), textFormat, layoutWidth, clientH, &layout);
-        size_t resultPos = 0; size_t visibleStartOffset = (vScrollPos < (int)lineStarts.size()) ? lineStarts[vScrollPos] : pt.length();
+        size_t resultPos = 0;
         if (SUCCEEDED(hr) && layout) {
             BOOL isTrailing, isInside; DWRITE_HIT_TEST_METRICS metrics; layout->HitTestPoint(virtualX, virtualY, &isTrailing, &isInside, &metrics);
             UINT32 utf16Index = metrics.textPosition; if (isTrailing) utf16Index += metrics.length;
             if (utf16Index > wtext.size()) utf16Index = (UINT32)wtext.size(); std::wstring wsub = wtext.substr(0, utf16Index); std::string sub = WToUTF8(wsub);
-            resultPos = visibleStartOffset + sub.size(); layout->Release();
+            resultPos = DocPosOfVisible(spans, sub.size()); layout->Release();
         }
         if (resultPos > pt.length()) resultPos = pt.length(); return resultPos;
     }
-    bool isWordChar(char c) {
-        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
-            (c >= '0' && c <= '9') || c == '_' ||
-            (unsigned char)c >= 0x80;
-    }
-    void mergeCursors() {
-        if (cursors.empty()) return;
-        std::sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) { return a.head < b.head; });
-        std::vector<Cursor> merged; merged.push_back(cursors[0]);
-        for (size_t i = 1; i < cursors.size(); ++i) {
-            Cursor& prev = merged.back(); Cursor& curr = cursors[i];
-            if (curr.start() <= prev.end()) { size_t newStart = std::min(prev.start(), curr.start()); size_t newEnd = std::max(prev.end(), curr.end()); bool prevForward = prev.head >= prev.anchor; prev.anchor = prevForward ? newStart : newEnd; prev.head = prevForward ? newEnd : newStart; }
-            else { merged.push_back(curr); }
-        }
-        cursors = merged;
-    }
-    void selectWordAt(size_t pos) {
-        if (pos >= pt.length()) { cursors.clear(); cursors.push_back({ pos, pos, getXFromPos(pos) }); return; }
-        char c = pt.charAt(pos); bool targetType = isWordChar(c);
-        if (c == '\n') { cursors.clear(); cursors.push_back({ pos + 1, pos, getXFromPos(pos + 1) }); return; }
-        size_t start = pos; while (start > 0) { char p = pt.charAt(start - 1); if (isWordChar(p) != targetType || p == '\n') break; start--; }
-        size_t end = pos; size_t len = pt.length(); while (end < len) { char p = pt.charAt(end); if (isWordChar(p) != targetType || p == '\n') break; end++; }
-        cursors.clear(); cursors.push_back({ end, start, getXFromPos(end) });
-    }
-    void selectLineAt(size_t pos) {
-        int lineIdx = getLineIdx(pos); size_t start = lineStarts[lineIdx]; size_t end = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : pt.length();
-        cursors.clear(); cursors.push_back({ end, start, getXFromPos(end) });
-    }
-    size_t moveWordLeft(size_t pos) {
-        if (pos == 0) return 0;
-        size_t curr = pos;
-        if (curr >= 2 && pt.charAt(curr - 1) == '\n' && pt.charAt(curr - 2) == '\r') return curr - 2;
-        if (curr >= 1 && pt.charAt(curr - 1) == '\n') return curr - 1;
-        while (curr > 0) {
-            char c = pt.charAt(curr - 1);
-            if (c == '\n' || c == '\r' || !isspace(c)) break;
-            curr--;
-        }
-        if (curr == 0) return 0;
-        char prev = pt.charAt(curr - 1);
-        if (prev == '\n' || prev == '\r') return curr;
-        bool type = isWordChar(prev);
-        while (curr > 0) {
-            char c = pt.charAt(curr - 1);
-            if (c == '\n' || c == '\r' || isspace(c) || isWordChar(c) != type) break;
-            curr--;
-        }
-        return curr;
-    }
-    size_t moveWordRight(size_t pos) {
-        size_t len = pt.length();
-        if (pos >= len) return len;
-        size_t curr = pos;
-        if (pt.charAt(curr) == '\r') {
-            if (curr + 1 < len && pt.charAt(curr + 1) == '\n') return curr + 2;
-            return curr + 1;
-        }
-        if (pt.charAt(curr) == '\n') return curr + 1;
-        if (!isspace(pt.charAt(curr))) {
-            bool type = isWordChar(pt.charAt(curr));
-            while (curr < len) {
-                char c = pt.charAt(curr);
-                if (c == '\n' || c == '\r' || isspace(c) || isWordChar(c) != type) break;
-                curr++;
-            }
-        }
-        while (curr < len) {
-            char c = pt.charAt(curr);
-            if (c == '\n' || c == '\r' || !isspace(c)) break;
-            curr++;
-        }
-        return curr;
-    }
-    size_t moveCaretVisual(size_t pos, bool forward) {
-        size_t len = pt.length();
-        if (pos == 0 && !forward) return 0;
-        if (pos >= len && forward) return len;
-        if (forward) {
-            char c = pt.charAt(pos);
-            if (c == '\r') {
-                if (pos + 1 < len && pt.charAt(pos + 1) == '\n') {
-                    return pos + 2;
-                }
-            }
-            if (c == '\n') return pos + 1;
-        }
-        else {
-            if (pos > 0) {
-                char prev = pt.charAt(pos - 1);
-                if (prev == '\n') {
-                    if (pos > 1 && pt.charAt(pos - 2) == '\r') {
-                        return pos - 2;
-                    }
-                    return pos - 1;
-                }
-            }
-        }
-        int lineIdx = getLineIdx(pos); size_t lineStart = lineStarts[lineIdx];
-        size_t nextLineStart = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : len;
-        size_t lineEnd = nextLineStart; if (lineEnd > lineStart && pt.charAt(lineEnd - 1) == '\n') lineEnd--;
-        if (pos < lineStart || pos > lineEnd) return forward ? std::min(pos + 1, len) : std::max(pos - 1, (size_t)0);
-        std::string lineUtf8 = pt.getRange(lineStart, lineEnd - lineStart); std::wstring lineUtf16 = UTF8ToW(lineUtf8);
-        size_t offsetInLine = pos - lineStart; std::string preUtf8 = lineUtf8.substr(0, offsetInLine); size_t u16Pos = UTF8ToW(preUtf8).length();
-        IDWriteTextLayout* layout = nullptr;
-        HRESULT hr = dwFactory->CreateTextLayout(lineUtf16.c_str(), (UINT32)lineUtf16.length(), textFormat, 10000.0f, (FLOAT)lineHeight, &layout);
-        size_t newU16Pos = u16Pos;
-        if (SUCCEEDED(hr) && layout) {
-            UINT32 clusterCount = 0; layout->GetClusterMetrics(NULL, 0, &clusterCount);
-            if (clusterCount > 0) {
-                std::vector<DWRITE_CLUSTER_METRICS> clusters(clusterCount); layout->GetClusterMetrics(clusters.data(), clusterCount, &clusterCount);
-                size_t currentU16 = 0; bool found = false;
-                if (forward) {
-                    for (const auto& cm : clusters) {
-                        size_t nextU16 = currentU16 + cm.length;
-                        if (u16Pos >= currentU16 && u16Pos < nextU16) { newU16Pos = nextU16; found = true; break; }
-                        currentU16 = nextU16;
-                    }
-                    if (!found) newU16Pos = u16Pos;
-                }
-                else {
-                    size_t currentU16 = 0;
-                    for (const auto& cm : clusters) {
-                        size_t nextU16 = currentU16 + cm.length;
-                        if (u16Pos > currentU16 && u16Pos <= nextU16) { newU16Pos = currentU16; found = true; break; }
-                        currentU16 = nextU16;
-                    }
-                    if (!found && u16Pos > 0) { if (u16Pos == lineUtf16.length()) { size_t c = 0; for (const auto& cm : clusters) { if (c + cm.length == u16Pos) { newU16Pos = c; break; } c += cm.length; } } }
-                }
-            }
-            layout->Release();
-        }
-        if (newU16Pos != u16Pos) {
-            std::wstring preNewW = lineUtf16.substr(0, newU16Pos); size_t newOffset = WToUTF8(preNewW).length();
-            return lineStart + newOffset;
-        }
-        return forward ? std::min(pos + 1, len) : std::max(pos - 1, (size_t)0);
-    }
-    size_t findText(size_t startPos, const std::string& query, bool forward, bool matchCase, bool wholeWord, bool isRegex, size_t* outLen = nullptr) {
-        if (query.empty()) return std::string::npos;
-        size_t len = pt.length();
-        std::string actualQuery = query;
-        if (isRegex) actualQuery = preprocessRegexQuery(query);
-        if (isRegex) {
-            std::string fullText = pt.getRange(0, len);
-            try {
-                std::regex_constants::syntax_option_type flags = std::regex_constants::ECMAScript;
-                if (!matchCase) flags |= std::regex_constants::icase;
-                std::regex re(actualQuery, flags);
-                std::smatch m;
-                size_t foundPos = std::string::npos;
-                size_t foundLen = 0;
-                bool startsWithCaret = (!query.empty() && query[0] == '^');
-                if (forward) {
-                    if (startPos >= fullText.size()) startPos = 0;
-                    size_t searchStartIdx = startPos;
-                    std::regex_constants::match_flag_type searchFlags = std::regex_constants::match_default;
-                    if (searchStartIdx > 0) {
-                        searchFlags |= std::regex_constants::match_not_bol;
-                        char prevChar = fullText[searchStartIdx - 1];
-                        if (prevChar == '\n') {
-                            searchStartIdx--;
-                            if (searchStartIdx > 0 && fullText[searchStartIdx - 1] == '\r') {
-                                searchStartIdx--;
-                            }
-                        }
-                        else if (prevChar == '\r') {
-                            searchStartIdx--;
-                        }
-                    }
-                    std::string::const_iterator searchStartIter = fullText.begin() + searchStartIdx;
-                    if (std::regex_search(searchStartIter, fullText.cend(), m, re, searchFlags)) {
-                        foundPos = searchStartIdx + m.position();
-                        foundLen = m.length();
-                    }
-                    else if (startPos > 0) {
-                        if (std::regex_search(fullText.cbegin(), fullText.cend(), m, re)) {
-                            foundPos = m.position();
-                            foundLen = m.length();
-                        }
-                    }
-                }
-                else {
-                    auto words_begin = std::sregex_iterator(fullText.begin(), fullText.end(), re);
-                    auto words_end = std::sregex_iterator();
-                    size_t bestPos = std::string::npos;
-                    size_t limit = (startPos == 0) ? len : startPos;
-                    for (auto i = words_begin; i != words_end; ++i) {
-                        if (i->position() < (std::ptrdiff_t)limit) {
-                            bestPos = i->position();
-                            foundLen = i->length();
-                        }
-                    }
-                    if (bestPos != std::string::npos) foundPos = bestPos;
-                }
-                if (foundPos != std::string::npos) {
-                    if (foundPos > 0 && startsWithCaret) {
-                        std::string matchStr = fullText.substr(foundPos, foundLen);
-                        size_t adj = 0;
-                        if (matchStr.size() >= 2 && matchStr[0] == '\r' && matchStr[1] == '\n') {
-                            adj = 2;
-                        }
-                        else if (matchStr.size() >= 1 && (matchStr[0] == '\n' || matchStr[0] == '\r')) {
-                            adj = 1;
-                        }
-                        foundPos += adj;
-                        foundLen -= adj;
-                    }
-                    if (outLen) *outLen = foundLen;
-                    return foundPos;
-                }
-            }
-            catch (...) { return std::string::npos; }
-            return std::string::npos;
-        }
-        size_t qLen = query.length();
-        if (outLen) *outLen = qLen;
-        auto toLower = [](char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; };
-        size_t cur = startPos;
-        if (forward) { if (cur >= len) cur = 0; }
-        else { if (cur == 0) cur = len; else cur--; }
-        size_t count = 0;
-        while (count < len) {
-            bool match = true;
-            for (size_t i = 0; i < qLen; ++i) {
-                size_t p = cur + i;
-                if (p >= len) { match = false; break; }
-                char c1 = pt.charAt(p); char c2 = query[i];
-                if (!matchCase) { c1 = toLower(c1); c2 = toLower(c2); }
-                if (c1 != c2) { match = false; break; }
-            }
-            if (match && wholeWord) {
-                if (cur > 0 && isWordChar(pt.charAt(cur - 1))) match = false;
-                if (match && (cur + qLen < len) && isWordChar(pt.charAt(cur + qLen))) match = false;
-            }
-            if (match) {
-                size_t nextPos = cur + qLen;
-                if (nextPos < len) {
-                    unsigned char b1 = (unsigned char)pt.charAt(nextPos);
-                    if (b1 == 0xE2 && nextPos + 2 < len) {
-                        unsigned char b2 = (unsigned char)pt.charAt(nextPos + 1);
-                        unsigned char b3 = (unsigned char)pt.charAt(nextPos + 2);
-                        if (b2 == 0x80 && b3 == 0x8D) match = false;
-                    }
-                    else if (b1 == 0xEF && nextPos + 2 < len) {
-                        unsigned char b2 = (unsigned char)pt.charAt(nextPos + 1);
-                        unsigned char b3 = (unsigned char)pt.charAt(nextPos + 2);
-                        if (b2 == 0xB8 && b3 == 0x8F) match = false;
-                    }
-                    else if (b1 == 0xF0 && nextPos + 3 < len) {
-                        unsigned char b2 = (unsigned char)pt.charAt(nextPos + 1);
-                        unsigned char b3 = (unsigned char)pt.charAt(nextPos + 2);
-                        unsigned char b4 = (unsigned char)pt.charAt(nextPos + 3);
-                        if (b2 == 0x9F && b3 == 0x8F && (b4 >= 0xBB && b4 <= 0xBF)) match = false;
-                    }
-                }
-            }
-            if (match) return cur;
-            if (forward) { cur++; if (cur >= len) cur = 0; }
-            else { if (cur == 0) cur = len - 1; else cur--; }
-            count++;
-        }
-        return std::string::npos;
-    }
     void findNext(bool forward) {
         if (searchQuery.empty()) { showFindDialog(false); return; }
-        size_t startPos = forward ? (cursors.empty() ? 0 : cursors.back().end()) : (cursors.empty() ? 0 : cursors.back().start());
-        size_t matchLen = 0;
-        size_t pos = findText(startPos, searchQuery, forward, searchMatchCase, searchWholeWord, searchRegex, &matchLen);
-        if (pos != std::string::npos) {
-            cursors.clear();
-            cursors.push_back({ pos + matchLen, pos, getXFromPos(pos + matchLen) });
-            ensureCaretVisible();
-            updateTitleBar();
-        }
+        if (findNextMatch(forward)) updateTitleBar();
         else MessageBeep(MB_ICONWARNING);
     }
     void replaceNext() {
+        SessionRecorder::Scope rs(recorder, cursors, "replace", { searchMatchCase ? 1 : 0, searchWholeWord ? 1 : 0, searchRegex ? 1 : 0 }, { searchQuery, replaceQuery });
         if (cursors.empty() || searchQuery.empty()) return;
         Cursor& c = cursors.back();
         if (!c.hasSelection()) { findNext(true); return; }
@@ -967,7 +445,7 @@ struct Editor {
         std::string replacement = replaceQuery;
         if (searchRegex) {
             try {
-                std::string actualQuery = preprocessRegexQuery(searchQuery);
+                std::string actualQuery = PreprocessRegexQuery(searchQuery);
                 std::regex_constants::syntax_option_type flags = std::regex_constants::ECMAScript;
                 if (!searchMatchCase) flags |= std::regex_constants::icase;
                 std::regex re(actualQuery, flags);
@@ -1035,80 +513,12 @@ struct Editor {
         }
     }
     void replaceAll() {
-        if (searchQuery.empty()) return;
-        struct Match { size_t start; size_t len; std::string replacementText; };
-        std::vector<Match> matches;
-        size_t currentPos = 0;
-        size_t docLen = pt.length();
-        std::string actualQuery = searchQuery;
-        if (searchRegex) {
-            actualQuery = preprocessRegexQuery(searchQuery);
-            std::string fullText = pt.getRange(0, docLen);
-            std::string fmt = UnescapeString(replaceQuery, newlineStr);
-            try {
-                std::regex_constants::syntax_option_type flags = std::regex_constants::ECMAScript;
-                if (!searchMatchCase) flags |= std::regex_constants::icase;
-                std::regex re(actualQuery, flags);
-                bool startsWithCaret = (!searchQuery.empty() && searchQuery[0] == '^');
-                auto begin = std::sregex_iterator(fullText.begin(), fullText.end(), re);
-                auto end = std::sregex_iterator();
-                for (auto i = begin; i != end; ++i) {
-                    size_t pos = i->position();
-                    size_t len = i->length();
-                    std::string rText = i->format(fmt);
-                    if (startsWithCaret) {
-                        std::string matchStr = i->str();
-                        size_t adj = 0;
-                        if (matchStr.size() >= 2 && matchStr[0] == '\r' && matchStr[1] == '\n') adj = 2;
-                        else if (matchStr.size() >= 1 && (matchStr[0] == '\n' || matchStr[0] == '\r')) adj = 1;
-                        if (adj > 0) { pos += adj; len -= adj; }
-                    }
-                    matches.push_back({ pos, len, rText });
-                }
-            }
-            catch (...) { return; }
-        }
-        else {
-            while (true) {
-                size_t matchLen = 0;
-                size_t pos = findText(currentPos, searchQuery, true, searchMatchCase, searchWholeWord, false, &matchLen);
-                if (pos == std::string::npos || pos < currentPos) break;
-                matches.push_back({ pos, matchLen, replaceQuery });
-                currentPos = pos + matchLen;
-                if (currentPos > docLen) break;
-            }
-        }
-        if (matches.empty()) { MessageBeep(MB_ICONASTERISK); return; }
-        commitPadding();
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        for (auto it = matches.rbegin(); it != matches.rend(); ++it) {
-            size_t start = it->start;
-            size_t len = it->len;
-            std::string deleted = pt.getRange(start, len);
-            pt.erase(start, len);
-            batch.ops.push_back({ EditOp::Erase, start, deleted });
-            pt.insert(start, it->replacementText);
-            batch.ops.push_back({ EditOp::Insert, start, it->replacementText });
-        }
-        size_t finalMatchIdx = matches.size() - 1;
-        long long offsetBeforeFinal = 0;
-        for (size_t i = 0; i < finalMatchIdx; ++i) {
-            offsetBeforeFinal += (long long)matches[i].replacementText.size() - (long long)matches[i].len;
-        }
-        size_t lastReplaceStart = (size_t)((long long)matches.back().start + offsetBeforeFinal);
-        size_t lastReplaceEnd = lastReplaceStart + matches.back().replacementText.size();
-        cursors.clear();
-        cursors.push_back({ lastReplaceEnd, lastReplaceStart, getXFromPos(lastReplaceEnd) });
-        batch.afterCursors = cursors;
-        undo.push(batch);
-        rebuildLineStarts();
-        ensureCaretVisible();
-        updateDirtyFlag();
-        InvalidateRect(hwnd, NULL, FALSE);
+        size_t count = replaceAllMatches();
+        if (count == std::string::npos) return;
+        if (count == 0) { MessageBeep(MB_ICONASTERISK); return; }
         ShowTaskDialog(
             GetResString(IDS_REPLACE_DONE).c_str(),
-            (std::to_wstring(matches.size()) + GetResString(IDS_REPLACE_COUNT)).c_str(),
+            (std::to_wstring(count) + GetResString(IDS_REPLACE_COUNT)).c_str(),
             nullptr, TDCBF_OK_BUTTON, TD_INFORMATION_ICON
         );
         if (hFindDlg && IsWindowVisible(hFindDlg)) {
@@ -1258,39 +668,9 @@ struct Editor {
         return FALSE;
     }
     void showGoToDialog() {
+        Watchdog::Pause wp(g_watchdog);
         DialogBoxParamW(GetModuleHandle(NULL), MAKEINTRESOURCE(IDD_GOTO_DIALOG), hwnd, GoToDlgProc, (LPARAM)this);
     }
-    void rollbackPadding() {
-        if (pendingPadding.ops.empty()) return;
-        for (int i = (int)pendingPadding.ops.size() - 1; i >= 0; --i) {
-            const auto& op = pendingPadding.ops[i];
-            if (op.type == EditOp::Insert) {
-                pt.erase(op.pos, op.text.size());
-                size_t len = op.text.size();
-                for (auto& c : cursors) {
-                    if (c.head > op.pos) {
-                        if (c.head < op.pos + len) c.head = op.pos;
-                        else c.head -= len;
-                    }
-                    if (c.anchor > op.pos) {
-                        if (c.anchor < op.pos + len) c.anchor = op.pos;
-                        else c.anchor -= len;
-                    }
-                }
-            }
-        }
-        pendingPadding.ops.clear();
-        pendingPadding.beforeCursors.clear();
-        pendingPadding.afterCursors.clear();
-        rebuildLineStarts();
-    }
-    void commitPadding() {
-        if (pendingPadding.ops.empty()) return;
-        undo.push(pendingPadding);
-        pendingPadding.ops.clear();
-        pendingPadding.beforeCursors.clear();
-        pendingPadding.afterCursors.clear();
-    }
     void updateRectSelection() {
         suppressUI = true;
         if (pendingPadding.ops.empty()) {
@@ -1361,20 +741,26 @@ struct Editor {
         batch.afterCursors = cursors; undo.push(batch); rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag();
     }
     void render() {
+        TRACE_SCOPE("render");
         if (!rend) return;
         PAINTSTRUCT ps; HDC hdc = BeginPaint(hwnd, &ps);
         rend->BeginDraw(); rend->Clear(background);
         RECT rc; GetClientRect(hwnd, &rc); D2D1_SIZE_F size = rend->GetSize();
         float clientW = size.width; float clientH = size.height;
         int linesVisible = (int)(clientH / lineHeight) + 2;
-        std::string text = buildVisibleText(linesVisible);
-        size_t visibleStartOffset = (vScrollPos < (int)lineStarts.size()) ? lineStarts[vScrollPos] : pt.length();
+        // 行を絞り込んでいると text は離れた行をつないだものになる。文書の位置との対応は spans で取る
+        std::vector<VisibleSpan> spans;
+        std::string text = buildVisibleText(linesVisible, spans);
+        // 色分けは変換中の文字列を挟む前の text で求める。行頭の状態が足りなければアイドル時に求めてから描き直す
+        std::vector<SyntaxToken> syntaxTokens;
+        if (!highlightVisible(text, spans, syntaxTokens)) SetTimer(hwnd, SYNTAX_TIMER_ID, 100, NULL);
         size_t mainCaretPos = cursors.empty() ? 0 : cursors.back().head;
-        size_t caretOffsetInVisible = std::string::npos;
-        if (mainCaretPos >= visibleStartOffset) caretOffsetInVisible = mainCaretPos - visibleStartOffset;
+        bool caretShown = false; size_t caretOffsetInVisible = VisibleOffsetOf(spans, mainCaretPos, &caretShown);
+        if (!caretShown) caretOffsetInVisible = std::string::npos;
         bool hasIME = !imeComp.empty() && caretOffsetInVisible != std::string::npos && caretOffsetInVisible <= text.size();
         if (hasIME) text.insert(caretOffsetInVisible, imeComp);
         std::wstring wtext = UTF8ToW(text);
+        lastFrameBytes = text.capacity() + wtext.capacity() * sizeof(wchar_t);
         float layoutWidth = maxLineWidth + clientW;
         IDWriteTextLayout* layout = nullptr;
         ID2D1SolidColorBrush* caretBrush = nullptr;
@@ -1383,6 +769,20 @@ struct Editor {
         rend->SetTransform(transform);
         float imeCx = 0, imeCy = 0;
         if (SUCCEEDED(hr) && layout) {
+            // 字句の色は文字色の描画効果として layout に付ける (layout がブラシを保持する)。UTF-16 の位置は前の字句からの差分だけ数える
+            ID2D1SolidColorBrush* syntaxBrushes[TOKEN_COUNT] = {};
+            size_t u8 = 0; UINT32 u16 = 0;
+            for (SyntaxToken tk : syntaxTokens) {
+                if (hasIME && tk.offset >= caretOffsetInVisible) tk.offset += imeComp.size();
+                else if (hasIME && tk.offset + tk.len > caretOffsetInVisible) tk.len += imeComp.size();
+                if (tk.offset < u8 || tk.offset + tk.len > text.size()) continue;
+                u16 += (UINT32)UTF8ToW(text.substr(u8, tk.offset - u8)).size();
+                UINT32 len16 = (UINT32)UTF8ToW(text.substr(tk.offset, tk.len)).size();
+                if (!syntaxBrushes[tk.kind]) rend->CreateSolidColorBrush(syntaxColors[tk.kind], &syntaxBrushes[tk.kind]);
+                if (syntaxBrushes[tk.kind]) layout->SetDrawingEffect(syntaxBrushes[tk.kind], { u16, len16 });
+                u8 = tk.offset + tk.len; u16 += len16;
+            }
+            for (auto* b : syntaxBrushes) if (b) b->Release();
             if (isOverwriteMode) rend->CreateSolidColorBrush(D2D1::ColorF(caretColor.r, caretColor.g, caretColor.b, 0.5f), &caretBrush);
             else rend->CreateSolidColorBrush(caretColor, &caretBrush);
             ID2D1SolidColorBrush* selBrush = nullptr; rend->CreateSolidColorBrush(selColor, &selBrush);
@@ -1397,8 +797,7 @@ struct Editor {
                 while ((offset = t.find(autoStr, offset)) != std::string::npos) {
                     bool match = true;
                     if (isWholeWord) {
-                        if (offset > 0 && isWordChar(t[offset - 1])) match = false;
-                        if (match && (offset + qLen < t.length()) && isWordChar(t[offset + qLen])) match = false;
+                        if (!IsWordBoundary(t, offset) || !IsWordBoundary(t, offset + qLen)) match = false;
                     }
                     if (match) {
                         size_t startU16 = UTF8ToW(t.substr(0, offset)).length();
@@ -1418,6 +817,23 @@ struct Editor {
                 }
             }
             autoHlBrush->Release();
+            // キャレットの隣の括弧と対応する括弧 (文字列の " ならもう一方の "、なければキャレットを囲む組) を枠で囲む。画面に出ている側だけ描く
+            size_t bracketOpen = 0, bracketClose = 0;
+            if (bracketPairAt(mainCaretPos, bracketOpen, bracketClose)) {
+                ID2D1SolidColorBrush* bracketBrush = nullptr; rend->CreateSolidColorBrush(bracketColor, &bracketBrush);
+                for (size_t pos : { bracketOpen, bracketClose }) {
+                    bool shown = false; size_t rel = VisibleOffsetOf(spans, pos, &shown);
+                    if (!shown || rel >= text.size()) continue;
+                    if (hasIME && rel >= caretOffsetInVisible) rel += imeComp.size();
+                    UINT32 idx16 = (UINT32)UTF8ToW(text.substr(0, rel)).size();
+                    DWRITE_HIT_TEST_METRICS mm; UINT32 count = 0;
+                    if (SUCCEEDED(layout->HitTestTextRange(idx16, 1, 0, 0, &mm, 1, &count)) && count > 0) {
+                        float top = std::floor((mm.top + lineHeight * 0.5f) / lineHeight) * lineHeight;
+                        rend->DrawRectangle(D2D1::RectF(mm.left + 0.5f, top + 0.5f, mm.left + mm.width - 0.5f, top + lineHeight - 0.5f), bracketBrush);
+                    }
+                }
+                bracketBrush->Release();
+            }
             if (!searchQuery.empty()) {
                 if (searchRegex) {
                     try {
@@ -1443,7 +859,7 @@ struct Editor {
                     size_t offset = 0;
                     while ((offset = t.find(q, offset)) != std::string::npos) {
                         bool match = true;
-                        if (searchWholeWord) { if (offset > 0 && isWordChar(text[offset - 1])) match = false; if (match && (offset + q.length() < text.length()) && isWordChar(text[offset + q.length()])) match = false; }
+                        if (searchWholeWord && (!IsWordBoundary(text, offset) || !IsWordBoundary(text, offset + q.length()))) match = false;
                         if (match) {
                             size_t startU16 = UTF8ToW(text.substr(0, offset)).length(); size_t lenU16 = UTF8ToW(text.substr(offset, q.length())).length();
                             UINT32 count = 0; layout->HitTestTextRange((UINT32)startU16, (UINT32)lenU16, 0, 0, 0, 0, &count);
@@ -1458,7 +874,7 @@ struct Editor {
             }
             ID2D1Geometry* unifiedSelectionGeo = nullptr; std::vector<D2D1_RECT_F> rawRects; float hInset = 4.0f; float vInset = 0.0f;
             for (const auto& cursor : cursors) {
-                size_t s = cursor.start(); size_t e = cursor.end(); size_t relS = (s > visibleStartOffset) ? s - visibleStartOffset : 0; size_t relE = (e > visibleStartOffset) ? e - visibleStartOffset : 0;
+                size_t s = cursor.start(); size_t e = cursor.end(); size_t relS = VisibleOffsetOf(spans, s); size_t relE = VisibleOffsetOf(spans, e);
                 if (hasIME) { if (relS >= caretOffsetInVisible) relS += imeComp.size(); if (relE >= caretOffsetInVisible) relE += imeComp.size(); }
                 if (relS < text.size() && relS != relE) {
                     if (relE > text.size()) relE = text.size();
@@ -1597,9 +1013,9 @@ struct Editor {
         rend->SetTransform(D2D1::Matrix3x2F::Identity());
         ID2D1SolidColorBrush* gutterBgBrush = nullptr; rend->CreateSolidColorBrush(gutterBg, &gutterBgBrush); rend->FillRectangle(D2D1::RectF(0, 0, gutterWidth, clientH), gutterBgBrush); gutterBgBrush->Release();
         ID2D1SolidColorBrush* gutterTextBrush = nullptr; rend->CreateSolidColorBrush(gutterText, &gutterTextBrush);
-        int startLine = vScrollPos; int endLine = startLine + linesVisible; if (endLine > (int)lineStarts.size()) endLine = (int)lineStarts.size();
+        int startLine = vScrollPos; int endLine = startLine + linesVisible; if (endLine > viewLineCount()) endLine = viewLineCount();
         for (int i = startLine; i < endLine; i++) {
-            std::wstring numStr = std::to_wstring(i + 1); float yPos = (float)((i - startLine)) * lineHeight; IDWriteTextLayout* numLayout = nullptr;
+            std::wstring numStr = std::to_wstring(viewLineAt(i) + 1); float yPos = (float)((i - startLine)) * lineHeight; IDWriteTextLayout* numLayout = nullptr;
             if (SUCCEEDED(dwFactory->CreateTextLayout(numStr.c_str(), (UINT32)numStr.size(), textFormat, gutterWidth, lineHeight, &numLayout))) {
                 numLayout->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_TRAILING); rend->DrawTextLayout(D2D1::Point2F(0, yPos), numLayout, gutterTextBrush); numLayout->Release();
             }
@@ -1610,8 +1026,8 @@ struct Editor {
             rend->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
             rend->SetTransform(transform);
             if (isDragMoving) {
-                size_t relPos = (dragMoveDestPos > visibleStartOffset) ? dragMoveDestPos - visibleStartOffset : 0;
-                if (relPos <= text.size()) {
+                bool shown = false; size_t relPos = VisibleOffsetOf(spans, dragMoveDestPos, &shown);
+                if (shown) {
                     std::string beforeCaret = text.substr(0, relPos); std::wstring wBefore = UTF8ToW(beforeCaret);
                     DWRITE_HIT_TEST_METRICS m; FLOAT px, py;
                     layout->HitTestTextPosition((UINT32)wBefore.size(), FALSE, &px, &py, &m);
@@ -1620,9 +1036,9 @@ struct Editor {
                 }
             }
             for (const auto& cursor : cursors) {
-                size_t head = cursor.head; size_t relHead = (head > visibleStartOffset) ? head - visibleStartOffset : 0;
+                bool shown = false; size_t relHead = VisibleOffsetOf(spans, cursor.head, &shown);
                 if (hasIME && relHead >= caretOffsetInVisible) relHead += imeComp.size();
-                if (relHead <= text.size()) {
+                if (shown) {
                     std::string beforeCaret = text.substr(0, relHead); std::wstring wBefore = UTF8ToW(beforeCaret);
                     DWRITE_HIT_TEST_METRICS m; FLOAT px, py;
                     layout->HitTestTextPosition((UINT32)wBefore.size(), FALSE, &px, &py, &m);
@@ -1681,141 +1097,6 @@ struct Editor {
         }
         rend->EndDraw(); EndPaint(hwnd, &ps);
     }
-    void insertAtCursors(const std::string& text) {
-        commitPadding();
-        if (cursors.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        std::vector<int> indices(cursors.size());
-        for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
-        std::sort(indices.begin(), indices.end(), [&](int a, int b) {return cursors[a].start() > cursors[b].start(); });
-        for (int idx : indices) {
-            Cursor& c = cursors[idx];
-            if (isOverwriteMode && !c.hasSelection()) {
-                char ch = (c.head < pt.length()) ? pt.charAt(c.head) : 0;
-                if (ch != 0 && ch != '\n' && ch != '\r') {
-                    size_t nextPos = moveCaretVisual(c.head, true);
-                    size_t charLen = nextPos - c.head;
-                    if (charLen > 0) {
-                        std::string d = pt.getRange(c.head, charLen);
-                        pt.erase(c.head, charLen);
-                        batch.ops.push_back({ EditOp::Erase, c.head, d });
-                        for (auto& o : cursors) {
-                            if (o.head > c.head) o.head -= charLen;
-                            if (o.anchor > c.head) o.anchor -= charLen;
-                        }
-                    }
-                }
-            }
-            if (c.hasSelection()) {
-                size_t s = c.start(); size_t l = c.end() - s;
-                std::string d = pt.getRange(s, l);
-                pt.erase(s, l);
-                batch.ops.push_back({ EditOp::Erase,s,d });
-                for (auto& o : cursors) { if (o.head > s)o.head -= l; if (o.anchor > s)o.anchor -= l; }
-                c.head = s; c.anchor = s;
-            }
-        }
-        for (int idx : indices) {
-            Cursor& c = cursors[idx];
-            size_t p = c.head;
-            pt.insert(p, text);
-            batch.ops.push_back({ EditOp::Insert,p,text });
-            size_t l = text.size();
-            for (auto& o : cursors) { if (o.head >= p)o.head += l; if (o.anchor >= p)o.anchor += l; }
-        }
-        batch.afterCursors = cursors;
-        undo.push(batch);
-        rebuildLineStarts();
-        ensureCaretVisible();
-        updateDirtyFlag();
-    }
-    void deleteForwardAtCursors() {
-        commitPadding();
-        if (cursors.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        std::vector<int> indices(cursors.size());
-        for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
-        std::sort(indices.begin(), indices.end(), [&](int a, int b) {return cursors[a].start() > cursors[b].start(); });
-        for (int idx : indices) {
-            Cursor& c = cursors[idx];
-            size_t s = c.start();
-            size_t l = 0;
-            if (c.hasSelection()) {
-                l = c.end() - s;
-            }
-            else {
-                if (s + 1 < pt.length() && pt.charAt(s) == '\r' && pt.charAt(s + 1) == '\n') {
-                    l = 2;
-                }
-                else {
-                    size_t n = moveCaretVisual(s, true);
-                    if (n > s) l = n - s;
-                }
-            }
-            if (l > 0 && s + l <= pt.length()) {
-                std::string d = pt.getRange(s, l);
-                pt.erase(s, l);
-                batch.ops.push_back({ EditOp::Erase,s,d });
-                for (auto& o : cursors) {
-                    if (o.head > s) o.head -= l;
-                    if (o.anchor > s) o.anchor -= l;
-                }
-                c.head = s; c.anchor = s;
-            }
-        }
-        batch.afterCursors = cursors;
-        undo.push(batch);
-        rebuildLineStarts();
-        ensureCaretVisible();
-        updateDirtyFlag();
-    }
-    void backspaceAtCursors(bool allowCharDeletion = true) {
-        commitPadding();
-        if (cursors.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        std::vector<int> indices(cursors.size());
-        for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
-        std::sort(indices.begin(), indices.end(), [&](int a, int b) {return cursors[a].start() > cursors[b].start(); });
-        for (int idx : indices) {
-            Cursor& c = cursors[idx];
-            size_t s = c.start();
-            size_t l = 0;
-            if (c.hasSelection()) {
-                l = c.end() - s;
-            }
-            else if (allowCharDeletion && s > 0) {
-                if (s >= 2 && pt.charAt(s - 1) == '\n' && pt.charAt(s - 2) == '\r') {
-                    l = 2;
-                    s -= 2;
-                }
-                else {
-                    size_t p = moveCaretVisual(s, false);
-                    if (p < s) { l = s - p; s = p; }
-                }
-            }
-            if (l > 0) {
-                std::string d = pt.getRange(s, l);
-                pt.erase(s, l);
-                batch.ops.push_back({ EditOp::Erase,s,d });
-                for (auto& o : cursors) {
-                    if (o.head > s) o.head -= l;
-                    if (o.anchor > s) o.anchor -= l;
-                }
-                c.head = s;
-                c.anchor = s;
-            }
-        }
-        if (!batch.ops.empty()) {
-            batch.afterCursors = cursors;
-            undo.push(batch);
-            rebuildLineStarts();
-            ensureCaretVisible();
-            updateDirtyFlag();
-        }
-    }
     void insertRectangularBlock(const std::string& text) {
         commitPadding();
         if (cursors.empty()) return;
@@ -1857,12 +1138,12 @@ struct Editor {
             }
             else {
                 size_t lineStart = lineStarts[targetLineIdx] + accumulatedDelta;
-                size_t scanPos = lineStart;
-                size_t maxLen = pt.length();
-                while (scanPos < maxLen && pt.charAt(scanPos) != '\n') {
-                    scanPos++;
-                }
-                size_t lineEnd = scanPos;
+                size_t lineEnd = lineStart;
+                pt.forEachChunk(lineStart, pt.length() - std::min(lineStart, pt.length()), [&](std::string_view chunk) {
+                    size_t nl = chunk.find('\n');
+                    lineEnd += (nl == std::string_view::npos) ? chunk.size() : nl;
+                    return nl == std::string_view::npos;
+                });
                 std::string currentLineStr = pt.getRange(lineStart, lineEnd - lineStart);
                 std::wstring wCurrentLine = UTF8ToW(currentLineStr);
                 size_t insertOffset = wCurrentLine.length();
@@ -1912,194 +1193,8 @@ struct Editor {
         updateDirtyFlag();
         InvalidateRect(hwnd, NULL, FALSE);
     }
-    void convertCase(bool toUpper) {
-        commitPadding();
-        if (cursors.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        bool isChanged = false;
-        std::vector<int> indices(cursors.size());
-        for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
-        std::sort(indices.begin(), indices.end(), [&](int a, int b) {
-            return cursors[a].start() > cursors[b].start();
-            });
-        for (int idx : indices) {
-            Cursor& c = cursors[idx];
-            if (!c.hasSelection()) continue;
-            size_t start = c.start();
-            size_t len = c.end() - start;
-            std::string text = pt.getRange(start, len);
-            std::wstring wText = UTF8ToW(text);
-            if (toUpper) CharUpperBuffW(&wText[0], (DWORD)wText.size());
-            else CharLowerBuffW(&wText[0], (DWORD)wText.size());
-            std::string newText = WToUTF8(wText);
-            if (text == newText) continue;
-            isChanged = true;
-            pt.erase(start, len);
-            batch.ops.push_back({ EditOp::Erase, start, text });
-            pt.insert(start, newText);
-            batch.ops.push_back({ EditOp::Insert, start, newText });
-            long long diff = (long long)newText.size() - (long long)len;
-            if (c.head > c.anchor) {
-                c.head = start + newText.size();
-                c.anchor = start;
-            }
-            else {
-                c.head = start;
-                c.anchor = start + newText.size();
-            }
-            if (diff != 0) {
-                for (size_t k = 0; k < cursors.size(); ++k) {
-                    if ((int)k == idx) continue;
-                    Cursor& other = cursors[k];
-                    if (other.start() > start) {
-                        if (other.head > start) other.head = (size_t)((long long)other.head + diff);
-                        if (other.anchor > start) other.anchor = (size_t)((long long)other.anchor + diff);
-                    }
-                }
-            }
-        }
-        if (isChanged) {
-            batch.afterCursors = cursors;
-            undo.push(batch);
-            rebuildLineStarts();
-            ensureCaretVisible();
-            updateDirtyFlag();
-            InvalidateRect(hwnd, NULL, FALSE);
-        }
-    }
-    std::vector<int> getSelectedLineIndices() {
-        std::vector<int> lines;
-        for (const auto& c : cursors) {
-            int startLine = getLineIdx(c.start());
-            int endLine = getLineIdx(c.end());
-            if (c.hasSelection() && c.end() > c.start()) {
-                if (c.end() > 0 && pt.charAt(c.end() - 1) == '\n') {
-                    if (endLine > startLine) endLine--;
-                }
-            }
-            for (int i = startLine; i <= endLine; ++i) lines.push_back(i);
-        }
-        std::sort(lines.begin(), lines.end());
-        lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
-        return lines;
-    }
-    void duplicateLines(bool up) {
-        commitPadding();
-        if (cursors.empty()) return;
-        std::vector<int> lines = getSelectedLineIndices();
-        if (lines.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        std::string blockText;
-        size_t blockStart = lineStarts[lines.front()];
-        size_t blockEnd = (lines.back() + 1 < (int)lineStarts.size()) ? lineStarts[lines.back() + 1] : pt.length();
-        blockText = pt.getRange(blockStart, blockEnd - blockStart);
-        bool needNewline = false;
-        if (blockText.empty() || blockText.back() != '\n') {
-            blockText += newlineStr;
-            needNewline = true;
-        }
-        size_t insertPos;
-        if (up) {
-            insertPos = blockStart;
-        }
-        else {
-            insertPos = blockEnd;
-            if (needNewline && blockEnd == pt.length() && blockEnd > 0 && pt.charAt(blockEnd - 1) != '\n') {
-                pt.insert(blockEnd, newlineStr);
-                batch.ops.push_back({ EditOp::Insert, blockEnd, newlineStr });
-                insertPos += newlineStr.length();
-            }
-        }
-        pt.insert(insertPos, blockText);
-        batch.ops.push_back({ EditOp::Insert, insertPos, blockText });
-        batch.afterCursors.clear();
-        size_t newSelectionStart = insertPos;
-        size_t newSelectionEnd = insertPos + blockText.size();
-        batch.afterCursors.push_back({ newSelectionEnd, newSelectionStart, getXFromPos(newSelectionEnd) });
-        cursors = batch.afterCursors;
-        undo.push(batch);
-        rebuildLineStarts();
-        ensureCaretVisible();
-        updateDirtyFlag();
-        InvalidateRect(hwnd, NULL, FALSE);
-    }
-    void moveLines(bool up) {
-        commitPadding();
-        if (cursors.empty()) return;
-        std::vector<int> lines = getSelectedLineIndices();
-        if (lines.empty()) return;
-        if (up && lines.front() == 0) return;
-        if (!up && lines.back() >= (int)lineStarts.size() - 1) return;
-        int startLine = lines.front();
-        int endLine = lines.back();
-        size_t rangeStart = lineStarts[startLine];
-        size_t rangeEnd = (endLine + 1 < (int)lineStarts.size()) ? lineStarts[endLine + 1] : pt.length();
-        std::string textToMove = pt.getRange(rangeStart, rangeEnd - rangeStart);
-        bool isLastLineNoNewline = (rangeEnd == pt.length()) && (textToMove.empty() || textToMove.back() != '\n');
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        if (up) {
-            int targetLineIdx = startLine - 1;
-            size_t targetStart = lineStarts[targetLineIdx];
-            size_t targetEnd = rangeStart;
-            std::string lineAbove = pt.getRange(targetStart, targetEnd - targetStart);
-            long long diff = -(long long)(rangeStart - targetStart);
-            if (isLastLineNoNewline) {
-                textToMove += newlineStr;
-                if (!lineAbove.empty() && lineAbove.back() == '\n') {
-                    if (lineAbove.size() >= 2 && lineAbove[lineAbove.size() - 2] == '\r') lineAbove.pop_back(), lineAbove.pop_back();
-                    else lineAbove.pop_back();
-                }
-            }
-            size_t deleteLen = rangeEnd - targetStart;
-            std::string deletedAll = pt.getRange(targetStart, deleteLen);
-            pt.erase(targetStart, deleteLen);
-            batch.ops.push_back({ EditOp::Erase, targetStart, deletedAll });
-            std::string newText = textToMove + lineAbove;
-            pt.insert(targetStart, newText);
-            batch.ops.push_back({ EditOp::Insert, targetStart, newText });
-            for (auto& c : cursors) {
-                c.head = (size_t)((long long)c.head + diff);
-                c.anchor = (size_t)((long long)c.anchor + diff);
-                c.desiredX = getXFromPos(c.head);
-            }
-        }
-        else {
-            int targetLineIdx = endLine + 1;
-            size_t targetStart = rangeEnd;
-            size_t targetEnd = (targetLineIdx + 1 < (int)lineStarts.size()) ? lineStarts[targetLineIdx + 1] : pt.length();
-            std::string lineBelow = pt.getRange(targetStart, targetEnd - targetStart);
-            if (targetEnd == pt.length() && (lineBelow.empty() || lineBelow.back() != '\n')) {
-                lineBelow += newlineStr;
-                if (!textToMove.empty() && textToMove.back() == '\n') {
-                    if (textToMove.size() >= 2 && textToMove[textToMove.size() - 2] == '\r') textToMove.pop_back(), textToMove.pop_back();
-                    else textToMove.pop_back();
-                }
-            }
-            size_t deleteLen = targetEnd - rangeStart;
-            std::string deletedAll = pt.getRange(rangeStart, deleteLen);
-            pt.erase(rangeStart, deleteLen);
-            batch.ops.push_back({ EditOp::Erase, rangeStart, deletedAll });
-            std::string newText = lineBelow + textToMove;
-            pt.insert(rangeStart, newText);
-            batch.ops.push_back({ EditOp::Insert, rangeStart, newText });
-            long long diff = (long long)lineBelow.size();
-            for (auto& c : cursors) {
-                c.head = (size_t)((long long)c.head + diff);
-                c.anchor = (size_t)((long long)c.anchor + diff);
-                c.desiredX = getXFromPos(c.head);
-            }
-        }
-        batch.afterCursors = cursors;
-        undo.push(batch);
-        rebuildLineStarts();
-        ensureCaretVisible();
-        updateDirtyFlag();
-        InvalidateRect(hwnd, NULL, FALSE);
-    }
     void setClipboard(const std::string& text, bool isLineCopy, bool isRectCopy) {
+        TRACE_SCOPE("setClipboard");
         if (text.empty()) return;
         if (OpenClipboard(hwnd)) {
             EmptyClipboard();
@@ -2123,6 +1218,7 @@ struct Editor {
         }
     }
     void copyToClipboard() {
+        TRACE_SCOPE("copyToClipboard");
         bool hasSelection = false;
         for (const auto& c : cursors) { if (c.hasSelection()) { hasSelection = true; break; } }
         std::string t;
@@ -2162,6 +1258,8 @@ struct Editor {
         }
     }
     void cutToClipboard() {
+        TRACE_SCOPE("cutToClipboard");
+        SessionRecorder::Scope rs(recorder, cursors, "cut");
         bool hasSelection = false;
         for (const auto& c : cursors) { if (c.hasSelection()) { hasSelection = true; break; } }
         if (hasSelection) {
@@ -2191,56 +1289,8 @@ struct Editor {
             deleteLines();
         }
     }
-    void deleteLines() {
-        rollbackPadding();
-        std::vector<Cursor> originalCursors = cursors;
-        std::vector<Cursor> delRanges;
-        bool hasSelection = false;
-        for (const auto& c : cursors) if (c.hasSelection()) hasSelection = true;
-        if (hasSelection) {
-            for (const auto& c : cursors) {
-                int sLine = getLineIdx(c.start());
-                int eLine = getLineIdx(c.end());
-                if (c.hasSelection() && c.end() > 0 && pt.charAt(c.end() - 1) == '\n' && eLine > sLine) {
-                    eLine--;
-                }
-                size_t start = lineStarts[sLine];
-                size_t end = (eLine + 1 < (int)lineStarts.size()) ? lineStarts[eLine + 1] : pt.length();
-                if (end == pt.length() && start > 0) {
-                    char prev = pt.charAt(start - 1);
-                    if (prev == '\n') {
-                        start--;
-                        if (start > 0 && pt.charAt(start - 1) == '\r') start--;
-                    }
-                    else if (prev == '\r') start--;
-                }
-                delRanges.push_back({ end, start, 0.0f });
-            }
-        }
-        else {
-            for (const auto& c : cursors) {
-                int lineIdx = getLineIdx(c.head);
-                size_t start = lineStarts[lineIdx];
-                size_t end = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : pt.length();
-                if (end == pt.length() && start > 0) {
-                    char prev = pt.charAt(start - 1);
-                    if (prev == '\n') {
-                        start--;
-                        if (start > 0 && pt.charAt(start - 1) == '\r') start--;
-                    }
-                    else if (prev == '\r') start--;
-                }
-                delRanges.push_back({ end, start, 0.0f });
-            }
-        }
-        cursors = delRanges;
-        mergeCursors();
-        insertAtCursors("");
-        if (!undo.undoStack.empty()) {
-            undo.undoStack.back().beforeCursors = originalCursors;
-        }
-    }
     void pasteFromClipboard() {
+        TRACE_SCOPE("pasteFromClipboard");
         if (!IsClipboardFormatAvailable(CF_UNICODETEXT)) return;
         if (OpenClipboard(hwnd)) {
             bool isRect = IsClipboardFormatAvailable(cfMsDevCol);
@@ -2252,6 +1302,7 @@ struct Editor {
                     std::wstring w(p);
                     GlobalUnlock(h);
                     std::string utf8 = WToUTF8(w);
+                    SessionRecorder::Scope rs(recorder, cursors, "paste", { isRect ? 2 : (isLine ? 1 : 0) }, { utf8 });
                     if (isRect) {
                         insertRectangularBlock(utf8);
                     }
@@ -2293,9 +1344,7 @@ struct Editor {
         }
     }
     void doInsert(size_t pos, const std::string& s) { cursors.clear(); cursors.push_back({ pos, pos, getXFromPos(pos) }); insertAtCursors(s); }
-    void performUndo() { if (!undo.canUndo())return; EditBatch b = undo.popUndo(); for (int i = (int)b.ops.size() - 1; i >= 0; --i) { const auto& o = b.ops[i]; if (o.type == EditOp::Insert)pt.erase(o.pos, o.text.size()); else pt.insert(o.pos, o.text); }cursors = b.beforeCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); }
-    void performRedo() { if (!undo.canRedo())return; EditBatch b = undo.popRedo(); for (const auto& o : b.ops) { if (o.type == EditOp::Insert)pt.insert(o.pos, o.text); else pt.erase(o.pos, o.text.size()); }cursors = b.afterCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); }
-    int ShowTaskDialog(const wchar_t* title, const wchar_t* instruction, const wchar_t* content, TASKDIALOG_COMMON_BUTTON_FLAGS buttons, PCWSTR icon) { TASKDIALOGCONFIG c = { 0 }; c.cbSize = sizeof(c); c.hwndParent = hwnd; c.hInstance = GetModuleHandle(NULL); c.dwFlags = TDF_ALLOW_DIALOG_CANCELLATION | TDF_POSITION_RELATIVE_TO_WINDOW; c.pszWindowTitle = title; c.pszMainInstruction = instruction; c.pszContent = content; c.dwCommonButtons = buttons; c.pszMainIcon = icon; int n = 0; TaskDialogIndirect(&c, &n, NULL, NULL); return n; }
+    int ShowTaskDialog(const wchar_t* title, const wchar_t* instruction, const wchar_t* content, TASKDIALOG_COMMON_BUTTON_FLAGS buttons, PCWSTR icon) { Watchdog::Pause wp(g_watchdog); TASKDIALOGCONFIG c = { 0 }; c.cbSize = sizeof(c); c.hwndParent = hwnd; c.hInstance = GetModuleHandle(NULL); c.dwFlags = TDF_ALLOW_DIALOG_CANCELLATION | TDF_POSITION_RELATIVE_TO_WINDOW; c.pszWindowTitle = title; c.pszMainInstruction = instruction; c.pszContent = content; c.dwCommonButtons = buttons; c.pszMainIcon = icon; int n = 0; TaskDialogIndirect(&c, &n, NULL, NULL); return n; }
     bool checkUnsavedChanges() { if (!isDirty)return true; int r = ShowTaskDialog(GetResString(IDS_CONFIRM_TITLE).c_str(), GetResString(IDS_SAVE_PROMPT).c_str(), currentFilePath.empty() ? GetResString(IDS_UNTITLED).c_str() : currentFilePath.c_str(), TDCBF_YES_BUTTON | TDCBF_NO_BUTTON | TDCBF_CANCEL_BUTTON, TD_WARNING_ICON); if (r == IDCANCEL)return false; if (r == IDYES) { if (currentFilePath.empty())return saveFileAs(); else return saveFile(currentFilePath); }return true; }
     bool openFile() {
         if (!checkUnsavedChanges()) return false;
@@ -2308,52 +1357,22 @@ struct Editor {
         o.lpstrFilter = L"All\0*.*\0Text\0*.txt\0";
         o.nFilterIndex = 1;
         o.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
+        Watchdog::Pause wp(g_watchdog);
         if (GetOpenFileNameW(&o)) {
             return openFileFromPath(f);
         }
         return false;
     }
     bool saveFile(const std::wstring& p) {
+        TRACE_SCOPE("saveFile");
+        if (trimTrailingOnSave) transformWhitespace(WS_TRIM_TRAILING, true);
         std::wstring t = p + L".tmp";
         HANDLE h = CreateFileW(t.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
         if (h == INVALID_HANDLE_VALUE) {
             ShowTaskDialog(GetResString(IDS_ERROR_TITLE).c_str(), GetResString(IDS_TEMP_FILE_ERR).c_str(), t.c_str(), TDCBF_OK_BUTTON, TD_ERROR_ICON);
             return false;
         }
-        std::string contentUtf8;
-        size_t totalLen = pt.length();
-        if (totalLen > 0) contentUtf8 = pt.getRange(0, totalLen);
-        bool ok = true;
-        DWORD w = 0;
-        if (currentEncoding == ENC_UTF16LE || currentEncoding == ENC_UTF16BE) {
-            std::wstring wStr = Utf8ToUtf16(contentUtf8);
-            unsigned char bomLE[] = { 0xFF, 0xFE };
-            unsigned char bomBE[] = { 0xFE, 0xFF };
-            if (currentEncoding == ENC_UTF16LE) {
-                WriteFile(h, bomLE, 2, &w, NULL);
-            }
-            else {
-                WriteFile(h, bomBE, 2, &w, NULL);
-                SwapBytes(&wStr[0], wStr.size());
-            }
-            DWORD bytesToWrite = (DWORD)(wStr.size() * sizeof(wchar_t));
-            if (!WriteFile(h, wStr.data(), bytesToWrite, &w, NULL) || w != bytesToWrite) ok = false;
-        }
-        else if (currentEncoding == ENC_ANSI) {
-            std::string ansi = Utf8ToAnsi(contentUtf8);
-            if (!ansi.empty()) {
-                if (!WriteFile(h, ansi.data(), (DWORD)ansi.size(), &w, NULL) || w != ansi.size()) ok = false;
-            }
-        }
-        else {
-            if (currentEncoding == ENC_UTF8_BOM) {
-                unsigned char bom[] = { 0xEF, 0xBB, 0xBF };
-                WriteFile(h, bom, 3, &w, NULL);
-            }
-            if (!contentUtf8.empty()) {
-                if (!WriteFile(h, contentUtf8.data(), (DWORD)contentUtf8.size(), &w, NULL) || w != contentUtf8.size()) ok = false;
-            }
-        }
+        bool ok = writeEncoded(currentEncoding, [&](const char* data, size_t len) { DWORD w = 0; return WriteFile(h, data, (DWORD)len, &w, NULL) && w == len; });
         CloseHandle(h);
         if (!ok) {
             DeleteFileW(t.c_str());
@@ -2385,10 +1404,13 @@ struct Editor {
         updateTitleBar();
         return true;
     }
-    bool saveFileAs() { WCHAR f[MAX_PATH] = { 0 }; OPENFILENAMEW o = { 0 }; o.lStructSize = sizeof(o); o.hwndOwner = hwnd; o.lpstrFile = f; o.nMaxFile = MAX_PATH; o.lpstrFilter = L"All\0*.*\0Text\0*.txt\0"; o.nFilterIndex = 1; o.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT; if (GetSaveFileNameW(&o))return saveFile(f); return false; }
+    bool saveFileAs() { WCHAR f[MAX_PATH] = { 0 }; OPENFILENAMEW o = { 0 }; o.lStructSize = sizeof(o); o.hwndOwner = hwnd; o.lpstrFile = f; o.nMaxFile = MAX_PATH; o.lpstrFilter = L"All\0*.*\0Text\0*.txt\0"; o.nFilterIndex = 1; o.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT; Watchdog::Pause wp(g_watchdog); if (GetSaveFileNameW(&o))return saveFile(f); return false; }
     void newFile() {
         if (!checkUnsavedChanges()) return;
         pt.initEmpty();
+        lineFilter = LineFilter();
+        bracketIndex.reset();
+        syntax.reset(SYNTAX_PLAIN);
         currentFilePath.clear();
         newlineStr = "\r\n";
         undo.clear();
@@ -2400,79 +1422,18 @@ struct Editor {
         vScrollPos = 0; hScrollPos = 0;
         fileMap.reset();
         rebuildLineStarts();
+        recordOpen("");
         updateTitleBar();
         InvalidateRect(hwnd, NULL, FALSE);
     }
-    void selectNextOccurrence() {
-        if (cursors.empty()) return;
-        Cursor c = cursors.back();
-        if (!c.hasSelection()) {
-            size_t targetPos = c.head;
-            if (targetPos > 0) {
-                char currChar = pt.charAt(targetPos);
-                char prevChar = pt.charAt(targetPos - 1);
-                if (!isWordChar(currChar) && isWordChar(prevChar)) {
-                    targetPos--;
-                }
-            }
-            selectWordAt(targetPos);
-            InvalidateRect(hwnd, NULL, FALSE);
-            return;
-        }
-        size_t start = c.start();
-        size_t len = c.end() - start;
-        std::string query = pt.getRange(start, len);
-        size_t nextPos = findText(std::max(c.head, c.anchor), query, true, true, false, false);
-        if (nextPos != std::string::npos) {
-            for (const auto& cur : cursors) {
-                if (cur.start() == nextPos) return;
-            }
-            cursors.push_back({ nextPos + len, nextPos, getXFromPos(nextPos + len) });
-            ensureCaretVisible();
-            InvalidateRect(hwnd, NULL, FALSE);
-        }
-    }
     bool openFileFromPath(const std::wstring& path) {
-        fileMap.reset(new MappedFile());
-        if (fileMap->open(path.c_str())) {
-            currentEncoding = DetectEncoding(fileMap->ptr, fileMap->size);
-            convertedBuffer.clear();
-            const char* ptr = fileMap->ptr;
-            size_t size = fileMap->size;
-            switch (currentEncoding) {
-            case ENC_UTF8_BOM:
-                if (size >= 3) { ptr += 3; size -= 3; }
-                pt.initFromFile(ptr, size);
-                detectNewlineStyle(ptr, size);
-                break;
-            case ENC_UTF16LE:
-                convertedBuffer = Utf16ToUtf8(ptr, size, false);
-                pt.initFromFile(convertedBuffer.data(), convertedBuffer.size());
-                detectNewlineStyle(convertedBuffer.data(), convertedBuffer.size());
-                break;
-            case ENC_UTF16BE:
-                convertedBuffer = Utf16ToUtf8(ptr, size, true);
-                pt.initFromFile(convertedBuffer.data(), convertedBuffer.size());
-                detectNewlineStyle(convertedBuffer.data(), convertedBuffer.size());
-                break;
-            case ENC_ANSI:
-                convertedBuffer = AnsiToUtf8(ptr, size);
-                pt.initFromFile(convertedBuffer.data(), convertedBuffer.size());
-                detectNewlineStyle(convertedBuffer.data(), convertedBuffer.size());
-                break;
-            default:
-                pt.initFromFile(ptr, size);
-                detectNewlineStyle(ptr, size);
-                break;
-            }
+        TRACE_SCOPE("openFileFromPath");
+        if (loadFile(path.c_str())) {
             currentFilePath = path;
-            undo.clear();
             isDirty = false;
-            undo.markSaved();
-            cursors.clear();
-            cursors.push_back({ 0, 0, 0.0f });
             vScrollPos = 0; hScrollPos = 0;
-            rebuildLineStarts();
+            updateScrollBars();
+            recordOpen(WToUTF8(path));
             updateTitleBar();
             InvalidateRect(hwnd, NULL, FALSE);
             return true;
@@ -2482,129 +1443,6 @@ struct Editor {
             return false;
         }
     }
-    void indentLines(bool forceLineIndent = false) {
-        bool hasSelection = false;
-        for (const auto& c : cursors) if (c.hasSelection()) hasSelection = true;
-        if (!hasSelection && !forceLineIndent) {
-            insertAtCursors("\t");
-            return;
-        }
-        commitPadding();
-        std::vector<int> lines = getSelectedLineIndices();
-        if (lines.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        std::sort(lines.rbegin(), lines.rend());
-        for (int lineIdx : lines) {
-            size_t pos = lineStarts[lineIdx];
-            std::string indentStr = "\t";
-            pt.insert(pos, indentStr);
-            batch.ops.push_back({ EditOp::Insert, pos, indentStr });
-            for (auto& c : cursors) {
-                if (c.head >= pos) c.head += indentStr.size();
-                if (c.anchor >= pos) c.anchor += indentStr.size();
-                c.desiredX = getXFromPos(c.head);
-            }
-        }
-        batch.afterCursors = cursors;
-        undo.push(batch);
-        rebuildLineStarts();
-        ensureCaretVisible();
-        updateDirtyFlag();
-        InvalidateRect(hwnd, NULL, FALSE);
-    }
-    void unindentLines() {
-        commitPadding();
-        std::vector<int> lines = getSelectedLineIndices();
-        if (lines.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        std::sort(lines.rbegin(), lines.rend());
-        for (int lineIdx : lines) {
-            size_t pos = lineStarts[lineIdx];
-            if (pos >= pt.length()) continue;
-            char c = pt.charAt(pos);
-            size_t eraseLen = 0;
-            if (c == '\t') eraseLen = 1;
-            else if (c == ' ') eraseLen = 1;
-            if (eraseLen > 0) {
-                std::string deleted = pt.getRange(pos, eraseLen);
-                pt.erase(pos, eraseLen);
-                batch.ops.push_back({ EditOp::Erase, pos, deleted });
-                for (auto& c : cursors) {
-                    if (c.head > pos) c.head -= std::min(c.head - pos, eraseLen);
-                    if (c.anchor > pos) c.anchor -= std::min(c.anchor - pos, eraseLen);
-                    c.desiredX = getXFromPos(c.head);
-                }
-            }
-        }
-        if (!batch.ops.empty()) {
-            batch.afterCursors = cursors;
-            undo.push(batch);
-            rebuildLineStarts();
-            ensureCaretVisible();
-            updateDirtyFlag();
-            InvalidateRect(hwnd, NULL, FALSE);
-        }
-    }
-    void insertNewlineWithAutoIndent() {
-        commitPadding();
-        if (cursors.empty()) return;
-        EditBatch batch;
-        batch.beforeCursors = cursors;
-        std::vector<int> indices(cursors.size());
-        for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
-        std::sort(indices.begin(), indices.end(), [&](int a, int b) {
-            return cursors[a].start() > cursors[b].start();
-            });
-        for (int idx : indices) {
-            Cursor& c = cursors[idx];
-            size_t start = c.start();
-            if (c.hasSelection()) {
-                size_t len = c.end() - start;
-                std::string deleted = pt.getRange(start, len);
-                pt.erase(start, len);
-                batch.ops.push_back({ EditOp::Erase, start, deleted });
-                for (auto& o : cursors) {
-                    if (o.head > start) o.head -= len;
-                    if (o.anchor > start) o.anchor -= len;
-                }
-                c.head = start; c.anchor = start;
-            }
-            int lineIdx = getLineIdx(start);
-            size_t lineStart = lineStarts[lineIdx];
-            std::string indentStr = "";
-            size_t p = lineStart;
-            size_t maxLen = pt.length();
-            while (p < maxLen && p < start) {
-                char ch = pt.charAt(p);
-                if (ch == ' ' || ch == '\t') {
-                    indentStr += ch;
-                }
-                else {
-                    break;
-                }
-                p++;
-            }
-            std::string textToInsert = newlineStr + indentStr;
-            pt.insert(start, textToInsert);
-            batch.ops.push_back({ EditOp::Insert, start, textToInsert });
-            size_t insLen = textToInsert.size();
-            for (auto& o : cursors) {
-                if (o.head >= start) o.head += insLen;
-                if (o.anchor >= start) o.anchor += insLen;
-                if (&o == &c) {
-                    o.desiredX = getXFromPos(o.head);
-                }
-            }
-        }
-        batch.afterCursors = cursors;
-        undo.push(batch);
-        rebuildLineStarts();
-        ensureCaretVisible();
-        updateDirtyFlag();
-        InvalidateRect(hwnd, NULL, FALSE);
-    }
     void toggleFullScreen() {
         if (!hwnd) return;
         DWORD style = GetWindowLong(hwnd, GWL_STYLE);
@@ -2670,10 +1508,11 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             if (inSel) { g_editor.isDragMovePending = true; g_editor.dragMoveSourceStart = g_editor.cursors.back().start(); g_editor.dragMoveSourceEnd = g_editor.cursors.back().end(); return 0; }
         }
         g_editor.isDragMovePending = false; g_editor.isDragMoving = false;
-        if (GetKeyState(VK_MENU) & 0x8000) { g_editor.isRectSelecting = true; float vx = x / g_editor.dpiScaleX - g_editor.gutterWidth + g_editor.hScrollPos; float vy = y / g_editor.dpiScaleY + (g_editor.vScrollPos * g_editor.lineHeight); g_editor.rectAnchorX = g_editor.rectHeadX = vx; g_editor.rectAnchorY = g_editor.rectHeadY = vy; g_editor.updateRectSelection(); }
+        if ((GetKeyState(VK_MENU) & 0x8000) && !g_editor.lineFilter.active) { g_editor.isRectSelecting = true; float vx = x / g_editor.dpiScaleX - g_editor.gutterWidth + g_editor.hScrollPos; float vy = y / g_editor.dpiScaleY + (g_editor.vScrollPos * g_editor.lineHeight); g_editor.rectAnchorX = g_editor.rectHeadX = vx; g_editor.rectAnchorY = g_editor.rectHeadY = vy; g_editor.updateRectSelection(); }
         else g_editor.isRectSelecting = false;
         if (x / g_editor.dpiScaleX < g_editor.gutterWidth) {
-            int line = g_editor.vScrollPos + (int)(y / g_editor.dpiScaleY / g_editor.lineHeight);
+            int row = g_editor.vScrollPos + (int)(y / g_editor.dpiScaleY / g_editor.lineHeight);
+            int line = (row >= 0 && row < g_editor.viewLineCount()) ? g_editor.viewLineAt(row) : -1;
             if (line >= 0 && line < (int)g_editor.lineStarts.size()) { size_t s = g_editor.lineStarts[line]; size_t e = (line + 1 < (int)g_editor.lineStarts.size()) ? g_editor.lineStarts[line + 1] : g_editor.pt.length(); g_editor.cursors.clear(); g_editor.cursors.push_back({ e, s, g_editor.getXFromPos(e) }); }
         }
         else {
@@ -2722,7 +1561,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_VSCROLL: {
         RECT rc; GetClientRect(hwnd, &rc); int page = (int)((rc.bottom / g_editor.dpiScaleY) / g_editor.lineHeight);
     switch (LOWORD(wParam)) { case SB_LINEUP: g_editor.vScrollPos--; break; case SB_LINEDOWN: g_editor.vScrollPos++; break; case SB_PAGEUP: g_editor.vScrollPos -= page; break; case SB_PAGEDOWN: g_editor.vScrollPos += page; break; case SB_THUMBTRACK: { SCROLLINFO si = { sizeof(SCROLLINFO), SIF_TRACKPOS }; GetScrollInfo(hwnd, SB_VERT, &si); g_editor.vScrollPos = si.nTrackPos; } break; }
-                                            if (g_editor.vScrollPos < 0) g_editor.vScrollPos = 0; if (g_editor.vScrollPos > (int)g_editor.lineStarts.size()) g_editor.vScrollPos = (int)g_editor.lineStarts.size(); g_editor.updateScrollBars(); InvalidateRect(hwnd, NULL, FALSE);
+                                            if (g_editor.vScrollPos < 0) g_editor.vScrollPos = 0; if (g_editor.vScrollPos > g_editor.viewLineCount()) g_editor.vScrollPos = g_editor.viewLineCount(); g_editor.updateScrollBars(); InvalidateRect(hwnd, NULL, FALSE);
     } break;
     case WM_HSCROLL: {
     switch (LOWORD(wParam)) { case SB_LINELEFT: g_editor.hScrollPos -= 10; break; case SB_LINERIGHT: g_editor.hScrollPos += 10; break; case SB_PAGELEFT: g_editor.hScrollPos -= 100; break; case SB_PAGERIGHT: g_editor.hScrollPos += 100; break; case SB_THUMBTRACK: { SCROLLINFO si = { sizeof(SCROLLINFO), SIF_TRACKPOS }; GetScrollInfo(hwnd, SB_HORZ, &si); g_editor.hScrollPos = si.nTrackPos; } break; }
@@ -2735,11 +1574,28 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         }
         else {
             g_editor.vScrollPos -= GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA * 3;
-            if (g_editor.vScrollPos < 0) g_editor.vScrollPos = 0; if (g_editor.vScrollPos > (int)g_editor.lineStarts.size()) g_editor.vScrollPos = (int)g_editor.lineStarts.size();
+            if (g_editor.vScrollPos < 0) g_editor.vScrollPos = 0; if (g_editor.vScrollPos > g_editor.viewLineCount()) g_editor.vScrollPos = g_editor.viewLineCount();
             g_editor.updateScrollBars();
         }
         InvalidateRect(hwnd, NULL, FALSE); break;
-    case WM_TIMER: if (wParam == 1) { KillTimer(hwnd, 1); InvalidateRect(hwnd, NULL, FALSE); } break;
+    case WM_TIMER:
+        if (wParam == 1) { KillTimer(hwnd, 1); InvalidateRect(hwnd, NULL, FALSE); }
+        else if (wParam == COMPACT_TIMER_ID) {
+            // 入力が来ていれば次の機会に回す。1 回は 8ms までにして残りは短い間隔で続ける
+            if (HIWORD(GetQueueStatus(QS_INPUT))) break;
+            if (g_editor.compactPieces(8000000)) SetTimer(hwnd, COMPACT_TIMER_ID, 10, NULL); else KillTimer(hwnd, COMPACT_TIMER_ID);
+        }
+        else if (wParam == BRACKET_TIMER_ID) {
+            if (HIWORD(GetQueueStatus(QS_INPUT))) break;
+            if (g_editor.buildBracketIndex(8000000)) SetTimer(hwnd, BRACKET_TIMER_ID, 10, NULL);
+            else { KillTimer(hwnd, BRACKET_TIMER_ID); InvalidateRect(hwnd, NULL, FALSE); }
+        }
+        else if (wParam == SYNTAX_TIMER_ID) {
+            if (HIWORD(GetQueueStatus(QS_INPUT))) break;
+            if (g_editor.buildSyntaxStates(8000000)) SetTimer(hwnd, SYNTAX_TIMER_ID, 10, NULL);
+            else { KillTimer(hwnd, SYNTAX_TIMER_ID); InvalidateRect(hwnd, NULL, FALSE); }
+        }
+        break;
     case WM_CHAR: {
         if (g_editor.showHelpPopup) { g_editor.showHelpPopup = false; InvalidateRect(hwnd, NULL, FALSE); }
         wchar_t c = (wchar_t)wParam;
@@ -2830,6 +1686,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             case 'X': g_editor.cutToClipboard(); return 0;
             case 'V': g_editor.pasteFromClipboard(); return 0;
             case 'D': g_editor.selectNextOccurrence(); return 0;
+            case 'M':
+                if (GetKeyState(VK_SHIFT) & 0x8000) g_editor.showMemoryStats();
+                else g_editor.jumpToMatchingBracket();
+                return 0;
             case 'G': g_editor.showGoToDialog(); return 0;
             case 'L':
                 if (GetKeyState(VK_SHIFT) & 0x8000) {
@@ -2892,7 +1752,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             bool shift = (GetKeyState(VK_SHIFT) & 0x8000);
             bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000);
             bool alt = (GetKeyState(VK_MENU) & 0x8000);
-            if (alt && shift && (wParam == VK_LEFT || wParam == VK_RIGHT || wParam == VK_UP || wParam == VK_DOWN)) {
+            // 矩形選択は画面の行と文書の行が一致している前提なので、行を絞り込んでいる間は使わない
+            if (alt && shift && !g_editor.lineFilter.active && (wParam == VK_LEFT || wParam == VK_RIGHT || wParam == VK_UP || wParam == VK_DOWN)) {
                 if (!g_editor.isRectSelecting) {
                     g_editor.isRectSelecting = true;
                     float vx = 0, vy = 0;
@@ -2928,34 +1789,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 InvalidateRect(hwnd, NULL, FALSE);
                 return 0;
             }
-            g_editor.rollbackPadding(); g_editor.isRectSelecting = false;
-            for (auto& c : g_editor.cursors) {
-                if (wParam == VK_LEFT) { if (c.hasSelection() && !shift) { c.head = c.start(); c.anchor = c.head; } else { if (ctrl) c.head = g_editor.moveWordLeft(c.head); else c.head = g_editor.moveCaretVisual(c.head, false); if (!shift) c.anchor = c.head; } }
-                else if (wParam == VK_RIGHT) { if (c.hasSelection() && !shift) { c.head = c.end(); c.anchor = c.head; } else { if (ctrl) c.head = g_editor.moveWordRight(c.head); else c.head = g_editor.moveCaretVisual(c.head, true); if (!shift) c.anchor = c.head; } }
-                else if (wParam == VK_UP) { int l = g_editor.getLineIdx(c.head); if (l > 0) c.head = g_editor.getPosFromLineAndX(l - 1, c.desiredX); if (!shift) c.anchor = c.head; }
-                else if (wParam == VK_DOWN) { int l = g_editor.getLineIdx(c.head); if (l + 1 < (int)g_editor.lineStarts.size()) c.head = g_editor.getPosFromLineAndX(l + 1, c.desiredX); if (!shift) c.anchor = c.head; }
-                else if (wParam == VK_HOME) { if (ctrl) c.head = 0; else { size_t p = c.head; while (p > 0 && g_editor.pt.charAt(p - 1) != '\n') p--; c.head = p; } if (!shift) c.anchor = c.head; }
-                else if (wParam == VK_END) {
-                    if (ctrl) c.head = g_editor.pt.length();
-                    else {
-                        size_t p = c.head;
-                        size_t len = g_editor.pt.length();
-                        while (p < len && g_editor.pt.charAt(p) != '\n') p++;
-                        if (p > 0 && p < len && g_editor.pt.charAt(p) == '\n') {
-                            if (g_editor.pt.charAt(p - 1) == '\r') {
-                                p--;
-                            }
-                        }
-                        c.head = p;
-                    }
-                    if (!shift) c.anchor = c.head;
-                    c.desiredX = g_editor.getXFromPos(c.head);
-                }
-                else if (wParam == VK_PRIOR) { RECT r; GetClientRect(hwnd, &r); int p = (int)((r.bottom / g_editor.dpiScaleY) / g_editor.lineHeight); int l = g_editor.getLineIdx(c.head); c.head = g_editor.getPosFromLineAndX(std::max(0, l - p), c.desiredX); if (!shift) c.anchor = c.head; }
-                else if (wParam == VK_NEXT) { RECT r; GetClientRect(hwnd, &r); int p = (int)((r.bottom / g_editor.dpiScaleY) / g_editor.lineHeight); int l = g_editor.getLineIdx(c.head); c.head = g_editor.getPosFromLineAndX(std::min((int)g_editor.lineStarts.size() - 1, l + p), c.desiredX); if (!shift) c.anchor = c.head; }
-                if (wParam == VK_LEFT || wParam == VK_RIGHT || wParam == VK_HOME || wParam == VK_END) c.desiredX = g_editor.getXFromPos(c.head);
-            }
-            g_editor.mergeCursors(); g_editor.ensureCaretVisible(); InvalidateRect(hwnd, NULL, FALSE);
+            g_editor.isRectSelecting = false;
+            CaretMove move = (wParam == VK_LEFT) ? MOVE_LEFT : (wParam == VK_RIGHT) ? MOVE_RIGHT : (wParam == VK_UP) ? MOVE_UP : (wParam == VK_DOWN) ? MOVE_DOWN : (wParam == VK_HOME) ? MOVE_HOME : (wParam == VK_END) ? MOVE_END : (wParam == VK_PRIOR) ? MOVE_PAGEUP : MOVE_PAGEDOWN;
+            RECT r; GetClientRect(hwnd, &r); int page = (int)((r.bottom / g_editor.dpiScaleY) / g_editor.lineHeight);
+            g_editor.moveCursors(move, shift, ctrl, page);
         }
         break;
     case WM_DROPFILES: {
@@ -2970,7 +1807,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     } break;
     case WM_CLOSE: if (g_editor.checkUnsavedChanges()) DestroyWindow(hwnd); return 0;
     case WM_PAINT: g_editor.render(); break;
-    case WM_DESTROY: g_editor.destroyGraphics(); PostQuitMessage(0); break;
+    case WM_APP_TASKDONE: { TRACE_SCOPE("taskResults"); g_uiTasks.drain(); } break;
+    case WM_ENTERSIZEMOVE: case WM_ENTERMENULOOP: g_watchdog.pause(); return DefWindowProc(hwnd, msg, wParam, lParam);
+    case WM_EXITSIZEMOVE: case WM_EXITMENULOOP: g_watchdog.resume(); return DefWindowProc(hwnd, msg, wParam, lParam);
+    case WM_DESTROY: if (!g_editor.tracePath.empty()) TraceWriteChromeJson(g_editor.tracePath.c_str()); g_editor.destroyGraphics(); PostQuitMessage(0); break;
     default: return DefWindowProc(hwnd, msg, wParam, lParam);
     }
     return 0;
@@ -2986,10 +1826,21 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     int initialHeight = MulDiv(600, dpiY, 96);
     HWND hwnd = CreateWindowEx(0, wc.lpszClassName, L"miu", WS_OVERLAPPEDWINDOW | WS_VSCROLL | WS_HSCROLL, CW_USEDEFAULT, CW_USEDEFAULT, initialWidth, initialHeight, NULL, NULL, hInstance, NULL);
     if (!hwnd) return 0; ShowWindow(hwnd, nShowCmd);
+    g_uiTasks.wake = [hwnd] { PostMessage(hwnd, WM_APP_TASKDONE, 0, 0); };
+    int watchdogMs = 50;
     if (g_editor.currentFilePath.empty()) {
         int argc; wchar_t** argv = CommandLineToArgvW(GetCommandLineW(), &argc);
-        if (argc >= 2) {
-            g_editor.openFileFromPath(argv[1]);
+        const wchar_t* fileArg = nullptr;
+        for (int i = 1; i < argc; ++i) {
+            if (wcscmp(argv[i], L"--record") == 0 && i + 1 < argc) g_editor.recorder.open(argv[++i]);
+            else if (wcscmp(argv[i], L"--trace") == 0 && i + 1 < argc) { g_editor.tracePath = argv[++i]; TraceSetEnabled(true); }
+            else if (wcscmp(argv[i], L"--watchdog") == 0 && i + 1 < argc) watchdogMs = _wtoi(argv[++i]);
+            else if (wcscmp(argv[i], L"--spill-mb") == 0 && i + 1 < argc) g_editor.pt.addBuf.spillThreshold = (size_t)_wtoi(argv[++i]) << 20;
+            else if (!fileArg) fileArg = argv[i];
+        }
+        if (g_editor.recorder.isOpen() && !fileArg) g_editor.recordOpen("");
+        if (fileArg) {
+            g_editor.openFileFromPath(fileArg);
         }
         else {
             g_editor.showHelpPopup = true;
@@ -2998,7 +1849,16 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         LocalFree(argv);
     }
     g_editor.updateTitleBar();
+    if (watchdogMs > 0) {
+        WCHAR tempDir[MAX_PATH];
+        DWORD n = GetTempPathW(MAX_PATH, tempDir);
+        g_watchdog.budgetNs = (uint64_t)watchdogMs * 1000000ull;
+        g_watchdog.messageName = WatchdogMessageName;
+        g_watchdog.describe = [] { return g_editor.diagnosticsContext(); };
+        if (n > 0 && n < MAX_PATH) g_watchdog.start(std::wstring(tempDir) + L"miu-diagnostics.log");
+    }
     MSG msg; while (GetMessage(&msg, NULL, 0, 0)) {
+        Watchdog::Message wm(g_watchdog, msg.message, (uint64_t)msg.wParam);
         if (msg.message == WM_KEYDOWN) {
             if (msg.wParam == VK_F1) {
                 g_editor.showHelpPopup = !g_editor.showHelpPopup;
@@ -3014,6 +1874,11 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
                 g_editor.toggleFullScreen();
                 continue;
             }
+            if (msg.wParam == VK_F9) {
+                if (GetKeyState(VK_SHIFT) & 0x8000) g_editor.toggleLineFilter();
+                else g_editor.showLineOperations();
+                continue;
+            }
             if (GetKeyState(VK_CONTROL) & 0x8000) {
                 if (msg.wParam == 'F') {
                     g_editor.showFindDialog(false);
@@ -3034,5 +1899,6 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         }
         if (!g_editor.hFindDlg || !IsDialogMessage(g_editor.hFindDlg, &msg)) { TranslateMessage(&msg); DispatchMessage(&msg); }
     }
+    g_watchdog.stop();
     return 0;
 }
\ No newline at end of file
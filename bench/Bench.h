@@ -0,0 +1,121 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// 最小限のベンチマークハーネス (ns/op, bytes/s, peak RSS, JSON 出力)
+struct BenchResult {
+    std::string name; size_t docSize = 0; uint64_t iterations = 0;
+    double nsPerOp = 0.0; double bytesPerSec = 0.0; size_t peakRss = 0;
+};
+
+inline size_t PeakRss() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc = { sizeof(pmc) };
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage ru; if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return (size_t)ru.ru_maxrss;
+#else
+    return (size_t)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+inline double NowNs() { return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+inline uint64_t SplitMix64(uint64_t& s) { uint64_t z = (s += 0x9E3779B97F4A7C15ULL); z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL; z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL; return z ^ (z >> 31); }
+
+// 英単語風の行 (LF 区切り) を決定的に生成する
+inline std::string MakeSyntheticDocument(size_t size, uint64_t seed = 1) {
+    static const char* words[] = { "alpha", "beta", "gamma", "delta", "miu", "piece", "table", "editor", "cursor", "undo", "line", "search", "value", "index", "_tmp", "0x1F" };
+    std::string s; s.reserve(size);
+    size_t col = 0;
+    while (s.size() < size) {
+        const char* w = words[SplitMix64(seed) & 15];
+        s.append(w); col += strlen(w);
+        if (col > 40 + (SplitMix64(seed) % 60)) { s.push_back('\n'); col = 0; }
+        else { s.push_back(' '); col++; }
+    }
+    s.resize(size);
+    return s;
+}
+
+inline size_t ParseSize(const char* s) {
+    char* end = nullptr; double v = strtod(s, &end);
+    if (end && (*end == 'K' || *end == 'k')) v *= 1024.0;
+    else if (end && (*end == 'M' || *end == 'm')) v *= 1024.0 * 1024.0;
+    else if (end && (*end == 'G' || *end == 'g')) v *= 1024.0 * 1024.0 * 1024.0;
+    return (size_t)v;
+}
+
+inline std::string FormatSize(size_t n) {
+    char buf[32];
+    if (n >= (1ULL << 30) && n % (1ULL << 30) == 0) snprintf(buf, sizeof(buf), "%zuG", n >> 30);
+    else if (n >= (1ULL << 20) && n % (1ULL << 20) == 0) snprintf(buf, sizeof(buf), "%zuM", n >> 20);
+    else if (n >= 1024 && n % 1024 == 0) snprintf(buf, sizeof(buf), "%zuK", n >> 10);
+    else snprintf(buf, sizeof(buf), "%zu", n);
+    return buf;
+}
+
+// fn(i) を minTimeSec 以上回るまで反復回数を倍々に増やして計測する
+template <class F>
+BenchResult RunBench(const std::string& name, size_t docSize, size_t bytesPerOp, double minTimeSec, F&& fn) {
+    BenchResult r; r.name = name; r.docSize = docSize;
+    uint64_t iters = 1; uint64_t done = 0; double elapsed = 0.0;
+    while (true) {
+        double t0 = NowNs();
+        for (uint64_t i = 0; i < iters; ++i) fn(done + i);
+        elapsed += NowNs() - t0; done += iters;
+        if (elapsed >= minTimeSec * 1e9) break;
+        double perOp = elapsed / (double)done;
+        uint64_t want = (uint64_t)((minTimeSec * 1e9 - elapsed) / (perOp > 0.0 ? perOp : 1.0) * 1.1) + 1;
+        iters = std::min(iters * 10, want);
+    }
+    r.iterations = done; r.nsPerOp = elapsed / (double)done;
+    r.bytesPerSec = bytesPerOp ? (double)bytesPerOp * 1e9 / r.nsPerOp : 0.0;
+    r.peakRss = PeakRss();
+    return r;
+}
+
+inline std::string JsonEscape(const std::string& s) {
+    std::string o;
+    for (char c : s) {
+        if (c == '"' || c == '\\') { o += '\\'; o += c; }
+        else if ((unsigned char)c < 0x20) { char b[8]; snprintf(b, sizeof(b), "\\u%04x", c); o += b; }
+        else o += c;
+    }
+    return o;
+}
+
+inline void PrintResult(const BenchResult& r) {
+    printf("%-28s %8s %12llu %14.1f ns/op %10.1f MB/s %8.1f MB peak\n", r.name.c_str(), FormatSize(r.docSize).c_str(), (unsigned long long)r.iterations, r.nsPerOp, r.bytesPerSec / (1024.0 * 1024.0), r.peakRss / (1024.0 * 1024.0));
+    fflush(stdout);
+}
+
+inline bool WriteJson(const char* path, const char* suite, const std::vector<BenchResult>& results) {
+    FILE* f = fopen(path, "wb"); if (!f) return false;
+    fprintf(f, "{\n  \"suite\": \"%s\",\n  \"timestamp\": %lld,\n  \"results\": [\n", JsonEscape(suite).c_str(), (long long)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"doc_size\": %zu, \"iterations\": %llu, \"ns_per_op\": %.3f, \"bytes_per_sec\": %.1f, \"peak_rss\": %zu}%s\n", JsonEscape(r.name).c_str(), r.docSize, (unsigned long long)r.iterations, r.nsPerOp, r.bytesPerSec, r.peakRss, (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f); return true;
+}
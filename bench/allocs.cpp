@@ -0,0 +1,216 @@
+#include "Bench.h"
+#include "core/Document.h"
+#include "core/Encoding.h"
+#include "core/Search.h"
+#include <atomic>
+#include <functional>
+#include <new>
+
+// グローバル operator new/delete を置き換えて確保回数とバイト数を数える (このバイナリ専用)
+static std::atomic<uint64_t> g_allocCount{ 0 }, g_allocBytes{ 0 }, g_freeCount{ 0 };
+static void* CountedAlloc(size_t n) {
+    g_allocCount.fetch_add(1, std::memory_order_relaxed); g_allocBytes.fetch_add(n, std::memory_order_relaxed);
+    return malloc(n ? n : 1);
+}
+static void CountedFree(void* p) { if (p) { g_freeCount.fetch_add(1, std::memory_order_relaxed); free(p); } }
+void* operator new(size_t n) { if (void* p = CountedAlloc(n)) return p; throw std::bad_alloc(); }
+void* operator new[](size_t n) { if (void* p = CountedAlloc(n)) return p; throw std::bad_alloc(); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return CountedAlloc(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return CountedAlloc(n); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+struct AllocCounts { uint64_t allocs = 0, bytes = 0, frees = 0; };
+static AllocCounts CurrentAllocs() { return { g_allocCount.load(std::memory_order_relaxed), g_allocBytes.load(std::memory_order_relaxed), g_freeCount.load(std::memory_order_relaxed) }; }
+// スコープ内で増えた分だけを取り出す
+struct AllocScope {
+    AllocCounts start = CurrentAllocs();
+    AllocCounts delta() const { AllocCounts c = CurrentAllocs(); return { c.allocs - start.allocs, c.bytes - start.bytes, c.frees - start.frees }; }
+};
+
+static volatile size_t g_sink = 0;
+struct AllocResult { std::string name; size_t docSize = 0; uint64_t ops = 0; double allocsPerOp = 0.0, bytesPerOp = 0.0, freesPerOp = 0.0; };
+struct Fixture { const std::string& doc; size_t size; uint64_t seed; int ops; };
+struct AllocDef { const char* name; std::function<AllocResult(const Fixture&, const char*)> run; };
+
+// 準備 (setup) の確保は数えず、op を ops 回呼んだ分の平均を取る
+template <class Setup, class Op>
+static AllocResult Measure(const char* name, const Fixture& fx, Setup&& setup, Op&& op) {
+    setup();
+    AllocScope scope;
+    for (int i = 0; i < fx.ops; ++i) op(i);
+    AllocCounts d = scope.delta();
+    AllocResult r; r.name = name; r.docSize = fx.size; r.ops = (uint64_t)fx.ops;
+    r.allocsPerOp = (double)d.allocs / fx.ops; r.bytesPerOp = (double)d.bytes / fx.ops; r.freesPerOp = (double)d.frees / fx.ops;
+    return r;
+}
+
+static void LoadDocument(Document& d, const Fixture& fx, size_t caret) {
+    d.pt.initFromFile(fx.doc.data(), fx.size); d.undo.clear(); d.pendingPadding = EditBatch();
+    d.rebuildLineStarts();
+    caret = std::min(caret, fx.size);
+    d.cursors.assign(1, { caret, caret, d.getXFromPos(caret) });
+}
+
+// render と同じ手順で 1 フレーム分のテキストモデル (表示範囲の文字列・UTF-16 変換・検索ハイライトの位置) を作る
+static size_t BuildFrameModel(const Document& d, size_t topLine, int lines) {
+    std::string text = d.visibleText(topLine, lines);
+    std::string wtext = Utf8ToUtf16Bytes(text, false);
+    size_t sink = wtext.size();
+    if (!d.searchQuery.empty()) {
+        size_t offset = 0;
+        while ((offset = text.find(d.searchQuery, offset)) != std::string::npos) {
+            sink += Utf8ToUtf16Bytes(text.substr(0, offset), false).size() + Utf8ToUtf16Bytes(text.substr(offset, d.searchQuery.size()), false).size();
+            offset++;
+        }
+    }
+    return sink;
+}
+
+static std::vector<AllocDef> MakeDefs() {
+    std::vector<AllocDef> b;
+    b.push_back({ "keystroke/insert", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, fx.size / 2); }, [&](int) { d.insertAtCursors("x"); });
+    } });
+    b.push_back({ "keystroke/insert x4 cursors", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] {
+            LoadDocument(d, fx, 0);
+            for (int k = 1; k <= 4; ++k) { size_t p = d.lineStarts[d.lineStarts.size() * k / 5]; d.cursors.push_back({ p, p, 0.0f }); }
+            d.cursors.erase(d.cursors.begin());
+        }, [&](int) { d.insertAtCursors("x"); });
+    } });
+    b.push_back({ "keystroke/backspace", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, fx.size); }, [&](int) { d.backspaceAtCursors(); });
+    } });
+    b.push_back({ "keystroke/newline", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, fx.size / 2); }, [&](int) { d.insertNewlineWithAutoIndent(); });
+    } });
+    b.push_back({ "keystroke/move", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); }, [&](int i) { d.moveCursors((i & 64) ? MOVE_UP : MOVE_DOWN, false, false); });
+    } });
+    b.push_back({ "keystroke/undo+redo", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, fx.size / 2); for (int i = 0; i < 64; ++i) { d.insertAtCursors("ab"); d.insertNewlineWithAutoIndent(); } }, [&](int) { d.performUndo(); d.performRedo(); });
+    } });
+    b.push_back({ "frame/model", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); }, [&](int i) { g_sink = g_sink + BuildFrameModel(d, (size_t)i * 7 % d.lineStarts.size(), 50); });
+    } });
+    b.push_back({ "frame/model+highlight", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); d.searchQuery = "gamma"; }, [&](int i) { g_sink = g_sink + BuildFrameModel(d, (size_t)i * 7 % d.lineStarts.size(), 50); });
+    } });
+    b.push_back({ "search/findText", [](const Fixture& fx, const char* n) {
+        Document d; uint64_t s = fx.seed;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); }, [&](int) { g_sink = g_sink + FindText(d.pt, SplitMix64(s) % fx.size, "gamma delta", true, true, false, false); });
+    } });
+    b.push_back({ "search/findText icase-word", [](const Fixture& fx, const char* n) {
+        Document d; uint64_t s = fx.seed;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); }, [&](int) { g_sink = g_sink + FindText(d.pt, SplitMix64(s) % fx.size, "GAMMA", true, false, true, false); });
+    } });
+    b.push_back({ "search/findText regex", [](const Fixture& fx, const char* n) {
+        Document d; uint64_t s = fx.seed;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); }, [&](int) { g_sink = g_sink + FindText(d.pt, SplitMix64(s) % fx.size, "gam+a", true, true, false, true); });
+    } });
+    b.push_back({ "search/findNext", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); d.searchQuery = "gamma"; }, [&](int) { d.findNextMatch(true); });
+    } });
+    b.push_back({ "search/selectNext", [](const Fixture& fx, const char* n) {
+        Document d;
+        return Measure(n, fx, [&] { LoadDocument(d, fx, 0); d.selectWordAt(0); }, [&](int) { d.selectNextOccurrence(); });
+    } });
+    return b;
+}
+
+static bool WriteAllocJson(const char* path, const std::vector<AllocResult>& results) {
+    FILE* f = fopen(path, "wb"); if (!f) return false;
+    fprintf(f, "{\n  \"suite\": \"allocs\",\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"doc_size\": %zu, \"ops\": %llu, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f, \"frees_per_op\": %.3f}%s\n", JsonEscape(r.name).c_str(), r.docSize, (unsigned long long)r.ops, r.allocsPerOp, r.bytesPerOp, r.freesPerOp, (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f); return true;
+}
+
+// WriteAllocJson が書いた形式だけを読む (name と allocs_per_op の組)
+static bool ReadBaseline(const char* path, std::vector<std::pair<std::string, double>>& out) {
+    FILE* f = fopen(path, "rb"); if (!f) return false;
+    std::string s; char buf[4096]; size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+    fclose(f);
+    size_t p = 0;
+    while ((p = s.find("\"name\": \"", p)) != std::string::npos) {
+        p += 9; size_t e = s.find('"', p); if (e == std::string::npos) break;
+        std::string name = s.substr(p, e - p);
+        size_t a = s.find("\"allocs_per_op\": ", e); if (a == std::string::npos) break;
+        out.push_back({ name, atof(s.c_str() + a + 17) });
+        p = a;
+    }
+    return true;
+}
+
+static void Usage() {
+    printf("usage: miu_allocs [--size N] [--ops N] [--filter STR] [--json PATH] [--check BASELINE] [--tolerance FRAC] [--seed N] [--list]\n"
+        "  counts heap allocations per keystroke, per frame model build and per search on a --size document (default 1M)\n"
+        "  --check fails when allocs/op exceeds the baseline JSON by more than --tolerance (default 0.1) plus 0.5\n");
+}
+
+int main(int argc, char** argv) {
+    size_t size = (size_t)1 << 20; int ops = 1000; double tolerance = 0.1;
+    std::string filter; const char* jsonPath = nullptr; const char* checkPath = nullptr; uint64_t seed = 1; bool listOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* { if (i + 1 >= argc) { Usage(); exit(2); } return argv[++i]; };
+        if (a == "--size") size = ParseSize(next());
+        else if (a == "--ops") ops = atoi(next());
+        else if (a == "--filter") filter = next();
+        else if (a == "--json") jsonPath = next();
+        else if (a == "--check") checkPath = next();
+        else if (a == "--tolerance") tolerance = atof(next());
+        else if (a == "--seed") seed = strtoull(next(), nullptr, 10);
+        else if (a == "--list") listOnly = true;
+        else { Usage(); return a == "--help" || a == "-h" ? 0 : 2; }
+    }
+    auto defs = MakeDefs();
+    if (listOnly) { for (auto& d : defs) printf("%s\n", d.name); return 0; }
+    if (size == 0) size = 1;
+    if (ops <= 0) ops = 1;
+    std::string doc = MakeSyntheticDocument(size, seed);
+    Fixture fx{ doc, size, seed, ops };
+    std::vector<AllocResult> results;
+    printf("%-28s %8s %8s %12s %14s %12s\n", "scenario", "doc", "ops", "allocs/op", "bytes/op", "frees/op");
+    for (auto& d : defs) {
+        if (!filter.empty() && std::string(d.name).find(filter) == std::string::npos) continue;
+        results.push_back(d.run(fx, d.name));
+        const auto& r = results.back();
+        printf("%-28s %8s %8llu %12.2f %14.1f %12.2f\n", r.name.c_str(), FormatSize(r.docSize).c_str(), (unsigned long long)r.ops, r.allocsPerOp, r.bytesPerOp, r.freesPerOp);
+        fflush(stdout);
+    }
+    if (jsonPath && !WriteAllocJson(jsonPath, results)) { fprintf(stderr, "cannot write %s\n", jsonPath); return 1; }
+    if (checkPath) {
+        std::vector<std::pair<std::string, double>> baseline;
+        if (!ReadBaseline(checkPath, baseline)) { fprintf(stderr, "cannot read %s\n", checkPath); return 1; }
+        int regressions = 0;
+        for (const auto& r : results) {
+            for (const auto& b : baseline) {
+                if (b.first != r.name || r.allocsPerOp <= b.second * (1.0 + tolerance) + 0.5) continue;
+                printf("REGRESSION %s: %.2f allocs/op (baseline %.2f)\n", r.name.c_str(), r.allocsPerOp, b.second);
+                regressions++;
+            }
+        }
+        if (regressions) return 1;
+        printf("allocation counts within baseline\n");
+    }
+    return 0;
+}
@@ -0,0 +1,398 @@
+#include "Bench.h"
+#include "core/Document.h"
+#include "core/Encoding.h"
+#include "core/Trace.h"
+#include <random>
+
+// ウィンドウなしで Document にスクリプトの操作を順に適用する (サーバー上の一括変換・スループット計測用)
+#ifdef _WIN32
+typedef std::wstring NativePath;
+static NativePath ToNative(const std::string& s) {
+    if (s.empty()) return {};
+    int n = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), NULL, 0);
+    std::wstring w(n > 0 ? n : 0, L'\0');
+    if (n > 0) MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), &w[0], n);
+    return w;
+}
+static FILE* CreateOutput(const NativePath& p) { return _wfopen(p.c_str(), L"wb"); }
+static void RemoveFile(const NativePath& p) { DeleteFileW(p.c_str()); }
+static bool ReplaceWith(const NativePath& from, const NativePath& to) { return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED) != 0; }
+#else
+typedef std::string NativePath;
+static NativePath ToNative(const std::string& s) { return s; }
+static FILE* CreateOutput(const NativePath& p) { return fopen(p.c_str(), "wb"); }
+static void RemoveFile(const NativePath& p) { remove(p.c_str()); }
+static bool ReplaceWith(const NativePath& from, const NativePath& to) { return rename(from.c_str(), to.c_str()) == 0; }
+#endif
+
+// 空白区切り。"..." の中は \" 以外そのまま渡す (\n 等は検索ダイアログと同じく各コマンドが解釈する)
+static bool Tokenize(const std::string& line, std::vector<std::string>& out) {
+    out.clear();
+    size_t i = 0, n = line.size();
+    while (i < n) {
+        while (i < n && (line[i] == ' ' || line[i] == '\t')) i++;
+        if (i >= n || line[i] == '#') break;
+        std::string tok;
+        if (line[i] == '"') {
+            i++;
+            bool closed = false;
+            while (i < n) {
+                char c = line[i++];
+                if (c == '"') { closed = true; break; }
+                if (c == '\\' && i < n && line[i] == '"') { tok += '"'; i++; }
+                else tok += c;
+            }
+            if (!closed) return false;
+        }
+        else while (i < n && line[i] != ' ' && line[i] != '\t') tok += line[i++];
+        out.push_back(tok);
+    }
+    return true;
+}
+
+static bool ParseEncoding(const std::string& s, Encoding& enc) {
+    if (s == "utf8") enc = ENC_UTF8_NOBOM;
+    else if (s == "utf8-bom") enc = ENC_UTF8_BOM;
+    else if (s == "utf16le") enc = ENC_UTF16LE;
+    else if (s == "utf16be") enc = ENC_UTF16BE;
+    else if (s == "ansi") enc = ENC_ANSI;
+    else return false;
+    return true;
+}
+static const char* EncodingName(Encoding enc) {
+    switch (enc) {
+    case ENC_UTF8_BOM: return "utf8-bom"; case ENC_UTF16LE: return "utf16le"; case ENC_UTF16BE: return "utf16be"; case ENC_ANSI: return "ansi";
+    default: return "utf8";
+    }
+}
+
+struct Batch {
+    Document doc; std::string path;
+    std::string error, result;
+    bool fail(const std::string& msg) { error = msg; return false; }
+    bool open(const std::string& p) {
+        if (!doc.loadFile(ToNative(p).c_str())) return fail("cannot open " + p);
+        path = p;
+        result = FormatSize(doc.pt.length()) + " " + EncodingName(doc.currentEncoding) + ", " + std::to_string(doc.lineStarts.size()) + " lines";
+        if (doc.newlineCounts.total()) result += " (" + doc.newlineCounts.describe() + ")";
+        return true;
+    }
+    // 一時ファイルへ書いてから置き換える。開いているファイル自身を上書きするときはマップを閉じて読み直す
+    bool saveAs(const std::string& p, Encoding enc) {
+        if (doc.trimTrailingOnSave) doc.transformWhitespace(WS_TRIM_TRAILING, true);
+        NativePath target = ToNative(p), tmp = ToNative(p + ".tmp");
+        FILE* f = CreateOutput(tmp);
+        if (!f) return fail("cannot create " + p + ".tmp");
+        size_t written = 0;
+        bool ok = doc.writeEncoded(enc, [&](const char* data, size_t len) { written += len; return fwrite(data, 1, len, f) == len; });
+        if (fclose(f) != 0) ok = false;
+        if (!ok) { RemoveFile(tmp); return fail("write failed: " + p); }
+        bool overwritesSource = (p == path && doc.fileMap);
+        std::vector<Cursor> savedCursors = doc.cursors;
+        if (overwritesSource) doc.fileMap->close();
+        if (!ReplaceWith(tmp, target)) {
+            RemoveFile(tmp);
+            if (overwritesSource) doc.loadFile(ToNative(path).c_str());
+            return fail("cannot replace " + p);
+        }
+        if (overwritesSource) {
+            if (!doc.loadFile(target.c_str())) return fail("cannot reopen " + p);
+            size_t len = doc.pt.length();
+            for (auto& c : savedCursors) { c.head = std::min(c.head, len); c.anchor = std::min(c.anchor, len); }
+            doc.cursors = savedCursors;
+        }
+        else doc.currentEncoding = enc;
+        path = p;
+        result = FormatSize(written) + " " + EncodingName(enc);
+        return true;
+    }
+    bool gotoLine(long long line, long long col) {
+        if (doc.lineStarts.empty()) return true;
+        size_t idx = (size_t)std::max(1LL, std::min(line, (long long)doc.lineStarts.size())) - 1;
+        size_t start = doc.lineStarts[idx];
+        size_t end = idx + 1 < doc.lineStarts.size() ? doc.lineStarts[idx + 1] : doc.pt.length();
+        size_t pos = std::min(start + (size_t)std::max(0LL, col - 1), end);
+        doc.commitPadding();
+        doc.cursors.assign(1, { pos, pos, doc.getXFromPos(pos) });
+        return true;
+    }
+    bool run(const std::vector<std::string>& t) {
+        const std::string& c = t[0];
+        auto has = [&](size_t n) { return t.size() > n; };
+        result.clear();
+        if (c == "open") return has(1) ? open(t[1]) : fail("open PATH");
+        if (c == "save") {
+            Encoding enc = doc.currentEncoding;
+            if (has(1) && !ParseEncoding(t[1], enc)) return fail("unknown encoding " + t[1]);
+            return path.empty() ? fail("save needs a path; use save-as") : saveAs(path, enc);
+        }
+        if (c == "save-as") {
+            Encoding enc = doc.currentEncoding;
+            if (!has(1)) return fail("save-as PATH [ENCODING]");
+            if (has(2) && !ParseEncoding(t[2], enc)) return fail("unknown encoding " + t[2]);
+            return saveAs(t[1], enc);
+        }
+        if (c == "set") {
+            if (!has(2)) return fail("set case|word|regex|trim-on-save on|off");
+            bool on = t[2] == "on" || t[2] == "1";
+            if (t[1] == "case") doc.searchMatchCase = on;
+            else if (t[1] == "word") doc.searchWholeWord = on;
+            else if (t[1] == "regex") doc.searchRegex = on;
+            else if (t[1] == "trim-on-save") doc.trimTrailingOnSave = on;
+            else return fail("unknown option " + t[1]);
+            return true;
+        }
+        if (c == "find") {
+            if (!has(1)) return fail("find QUERY");
+            doc.searchQuery = t[1];
+            bool found = doc.findNextMatch(!(has(2) && t[2] == "up"));
+            result = found ? "at " + std::to_string(doc.cursors.back().start()) : "not found";
+            return true;
+        }
+        if (c == "replace-all") {
+            if (!has(2)) return fail("replace-all QUERY REPLACEMENT");
+            doc.searchQuery = t[1]; doc.replaceQuery = t[2];
+            size_t n = doc.replaceAllMatches();
+            if (n == std::string::npos) return fail("invalid query " + t[1]);
+            result = std::to_string(n) + " replaced";
+            return true;
+        }
+        if (c == "goto") return has(1) ? gotoLine(atoll(t[1].c_str()), has(2) ? atoll(t[2].c_str()) : 1) : fail("goto LINE [COLUMN]");
+        if (c == "select-all") { size_t len = doc.pt.length(); doc.commitPadding(); doc.cursors.assign(1, { len, 0, doc.getXFromPos(len) }); return true; }
+        if (c == "select-word") { if (!doc.cursors.empty()) doc.selectWordAt(doc.cursors.back().head); return true; }
+        if (c == "select-line") { if (!doc.cursors.empty()) doc.selectLineAt(doc.cursors.back().head); return true; }
+        if (c == "select-next") {
+            size_t repeat = has(1) ? (size_t)atoll(t[1].c_str()) : 1;
+            for (size_t i = 0; i < repeat; ++i) doc.selectNextOccurrence();
+            result = std::to_string(doc.cursors.size()) + " cursors";
+            return true;
+        }
+        if (c == "insert") { if (!has(1)) return fail("insert TEXT"); doc.insertAtCursors(UnescapeString(t[1], doc.newlineStr)); return true; }
+        if (c == "newline") { doc.insertNewlineWithAutoIndent(); return true; }
+        if (c == "backspace") { doc.backspaceAtCursors(); return true; }
+        if (c == "delete") { doc.deleteForwardAtCursors(); return true; }
+        if (c == "move") {
+            static const char* names[] = { "left", "right", "up", "down", "home", "end", "pageup", "pagedown" };
+            if (!has(1)) return fail("move DIRECTION [select] [word] [COUNT]");
+            int m = -1; for (int i = 0; i < 8; ++i) if (t[1] == names[i]) m = i;
+            if (m < 0) return fail("unknown direction " + t[1]);
+            bool shift = false, ctrl = false; long long repeat = 1;
+            for (size_t i = 2; i < t.size(); ++i) { if (t[i] == "select") shift = true; else if (t[i] == "word") ctrl = true; else repeat = atoll(t[i].c_str()); }
+            for (long long i = 0; i < repeat; ++i) doc.moveCursors((CaretMove)m, shift, ctrl);
+            return true;
+        }
+        if (c == "delete-lines") { doc.deleteLines(); return true; }
+        if (c == "duplicate-lines") { doc.duplicateLines(has(1) && t[1] == "up"); return true; }
+        if (c == "move-lines") { if (!has(1)) return fail("move-lines up|down"); doc.moveLines(t[1] == "up"); return true; }
+        if (c == "indent") { doc.indentLines(true); return true; }
+        if (c == "unindent") { doc.unindentLines(); return true; }
+        if (c == "sort-lines") { doc.rearrangeLines(!has(1) ? LINES_SORT : t[1] == "icase" ? LINES_SORT_ICASE : t[1] == "numeric" ? LINES_SORT_NUMERIC : LINES_SORT); return true; }
+        if (c == "unique-lines") { doc.rearrangeLines(LINES_UNIQUE); return true; }
+        if (c == "reverse-lines") { doc.rearrangeLines(LINES_REVERSE); return true; }
+        if (c == "shuffle-lines") { doc.rearrangeLines(LINES_SHUFFLE, has(1) ? (uint64_t)atoll(t[1].c_str()) : 1); return true; }
+        if (c == "keep-lines" || c == "remove-lines") {
+            if (!has(1)) return fail(c + " QUERY");
+            doc.searchQuery = t[1];
+            size_t n = doc.filterLines(c == "keep-lines");
+            if (n == std::string::npos) return fail("invalid query " + t[1]);
+            result = std::to_string(n) + " lines removed";
+            return true;
+        }
+        if (c == "show-matching") {
+            if (!has(1)) return fail("show-matching QUERY|off");
+            if (t[1] == "off") { doc.setLineFilter(false); return true; }
+            doc.searchQuery = t[1];
+            if (!doc.setLineFilter(true)) return fail("invalid query " + t[1]);
+            result = std::to_string(doc.viewLineCount()) + " of " + std::to_string(doc.lineStarts.size()) + " lines shown";
+            return true;
+        }
+        if (c == "upper" || c == "lower") { doc.convertCase(c == "upper"); return true; }
+        if (c == "trim-trailing" || c == "tabs-to-spaces" || c == "spaces-to-tabs") {
+            size_t n = doc.transformWhitespace(c == "trim-trailing" ? WS_TRIM_TRAILING : c == "tabs-to-spaces" ? WS_TABS_TO_SPACES : WS_SPACES_TO_TABS);
+            result = std::to_string(n) + " lines changed";
+            return true;
+        }
+        if (c == "match-bracket") {
+            if (doc.cursors.empty()) return true;
+            size_t before = doc.cursors.back().head;
+            doc.jumpToMatchingBracket();
+            result = doc.cursors.back().head != before ? "at " + std::to_string(doc.cursors.back().head) : "no bracket";
+            return true;
+        }
+        if (c == "highlight") {
+            // LINE 行目から COUNT 行を描画と同じように色分けし、種類ごとの字句の数を返す
+            size_t first = has(1) ? (size_t)std::max(atoll(t[1].c_str()) - 1, 0LL) : 0, count = has(2) ? (size_t)atoll(t[2].c_str()) : 50;
+            std::vector<VisibleSpan> spans; std::vector<SyntaxToken> tokens;
+            std::string text = doc.visibleText(first, (int)count, &spans);
+            bool exact = doc.highlightVisible(text, spans, tokens);
+            while (!exact && doc.buildSyntaxStates(UINT64_MAX)) {}
+            if (!exact) doc.highlightVisible(text, spans, tokens);
+            static const char* const kNames[TOKEN_COUNT] = { "text", "keyword", "string", "number", "comment", "preprocessor", "key", "section", "literal", "error", "warning", "info", "debug" };
+            size_t counts[TOKEN_COUNT] = {};
+            for (const auto& tk : tokens) counts[tk.kind]++;
+            result = std::to_string(tokens.size()) + " tokens";
+            for (int k = 0; k < TOKEN_COUNT; ++k) if (counts[k]) result += std::string(", ") + kNames[k] + " " + std::to_string(counts[k]);
+            if (!exact) result += " (deferred)";
+            return true;
+        }
+        if (c == "check-syntax") {
+            // EDITS 回ランダムに選んで書き換え、そのたびに行頭の状態を先頭から読み直した値と比べる (色分けの種類がなければ C/C++ とみなす)
+            size_t edits = has(1) ? (size_t)atoll(t[1].c_str()) : 1000; uint64_t seed = has(2) ? (uint64_t)atoll(t[2].c_str()) : 1;
+            if (!SyntaxHasLineState(doc.syntax.language)) doc.syntax.reset(SYNTAX_CPP);
+            static const char* const kPieces[] = { "/*", "*/", "\"", "\\", "//", "\n", "\r", "\r\n", "a", " ", "'" };
+            size_t checked = 0;
+            for (size_t e = 0; e < edits; ++e) {
+                size_t len = doc.pt.length(), at = len ? SplitMix64(seed) % (len + 1) : 0, sel = std::min<size_t>(SplitMix64(seed) % 4, len - at);
+                std::string text; for (size_t k = SplitMix64(seed) % 6; k > 0; --k) text += kPieces[SplitMix64(seed) % 11];
+                doc.cursors.assign(1, { at + sel, at, 0.0f });
+                doc.insertAtCursors(text);
+                size_t line = SplitMix64(seed) % doc.lineStarts.size();
+                doc.syntax.advance(doc.pt, doc.lineStarts, line, UINT64_MAX);
+                std::string s = doc.pt.getRange(0, doc.lineStarts[line]); uint8_t state = 0;
+                for (size_t l = 0; l <= line; ++l, ++checked) {
+                    if (doc.syntax.stateAt(l) != state) return fail("edit " + std::to_string(e + 1) + ": line " + std::to_string(l + 1) + " state " + std::to_string(doc.syntax.stateAt(l)) + ", expected " + std::to_string(state));
+                    if (l < line) state = LexLine(doc.syntax.language, std::string_view(s).substr(doc.lineStarts[l], doc.lineStarts[l + 1] - doc.lineStarts[l]), state, nullptr);
+                }
+            }
+            result = std::to_string(checked) + " line states match";
+            return true;
+        }
+        if (c == "check-lines") {
+            // 改行の混じった行をいくつものピースに分けて置き、並べ替え・重複削除・逆順・シャッフルが各行の改行を保つか比べる (undo も確かめる)
+            size_t rounds = has(1) ? (size_t)atoll(t[1].c_str()) : 1000; uint64_t seed = has(2) ? (uint64_t)atoll(t[2].c_str()) : 1;
+            static const char* const kPieces[] = { "a", "b", "ab", "\n", "\r", "\r\n", "" };
+            static const LineOperation kOps[] = { LINES_SORT, LINES_UNIQUE, LINES_REVERSE, LINES_SHUFFLE };
+            for (size_t r = 0; r < rounds; ++r) {
+                Document d; d.newlineStr = "\r\n"; d.cursors.push_back({ 0, 0, 0.0f }); d.rebuildLineStarts();
+                for (size_t k = SplitMix64(seed) % 16; k > 0; --k) {
+                    size_t at = SplitMix64(seed) % (d.pt.length() + 1);
+                    d.cursors.assign(1, { at, at, 0.0f });
+                    d.insertAtCursors(kPieces[SplitMix64(seed) % 6]);
+                }
+                std::string before = d.pt.getRange(0, d.pt.length());
+                std::vector<std::string> lines;
+                for (size_t i = 0; i < before.size();) {
+                    size_t eol = before.find_first_of("\r\n", i);
+                    size_t next = eol == std::string::npos ? before.size() : eol + ((before[eol] == '\r' && eol + 1 < before.size() && before[eol + 1] == '\n') ? 2 : 1);
+                    lines.push_back(before.substr(i, next - i)); i = next;
+                }
+                LineOperation op = kOps[SplitMix64(seed) % 4]; uint64_t shuffleSeed = SplitMix64(seed);
+                std::string expected = before;
+                if (lines.size() >= 2) {
+                    auto content = [](const std::string& l) { return LineContent(l); };
+                    bool trailingNewline = content(lines.back()).size() != lines.back().size();
+                    if (op == LINES_SORT) std::stable_sort(lines.begin(), lines.end(), [&](const std::string& a, const std::string& b) { return content(a) < content(b); });
+                    else if (op == LINES_REVERSE) std::reverse(lines.begin(), lines.end());
+                    else if (op == LINES_SHUFFLE) { std::mt19937_64 rng(shuffleSeed); std::shuffle(lines.begin(), lines.end(), rng); }
+                    else {
+                        std::vector<std::string> kept;
+                        for (auto& l : lines) if (std::none_of(kept.begin(), kept.end(), [&](const std::string& k) { return content(k) == content(l); })) kept.push_back(l);
+                        lines.swap(kept);
+                    }
+                    // 最後の行に改行がなかったときは、最後になった行の改行をその行へ移す
+                    std::string lastBreak = lines.back().substr(content(lines.back()).size());
+                    expected.clear();
+                    for (size_t i = 0; i < lines.size(); ++i) {
+                        std::string lineBreak = lines[i].substr(content(lines[i]).size());
+                        if (!trailingNewline) lineBreak = i + 1 == lines.size() ? std::string() : lineBreak.empty() ? lastBreak : lineBreak;
+                        expected += std::string(content(lines[i])) + lineBreak;
+                    }
+                }
+                d.cursors.assign(1, { d.pt.length(), 0, 0.0f });
+                d.rearrangeLines(op, shuffleSeed);
+                std::string after = d.pt.getRange(0, d.pt.length());
+                if (after != expected) return fail("round " + std::to_string(r + 1) + ": operation " + std::to_string((int)op) + " changed line endings");
+                if (after == before) continue;
+                d.performUndo();
+                if (d.pt.getRange(0, d.pt.length()) != before) return fail("round " + std::to_string(r + 1) + ": undo did not restore the lines");
+            }
+            result = std::to_string(rounds) + " rearrangements keep their line endings";
+            return true;
+        }
+        if (c == "newlines") {
+            if (!has(1) || (t[1] != "crlf" && t[1] != "lf" && t[1] != "cr")) return fail("newlines crlf|lf|cr");
+            size_t n = doc.convertNewlines(t[1] == "crlf" ? "\r\n" : t[1] == "lf" ? "\n" : "\r");
+            result = std::to_string(n) + " line endings converted";
+            return true;
+        }
+        if (c == "compact") { size_t before = doc.pt.pieces.size(); while (doc.compactPieces(UINT64_MAX)) {} result = std::to_string(before) + " -> " + std::to_string(doc.pt.pieces.size()) + " pieces"; return true; }
+        if (c == "undo") { doc.performUndo(); return true; }
+        if (c == "redo") { doc.performRedo(); return true; }
+        if (c == "stats") {
+            MemoryStats m = doc.sampleMemory();
+            result = FormatSize(doc.pt.length()) + ", " + std::to_string(doc.lineStarts.size()) + " lines (" + (doc.newlineCounts.total() ? doc.newlineCounts.describe() : "no line endings") + "), " + std::to_string(doc.pt.pieces.size()) + " pieces, " + std::to_string(doc.cursors.size()) + " cursors, " + FormatSize(m.privateTotal()) + " private";
+            return true;
+        }
+        return fail("unknown command " + c);
+    }
+};
+
+static void Usage() {
+    printf("usage: miu_batch [SCRIPT|-] [-e COMMAND]... [--quiet] [--keep-going] [--trace PATH] [--spill-mb N]\n"
+        "  commands: open PATH | save [ENC] | save-as PATH [ENC] | set case|word|regex|trim-on-save on|off\n"
+        "            find QUERY [up] | replace-all QUERY REPLACEMENT | goto LINE [COL] | match-bracket | highlight [LINE] [COUNT]\n"
+        "            check-syntax [EDITS] [SEED] | check-lines [ROUNDS] [SEED]\n"
+        "            select-all | select-word | select-line | select-next [N] | move DIR [select] [word] [N]\n"
+        "            insert TEXT | newline | backspace | delete | upper | lower | undo | redo | stats | compact\n"
+        "            delete-lines | duplicate-lines [up] | move-lines up|down | indent | unindent\n"
+        "            sort-lines [icase|numeric] | unique-lines | reverse-lines | shuffle-lines [SEED]\n"
+        "            keep-lines QUERY | remove-lines QUERY | show-matching QUERY|off\n"
+        "            newlines crlf|lf|cr | trim-trailing | tabs-to-spaces | spaces-to-tabs\n"
+        "  ENC is utf8, utf8-bom, utf16le, utf16be or ansi; quote arguments with \"...\" (\\\" for a quote);\n"
+        "  \\n and \\t are interpreted as in the find/replace dialog\n");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> lines; const char* tracePath = nullptr; bool quiet = false, keepGoing = false; int spillMb = -1;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* { if (i + 1 >= argc) { Usage(); exit(2); } return argv[++i]; };
+        if (a == "-e") lines.push_back(next());
+        else if (a == "--quiet") quiet = true;
+        else if (a == "--keep-going") keepGoing = true;
+        else if (a == "--trace") tracePath = next();
+        else if (a == "--spill-mb") spillMb = atoi(next());
+        else if (a == "--help" || a == "-h") { Usage(); return 0; }
+        else {
+            FILE* f = a == "-" ? stdin : fopen(a.c_str(), "rb");
+            if (!f) { fprintf(stderr, "cannot read %s\n", a.c_str()); return 1; }
+            std::string s; char buf[1 << 16]; size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+            if (f != stdin) fclose(f);
+            size_t p = 0;
+            while (p <= s.size()) {
+                size_t e = s.find('\n', p); if (e == std::string::npos) e = s.size();
+                std::string line = s.substr(p, e - p);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                lines.push_back(line);
+                p = e + 1;
+            }
+        }
+    }
+    if (lines.empty()) { Usage(); return 2; }
+    if (tracePath) TraceSetEnabled(true);
+    Batch b;
+    if (spillMb >= 0) b.doc.pt.addBuf.spillThreshold = (size_t)spillMb << 20;
+    b.doc.newlineStr = "\n";
+    b.doc.cursors.push_back({ 0, 0, 0.0f });
+    b.doc.rebuildLineStarts();
+    int failures = 0; double total = 0.0;
+    std::vector<std::string> tok;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!Tokenize(lines[i], tok)) { fprintf(stderr, "line %zu: unterminated quote\n", i + 1); return 2; }
+        if (tok.empty()) continue;
+        double t0 = NowNs();
+        bool ok = b.run(tok);
+        double ms = (NowNs() - t0) / 1e6; total += ms;
+        if (!ok) {
+            fprintf(stderr, "line %zu: %s: %s\n", i + 1, tok[0].c_str(), b.error.c_str());
+            failures++;
+            if (!keepGoing) break;
+            continue;
+        }
+        if (!quiet) { printf("%10.3f ms  %-16s %s\n", ms, tok[0].c_str(), b.result.c_str()); fflush(stdout); }
+    }
+    if (!quiet) printf("%10.3f ms  total, %s document, %zu pieces\n", total, FormatSize(b.doc.pt.length()).c_str(), b.doc.pt.pieces.size());
+    if (tracePath && !TraceWriteChromeJson(tracePath)) fprintf(stderr, "cannot write %s\n", tracePath);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+#include "Bench.h"
+#include "core/PieceTable.h"
+#include "core/LineIndex.h"
+#include "core/Search.h"
+#include "core/Encoding.h"
+#include "core/Edit.h"
+#include <functional>
+
+struct Fixture { const std::string& doc; size_t size; uint64_t seed; };
+struct BenchDef { const char* name; size_t maxDoc; std::function<BenchResult(const Fixture&, const char*, double)> run; };
+
+static void Fragment(PieceTable& pt, const Fixture& fx, int edits) {
+    uint64_t s = fx.seed;
+    for (int i = 0; i < edits; ++i) pt.insert(SplitMix64(s) % (pt.length() + 1), "x");
+}
+
+static std::vector<BenchDef> MakeBenches() {
+    std::vector<BenchDef> b;
+    const size_t kNoLimit = (size_t)-1;
+    const size_t kRegexLimit = (size_t)256 << 20;
+    b.push_back({ "pt.insert", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); uint64_t s = fx.seed;
+        return RunBench(n, fx.size, 1, t, [&](uint64_t i) { if ((i & 1023) == 0) pt.initFromFile(fx.doc.data(), fx.size); pt.insert(SplitMix64(s) % (pt.length() + 1), "x"); });
+    } });
+    b.push_back({ "pt.erase", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); uint64_t s = fx.seed;
+        return RunBench(n, fx.size, 1, t, [&](uint64_t i) { if ((i & 1023) == 0) pt.initFromFile(fx.doc.data(), fx.size); size_t len = pt.length(); if (len) pt.erase(SplitMix64(s) % len, 1); });
+    } });
+    b.push_back({ "pt.charAt", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); Fragment(pt, fx, 1024);
+        size_t len = pt.length(); uint64_t s = fx.seed; volatile char sink = 0;
+        return RunBench(n, fx.size, 1, t, [&](uint64_t) { sink = sink + pt.charAt(SplitMix64(s) % len); });
+    } });
+    b.push_back({ "pt.getRange/4K", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); Fragment(pt, fx, 1024);
+        size_t len = pt.length(); uint64_t s = fx.seed; volatile size_t sink = 0;
+        return RunBench(n, fx.size, 4096, t, [&](uint64_t) { sink = sink + pt.getRange(SplitMix64(s) % len, 4096).size(); });
+    } });
+    b.push_back({ "PieceIterator/4K", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); Fragment(pt, fx, 1024);
+        size_t len = pt.length(); uint64_t s = fx.seed; volatile char sink = 0;
+        return RunBench(n, fx.size, 4096, t, [&](uint64_t) { size_t p = SplitMix64(s) % len; size_t e = std::min(len, p + 4096); char acc = 0; for (PieceIterator it(pt, p); it.position() < e; ++it) acc ^= *it; sink = sink + acc; });
+    } });
+    b.push_back({ "pt.forEachChunk/4K", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); Fragment(pt, fx, 1024);
+        size_t len = pt.length(); uint64_t s = fx.seed; volatile size_t sink = 0;
+        return RunBench(n, fx.size, 4096, t, [&](uint64_t) { size_t lines = 0; pt.forEachChunk(SplitMix64(s) % len, 4096, [&](std::string_view c) { lines += std::count(c.begin(), c.end(), '\n'); return true; }); sink = sink + lines; });
+    } });
+    b.push_back({ "BuildLineStarts", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); std::vector<size_t> ls;
+        return RunBench(n, fx.size, fx.size, t, [&](uint64_t) { BuildLineStarts(pt, ls); });
+    } });
+    b.push_back({ "FindText/literal", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); volatile size_t sink = 0;
+        return RunBench(n, fx.size, fx.size, t, [&](uint64_t) { sink = sink + FindText(pt, 0, "zqzqz", true, true, false, false); });
+    } });
+    b.push_back({ "FindText/literal-icase-word", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); volatile size_t sink = 0;
+        return RunBench(n, fx.size, fx.size, t, [&](uint64_t) { sink = sink + FindText(pt, 0, "ZQZQZ", true, false, true, false); });
+    } });
+    b.push_back({ "FindText/regex", kRegexLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); volatile size_t sink = 0;
+        return RunBench(n, fx.size, fx.size, t, [&](uint64_t) { sink = sink + FindText(pt, 0, "zq[0-9]+x", true, true, false, true); });
+    } });
+    b.push_back({ "replaceAll/literal", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; std::vector<ReplaceMatch> m; std::vector<EditOp> ops;
+        return RunBench(n, fx.size, fx.size, t, [&](uint64_t) { pt.initFromFile(fx.doc.data(), fx.size); ops.clear(); CollectReplaceMatches(pt, "gamma delta", "GAMMA DELTA", "\n", true, false, false, m); ApplyReplaceMatches(pt, m, ops); });
+    } });
+    b.push_back({ "replaceAll/regex", kRegexLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; std::vector<ReplaceMatch> m; std::vector<EditOp> ops;
+        return RunBench(n, fx.size, fx.size, t, [&](uint64_t) { pt.initFromFile(fx.doc.data(), fx.size); ops.clear(); CollectReplaceMatches(pt, "gamma (delta)", "$1 gamma", "\n", true, false, true, m); ApplyReplaceMatches(pt, m, ops); });
+    } });
+    b.push_back({ "DetectEncoding", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        volatile int sink = 0;
+        return RunBench(n, fx.size, std::min<size_t>(fx.size, 4096), t, [&](uint64_t) { sink = sink + (int)DetectEncoding(fx.doc.data(), fx.size); });
+    } });
+    b.push_back({ "Utf8ToUtf16Bytes", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        volatile size_t sink = 0;
+        return RunBench(n, fx.size, fx.size, t, [&](uint64_t) { sink = sink + Utf8ToUtf16Bytes(fx.doc, false).size(); });
+    } });
+    b.push_back({ "Utf16ToUtf8", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        std::string w = "\xFF\xFE" + Utf8ToUtf16Bytes(fx.doc, false); volatile size_t sink = 0;
+        return RunBench(n, fx.size, w.size(), t, [&](uint64_t) { sink = sink + Utf16ToUtf8(w.data(), w.size(), false).size(); });
+    } });
+    b.push_back({ "undo+redo/256ops", kNoLimit, [](const Fixture& fx, const char* n, double t) {
+        PieceTable pt; pt.initFromFile(fx.doc.data(), fx.size); Fragment(pt, fx, 1024);
+        EditBatch batch; uint64_t s = fx.seed ^ 0x5555;
+        for (int i = 0; i < 256; ++i) {
+            size_t len = pt.length(); size_t pos = SplitMix64(s) % (len + 1);
+            if ((i & 3) == 3 && pos < len) { std::string d = pt.getRange(pos, 1); pt.erase(pos, 1); batch.ops.push_back({ EditOp::Erase, pos, d }); }
+            else { pt.insert(pos, "ab"); batch.ops.push_back({ EditOp::Insert, pos, "ab" }); }
+        }
+        return RunBench(n, fx.size, 0, t, [&](uint64_t) { RevertBatch(pt, batch); ReapplyBatch(pt, batch); });
+    } });
+    return b;
+}
+
+static void Usage() {
+    printf("usage: miu_bench [--min-size N] [--max-size N] [--min-time SEC] [--filter STR] [--json PATH] [--seed N] [--list]\n"
+        "  sizes accept K/M/G suffixes; documents grow x16 from --min-size (default 1K) to --max-size (default 64M, up to 4G)\n");
+}
+
+int main(int argc, char** argv) {
+    size_t minSize = 1024, maxSize = (size_t)64 << 20; double minTime = 0.2;
+    std::string filter; const char* jsonPath = nullptr; uint64_t seed = 1; bool listOnly = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* { if (i + 1 >= argc) { Usage(); exit(2); } return argv[++i]; };
+        if (a == "--min-size") minSize = ParseSize(next());
+        else if (a == "--max-size") maxSize = ParseSize(next());
+        else if (a == "--min-time") minTime = atof(next());
+        else if (a == "--filter") filter = next();
+        else if (a == "--json") jsonPath = next();
+        else if (a == "--seed") seed = strtoull(next(), nullptr, 10);
+        else if (a == "--list") listOnly = true;
+        else { Usage(); return a == "--help" || a == "-h" ? 0 : 2; }
+    }
+    auto benches = MakeBenches();
+    if (listOnly) { for (auto& b : benches) printf("%s\n", b.name); return 0; }
+    if (minSize == 0) minSize = 1;
+    std::vector<size_t> sizes;
+    for (size_t s = minSize; s <= maxSize; s *= 16) { sizes.push_back(s); if (s > maxSize / 16) break; }
+    if (sizes.empty() || sizes.back() < maxSize) sizes.push_back(maxSize);
+    std::vector<BenchResult> results;
+    for (size_t size : sizes) {
+        std::string doc = MakeSyntheticDocument(size, seed);
+        Fixture fx{ doc, size, seed };
+        for (auto& b : benches) {
+            if (!filter.empty() && std::string(b.name).find(filter) == std::string::npos) continue;
+            if (size > b.maxDoc) { printf("%-28s %8s skipped (std::regex needs the whole document in memory)\n", b.name, FormatSize(size).c_str()); continue; }
+            results.push_back(b.run(fx, b.name, minTime));
+            PrintResult(results.back());
+        }
+    }
+    if (jsonPath && !WriteJson(jsonPath, "core", results)) { fprintf(stderr, "cannot write %s\n", jsonPath); return 1; }
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "Bench.h"
+#include "core/PieceTable.h"
+#include "core/LineIndex.h"
+#include "core/Search.h"
+#include "core/Encoding.h"
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// 性能測試用のコーパス生成器。出力はシードから決定的に決まる
+struct Rng {
+    uint64_t s;
+    uint64_t next() { return SplitMix64(s); }
+    size_t below(size_t n) { return (size_t)(next() % n); }
+    template <size_t N> const char* pick(const char* const (&a)[N]) { return a[below(N)]; }
+};
+
+static void AppendUtf8(std::string& s, uint32_t cp) {
+    if (cp < 0x80) s += (char)cp;
+    else if (cp < 0x800) { s += (char)(0xC0 | (cp >> 6)); s += (char)(0x80 | (cp & 0x3F)); }
+    else if (cp < 0x10000) { s += (char)(0xE0 | (cp >> 12)); s += (char)(0x80 | ((cp >> 6) & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+    else { s += (char)(0xF0 | (cp >> 18)); s += (char)(0x80 | ((cp >> 12) & 0x3F)); s += (char)(0x80 | ((cp >> 6) & 0x3F)); s += (char)(0x80 | (cp & 0x3F)); }
+}
+
+static void LogLine(std::string& s, Rng& r, const char* nl) {
+    static const char* const levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+    static const char* const paths[] = { "/api/v1/users", "/api/v1/orders", "/static/app.js", "/healthz", "/api/v2/search?q=miu", "/login" };
+    static const char* const methods[] = { "GET", "GET", "POST", "PUT", "DELETE" };
+    char b[256];
+    uint64_t t = r.next();
+    snprintf(b, sizeof(b), "2026-%02d-%02dT%02d:%02d:%02d.%03dZ %-5s [worker-%d] %s %s status=%d bytes=%d took=%dms req=%08x",
+        (int)(t % 12) + 1, (int)((t >> 8) % 28) + 1, (int)((t >> 16) % 24), (int)((t >> 24) % 60), (int)((t >> 32) % 60), (int)((t >> 40) % 1000),
+        r.pick(levels), (int)r.below(16), r.pick(methods), r.pick(paths), r.below(10) ? 200 : 500, (int)r.below(65536), (int)r.below(2000), (unsigned)r.next());
+    s += b; s += nl;
+}
+
+static void JsonObject(std::string& s, Rng& r) {
+    static const char* const names[] = { "alpha", "beta", "gamma", "\\u3042\\u3044", "miu", "piece \\\"table\\\"" };
+    char b[200];
+    snprintf(b, sizeof(b), "{\"id\":%llu,\"name\":\"%s\",\"score\":%d.%02d,\"active\":%s,\"tags\":[\"t%d\",\"t%d\"],\"meta\":{\"x\":%d,\"y\":null}}",
+        (unsigned long long)(r.next() % 100000000), r.pick(names), (int)r.below(1000), (int)r.below(100), r.below(2) ? "true" : "false", (int)r.below(50), (int)r.below(50), (int)r.below(1 << 20));
+    s += b;
+}
+
+static void CjkSentence(std::string& s, Rng& r) {
+    size_t n = 8 + r.below(40);
+    for (size_t i = 0; i < n; ++i) {
+        size_t k = r.below(10);
+        if (k < 4) AppendUtf8(s, 0x3041 + (uint32_t)r.below(83));
+        else if (k < 6) AppendUtf8(s, 0x30A1 + (uint32_t)r.below(86));
+        else if (k < 9) AppendUtf8(s, 0x4E00 + (uint32_t)r.below(0x5000));
+        else AppendUtf8(s, 0xAC00 + (uint32_t)r.below(11172));
+        if (r.below(12) == 0) AppendUtf8(s, 0x3001);
+    }
+    AppendUtf8(s, r.below(6) ? 0x3002 : 0xFF01);
+}
+
+static void EmojiRun(std::string& s, Rng& r) {
+    static const char* const seqs[] = {
+        "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7",   // family (ZWJ)
+        "\xE2\x9D\xA4\xEF\xB8\x8F",                                                 // heart + VS16
+        "\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD",                                         // thumbs up + skin tone
+        "\xF0\x9F\x8F\xB3\xEF\xB8\x8F\xE2\x80\x8D\xF0\x9F\x8C\x88",                 // rainbow flag
+        "\xF0\x9F\x87\xAF\xF0\x9F\x87\xB5",                                         // regional indicators
+        "\xF0\x9F\x98\x80", "a", "miu", " ", "\xE2\x98\x95" };
+    size_t n = 4 + r.below(20);
+    for (size_t i = 0; i < n; ++i) s += r.pick(seqs);
+}
+
+static const char* const kProfiles[] = { "log-lf", "log-crlf", "json-min", "cjk", "emoji", "mixed-nl", "utf16le", "utf16be", "sjis" };
+
+static std::string Generate(const std::string& profile, size_t size, uint64_t seed) {
+    Rng r{ seed };
+    std::string s; s.reserve(size + 256);
+    if (profile == "log-lf" || profile == "log-crlf") { const char* nl = profile == "log-lf" ? "\n" : "\r\n"; while (s.size() < size) LogLine(s, r, nl); }
+    else if (profile == "json-min") { s += '['; while (s.size() + 1 < size) { if (s.size() > 1) s += ','; JsonObject(s, r); } s += ']'; }
+    else if (profile == "cjk") { while (s.size() < size) { CjkSentence(s, r); if (r.below(4) == 0) s += "\r\n"; } }
+    else if (profile == "emoji") { while (s.size() < size) { EmojiRun(s, r); s += r.below(3) ? " " : "\n"; } }
+    else if (profile == "mixed-nl") {
+        static const char* const nls[] = { "\n", "\r\n", "\r" };
+        while (s.size() < size) { LogLine(s, r, r.pick(nls)); }
+    }
+    else if (profile == "utf16le" || profile == "utf16be") {
+        std::string u8;
+        while (u8.size() * 2 < size) { if (r.below(2)) CjkSentence(u8, r); else LogLine(u8, r, ""); u8 += "\r\n"; }
+        bool be = profile == "utf16be";
+        s = be ? "\xFE\xFF" : "\xFF\xFE";
+        s += Utf8ToUtf16Bytes(u8, be);
+    }
+    else if (profile == "sjis") {
+        while (s.size() < size) {
+            size_t n = 8 + r.below(40);
+            for (size_t i = 0; i < n; ++i) {
+                size_t k = r.below(10);
+                if (k < 5) { unsigned v = 0x829F + (unsigned)r.below(83); s += (char)(v >> 8); s += (char)(v & 0xFF); }
+                else if (k < 8) { unsigned v = 0x8340 + (unsigned)r.below(63); s += (char)(v >> 8); s += (char)(v & 0xFF); }
+                else s += (char)('a' + r.below(26));
+            }
+            s += "\x81\x42\r\n";
+        }
+    }
+    else return std::string();
+    // 途中で切ると不正なバイト列になるので、行頭 (またはレコード境界) で打ち切る
+    if (s.size() > size && profile != "json-min" && profile != "utf16le" && profile != "utf16be") {
+        size_t cut = s.find_last_of('\n', size);
+        if (cut != std::string::npos && cut > 0) s.resize(cut + 1);
+    }
+    return s;
+}
+
+static const char* ProfileNeedle(const std::string& profile) {
+    if (profile == "emoji") return "\xE2\x9D\xA4";
+    if (profile == "json-min") return "\"active\":true";
+    if (profile == "cjk" || profile == "utf16le" || profile == "utf16be") return "\xE3\x81\x82\xE3\x81\x84";
+    if (profile == "sjis") return "\x82\xA0\x82\xA2";
+    return "ERROR";
+}
+
+static int RunBenchmarks(size_t size, uint64_t seed, double minTime, const char* jsonPath) {
+    std::vector<BenchResult> results;
+    for (const char* profile : kProfiles) {
+        std::string raw = Generate(profile, size, seed);
+        std::string prefix = std::string(profile) + "/";
+        std::string converted; PieceTable pt;
+        results.push_back(RunBench(prefix + "load", raw.size(), raw.size(), minTime, [&](uint64_t) {
+            Encoding enc = DetectEncoding(raw.data(), raw.size());
+            const char* p = raw.data(); size_t n = raw.size();
+            if (enc == ENC_UTF16LE || enc == ENC_UTF16BE) { converted = Utf16ToUtf8(p, n, enc == ENC_UTF16BE); p = converted.data(); n = converted.size(); }
+            else if (enc == ENC_UTF8_BOM) { p += 3; n -= 3; }
+            pt.initFromFile(p, n);
+        }));
+        PrintResult(results.back());
+        std::vector<size_t> lineStarts;
+        results.push_back(RunBench(prefix + "BuildLineStarts", pt.length(), pt.length(), minTime, [&](uint64_t) { BuildLineStarts(pt, lineStarts); }));
+        PrintResult(results.back());
+        volatile size_t sink = 0;
+        results.push_back(RunBench(prefix + "FindText/absent", pt.length(), pt.length(), minTime, [&](uint64_t) { sink = sink + FindText(pt, 0, "zqzqz", true, true, false, false); }));
+        PrintResult(results.back());
+        const char* needle = ProfileNeedle(profile);
+        results.push_back(RunBench(prefix + "FindText/all", pt.length(), pt.length(), minTime, [&](uint64_t) {
+            size_t pos = 0, count = 0, len = pt.length();
+            while (pos < len) { size_t m = FindText(pt, pos, needle, true, true, false, false); if (m == std::string::npos || m < pos) break; count++; pos = m + 1; }
+            sink = sink + count;
+        }));
+        PrintResult(results.back());
+    }
+    if (jsonPath && !WriteJson(jsonPath, "corpus", results)) { fprintf(stderr, "cannot write %s\n", jsonPath); return 1; }
+    return 0;
+}
+
+static void Usage() {
+    printf("usage: miu_corpusgen PROFILE SIZE [--seed N] [-o FILE]\n"
+        "       miu_corpusgen --bench [--size N] [--seed N] [--min-time SEC] [--json PATH]\n"
+        "profiles:");
+    for (const char* p : kProfiles) printf(" %s", p);
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    bool bench = false; size_t size = (size_t)16 << 20; uint64_t seed = 1; double minTime = 0.2;
+    const char* outPath = nullptr; const char* jsonPath = nullptr; std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool hasNext = i + 1 < argc;
+        if (a == "--bench") bench = true;
+        else if (a == "--size" && hasNext) size = ParseSize(argv[++i]);
+        else if (a == "--seed" && hasNext) seed = strtoull(argv[++i], nullptr, 10);
+        else if (a == "--min-time" && hasNext) minTime = atof(argv[++i]);
+        else if (a == "--json" && hasNext) jsonPath = argv[++i];
+        else if (a == "-o" && hasNext) outPath = argv[++i];
+        else if (a[0] != '-') positional.push_back(a);
+        else { Usage(); return 2; }
+    }
+    if (bench) return RunBenchmarks(size, seed, minTime, jsonPath);
+    if (positional.size() != 2) { Usage(); return 2; }
+    std::string data = Generate(positional[0], ParseSize(positional[1].c_str()), seed);
+    if (data.empty()) { fprintf(stderr, "unknown profile: %s\n", positional[0].c_str()); Usage(); return 2; }
+#ifdef _WIN32
+    if (!outPath) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    FILE* f = outPath ? fopen(outPath, "wb") : stdout;
+    if (!f) { fprintf(stderr, "cannot write %s\n", outPath); return 1; }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (outPath) fclose(f);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+#include "Bench.h"
+#include "core/Document.h"
+#include "core/Encoding.h"
+#include "core/Session.h"
+#include "core/Trace.h"
+#include <map>
+
+// 記録されたセッションをウィンドウなしで再生し、コマンドごとの遅延を集計する
+struct Player {
+    Document doc; std::string buffer; const char* docPath = nullptr;
+    std::map<std::string, std::vector<double>> latencies;
+    std::map<std::string, size_t> skipped;
+    void open(const SessionEvent& e) {
+        std::string path = docPath ? docPath : (e.texts.empty() ? "" : e.texts[0]);
+        buffer.clear();
+        FILE* f = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+        if (f) {
+            char tmp[1 << 16]; size_t n;
+            while ((n = fread(tmp, 1, sizeof(tmp), f)) > 0) buffer.append(tmp, n);
+            fclose(f);
+            Encoding enc = DetectEncoding(buffer.data(), buffer.size());
+            if (enc == ENC_UTF16LE || enc == ENC_UTF16BE) buffer = Utf16ToUtf8(buffer.data(), buffer.size(), enc == ENC_UTF16BE);
+            else if (enc == ENC_UTF8_BOM) buffer.erase(0, 3);
+        }
+        else {
+            size_t size = e.args.empty() ? 0 : (size_t)e.args[0];
+            if (size > 0) fprintf(stderr, "replay: %s not readable, using a %s synthetic document\n", path.empty() ? "(untitled)" : path.c_str(), FormatSize(size).c_str());
+            buffer = MakeSyntheticDocument(size);
+            long long nl = e.args.size() > 1 ? e.args[1] : 0;
+            doc.newlineStr = nl == 1 ? "\n" : nl == 2 ? "\r" : "\r\n";
+        }
+        doc.pt.initFromFile(buffer.data(), buffer.size());
+        doc.undo.clear(); doc.pendingPadding = EditBatch();
+        doc.cursors.clear(); doc.cursors.push_back({ 0, 0, 0.0f });
+        doc.rebuildLineStarts();
+        if (f) doc.newlineStr = doc.newlineCounts.dominant();
+    }
+    void setCursors(const SessionEvent& e) {
+        size_t len = doc.pt.length();
+        doc.cursors.clear();
+        for (size_t i = 0; i + 1 < e.args.size(); i += 2) {
+            size_t h = std::min((size_t)e.args[i], len); size_t a = std::min((size_t)e.args[i + 1], len);
+            doc.cursors.push_back({ h, a, doc.getXFromPos(h) });
+        }
+        if (doc.cursors.empty()) doc.cursors.push_back({ 0, 0, 0.0f });
+    }
+    void pasteLines(const std::string& text) {
+        bool hasSelection = false;
+        for (const auto& c : doc.cursors) if (c.hasSelection()) hasSelection = true;
+        if (hasSelection) { doc.insertAtCursors(text); return; }
+        doc.rollbackPadding();
+        std::vector<size_t> offsets;
+        for (auto& c : doc.cursors) {
+            size_t lineStart = doc.lineStarts[doc.getLineIdx(c.head)];
+            offsets.push_back(c.head - lineStart); c.head = lineStart; c.anchor = lineStart;
+        }
+        doc.insertAtCursors(text);
+        for (size_t i = 0; i < doc.cursors.size() && i < offsets.size(); ++i) {
+            doc.cursors[i].head += offsets[i]; doc.cursors[i].anchor = doc.cursors[i].head;
+            doc.cursors[i].desiredX = doc.getXFromPos(doc.cursors[i].head);
+        }
+    }
+    bool apply(const SessionEvent& e) {
+        const std::string& c = e.command;
+        auto arg = [&](size_t i) { return i < e.args.size() ? e.args[i] : 0; };
+        auto text = [&](size_t i) { return i < e.texts.size() ? e.texts[i] : std::string(); };
+        if (c == "open") open(e);
+        else if (c == "cursors") setCursors(e);
+        else if (c == "insert") doc.insertAtCursors(text(0));
+        else if (c == "newline") doc.insertNewlineWithAutoIndent();
+        else if (c == "backspace") doc.backspaceAtCursors(arg(0) != 0);
+        else if (c == "delete") doc.deleteForwardAtCursors();
+        else if (c == "move") doc.moveCursors((CaretMove)arg(0), arg(1) != 0, arg(2) != 0, (int)arg(3));
+        else if (c == "selectnext") doc.selectNextOccurrence();
+        else if (c == "undo") doc.performUndo();
+        else if (c == "redo") doc.performRedo();
+        else if (c == "paste") { if (arg(0) == 1) pasteLines(text(0)); else doc.insertAtCursors(text(0)); }
+        else if (c == "cut") {
+            bool hasSelection = false;
+            for (const auto& cur : doc.cursors) if (cur.hasSelection()) hasSelection = true;
+            if (!hasSelection) return false;
+            doc.insertAtCursors("");
+        }
+        else if (c == "find") { doc.searchMatchCase = arg(1) != 0; doc.searchWholeWord = arg(2) != 0; doc.searchRegex = arg(3) != 0; doc.searchQuery = text(0); doc.findNextMatch(arg(0) != 0); }
+        else if (c == "indent") doc.indentLines(arg(0) != 0);
+        else if (c == "unindent") doc.unindentLines();
+        else if (c == "duplicate") doc.duplicateLines(arg(0) != 0);
+        else if (c == "movelines") doc.moveLines(arg(0) != 0);
+        else if (c == "deletelines") doc.deleteLines();
+        else if (c == "rearrange") doc.rearrangeLines((LineOperation)arg(0), (uint64_t)arg(1));
+        else if (c == "filter") { doc.searchMatchCase = arg(1) != 0; doc.searchWholeWord = arg(2) != 0; doc.searchRegex = arg(3) != 0; doc.searchQuery = text(0); doc.filterLines(arg(0) != 0); }
+        else if (c == "linefilter") { doc.searchMatchCase = arg(1) != 0; doc.searchWholeWord = arg(2) != 0; doc.searchRegex = arg(3) != 0; doc.searchQuery = text(0); doc.setLineFilter(arg(0) != 0); }
+        else if (c == "case") doc.convertCase(arg(0) != 0);
+        else if (c == "whitespace") doc.transformWhitespace((WhitespaceOperation)arg(0), arg(1) != 0);
+        else if (c == "newlines") { long long nl = arg(0); doc.convertNewlines(nl == 1 ? "\n" : nl == 2 ? "\r" : "\r\n"); }
+        else if (c == "bracket") doc.jumpToMatchingBracket();
+        else if (c == "replaceall") { doc.searchMatchCase = arg(0) != 0; doc.searchWholeWord = arg(1) != 0; doc.searchRegex = arg(2) != 0; doc.searchQuery = text(0); doc.replaceQuery = text(1); doc.replaceAllMatches(); }
+        else return false;
+        return true;
+    }
+};
+
+static double Percentile(std::vector<double>& v, double q) {
+    if (v.empty()) return 0.0;
+    size_t k = (size_t)(q * (double)(v.size() - 1) + 0.5);
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+int main(int argc, char** argv) {
+    const char* tracePath = nullptr; const char* jsonPath = nullptr; const char* docPath = nullptr; const char* tracePathOut = nullptr; int repeat = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else if (a == "--doc" && i + 1 < argc) docPath = argv[++i];
+        else if (a == "--trace" && i + 1 < argc) { tracePathOut = argv[++i]; TraceSetEnabled(true); }
+        else if (a == "--repeat" && i + 1 < argc) repeat = std::max(1, atoi(argv[++i]));
+        else if (a[0] != '-' && !tracePath) tracePath = argv[i];
+        else { printf("usage: miu_replay TRACE [--doc FILE] [--repeat N] [--json PATH] [--trace PATH]\n"); return 2; }
+    }
+    if (!tracePath) { printf("usage: miu_replay TRACE [--doc FILE] [--repeat N] [--json PATH] [--trace PATH]\n"); return 2; }
+    std::vector<SessionEvent> events;
+    if (!ReadSessionFile(tracePath, events)) { fprintf(stderr, "cannot read %s\n", tracePath); return 1; }
+    Player player; player.docPath = docPath;
+    SessionEvent initial; initial.command = "open";
+    if (events.empty() || events[0].command != "open") player.open(initial);
+    double totalNs = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+        for (const auto& e : events) {
+            double t0 = NowNs();
+            bool ok = player.apply(e);
+            double dt = NowNs() - t0;
+            if (!ok) { player.skipped[e.command]++; continue; }
+            if (e.command == "open") continue;
+            player.latencies[e.command].push_back(dt);
+            totalNs += dt;
+        }
+    }
+    printf("%-12s %8s %12s %12s %12s %12s\n", "command", "count", "p50 us", "p99 us", "max us", "total ms");
+    FILE* jf = nullptr;
+    if (jsonPath) { jf = fopen(jsonPath, "wb"); if (!jf) { fprintf(stderr, "cannot write %s\n", jsonPath); return 1; } fprintf(jf, "{\n  \"suite\": \"replay\",\n  \"trace\": \"%s\",\n  \"commands\": [\n", JsonEscape(tracePath).c_str()); }
+    size_t n = 0;
+    for (auto& kv : player.latencies) {
+        auto& v = kv.second; double sum = 0.0, mx = 0.0;
+        for (double d : v) { sum += d; mx = std::max(mx, d); }
+        double p50 = Percentile(v, 0.50), p99 = Percentile(v, 0.99);
+        printf("%-12s %8zu %12.1f %12.1f %12.1f %12.2f\n", kv.first.c_str(), v.size(), p50 / 1e3, p99 / 1e3, mx / 1e3, sum / 1e6);
+        if (jf) fprintf(jf, "    {\"command\": \"%s\", \"count\": %zu, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f, \"total_ns\": %.0f}%s\n", JsonEscape(kv.first).c_str(), v.size(), p50, p99, mx, sum, (++n < player.latencies.size()) ? "," : "");
+    }
+    for (auto& kv : player.skipped) printf("%-12s %8zu skipped (not replayable headless)\n", kv.first.c_str(), kv.second);
+    MemoryStats mem = player.doc.sampleMemory();
+    printf("\n%s\n", FormatMemoryStats(mem, player.doc.memoryPeak, player.doc.memoryPeakTotal).c_str());
+    printf("total %.2f ms, document %zu bytes in %zu pieces, %zu lines, undo depth %zu, peak RSS %.1f MB\n", totalNs / 1e6, player.doc.pt.length(), player.doc.pt.pieces.size(), player.doc.lineStarts.size(), player.doc.undo.undoStack.size(), PeakRss() / (1024.0 * 1024.0));
+    if (jf) {
+        fprintf(jf, "  ],\n  \"total_ns\": %.0f,\n  \"doc_size\": %zu,\n  \"pieces\": %zu,\n  \"peak_rss\": %zu,\n", totalNs, player.doc.pt.length(), player.doc.pt.pieces.size(), PeakRss());
+        fprintf(jf, "  \"memory\": %s,\n  \"memory_peak\": %s\n}\n", MemoryStatsJson(mem).c_str(), MemoryStatsJson(player.doc.memoryPeak).c_str());
+        fclose(jf);
+    }
+    if (tracePathOut && !TraceWriteChromeJson(tracePathOut)) { fprintf(stderr, "cannot write %s\n", tracePathOut); return 1; }
+    return 0;
+}
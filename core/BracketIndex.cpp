@@ -0,0 +1,337 @@
+#include "BracketIndex.h"
+#include <algorithm>
+#include <cstdlib>
+#include "Trace.h"
+static const int32_t kNoPoint = INT32_MAX;
+// 状態ごとの 1 バイト先の状態と、文字列の外で見たときの括弧 (開きは +種類、閉じは -種類。種類は 1 から)
+struct BracketTables { uint8_t next[BracketIndex::STATE_COUNT][256]; int8_t bracket[256]; };
+static constexpr BracketTables MakeBracketTables() {
+    BracketTables t{};
+    for (int c = 0; c < 256; ++c) {
+        bool eol = (c == '\n' || c == '\r');
+        t.next[BracketIndex::STATE_CODE][c] = c == '"' ? BracketIndex::STATE_STRING : BracketIndex::STATE_CODE;
+        t.next[BracketIndex::STATE_STRING][c] = (c == '"' || eol) ? BracketIndex::STATE_CODE : c == '\\' ? BracketIndex::STATE_ESCAPE : BracketIndex::STATE_STRING;
+        t.next[BracketIndex::STATE_ESCAPE][c] = eol ? BracketIndex::STATE_CODE : BracketIndex::STATE_STRING;
+    }
+    t.bracket['('] = 1; t.bracket['['] = 2; t.bracket['{'] = 3;
+    t.bracket[')'] = -1; t.bracket[']'] = -2; t.bracket['}'] = -3;
+    return t;
+}
+static constexpr BracketTables kBracketTables = MakeBracketTables();
+// it から n バイトを読んで state を進め、文字列の外の括弧ごとに fn(位置, 括弧) を呼ぶ。fn が false を返したら止めて false
+template <class F> static bool ScanBrackets(PieceIterator& it, size_t n, int& state, F fn) {
+    size_t pos = it.position();
+    return it.forEachSpan(n, [&](const char* data, size_t m) {
+        const unsigned char* p = (const unsigned char*)data;
+        for (size_t i = 0; i < m; ++i) {
+            int b = kBracketTables.bracket[p[i]];
+            if (b && state == BracketIndex::STATE_CODE && !fn(pos + i, b)) return false;
+            state = kBracketTables.next[state][p[i]];
+        }
+        pos += m;
+        return true;
+    });
+}
+static void ApplyBracket(BracketIndex::Summary& s, int entry, int b) {
+    int k = std::abs(b) - 1;
+    if (b > 0) { s.net[entry][k]++; return; }
+    s.net[entry][k]--; s.low[entry][k] = std::min(s.low[entry][k], s.net[entry][k]);
+}
+// it から n バイトを 3 つの入口の状態で同時に読んで要約する。状態がそろったら (たいてい最初の改行で) 1 本だけ追う
+static BracketIndex::Summary Summarize(PieceIterator& it, size_t n) {
+    BracketIndex::Summary s; s.len = n;
+    uint8_t st[BracketIndex::STATE_COUNT] = { BracketIndex::STATE_CODE, BracketIndex::STATE_STRING, BracketIndex::STATE_ESCAPE };
+    bool merged = false;
+    it.forEachSpan(n, [&](const char* data, size_t m) {
+        const unsigned char* p = (const unsigned char*)data;
+        size_t i = 0;
+        for (; i < m && !merged; ++i) {
+            int b = kBracketTables.bracket[p[i]];
+            for (int e = 0; e < BracketIndex::STATE_COUNT; ++e) { if (b && st[e] == BracketIndex::STATE_CODE) ApplyBracket(s, e, b); st[e] = kBracketTables.next[st[e]][p[i]]; }
+            merged = st[0] == st[1] && st[1] == st[2];
+        }
+        uint8_t cur = st[0];
+        for (; i < m; ++i) {
+            int b = kBracketTables.bracket[p[i]];
+            if (b && cur == BracketIndex::STATE_CODE) for (int e = 0; e < BracketIndex::STATE_COUNT; ++e) ApplyBracket(s, e, b);
+            cur = kBracketTables.next[cur][p[i]];
+        }
+        if (merged) st[0] = st[1] = st[2] = cur;
+        return true;
+    });
+    for (int e = 0; e < BracketIndex::STATE_COUNT; ++e) s.exit[e] = st[e];
+    return s;
+}
+static BracketIndex::Summary Combine(const BracketIndex::Summary& a, const BracketIndex::Summary& b) {
+    BracketIndex::Summary s; s.len = a.len + b.len;
+    for (int e = 0; e < BracketIndex::STATE_COUNT; ++e) {
+        int m = a.exit[e]; s.exit[e] = b.exit[m];
+        for (int k = 0; k < BracketIndex::KIND_COUNT; ++k) {
+            s.net[e][k] = a.net[e][k] + b.net[m][k];
+            int64_t low = b.low[m][k] == kNoPoint ? kNoPoint : (int64_t)a.net[e][k] + b.low[m][k];
+            s.low[e][k] = (int32_t)std::min<int64_t>(a.low[e][k], low);
+        }
+    }
+    return s;
+}
+static BracketIndex::Summary MakeEmptySummary() {
+    BracketIndex::Summary s;
+    for (auto& row : s.low) for (auto& v : row) v = kNoPoint;
+    return s;
+}
+const BracketIndex::Summary& BracketIndex::node(size_t i) const {
+    static const Summary empty = MakeEmptySummary();
+    if (i < leafBase) return tree[i];
+    return i - leafBase < blocks.size() ? blocks[i - leafBase] : empty;
+}
+void BracketIndex::rebuildTree() {
+    leafBase = 1; while (leafBase < blocks.size()) leafBase *= 2;
+    tree.assign(leafBase, Summary());
+    for (size_t i = leafBase - 1; i >= 1; --i) tree[i] = Combine(node(2 * i), node(2 * i + 1));
+}
+void BracketIndex::refreshPath(size_t block) {
+    for (size_t i = (leafBase + block) / 2; i >= 1; i /= 2) tree[i] = Combine(node(2 * i), node(2 * i + 1));
+}
+BracketIndex::Probe BracketIndex::locate(size_t pos) const {
+    Probe p = { 0, 0, STATE_CODE, { 0, 0, 0 } };
+    size_t i = 1;
+    while (i < leafBase) {
+        const Summary& left = node(2 * i);
+        if (pos < p.start + left.len) { i = 2 * i; continue; }
+        p.start += left.len;
+        for (int k = 0; k < KIND_COUNT; ++k) p.depth[k] += left.net[p.state][k];
+        p.state = left.exit[p.state]; i = 2 * i + 1;
+    }
+    p.block = i - leafBase;
+    return p;
+}
+void BracketIndex::update(const PieceTable& pt, const ChangeSpan& change) {
+    size_t len = pt.length();
+    if (change.any() && !complete) {
+        // 作りかけの部分に掛かる編集なら、そのブロックから先を作り直す
+        if (change.from < builtBytes) {
+            size_t b = 0, start = 0;
+            while (b < blocks.size() && start + blocks[b].len <= change.from) start += blocks[b++].len;
+            blocks.resize(b); builtBytes = start;
+        }
+    }
+    else if (change.any() && blocks.empty()) reset();
+    else if (change.any()) {
+        // 古い文書で変わった範囲 [from, oldEnd) に掛かるブロックを、新しい内容で同じくらいの大きさに分け直す
+        size_t oldLen = change.oldLength, oldEnd = oldLen - std::min(change.tail, oldLen);
+        Probe first = locate(std::min(change.from, oldLen - 1));
+        Probe last = locate(std::min(std::max(oldEnd, change.from + 1) - 1, oldLen - 1));
+        size_t b0 = first.block, b1 = last.block, start = first.start;
+        size_t newLen = last.start + blocks[b1].len - start + change.newLength - oldLen;
+        // 小さな端切れが残らないよう、短くなったら次のブロックとまとめる
+        if (newLen < kBlockBytes / 2 && b1 + 1 < blocks.size()) newLen += blocks[++b1].len;
+        if (newLen > kSyncBuildBytes) { blocks.resize(b0); tree.clear(); leafBase = 0; builtBytes = start; complete = false; }
+        else {
+            size_t n = (newLen + kBlockBytes - 1) / kBlockBytes;
+            std::vector<Summary> fresh; fresh.reserve(n);
+            PieceIterator it(pt, start);
+            for (size_t i = 0; i < n; ++i) fresh.push_back(Summarize(it, newLen / n + (i < newLen % n ? 1 : 0)));
+            if (fresh.size() == b1 - b0 + 1) { for (size_t i = 0; i < n; ++i) { blocks[b0 + i] = fresh[i]; refreshPath(b0 + i); } }
+            else { blocks.erase(blocks.begin() + b0, blocks.begin() + b1 + 1); blocks.insert(blocks.begin() + b0, fresh.begin(), fresh.end()); rebuildTree(); }
+            builtBytes = len;
+        }
+    }
+    if (!complete && len - builtBytes <= kSyncBuildBytes) buildStep(pt, UINT64_MAX);
+}
+bool BracketIndex::buildStep(const PieceTable& pt, uint64_t budgetNs) {
+    if (complete) return false;
+    TRACE_SCOPE("bracketIndex");
+    uint64_t t0 = TraceNowNs();
+    size_t len = pt.length();
+    PieceIterator it(pt, builtBytes);
+    while (builtBytes < len) {
+        size_t take = std::min(kBlockBytes, len - builtBytes);
+        blocks.push_back(Summarize(it, take)); builtBytes += take;
+        if (builtBytes < len && TraceNowNs() - t0 >= budgetNs) return true;
+    }
+    complete = true;
+    rebuildTree();
+    return false;
+}
+size_t BracketIndex::descendForward(size_t i, size_t lo, size_t hi, size_t from, Probe& p, int kind, int64_t target) const {
+    if (hi <= from || lo >= blocks.size()) return SIZE_MAX;
+    const Summary& s = node(i);
+    if (lo >= from && p.depth[kind] + s.low[p.state][kind] >= target) {
+        p.start += s.len; p.depth[kind] += s.net[p.state][kind]; p.state = s.exit[p.state];
+        return SIZE_MAX;
+    }
+    if (i >= leafBase) { p.block = lo; return lo; }
+    size_t mid = (lo + hi) / 2;
+    size_t r = descendForward(2 * i, lo, mid, from, p, kind, target);
+    return r != SIZE_MAX ? r : descendForward(2 * i + 1, mid, hi, from, p, kind, target);
+}
+size_t BracketIndex::descendBackward(size_t i, size_t lo, size_t hi, size_t to, Probe p, int kind, int64_t target, Probe& out) const {
+    if (lo >= to) return SIZE_MAX;
+    const Summary& s = node(i);
+    if (hi <= to && p.depth[kind] + s.low[p.state][kind] >= target) return SIZE_MAX;
+    if (i >= leafBase) { out = p; out.block = lo; return lo; }
+    size_t mid = (lo + hi) / 2;
+    const Summary& left = node(2 * i);
+    Probe right = p; right.start += left.len; right.depth[kind] += left.net[p.state][kind]; right.state = left.exit[p.state];
+    size_t r = descendBackward(2 * i + 1, mid, hi, to, right, kind, target, out);
+    return r != SIZE_MAX ? r : descendBackward(2 * i, lo, mid, to, p, kind, target, out);
+}
+// at のブロックの from 以降で、閉じ括弧 kind によって深さが target を下回る最初の位置。なければ後ろのブロックを木で探す
+size_t BracketIndex::findClose(const PieceTable& pt, const Probe& at, size_t from, int kind, int64_t target) const {
+    int state = at.state; int64_t d = at.depth[kind]; size_t found = SIZE_MAX, checkFrom = from;
+    auto visit = [&](size_t pos, int b) {
+        if (std::abs(b) - 1 != kind) return true;
+        if (b > 0) { d++; return true; }
+        if (--d < target && pos >= checkFrom) { found = pos; return false; }
+        return true;
+    };
+    PieceIterator it(pt, at.start);
+    if (!ScanBrackets(it, blocks[at.block].len, state, visit)) return found;
+    Probe p = at; p.start = at.start + blocks[at.block].len; p.state = state; p.depth[kind] = d;
+    if (descendForward(1, 0, leafBase, at.block + 1, p, kind, target) == SIZE_MAX) return SIZE_MAX;
+    state = p.state; d = p.depth[kind]; checkFrom = 0;
+    it.seek(p.start);
+    ScanBrackets(it, blocks[p.block].len, state, visit);
+    return found;
+}
+// at のブロックの to より前で、深さが target を下回る位置にある最後の開き括弧 kind。なければ前のブロックを木で探す
+size_t BracketIndex::findOpen(const PieceTable& pt, const Probe& at, size_t to, int kind, int64_t target) const {
+    int state = at.state; int64_t d = at.depth[kind]; size_t found = SIZE_MAX;
+    auto visit = [&](size_t pos, int b) {
+        if (std::abs(b) - 1 != kind) return true;
+        if (b > 0) { if (d < target) found = pos; d++; }
+        else d--;
+        return true;
+    };
+    PieceIterator it(pt, at.start);
+    ScanBrackets(it, to - at.start, state, visit);
+    if (found != SIZE_MAX) return found;
+    Probe root = { 0, 0, STATE_CODE, { 0, 0, 0 } }, hit;
+    if (descendBackward(1, 0, leafBase, at.block, root, kind, target, hit) == SIZE_MAX) return SIZE_MAX;
+    state = hit.state; d = hit.depth[kind];
+    it.seek(hit.start);
+    ScanBrackets(it, blocks[hit.block].len, state, visit);
+    return found;
+}
+bool BracketIndex::matchAt(const PieceTable& pt, size_t pos, size_t& open, size_t& close) const {
+    if (!complete || blocks.empty()) return false;
+    for (size_t c : { pos, pos - 1 }) {
+        if (c >= builtBytes) continue;
+        Probe at = locate(c);
+        int state = at.state; int64_t depth[KIND_COUNT] = { at.depth[0], at.depth[1], at.depth[2] };
+        PieceIterator it(pt, at.start);
+        ScanBrackets(it, c - at.start, state, [&](size_t, int b) { depth[std::abs(b) - 1] += b > 0 ? 1 : -1; return true; });
+        int b = kBracketTables.bracket[(unsigned char)*it];
+        if (state != STATE_CODE || b == 0) continue;
+        int kind = std::abs(b) - 1;
+        if (b > 0) { size_t m = findClose(pt, at, c + 1, kind, depth[kind] + 1); if (m != SIZE_MAX) { open = c; close = m; return true; } }
+        else { size_t m = findOpen(pt, at, c, kind, depth[kind]); if (m != SIZE_MAX) { open = m; close = c; return true; } }
+    }
+    return false;
+}
+bool BracketIndex::enclosing(const PieceTable& pt, size_t pos, size_t& open, size_t& close) const {
+    if (!complete || pos >= builtBytes) return false;
+    Probe at = locate(pos);
+    int state = at.state; int64_t depth[KIND_COUNT] = { at.depth[0], at.depth[1], at.depth[2] };
+    PieceIterator it(pt, at.start);
+    ScanBrackets(it, pos - at.start, state, [&](size_t, int b) { depth[std::abs(b) - 1] += b > 0 ? 1 : -1; return true; });
+    bool found = false;
+    for (int kind = 0; kind < KIND_COUNT; ++kind) {
+        size_t o = findOpen(pt, at, pos, kind, depth[kind]);
+        if (o == SIZE_MAX || (found && o <= open)) continue;
+        size_t c = findClose(pt, at, pos, kind, depth[kind]);
+        if (c == SIZE_MAX) continue;
+        open = o; close = c; found = true;
+    }
+    return found;
+}
+// from から to まで読み、種類ごとにまだ閉じていない開き括弧の位置を積む
+static void StackOpens(const PieceTable& pt, size_t from, size_t to, int& state, std::vector<size_t> (&opens)[BracketIndex::KIND_COUNT]) {
+    PieceIterator it(pt, from);
+    ScanBrackets(it, to - from, state, [&](size_t pos, int b) {
+        auto& stack = opens[std::abs(b) - 1];
+        if (b > 0) stack.push_back(pos); else if (!stack.empty()) stack.pop_back();
+        return true;
+    });
+}
+// from (状態 state) から end までで、括弧 kind の深さが from より浅くなる閉じ括弧の位置。なければ SIZE_MAX
+static size_t ScanClose(const PieceTable& pt, size_t from, size_t end, int state, int kind) {
+    int64_t d = 0; size_t found = SIZE_MAX;
+    PieceIterator it(pt, from);
+    ScanBrackets(it, end - from, state, [&](size_t pos, int b) {
+        if (std::abs(b) - 1 != kind) return true;
+        if (b > 0) d++; else if (--d < 0) { found = pos; return false; }
+        return true;
+    });
+    return found;
+}
+BracketIndex::NearResult BracketIndex::matchNear(const PieceTable& pt, size_t from, size_t pos, size_t limit, size_t& open, size_t& close) {
+    size_t len = pt.length(), end = std::min(len, pos + limit);
+    for (size_t c : { pos, pos - 1 }) {
+        if (c < from || c >= len) continue;
+        std::vector<size_t> opens[KIND_COUNT]; int state = STATE_CODE;
+        StackOpens(pt, from, c, state, opens);
+        int b = kBracketTables.bracket[(unsigned char)pt.charAt(c)];
+        if (state != STATE_CODE || b == 0) continue;
+        int kind = std::abs(b) - 1;
+        if (b < 0) {
+            if (!opens[kind].empty()) { open = opens[kind].back(); close = c; return NEAR_FOUND; }
+            if (from > 0) return NEAR_UNKNOWN;
+            continue;
+        }
+        size_t m = ScanClose(pt, c + 1, std::max(end, c + 1), STATE_CODE, kind);
+        if (m != SIZE_MAX) { open = c; close = m; return NEAR_FOUND; }
+        if (end < len) return NEAR_UNKNOWN;
+    }
+    return NEAR_NONE;
+}
+BracketIndex::NearResult BracketIndex::enclosingNear(const PieceTable& pt, size_t from, size_t pos, size_t limit, size_t& open, size_t& close) {
+    size_t len = pt.length(), end = std::min(len, pos + limit);
+    if (pos >= len) return NEAR_NONE;
+    std::vector<size_t> opens[KIND_COUNT]; int state = STATE_CODE;
+    StackOpens(pt, from, pos, state, opens);
+    // 開き括弧が後ろにある (内側の) 種類から、閉じ括弧のあるものを選ぶ。閉じていない開き括弧の後ろに閉じ括弧はない
+    int order[KIND_COUNT] = { 0, 1, 2 };
+    std::sort(order, order + KIND_COUNT, [&](int a, int b) { return (opens[a].empty() ? 0 : opens[a].back() + 1) > (opens[b].empty() ? 0 : opens[b].back() + 1); });
+    for (int kind : order) {
+        if (opens[kind].empty()) return from > 0 ? NEAR_UNKNOWN : NEAR_NONE;
+        size_t m = ScanClose(pt, pos, end, state, kind);
+        if (m != SIZE_MAX) { open = opens[kind].back(); close = m; return NEAR_FOUND; }
+        if (end < len) return NEAR_UNKNOWN;
+    }
+    return NEAR_NONE;
+}
+BracketIndex::NearResult BracketIndex::quoteAt(const PieceTable& pt, size_t lineStart, size_t pos, size_t limit, size_t& open, size_t& close) {
+    size_t len = pt.length(), end = std::min(len, pos + limit);
+    for (size_t c : { pos, pos - 1 }) {
+        if (c < lineStart || c >= len || pt.charAt(c) != '"') continue;
+        // 行頭から c の手前まで読んで、c が文字列を開くのか閉じるのかを決める
+        int state = STATE_CODE; size_t opened = SIZE_MAX, at = lineStart;
+        PieceIterator it(pt, lineStart);
+        it.forEachSpan(c - lineStart, [&](const char* data, size_t m) {
+            for (size_t i = 0; i < m; ++i) {
+                if (data[i] == '"' && state == STATE_CODE) opened = at + i;
+                state = kBracketTables.next[state][(unsigned char)data[i]];
+            }
+            at += m;
+            return true;
+        });
+        if (state == STATE_STRING) { open = opened; close = c; return NEAR_FOUND; }
+        if (state != STATE_CODE) continue;
+        // 開く " なら閉じる " を探す。閉じずに行が終わればその文字列に組はない
+        state = STATE_STRING; at = c + 1; size_t found = SIZE_MAX; bool lineEnded = false;
+        ++it;
+        it.forEachSpan(std::max(end, c + 1) - c - 1, [&](const char* data, size_t m) {
+            for (size_t i = 0; i < m; ++i) {
+                if (data[i] == '"' && state == STATE_STRING) { found = at + i; return false; }
+                state = kBracketTables.next[state][(unsigned char)data[i]];
+                if (state == STATE_CODE) { lineEnded = true; return false; }
+            }
+            at += m;
+            return true;
+        });
+        if (found != SIZE_MAX) { open = c; close = found; return NEAR_FOUND; }
+        if (!lineEnded && end < len) return NEAR_UNKNOWN;
+    }
+    return NEAR_NONE;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PieceTable.h"
+// 括弧 () [] {} の対応を探す索引。文書を kBlockBytes 前後のブロックに分け、ブロックごとに種類別の深さの増減と最小値を持つ
+// "..." の中の括弧は数えない (文字列は行をまたがず、\ は次の 1 文字を打ち消す)。ブロックの入口がどの状態でも引けるよう状態ごとに要約する
+// 要約を葉にした木をたどり、対応する括弧のあるブロックまで O(log n) で飛ぶ。編集では変わった範囲に掛かるブロックだけ読み直す
+struct BracketIndex {
+    static constexpr size_t kBlockBytes = 16384;
+    // 作り直す量がこれより多ければその場では作らず、アイドル時に buildStep で少しずつ作る
+    static constexpr size_t kSyncBuildBytes = (size_t)8 << 20;
+    // 索引ができる前に飛ぶときは、まずカーソルの前後これだけを直接読んで探す
+    static constexpr size_t kNearBytes = 4 * kBlockBytes;
+    enum { STATE_CODE, STATE_STRING, STATE_ESCAPE, STATE_COUNT };
+    enum { KIND_COUNT = 3 };
+    struct Summary {
+        size_t len = 0;
+        uint8_t exit[STATE_COUNT] = { STATE_CODE, STATE_STRING, STATE_ESCAPE };
+        // 入口の状態・括弧の種類ごとの、ブロック全体での深さの増減と、先頭から末尾までの各位置での深さの最小値 (先頭を 0 として)
+        // 位置を持たない (空の) 要約の low は kNoPoint
+        int32_t net[STATE_COUNT][KIND_COUNT] = {}; int32_t low[STATE_COUNT][KIND_COUNT] = {};
+    };
+    std::vector<Summary> blocks;
+    // 先頭から builtBytes バイトまでのブロックができている。complete なら文書全体
+    size_t builtBytes = 0; bool complete = false;
+    void reset() { blocks.clear(); tree.clear(); leafBase = 0; builtBytes = 0; complete = false; }
+    // 前回から change の分だけ書き換わった文書に合わせる。作り直す量が kSyncBuildBytes 以下ならその場で作り終える
+    void update(const PieceTable& pt, const ChangeSpan& change);
+    // 続きのブロックを budgetNs だけ作る。まだ続きがあれば true
+    bool buildStep(const PieceTable& pt, uint64_t budgetNs);
+    // pos の文字 (括弧でなければ pos の直前の文字) が文字列の外の括弧なら、それと対応する括弧の組 (open < close)
+    bool matchAt(const PieceTable& pt, size_t pos, size_t& open, size_t& close) const;
+    // pos を囲む最も内側の括弧の組 (open < pos <= close)
+    bool enclosing(const PieceTable& pt, size_t pos, size_t& open, size_t& close) const;
+    // 索引を使わずに from から pos の limit バイト先までだけを読んで、matchAt・enclosing と同じ組を求める。from は文字列の外 (行頭か文書の先頭)
+    // 組があれば NEAR_FOUND、ないと決まれば NEAR_NONE。相手が読んだ範囲の外にあるかもしれなければ NEAR_UNKNOWN
+    enum NearResult { NEAR_NONE, NEAR_FOUND, NEAR_UNKNOWN };
+    static NearResult matchNear(const PieceTable& pt, size_t from, size_t pos, size_t limit, size_t& open, size_t& close);
+    static NearResult enclosingNear(const PieceTable& pt, size_t from, size_t pos, size_t limit, size_t& open, size_t& close);
+    // pos の文字 (" でなければ pos の直前の文字) が文字列の両端の " なら、その組 (open < close)。文字列は行をまたがないので lineStart から読む
+    static NearResult quoteAt(const PieceTable& pt, size_t lineStart, size_t pos, size_t limit, size_t& open, size_t& close);
+    size_t memoryBytes() const { return (blocks.capacity() + tree.capacity()) * sizeof(Summary); }
+private:
+    // 内部節点。節点 i の子は 2i と 2i + 1、葉 (leafBase + ブロック番号) は blocks を指す
+    std::vector<Summary> tree; size_t leafBase = 0;
+    const Summary& node(size_t i) const;
+    void rebuildTree();
+    void refreshPath(size_t block);
+    // ブロック block (先頭 start) の入口での状態と種類ごとの深さ
+    struct Probe { size_t block, start; int state; int64_t depth[KIND_COUNT]; };
+    Probe locate(size_t pos) const;
+    size_t descendForward(size_t i, size_t lo, size_t hi, size_t from, Probe& p, int kind, int64_t target) const;
+    size_t descendBackward(size_t i, size_t lo, size_t hi, size_t to, Probe p, int kind, int64_t target, Probe& out) const;
+    size_t findClose(const PieceTable& pt, const Probe& at, size_t from, int kind, int64_t target) const;
+    size_t findOpen(const PieceTable& pt, const Probe& at, size_t to, int kind, int64_t target) const;
+};
@@ -0,0 +1,164 @@
+#include "CaseMap.h"
+#include <algorithm>
+#include <vector>
+#include "ThreadPool.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIU_SSE2 1
+#endif
+// first から stride おきに count 個の文字は delta を足すと変換後の文字になる。first の昇順で、範囲は重ならない
+// Unicode 14.0 の UnicodeData.txt の単純大文字・小文字対応 (12・13 番目の欄) を、ASCII を除いてまとめたもの
+struct CaseRun { uint32_t first; uint16_t count; uint8_t stride; int32_t delta; };
+static const CaseRun kUpperRuns[] = {
+    { 0xB5, 1, 1, 743 }, { 0xE0, 23, 1, -32 }, { 0xF8, 7, 1, -32 }, { 0xFF, 1, 1, 121 }, { 0x101, 24, 2, -1 }, { 0x131, 1, 1, -232 },
+    { 0x133, 3, 2, -1 }, { 0x13A, 8, 2, -1 }, { 0x14B, 23, 2, -1 }, { 0x17A, 3, 2, -1 }, { 0x17F, 1, 1, -300 }, { 0x180, 1, 1, 195 },
+    { 0x183, 2, 2, -1 }, { 0x188, 1, 1, -1 }, { 0x18C, 1, 1, -1 }, { 0x192, 1, 1, -1 }, { 0x195, 1, 1, 97 }, { 0x199, 1, 1, -1 },
+    { 0x19A, 1, 1, 163 }, { 0x19E, 1, 1, 130 }, { 0x1A1, 3, 2, -1 }, { 0x1A8, 1, 1, -1 }, { 0x1AD, 1, 1, -1 }, { 0x1B0, 1, 1, -1 },
+    { 0x1B4, 2, 2, -1 }, { 0x1B9, 1, 1, -1 }, { 0x1BD, 1, 1, -1 }, { 0x1BF, 1, 1, 56 }, { 0x1C5, 1, 1, -1 }, { 0x1C6, 1, 1, -2 }, { 0x1C8, 1, 1, -1 },
+    { 0x1C9, 1, 1, -2 }, { 0x1CB, 1, 1, -1 }, { 0x1CC, 1, 1, -2 }, { 0x1CE, 8, 2, -1 }, { 0x1DD, 1, 1, -79 }, { 0x1DF, 9, 2, -1 },
+    { 0x1F2, 1, 1, -1 }, { 0x1F3, 1, 1, -2 }, { 0x1F5, 1, 1, -1 }, { 0x1F9, 20, 2, -1 }, { 0x223, 9, 2, -1 }, { 0x23C, 1, 1, -1 },
+    { 0x23F, 2, 1, 10815 }, { 0x242, 1, 1, -1 }, { 0x247, 5, 2, -1 }, { 0x250, 1, 1, 10783 }, { 0x251, 1, 1, 10780 }, { 0x252, 1, 1, 10782 },
+    { 0x253, 1, 1, -210 }, { 0x254, 1, 1, -206 }, { 0x256, 2, 1, -205 }, { 0x259, 1, 1, -202 }, { 0x25B, 1, 1, -203 }, { 0x25C, 1, 1, 42319 },
+    { 0x260, 1, 1, -205 }, { 0x261, 1, 1, 42315 }, { 0x263, 1, 1, -207 }, { 0x265, 1, 1, 42280 }, { 0x266, 1, 1, 42308 }, { 0x268, 1, 1, -209 },
+    { 0x269, 1, 1, -211 }, { 0x26A, 1, 1, 42308 }, { 0x26B, 1, 1, 10743 }, { 0x26C, 1, 1, 42305 }, { 0x26F, 1, 1, -211 }, { 0x271, 1, 1, 10749 },
+    { 0x272, 1, 1, -213 }, { 0x275, 1, 1, -214 }, { 0x27D, 1, 1, 10727 }, { 0x280, 1, 1, -218 }, { 0x282, 1, 1, 42307 }, { 0x283, 1, 1, -218 },
+    { 0x287, 1, 1, 42282 }, { 0x288, 1, 1, -218 }, { 0x289, 1, 1, -69 }, { 0x28A, 2, 1, -217 }, { 0x28C, 1, 1, -71 }, { 0x292, 1, 1, -219 },
+    { 0x29D, 1, 1, 42261 }, { 0x29E, 1, 1, 42258 }, { 0x345, 1, 1, 84 }, { 0x371, 2, 2, -1 }, { 0x377, 1, 1, -1 }, { 0x37B, 3, 1, 130 },
+    { 0x3AC, 1, 1, -38 }, { 0x3AD, 3, 1, -37 }, { 0x3B1, 17, 1, -32 }, { 0x3C2, 1, 1, -31 }, { 0x3C3, 9, 1, -32 }, { 0x3CC, 1, 1, -64 },
+    { 0x3CD, 2, 1, -63 }, { 0x3D0, 1, 1, -62 }, { 0x3D1, 1, 1, -57 }, { 0x3D5, 1, 1, -47 }, { 0x3D6, 1, 1, -54 }, { 0x3D7, 1, 1, -8 },
+    { 0x3D9, 12, 2, -1 }, { 0x3F0, 1, 1, -86 }, { 0x3F1, 1, 1, -80 }, { 0x3F2, 1, 1, 7 }, { 0x3F3, 1, 1, -116 }, { 0x3F5, 1, 1, -96 },
+    { 0x3F8, 1, 1, -1 }, { 0x3FB, 1, 1, -1 }, { 0x430, 32, 1, -32 }, { 0x450, 16, 1, -80 }, { 0x461, 17, 2, -1 }, { 0x48B, 27, 2, -1 },
+    { 0x4C2, 7, 2, -1 }, { 0x4CF, 1, 1, -15 }, { 0x4D1, 48, 2, -1 }, { 0x561, 38, 1, -48 }, { 0x10D0, 43, 1, 3008 }, { 0x10FD, 3, 1, 3008 },
+    { 0x13F8, 6, 1, -8 }, { 0x1C80, 1, 1, -6254 }, { 0x1C81, 1, 1, -6253 }, { 0x1C82, 1, 1, -6244 }, { 0x1C83, 2, 1, -6242 }, { 0x1C85, 1, 1, -6243 },
+    { 0x1C86, 1, 1, -6236 }, { 0x1C87, 1, 1, -6181 }, { 0x1C88, 1, 1, 35266 }, { 0x1D79, 1, 1, 35332 }, { 0x1D7D, 1, 1, 3814 },
+    { 0x1D8E, 1, 1, 35384 }, { 0x1E01, 75, 2, -1 }, { 0x1E9B, 1, 1, -59 }, { 0x1EA1, 48, 2, -1 }, { 0x1F00, 8, 1, 8 }, { 0x1F10, 6, 1, 8 },
+    { 0x1F20, 8, 1, 8 }, { 0x1F30, 8, 1, 8 }, { 0x1F40, 6, 1, 8 }, { 0x1F51, 4, 2, 8 }, { 0x1F60, 8, 1, 8 }, { 0x1F70, 2, 1, 74 },
+    { 0x1F72, 4, 1, 86 }, { 0x1F76, 2, 1, 100 }, { 0x1F78, 2, 1, 128 }, { 0x1F7A, 2, 1, 112 }, { 0x1F7C, 2, 1, 126 }, { 0x1F80, 8, 1, 8 },
+    { 0x1F90, 8, 1, 8 }, { 0x1FA0, 8, 1, 8 }, { 0x1FB0, 2, 1, 8 }, { 0x1FB3, 1, 1, 9 }, { 0x1FBE, 1, 1, -7205 }, { 0x1FC3, 1, 1, 9 },
+    { 0x1FD0, 2, 1, 8 }, { 0x1FE0, 2, 1, 8 }, { 0x1FE5, 1, 1, 7 }, { 0x1FF3, 1, 1, 9 }, { 0x214E, 1, 1, -28 }, { 0x2170, 16, 1, -16 },
+    { 0x2184, 1, 1, -1 }, { 0x24D0, 26, 1, -26 }, { 0x2C30, 48, 1, -48 }, { 0x2C61, 1, 1, -1 }, { 0x2C65, 1, 1, -10795 }, { 0x2C66, 1, 1, -10792 },
+    { 0x2C68, 3, 2, -1 }, { 0x2C73, 1, 1, -1 }, { 0x2C76, 1, 1, -1 }, { 0x2C81, 50, 2, -1 }, { 0x2CEC, 2, 2, -1 }, { 0x2CF3, 1, 1, -1 },
+    { 0x2D00, 38, 1, -7264 }, { 0x2D27, 1, 1, -7264 }, { 0x2D2D, 1, 1, -7264 }, { 0xA641, 23, 2, -1 }, { 0xA681, 14, 2, -1 }, { 0xA723, 7, 2, -1 },
+    { 0xA733, 31, 2, -1 }, { 0xA77A, 2, 2, -1 }, { 0xA77F, 5, 2, -1 }, { 0xA78C, 1, 1, -1 }, { 0xA791, 2, 2, -1 }, { 0xA794, 1, 1, 48 },
+    { 0xA797, 10, 2, -1 }, { 0xA7B5, 8, 2, -1 }, { 0xA7C8, 2, 2, -1 }, { 0xA7D1, 1, 1, -1 }, { 0xA7D7, 2, 2, -1 }, { 0xA7F6, 1, 1, -1 },
+    { 0xAB53, 1, 1, -928 }, { 0xAB70, 80, 1, -38864 }, { 0xFF41, 26, 1, -32 }, { 0x10428, 40, 1, -40 }, { 0x104D8, 36, 1, -40 },
+    { 0x10597, 11, 1, -39 }, { 0x105A3, 15, 1, -39 }, { 0x105B3, 7, 1, -39 }, { 0x105BB, 2, 1, -39 }, { 0x10CC0, 51, 1, -64 },
+    { 0x118C0, 32, 1, -32 }, { 0x16E60, 32, 1, -32 }, { 0x1E922, 34, 1, -34 },
+};
+static const CaseRun kLowerRuns[] = {
+    { 0xC0, 23, 1, 32 }, { 0xD8, 7, 1, 32 }, { 0x100, 24, 2, 1 }, { 0x130, 1, 1, -199 }, { 0x132, 3, 2, 1 }, { 0x139, 8, 2, 1 }, { 0x14A, 23, 2, 1 },
+    { 0x178, 1, 1, -121 }, { 0x179, 3, 2, 1 }, { 0x181, 1, 1, 210 }, { 0x182, 2, 2, 1 }, { 0x186, 1, 1, 206 }, { 0x187, 1, 1, 1 }, { 0x189, 2, 1, 205 },
+    { 0x18B, 1, 1, 1 }, { 0x18E, 1, 1, 79 }, { 0x18F, 1, 1, 202 }, { 0x190, 1, 1, 203 }, { 0x191, 1, 1, 1 }, { 0x193, 1, 1, 205 }, { 0x194, 1, 1, 207 },
+    { 0x196, 1, 1, 211 }, { 0x197, 1, 1, 209 }, { 0x198, 1, 1, 1 }, { 0x19C, 1, 1, 211 }, { 0x19D, 1, 1, 213 }, { 0x19F, 1, 1, 214 },
+    { 0x1A0, 3, 2, 1 }, { 0x1A6, 1, 1, 218 }, { 0x1A7, 1, 1, 1 }, { 0x1A9, 1, 1, 218 }, { 0x1AC, 1, 1, 1 }, { 0x1AE, 1, 1, 218 }, { 0x1AF, 1, 1, 1 },
+    { 0x1B1, 2, 1, 217 }, { 0x1B3, 2, 2, 1 }, { 0x1B7, 1, 1, 219 }, { 0x1B8, 1, 1, 1 }, { 0x1BC, 1, 1, 1 }, { 0x1C4, 1, 1, 2 }, { 0x1C5, 1, 1, 1 },
+    { 0x1C7, 1, 1, 2 }, { 0x1C8, 1, 1, 1 }, { 0x1CA, 1, 1, 2 }, { 0x1CB, 9, 2, 1 }, { 0x1DE, 9, 2, 1 }, { 0x1F1, 1, 1, 2 }, { 0x1F2, 2, 2, 1 },
+    { 0x1F6, 1, 1, -97 }, { 0x1F7, 1, 1, -56 }, { 0x1F8, 20, 2, 1 }, { 0x220, 1, 1, -130 }, { 0x222, 9, 2, 1 }, { 0x23A, 1, 1, 10795 },
+    { 0x23B, 1, 1, 1 }, { 0x23D, 1, 1, -163 }, { 0x23E, 1, 1, 10792 }, { 0x241, 1, 1, 1 }, { 0x243, 1, 1, -195 }, { 0x244, 1, 1, 69 },
+    { 0x245, 1, 1, 71 }, { 0x246, 5, 2, 1 }, { 0x370, 2, 2, 1 }, { 0x376, 1, 1, 1 }, { 0x37F, 1, 1, 116 }, { 0x386, 1, 1, 38 }, { 0x388, 3, 1, 37 },
+    { 0x38C, 1, 1, 64 }, { 0x38E, 2, 1, 63 }, { 0x391, 17, 1, 32 }, { 0x3A3, 9, 1, 32 }, { 0x3CF, 1, 1, 8 }, { 0x3D8, 12, 2, 1 },
+    { 0x3F4, 1, 1, -60 }, { 0x3F7, 1, 1, 1 }, { 0x3F9, 1, 1, -7 }, { 0x3FA, 1, 1, 1 }, { 0x3FD, 3, 1, -130 }, { 0x400, 16, 1, 80 },
+    { 0x410, 32, 1, 32 }, { 0x460, 17, 2, 1 }, { 0x48A, 27, 2, 1 }, { 0x4C0, 1, 1, 15 }, { 0x4C1, 7, 2, 1 }, { 0x4D0, 48, 2, 1 },
+    { 0x531, 38, 1, 48 }, { 0x10A0, 38, 1, 7264 }, { 0x10C7, 1, 1, 7264 }, { 0x10CD, 1, 1, 7264 }, { 0x13A0, 80, 1, 38864 }, { 0x13F0, 6, 1, 8 },
+    { 0x1C90, 43, 1, -3008 }, { 0x1CBD, 3, 1, -3008 }, { 0x1E00, 75, 2, 1 }, { 0x1E9E, 1, 1, -7615 }, { 0x1EA0, 48, 2, 1 }, { 0x1F08, 8, 1, -8 },
+    { 0x1F18, 6, 1, -8 }, { 0x1F28, 8, 1, -8 }, { 0x1F38, 8, 1, -8 }, { 0x1F48, 6, 1, -8 }, { 0x1F59, 4, 2, -8 }, { 0x1F68, 8, 1, -8 },
+    { 0x1F88, 8, 1, -8 }, { 0x1F98, 8, 1, -8 }, { 0x1FA8, 8, 1, -8 }, { 0x1FB8, 2, 1, -8 }, { 0x1FBA, 2, 1, -74 }, { 0x1FBC, 1, 1, -9 },
+    { 0x1FC8, 4, 1, -86 }, { 0x1FCC, 1, 1, -9 }, { 0x1FD8, 2, 1, -8 }, { 0x1FDA, 2, 1, -100 }, { 0x1FE8, 2, 1, -8 }, { 0x1FEA, 2, 1, -112 },
+    { 0x1FEC, 1, 1, -7 }, { 0x1FF8, 2, 1, -128 }, { 0x1FFA, 2, 1, -126 }, { 0x1FFC, 1, 1, -9 }, { 0x2126, 1, 1, -7517 }, { 0x212A, 1, 1, -8383 },
+    { 0x212B, 1, 1, -8262 }, { 0x2132, 1, 1, 28 }, { 0x2160, 16, 1, 16 }, { 0x2183, 1, 1, 1 }, { 0x24B6, 26, 1, 26 }, { 0x2C00, 48, 1, 48 },
+    { 0x2C60, 1, 1, 1 }, { 0x2C62, 1, 1, -10743 }, { 0x2C63, 1, 1, -3814 }, { 0x2C64, 1, 1, -10727 }, { 0x2C67, 3, 2, 1 }, { 0x2C6D, 1, 1, -10780 },
+    { 0x2C6E, 1, 1, -10749 }, { 0x2C6F, 1, 1, -10783 }, { 0x2C70, 1, 1, -10782 }, { 0x2C72, 1, 1, 1 }, { 0x2C75, 1, 1, 1 }, { 0x2C7E, 2, 1, -10815 },
+    { 0x2C80, 50, 2, 1 }, { 0x2CEB, 2, 2, 1 }, { 0x2CF2, 1, 1, 1 }, { 0xA640, 23, 2, 1 }, { 0xA680, 14, 2, 1 }, { 0xA722, 7, 2, 1 },
+    { 0xA732, 31, 2, 1 }, { 0xA779, 2, 2, 1 }, { 0xA77D, 1, 1, -35332 }, { 0xA77E, 5, 2, 1 }, { 0xA78B, 1, 1, 1 }, { 0xA78D, 1, 1, -42280 },
+    { 0xA790, 2, 2, 1 }, { 0xA796, 10, 2, 1 }, { 0xA7AA, 1, 1, -42308 }, { 0xA7AB, 1, 1, -42319 }, { 0xA7AC, 1, 1, -42315 }, { 0xA7AD, 1, 1, -42305 },
+    { 0xA7AE, 1, 1, -42308 }, { 0xA7B0, 1, 1, -42258 }, { 0xA7B1, 1, 1, -42282 }, { 0xA7B2, 1, 1, -42261 }, { 0xA7B3, 1, 1, 928 },
+    { 0xA7B4, 8, 2, 1 }, { 0xA7C4, 1, 1, -48 }, { 0xA7C5, 1, 1, -42307 }, { 0xA7C6, 1, 1, -35384 }, { 0xA7C7, 2, 2, 1 }, { 0xA7D0, 1, 1, 1 },
+    { 0xA7D6, 2, 2, 1 }, { 0xA7F5, 1, 1, 1 }, { 0xFF21, 26, 1, 32 }, { 0x10400, 40, 1, 40 }, { 0x104B0, 36, 1, 40 }, { 0x10570, 11, 1, 39 },
+    { 0x1057C, 15, 1, 39 }, { 0x1058C, 7, 1, 39 }, { 0x10594, 2, 1, 39 }, { 0x10C80, 51, 1, 64 }, { 0x118A0, 32, 1, 32 }, { 0x16E40, 32, 1, 32 },
+    { 0x1E900, 34, 1, 34 },
+};
+uint32_t MapCodePointCase(uint32_t cp, bool toUpper) {
+    if (cp < 0x80) return toUpper ? (cp >= 'a' && cp <= 'z' ? cp - 32 : cp) : (cp >= 'A' && cp <= 'Z' ? cp + 32 : cp);
+    const CaseRun* begin = toUpper ? kUpperRuns : kLowerRuns;
+    const CaseRun* end = begin + (toUpper ? sizeof(kUpperRuns) : sizeof(kLowerRuns)) / sizeof(CaseRun);
+    const CaseRun* r = std::upper_bound(begin, end, cp, [](uint32_t c, const CaseRun& run) { return c < run.first; });
+    if (r == begin) return cp;
+    --r;
+    uint32_t off = cp - r->first;
+    if (off % r->stride != 0 || off / r->stride >= r->count) return cp;
+    return (uint32_t)((int32_t)cp + r->delta);
+}
+// s の先頭の 1 文字を読んでバイト数を返す。不正 (途切れ・冗長な表現・サロゲート・範囲外) なら 0
+static size_t DecodeUtf8(const unsigned char* s, size_t avail, uint32_t& cp) {
+    unsigned char c = s[0];
+    size_t n = (c >= 0xF0 && c <= 0xF4) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC2 && c < 0xE0) ? 2 : 0;
+    if (n == 0 || c > 0xF4 || n > avail) return 0;
+    cp = c & (0x7F >> n);
+    for (size_t i = 1; i < n; ++i) { if ((s[i] & 0xC0) != 0x80) return 0; cp = (cp << 6) | (s[i] & 0x3F); }
+    if ((n == 3 && (cp < 0x800 || (cp >= 0xD800 && cp < 0xE000))) || (n == 4 && (cp < 0x10000 || cp > 0x10FFFF))) return 0;
+    return n;
+}
+static size_t Utf8Length(uint32_t cp) { return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4; }
+static void EncodeUtf8(uint32_t cp, char* out) {
+    if (cp < 0x80) { out[0] = (char)cp; return; }
+    if (cp < 0x800) { out[0] = (char)(0xC0 | (cp >> 6)); out[1] = (char)(0x80 | (cp & 0x3F)); return; }
+    if (cp < 0x10000) { out[0] = (char)(0xE0 | (cp >> 12)); out[1] = (char)(0x80 | ((cp >> 6) & 0x3F)); out[2] = (char)(0x80 | (cp & 0x3F)); return; }
+    out[0] = (char)(0xF0 | (cp >> 18)); out[1] = (char)(0x80 | ((cp >> 12) & 0x3F)); out[2] = (char)(0x80 | ((cp >> 6) & 0x3F)); out[3] = (char)(0x80 | (cp & 0x3F));
+}
+// [p, end) を変換したバイト数を返す。out があればそこに書く。変わる文字があれば changed を立てる
+static size_t MapSegment(const char* p, const char* end, bool toUpper, char* out, bool& changed) {
+    size_t o = 0;
+    const char lo = toUpper ? 'a' : 'A', hi = toUpper ? 'z' : 'Z';
+#ifdef MIU_SSE2
+    const __m128i vlo = _mm_set1_epi8(lo - 1), vhi = _mm_set1_epi8(hi + 1), flip = _mm_set1_epi8(0x20);
+#endif
+    while (p < end) {
+#ifdef MIU_SSE2
+        // 16 バイトすべてが ASCII なら、対象の英字だけ 0x20 を反転する
+        if (end - p >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            if (_mm_movemask_epi8(v) == 0) {
+                __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(v, vlo), _mm_cmplt_epi8(v, vhi));
+                if (_mm_movemask_epi8(letters)) { changed = true; v = _mm_xor_si128(v, _mm_and_si128(letters, flip)); }
+                if (out) _mm_storeu_si128((__m128i*)(out + o), v);
+                p += 16; o += 16; continue;
+            }
+        }
+#endif
+        unsigned char c = (unsigned char)*p;
+        if (c < 0x80) {
+            if (c >= (unsigned char)lo && c <= (unsigned char)hi) { changed = true; c ^= 0x20; }
+            if (out) out[o] = (char)c;
+            p++; o++; continue;
+        }
+        uint32_t cp; size_t n = DecodeUtf8((const unsigned char*)p, end - p, cp);
+        if (n == 0) { if (out) out[o] = *p; p++; o++; continue; }
+        uint32_t m = MapCodePointCase(cp, toUpper);
+        if (m == cp) { if (out) std::copy(p, p + n, out + o); o += n; }
+        else { changed = true; if (out) EncodeUtf8(m, out + o); o += Utf8Length(m); }
+        p += n;
+    }
+    return o;
+}
+bool MapCase(std::string_view text, bool toUpper, const std::function<char*(size_t)>& alloc) {
+    const size_t kParallelCase = (size_t)4 << 20, kCaseChunk = (size_t)1 << 20;
+    // 区切りは文字の途中に来ないよう後ろの継続バイトを飛ばす (不正な並びは 1 バイトずつ写すので、3 バイト先で止めても結果は同じ)
+    std::vector<size_t> bounds(1, 0);
+    if (text.size() >= kParallelCase) {
+        for (size_t pos = kCaseChunk; pos < text.size(); pos += kCaseChunk) {
+            for (int k = 0; k < 3 && pos < text.size() && ((unsigned char)text[pos] & 0xC0) == 0x80; ++k) pos++;
+            if (pos < text.size()) bounds.push_back(pos);
+        }
+    }
+    bounds.push_back(text.size());
+    size_t parts = bounds.size() - 1;
+    std::vector<size_t> lengths(parts); std::vector<char> changed(parts, 0);
+    auto forParts = [&](const std::function<void(size_t)>& fn) { if (parts == 1) fn(0); else ParallelFor(SharedThreadPool(), parts, fn); };
+    forParts([&](size_t i) { bool c = false; lengths[i] = MapSegment(text.data() + bounds[i], text.data() + bounds[i + 1], toUpper, nullptr, c); changed[i] = c; });
+    if (std::find(changed.begin(), changed.end(), 1) == changed.end()) return false;
+    std::vector<size_t> offsets(parts + 1, 0);
+    for (size_t i = 0; i < parts; ++i) offsets[i + 1] = offsets[i] + lengths[i];
+    char* out = alloc(offsets[parts]);
+    forParts([&](size_t i) { bool c = false; MapSegment(text.data() + bounds[i], text.data() + bounds[i + 1], toUpper, out + offsets[i], c); });
+    return true;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+// UTF-8 のまま大文字・小文字に変換する。対応は Unicode の単純大文字小文字対応 (1 文字 → 1 文字) で、ß → SS のような文字数の変わる変換はしない
+// 不正なバイト列はそのまま写す。変換でバイト数が変わる文字 (ı → I など) もある
+uint32_t MapCodePointCase(uint32_t cp, bool toUpper);
+// text を変換した結果を alloc(n) が返す n バイトの領域に書く。変わる文字がなければ alloc を呼ばずに false を返す
+// ASCII は SSE2 で 16 バイトずつ変換する。大きいときは文字の境目で区切って共有スレッドプールで並列に処理する (長さを数えてから書く)
+bool MapCase(std::string_view text, bool toUpper, const std::function<char*(size_t)>& alloc);
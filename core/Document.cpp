@@ -0,0 +1,1155 @@
+#include "Document.h"
+#include <algorithm>
+#include "Trace.h"
+static const int kTabColumns = 4;
+void Document::rebuildLineStarts() {
+    TRACE_SCOPE("rebuildLineStarts");
+    // 絞り込みと色分けの行頭の状態は、変わった範囲に掛かる行を古い行インデックスで求めておき、その行だけ調べ直す
+    ChangeSpan change = pt.takeChange();
+    bracketIndex.update(pt, change);
+    bool relines = change.any() && (lineFilter.active || SyntaxHasLineState(syntax.language));
+    size_t first = 0, oldEnd = 0;
+    if (relines) { first = (size_t)getLineIdx(change.from); oldEnd = (size_t)getLineIdx(change.oldLength - change.tail) + 1; }
+    maxLineBytes = BuildLineStarts(pt, lineStarts, &newlineCounts);
+    if (relines) {
+        size_t newEnd = (size_t)getLineIdx(change.newLength - change.tail) + 1;
+        if (lineFilter.active) lineFilter.update(pt, lineStarts, first, oldEnd, newEnd);
+        syntax.update(lineStarts.size(), first, oldEnd, newEnd);
+    }
+    sampleMemory(); lineStartsChanged();
+}
+bool Document::setLineFilter(bool on) {
+    TRACE_SCOPE("setLineFilter");
+    SessionRecorder::Scope rs(recorder, cursors, "linefilter", { on ? 1 : 0, searchMatchCase ? 1 : 0, searchWholeWord ? 1 : 0, searchRegex ? 1 : 0 }, { searchQuery });
+    LineFilter f;
+    if (on) {
+        f.query = searchQuery; f.matchCase = searchMatchCase; f.wholeWord = searchWholeWord; f.isRegex = searchRegex;
+        if (searchQuery.empty() || !f.build(pt, lineStarts)) return false;
+        f.active = true;
+    }
+    lineFilter = std::move(f);
+    lineStartsChanged();
+    ensureCaretVisible();
+    invalidate();
+    return true;
+}
+size_t Document::snapToView(size_t pos, bool forward) {
+    int line = getLineIdx(pos);
+    if (!lineFilter.active || lineFilter.lines.empty() || lineFilter.contains((size_t)line)) return pos;
+    size_t r = lineFilter.rowOf((size_t)line), n = lineFilter.lines.size();
+    if (forward ? r == n : r > 0) {
+        size_t target = lineFilter.lines[r - 1];
+        size_t end = (target + 1 < lineStarts.size()) ? lineStarts[target + 1] : pt.length();
+        if (end > lineStarts[target] && pt.charAt(end - 1) == '\n') end--;
+        if (end > lineStarts[target] && pt.charAt(end - 1) == '\r') end--;
+        return end;
+    }
+    return lineStarts[lineFilter.lines[r]];
+}
+size_t VisibleOffsetOf(const std::vector<VisibleSpan>& spans, size_t pos, bool* shown) {
+    if (shown) *shown = false;
+    if (spans.empty()) return 0;
+    for (const auto& s : spans) {
+        if (pos < s.docPos) return s.textOffset;
+        if (pos < s.docPos + s.len || (s.includesEnd && pos == s.docPos + s.len)) { if (shown) *shown = true; return s.textOffset + (pos - s.docPos); }
+    }
+    return spans.back().textOffset + spans.back().len;
+}
+size_t DocPosOfVisible(const std::vector<VisibleSpan>& spans, size_t offset) {
+    if (spans.empty()) return 0;
+    for (const auto& s : spans) if (offset < s.textOffset + s.len) return s.docPos + (offset >= s.textOffset ? offset - s.textOffset : 0);
+    return spans.back().docPos + spans.back().len;
+}
+std::string Document::visibleText(size_t firstRow, int numRows, std::vector<VisibleSpan>* spans) const {
+    if (spans) spans->clear();
+    if (lineStarts.empty()) return "";
+    size_t docLen = pt.length();
+    if (!lineFilter.active) {
+        size_t startOffset = (firstRow < lineStarts.size()) ? lineStarts[firstRow] : lineStarts.back();
+        size_t endOffset = docLen; size_t endLineIdx = firstRow + numRows; if (endLineIdx < lineStarts.size()) endOffset = lineStarts[endLineIdx];
+        size_t len = (endOffset > startOffset) ? (endOffset - startOffset) : 0;
+        if (spans) spans->push_back({ 0, startOffset, len, true });
+        return pt.getRange(startOffset, len);
+    }
+    // 見えている行を 1 行ずつつなぐ。文書上で続いている行は 1 つの断片にまとめる
+    std::string text;
+    size_t lastRow = std::min(lineFilter.lines.size(), firstRow + (size_t)std::max(numRows, 0));
+    for (size_t r = firstRow; r < lastRow; ++r) {
+        size_t line = lineFilter.lines[r];
+        size_t b = lineStarts[line], e = (line + 1 < lineStarts.size()) ? lineStarts[line + 1] : docLen;
+        if (spans) {
+            if (!spans->empty() && spans->back().docPos + spans->back().len == b) spans->back().len += e - b;
+            else spans->push_back({ text.size(), b, e - b, false });
+            spans->back().includesEnd = (e == docLen);
+        }
+        pt.forEachChunk(b, e - b, [&](std::string_view chunk) { text.append(chunk.data(), chunk.size()); return true; });
+    }
+    return text;
+}
+MemoryStats Document::memoryUsage() const {
+    MemoryStats m;
+    m.mappedOriginal = fileMap ? fileMap->size : pt.origSize;
+    m.convertedBuffer = convertedBuffer.capacity();
+    m.addBuffer = pt.addBuf.heapBytes; m.addSpilled = pt.addBuf.spilledBytes;
+    m.pieceList = pt.pieces.capacity() * sizeof(Piece);
+    m.lineStarts = lineStarts.capacity() * sizeof(size_t);
+    m.lineFilter = lineFilter.lines.capacity() * sizeof(size_t);
+    m.bracketIndex = bracketIndex.memoryBytes();
+    m.syntaxStates = syntax.memoryBytes();
+    m.undoText = undo.undoTextBytes; m.undoCursors = undo.undoCursorBytes;
+    m.redoText = undo.redoTextBytes; m.redoCursors = undo.redoCursorBytes;
+    m.pendingPadding = EditTextBytes(pendingPadding) + EditCursorBytes(pendingPadding);
+    return m;
+}
+float Document::getXFromPos(size_t pos) {
+    int lineIdx = getLineIdx(pos); size_t start = lineStarts[lineIdx];
+    size_t col = 0;
+    if (pos > start) pt.forEachChunk(start, pos - start, [&](std::string_view chunk) {
+        for (unsigned char c : chunk) {
+            if (c == '\t') col = (col / kTabColumns + 1) * kTabColumns;
+            else if ((c & 0xC0) != 0x80) col++;
+        }
+        return true;
+    });
+    return (float)col;
+}
+size_t Document::getPosFromLineAndX(int lineIdx, float targetX) {
+    if (lineIdx < 0 || lineIdx >= (int)lineStarts.size()) return cursors.empty() ? 0 : cursors.back().head;
+    size_t start = lineStarts[lineIdx];
+    size_t end = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : pt.length();
+    if (end > start) { PieceIterator it(pt, end - 1); while (end > start && (*it == '\n' || *it == '\r')) { end--; if (end > start) --it; } }
+    size_t col = 0;
+    PieceIterator it(pt, start);
+    while (it.position() < end) {
+        unsigned char c = (unsigned char)*it;
+        size_t next = (c == '\t') ? (col / kTabColumns + 1) * kTabColumns : col + 1;
+        if ((float)(col + next) / 2.0f >= targetX) break;
+        col = next; ++it;
+        while (it.position() < end && ((unsigned char)*it & 0xC0) == 0x80) ++it;
+    }
+    return it.position();
+}
+size_t Document::moveCaretVisual(size_t pos, bool forward) {
+    return forward ? NextGraphemeBoundary(pt, pos) : PrevGraphemeBoundary(pt, pos);
+}
+void Document::mergeCursors() {
+    if (cursors.empty()) return;
+    std::sort(cursors.begin(), cursors.end(), [](const Cursor& a, const Cursor& b) { return a.head < b.head; });
+    std::vector<Cursor> merged; merged.push_back(cursors[0]);
+    for (size_t i = 1; i < cursors.size(); ++i) {
+        Cursor& prev = merged.back(); Cursor& curr = cursors[i];
+        if (curr.start() <= prev.end()) { size_t newStart = std::min(prev.start(), curr.start()); size_t newEnd = std::max(prev.end(), curr.end()); bool prevForward = prev.head >= prev.anchor; prev.anchor = prevForward ? newStart : newEnd; prev.head = prevForward ? newEnd : newStart; }
+        else { merged.push_back(curr); }
+    }
+    cursors = merged;
+}
+void Document::selectWordAt(size_t pos) {
+    if (pos >= pt.length()) { cursors.clear(); cursors.push_back({ pos, pos, getXFromPos(pos) }); return; }
+    size_t start, end; WordRangeAt(pt, pos, start, end);
+    cursors.clear(); cursors.push_back({ end, start, getXFromPos(end) });
+}
+void Document::selectLineAt(size_t pos) {
+    int lineIdx = getLineIdx(pos); size_t start = lineStarts[lineIdx]; size_t end = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : pt.length();
+    cursors.clear(); cursors.push_back({ end, start, getXFromPos(end) });
+}
+size_t Document::moveWordLeft(size_t pos) { return PrevWordStop(pt, pos); }
+size_t Document::moveWordRight(size_t pos) { return NextWordStop(pt, pos); }
+void Document::rollbackPadding() {
+    if (pendingPadding.ops.empty()) return;
+    for (int i = (int)pendingPadding.ops.size() - 1; i >= 0; --i) {
+        const auto& op = pendingPadding.ops[i];
+        if (op.type == EditOp::Insert) {
+            pt.erase(op.pos, op.text.size());
+            size_t len = op.text.size();
+            for (auto& c : cursors) {
+                if (c.head > op.pos) {
+                    if (c.head < op.pos + len) c.head = op.pos;
+                    else c.head -= len;
+                }
+                if (c.anchor > op.pos) {
+                    if (c.anchor < op.pos + len) c.anchor = op.pos;
+                    else c.anchor -= len;
+                }
+            }
+        }
+    }
+    pendingPadding.ops.clear();
+    pendingPadding.beforeCursors.clear();
+    pendingPadding.afterCursors.clear();
+    rebuildLineStarts();
+}
+void Document::commitPadding() {
+    if (pendingPadding.ops.empty()) return;
+    undo.push(pendingPadding);
+    pendingPadding.ops.clear();
+    pendingPadding.beforeCursors.clear();
+    pendingPadding.afterCursors.clear();
+}
+void Document::insertAtCursors(const std::string& text) {
+    SessionRecorder::Scope rs(recorder, cursors, "insert", {}, { text });
+    commitPadding();
+    if (cursors.empty()) return;
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    std::vector<int> indices(cursors.size());
+    for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
+    std::sort(indices.begin(), indices.end(), [&](int a, int b) {return cursors[a].start() > cursors[b].start(); });
+    for (int idx : indices) {
+        Cursor& c = cursors[idx];
+        if (isOverwriteMode && !c.hasSelection()) {
+            char ch = (c.head < pt.length()) ? pt.charAt(c.head) : 0;
+            if (ch != 0 && ch != '\n' && ch != '\r') {
+                size_t nextPos = moveCaretVisual(c.head, true);
+                size_t charLen = nextPos - c.head;
+                if (charLen > 0) {
+                    std::string d = pt.getRange(c.head, charLen);
+                    pt.erase(c.head, charLen);
+                    batch.ops.push_back({ EditOp::Erase, c.head, d });
+                    for (auto& o : cursors) {
+                        if (o.head > c.head) o.head -= charLen;
+                        if (o.anchor > c.head) o.anchor -= charLen;
+                    }
+                }
+            }
+        }
+        if (c.hasSelection()) {
+            size_t s = c.start(); size_t l = c.end() - s;
+            std::string d = pt.getRange(s, l);
+            pt.erase(s, l);
+            batch.ops.push_back({ EditOp::Erase,s,d });
+            for (auto& o : cursors) { if (o.head > s)o.head -= l; if (o.anchor > s)o.anchor -= l; }
+            c.head = s; c.anchor = s;
+        }
+    }
+    for (int idx : indices) {
+        Cursor& c = cursors[idx];
+        size_t p = c.head;
+        pt.insert(p, text);
+        batch.ops.push_back({ EditOp::Insert,p,text });
+        size_t l = text.size();
+        for (auto& o : cursors) { if (o.head >= p)o.head += l; if (o.anchor >= p)o.anchor += l; }
+    }
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+}
+void Document::deleteForwardAtCursors() {
+    SessionRecorder::Scope rs(recorder, cursors, "delete");
+    commitPadding();
+    if (cursors.empty()) return;
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    std::vector<int> indices(cursors.size());
+    for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
+    std::sort(indices.begin(), indices.end(), [&](int a, int b) {return cursors[a].start() > cursors[b].start(); });
+    for (int idx : indices) {
+        Cursor& c = cursors[idx];
+        size_t s = c.start();
+        size_t l = 0;
+        if (c.hasSelection()) {
+            l = c.end() - s;
+        }
+        else {
+            if (s + 1 < pt.length() && pt.charAt(s) == '\r' && pt.charAt(s + 1) == '\n') {
+                l = 2;
+            }
+            else {
+                size_t n = moveCaretVisual(s, true);
+                if (n > s) l = n - s;
+            }
+        }
+        if (l > 0 && s + l <= pt.length()) {
+            std::string d = pt.getRange(s, l);
+            pt.erase(s, l);
+            batch.ops.push_back({ EditOp::Erase,s,d });
+            for (auto& o : cursors) {
+                if (o.head > s) o.head -= l;
+                if (o.anchor > s) o.anchor -= l;
+            }
+            c.head = s; c.anchor = s;
+        }
+    }
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+}
+void Document::backspaceAtCursors(bool allowCharDeletion) {
+    SessionRecorder::Scope rs(recorder, cursors, "backspace", { allowCharDeletion ? 1 : 0 });
+    commitPadding();
+    if (cursors.empty()) return;
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    std::vector<int> indices(cursors.size());
+    for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
+    std::sort(indices.begin(), indices.end(), [&](int a, int b) {return cursors[a].start() > cursors[b].start(); });
+    for (int idx : indices) {
+        Cursor& c = cursors[idx];
+        size_t s = c.start();
+        size_t l = 0;
+        if (c.hasSelection()) {
+            l = c.end() - s;
+        }
+        else if (allowCharDeletion && s > 0) {
+            if (s >= 2 && pt.charAt(s - 1) == '\n' && pt.charAt(s - 2) == '\r') {
+                l = 2;
+                s -= 2;
+            }
+            else {
+                size_t p = moveCaretVisual(s, false);
+                if (p < s) { l = s - p; s = p; }
+            }
+        }
+        if (l > 0) {
+            std::string d = pt.getRange(s, l);
+            pt.erase(s, l);
+            batch.ops.push_back({ EditOp::Erase,s,d });
+            for (auto& o : cursors) {
+                if (o.head > s) o.head -= l;
+                if (o.anchor > s) o.anchor -= l;
+            }
+            c.head = s;
+            c.anchor = s;
+        }
+    }
+    if (!batch.ops.empty()) {
+        batch.afterCursors = cursors;
+        undo.push(batch);
+        rebuildLineStarts();
+        ensureCaretVisible();
+        updateDirtyFlag();
+    }
+}
+void Document::insertNewlineWithAutoIndent() {
+    SessionRecorder::Scope rs(recorder, cursors, "newline");
+    commitPadding();
+    if (cursors.empty()) return;
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    std::vector<int> indices(cursors.size());
+    for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
+    std::sort(indices.begin(), indices.end(), [&](int a, int b) {
+        return cursors[a].start() > cursors[b].start();
+        });
+    for (int idx : indices) {
+        Cursor& c = cursors[idx];
+        size_t start = c.start();
+        if (c.hasSelection()) {
+            size_t len = c.end() - start;
+            std::string deleted = pt.getRange(start, len);
+            pt.erase(start, len);
+            batch.ops.push_back({ EditOp::Erase, start, deleted });
+            for (auto& o : cursors) {
+                if (o.head > start) o.head -= len;
+                if (o.anchor > start) o.anchor -= len;
+            }
+            c.head = start; c.anchor = start;
+        }
+        int lineIdx = getLineIdx(start);
+        size_t lineStart = lineStarts[lineIdx];
+        std::string indentStr = "";
+        size_t maxLen = pt.length();
+        for (PieceIterator it(pt, lineStart); it.position() < maxLen && it.position() < start; ++it) {
+            char ch = *it;
+            if (ch == ' ' || ch == '\t') {
+                indentStr += ch;
+            }
+            else {
+                break;
+            }
+        }
+        std::string textToInsert = newlineStr + indentStr;
+        pt.insert(start, textToInsert);
+        batch.ops.push_back({ EditOp::Insert, start, textToInsert });
+        size_t insLen = textToInsert.size();
+        for (auto& o : cursors) {
+            if (o.head >= start) o.head += insLen;
+            if (o.anchor >= start) o.anchor += insLen;
+            if (&o == &c) {
+                o.desiredX = getXFromPos(o.head);
+            }
+        }
+    }
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+}
+void Document::selectNextOccurrence() {
+    SessionRecorder::Scope rs(recorder, cursors, "selectnext");
+    if (cursors.empty()) return;
+    Cursor c = cursors.back();
+    if (!c.hasSelection()) {
+        size_t targetPos = c.head;
+        if (targetPos > 0) {
+            if (!IsWordClass(WordClassAt(pt, targetPos)) && IsWordClass(WordClassBefore(pt, targetPos))) {
+                targetPos = PrevGraphemeBoundary(pt, targetPos);
+            }
+        }
+        selectWordAt(targetPos);
+        invalidate();
+        return;
+    }
+    size_t start = c.start();
+    size_t len = c.end() - start;
+    std::string query = pt.getRange(start, len);
+    size_t nextPos = FindText(pt, std::max(c.head, c.anchor), query, true, true, false, false);
+    if (nextPos != std::string::npos) {
+        for (const auto& cur : cursors) {
+            if (cur.start() == nextPos) return;
+        }
+        cursors.push_back({ nextPos + len, nextPos, getXFromPos(nextPos + len) });
+        ensureCaretVisible();
+        invalidate();
+    }
+}
+void Document::moveCursors(CaretMove move, bool shift, bool ctrl, int pageLines) {
+    SessionRecorder::Scope rs(recorder, cursors, "move", { (long long)move, shift ? 1 : 0, ctrl ? 1 : 0, pageLines }, {}, true);
+    rollbackPadding();
+    for (auto& c : cursors) {
+        if (move == MOVE_LEFT) { if (c.hasSelection() && !shift) { c.head = c.start(); c.anchor = c.head; } else { if (ctrl) c.head = moveWordLeft(c.head); else c.head = moveCaretVisual(c.head, false); if (!shift) c.anchor = c.head; } }
+        else if (move == MOVE_RIGHT) { if (c.hasSelection() && !shift) { c.head = c.end(); c.anchor = c.head; } else { if (ctrl) c.head = moveWordRight(c.head); else c.head = moveCaretVisual(c.head, true); if (!shift) c.anchor = c.head; } }
+        else if (move == MOVE_UP) { int r = viewRowOf(getLineIdx(c.head)); if (r > 0) c.head = getPosFromLineAndX(viewLineAt(r - 1), c.desiredX); if (!shift) c.anchor = c.head; }
+        else if (move == MOVE_DOWN) { int r = viewRowOf(getLineIdx(c.head) + 1); if (r < viewLineCount()) c.head = getPosFromLineAndX(viewLineAt(r), c.desiredX); if (!shift) c.anchor = c.head; }
+        else if (move == MOVE_HOME) { if (ctrl) c.head = 0; else { size_t p = c.head; PieceIterator it(pt, p); while (p > 0 && *--it != '\n') p--; c.head = p; } if (!shift) c.anchor = c.head; }
+        else if (move == MOVE_END) {
+            if (ctrl) c.head = pt.length();
+            else {
+                size_t len = pt.length();
+                PieceIterator it(pt, c.head);
+                while (it.position() < len && *it != '\n') ++it;
+                size_t p = it.position();
+                if (p > 0 && p < len) {
+                    if (*--it == '\r') {
+                        p--;
+                    }
+                }
+                c.head = p;
+            }
+            if (!shift) c.anchor = c.head;
+            c.desiredX = getXFromPos(c.head);
+        }
+        else if (move == MOVE_PAGEUP) { int r = viewRowOf(getLineIdx(c.head)); if (viewLineCount() > 0) c.head = getPosFromLineAndX(viewLineAt(std::max(0, std::min(r, viewLineCount()) - pageLines)), c.desiredX); if (!shift) c.anchor = c.head; }
+        else if (move == MOVE_PAGEDOWN) { int r = viewRowOf(getLineIdx(c.head) + 1); if (viewLineCount() > 0) c.head = getPosFromLineAndX(viewLineAt(std::min(viewLineCount() - 1, r + pageLines - 1)), c.desiredX); if (!shift) c.anchor = c.head; }
+        if (lineFilter.active) {
+            size_t h = snapToView(c.head, move == MOVE_RIGHT || move == MOVE_DOWN || move == MOVE_END || move == MOVE_PAGEDOWN);
+            if (h != c.head) { c.head = h; if (!shift) c.anchor = h; }
+        }
+        if (move == MOVE_LEFT || move == MOVE_RIGHT || move == MOVE_HOME || move == MOVE_END) c.desiredX = getXFromPos(c.head);
+    }
+    mergeCursors(); ensureCaretVisible(); invalidate();
+}
+bool Document::findNextMatch(bool forward) {
+    SessionRecorder::Scope rs(recorder, cursors, "find", { forward ? 1 : 0, searchMatchCase ? 1 : 0, searchWholeWord ? 1 : 0, searchRegex ? 1 : 0 }, { searchQuery });
+    size_t startPos = forward ? (cursors.empty() ? 0 : cursors.back().end()) : (cursors.empty() ? 0 : cursors.back().start());
+    size_t matchLen = 0;
+    size_t pos = FindText(pt, startPos, searchQuery, forward, searchMatchCase, searchWholeWord, searchRegex, &matchLen);
+    if (pos == std::string::npos) return false;
+    cursors.clear();
+    cursors.push_back({ pos + matchLen, pos, getXFromPos(pos + matchLen) });
+    ensureCaretVisible();
+    return true;
+}
+size_t Document::replaceAllMatches() {
+    TRACE_SCOPE("replaceAll");
+    SessionRecorder::Scope rs(recorder, cursors, "replaceall", { searchMatchCase ? 1 : 0, searchWholeWord ? 1 : 0, searchRegex ? 1 : 0 }, { searchQuery, replaceQuery });
+    if (searchQuery.empty()) return std::string::npos;
+    std::vector<ReplaceMatch> matches;
+    if (!CollectReplaceMatches(pt, searchQuery, replaceQuery, newlineStr, searchMatchCase, searchWholeWord, searchRegex, matches)) return std::string::npos;
+    if (matches.empty()) return 0;
+    commitPadding();
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    ApplyReplaceMatches(pt, matches, batch.ops);
+    size_t finalMatchIdx = matches.size() - 1;
+    long long offsetBeforeFinal = 0;
+    for (size_t i = 0; i < finalMatchIdx; ++i) {
+        offsetBeforeFinal += (long long)matches[i].replacementText.size() - (long long)matches[i].len;
+    }
+    size_t lastReplaceStart = (size_t)((long long)matches.back().start + offsetBeforeFinal);
+    size_t lastReplaceEnd = lastReplaceStart + matches.back().replacementText.size();
+    cursors.clear();
+    cursors.push_back({ lastReplaceEnd, lastReplaceStart, getXFromPos(lastReplaceEnd) });
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+    return matches.size();
+}
+void Document::performUndo() { TRACE_SCOPE("performUndo"); SessionRecorder::Scope rs(recorder, cursors, "undo"); if (!undo.canUndo())return; EditBatch b = undo.popUndo(); RevertBatch(pt, b); cursors = b.beforeCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); }
+void Document::performRedo() { TRACE_SCOPE("performRedo"); SessionRecorder::Scope rs(recorder, cursors, "redo"); if (!undo.canRedo())return; EditBatch b = undo.popRedo(); ReapplyBatch(pt, b); cursors = b.afterCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); }
+bool Document::compactPieces(uint64_t budgetNs) {
+    TRACE_SCOPE("compactPieces");
+    uint64_t t0 = TraceNowNs();
+    std::vector<const std::vector<Piece>*> retained;
+    for (const auto* stack : { &undo.undoStack, &undo.redoStack })
+        for (const auto& b : *stack) if (b.pieces) { retained.push_back(&b.pieces->before); retained.push_back(&b.pieces->after); }
+    while (pt.compactStep(4096, retained)) if (TraceNowNs() - t0 >= budgetNs) return true;
+    return false;
+}
+bool Document::bracketPairAt(size_t pos, size_t& open, size_t& close) const {
+    if (bracketIndex.matchAt(pt, pos, open, close)) return true;
+    size_t lineStart = lineStarts[FindLineIndex(lineStarts, pos)];
+    if (pos - lineStart <= 2 * BracketIndex::kNearBytes && BracketIndex::quoteAt(pt, lineStart, pos, BracketIndex::kNearBytes, open, close) == BracketIndex::NEAR_FOUND) return true;
+    return bracketIndex.enclosing(pt, pos, open, close);
+}
+void Document::jumpToMatchingBracket() {
+    TRACE_SCOPE("jumpToMatchingBracket");
+    SessionRecorder::Scope rs(recorder, cursors, "bracket");
+    rollbackPadding();
+    // 索引ができていなければ、まず行頭からカーソルの前後 kNearBytes だけを直接読む。それで決まらなければ索引をその場で作り終える
+    auto resolve = [&](BracketIndex::NearResult r, const std::function<bool()>& indexed) {
+        if (r != BracketIndex::NEAR_UNKNOWN) return r == BracketIndex::NEAR_FOUND;
+        while (bracketIndex.buildStep(pt, UINT64_MAX)) {}
+        return indexed();
+    };
+    const size_t near = BracketIndex::kNearBytes;
+    for (auto& c : cursors) {
+        size_t p = c.head, open, close, target;
+        size_t lineStart = lineStarts[getLineIdx(p)], from = lineStarts[getLineIdx(p > near ? p - near : 0)];
+        bool local = !bracketIndex.complete && p - from <= 2 * near;
+        auto other = [&] { return (open == p) ? close : (close == p) ? open : (open + 1 == p) ? close + 1 : open + 1; };
+        if (resolve(local ? BracketIndex::matchNear(pt, from, p, near, open, close) : BracketIndex::NEAR_UNKNOWN, [&] { return bracketIndex.matchAt(pt, p, open, close); })) target = other();
+        else if (p - lineStart <= 2 * near && BracketIndex::quoteAt(pt, lineStart, p, near, open, close) == BracketIndex::NEAR_FOUND) target = other();
+        else if (resolve(local ? BracketIndex::enclosingNear(pt, from, p, near, open, close) : BracketIndex::NEAR_UNKNOWN, [&] { return bracketIndex.enclosing(pt, p, open, close); })) target = open;
+        else continue;
+        c.head = c.anchor = target; c.desiredX = getXFromPos(target);
+    }
+    mergeCursors();
+    ensureCaretVisible();
+    invalidate();
+}
+bool Document::highlightVisible(const std::string& text, const std::vector<VisibleSpan>& spans, std::vector<SyntaxToken>& tokens) {
+    TRACE_SCOPE("highlightVisible");
+    tokens.clear();
+    if (syntax.language == SYNTAX_PLAIN || spans.empty() || lineStarts.empty()) return true;
+    // 最後に見えている行まで行頭の状態を求める。読む量が多ければアイドル時に回し、それまでは分かっている所から読み進めた状態で塗る
+    const VisibleSpan& tail = spans.back();
+    size_t lastLine = (size_t)getLineIdx(tail.docPos + (tail.len ? tail.len - 1 : 0));
+    bool exact = true;
+    if (SyntaxHasLineState(syntax.language) && syntax.validLines <= lastLine) {
+        size_t known = syntax.validLines ? lineStarts[syntax.validLines - 1] : 0;
+        syntax.wantedLine = lastLine;
+        exact = lineStarts[lastLine] - known <= SyntaxCache::kSyncBytes && syntax.advance(pt, lineStarts, lastLine, UINT64_MAX);
+    }
+    size_t docLen = pt.length();
+    for (const VisibleSpan& span : spans) {
+        size_t line = (size_t)getLineIdx(span.docPos), pos = span.docPos, end = span.docPos + span.len;
+        uint8_t state = syntax.stateAt(line);
+        while (pos < end) {
+            size_t lineEnd = std::min(end, line + 1 < lineStarts.size() ? lineStarts[line + 1] : docLen), offset = span.textOffset + (pos - span.docPos);
+            size_t before = tokens.size();
+            state = LexLine(syntax.language, std::string_view(text).substr(offset, lineEnd - pos), state, &tokens);
+            for (size_t i = before; i < tokens.size(); ++i) tokens[i].offset += offset;
+            pos = lineEnd; line++;
+            if (line < syntax.validLines) state = syntax.lineStates[line];
+        }
+    }
+    return exact;
+}
+void Document::recordOpen(const std::string& path) {
+    if (!recorder.isOpen()) return;
+    recorder.write("open", { (long long)pt.length(), newlineStr == "\n" ? 1 : newlineStr == "\r" ? 2 : 0 }, { path });
+    recorder.lastCursors = cursors;
+}
+std::vector<int> Document::getSelectedLineIndices() {
+    std::vector<int> lines;
+    for (const auto& c : cursors) {
+        int startLine = getLineIdx(c.start());
+        int endLine = getLineIdx(c.end());
+        if (c.hasSelection() && c.end() > c.start()) {
+            if (c.end() > 0 && pt.charAt(c.end() - 1) == '\n') {
+                if (endLine > startLine) endLine--;
+            }
+        }
+        for (int i = startLine; i <= endLine; ++i) lines.push_back(i);
+    }
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+    return lines;
+}
+void Document::duplicateLines(bool up) {
+    SessionRecorder::Scope rs(recorder, cursors, "duplicate", { up ? 1 : 0 });
+    commitPadding();
+    if (cursors.empty()) return;
+    std::vector<int> lines = getSelectedLineIndices();
+    if (lines.empty()) return;
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    std::string blockText;
+    size_t blockStart = lineStarts[lines.front()];
+    size_t blockEnd = (lines.back() + 1 < (int)lineStarts.size()) ? lineStarts[lines.back() + 1] : pt.length();
+    blockText = pt.getRange(blockStart, blockEnd - blockStart);
+    bool needNewline = false;
+    if (blockText.empty() || blockText.back() != '\n') {
+        blockText += newlineStr;
+        needNewline = true;
+    }
+    size_t insertPos;
+    if (up) {
+        insertPos = blockStart;
+    }
+    else {
+        insertPos = blockEnd;
+        if (needNewline && blockEnd == pt.length() && blockEnd > 0 && pt.charAt(blockEnd - 1) != '\n') {
+            pt.insert(blockEnd, newlineStr);
+            batch.ops.push_back({ EditOp::Insert, blockEnd, newlineStr });
+            insertPos += newlineStr.length();
+        }
+    }
+    pt.insert(insertPos, blockText);
+    batch.ops.push_back({ EditOp::Insert, insertPos, blockText });
+    batch.afterCursors.clear();
+    size_t newSelectionStart = insertPos;
+    size_t newSelectionEnd = insertPos + blockText.size();
+    batch.afterCursors.push_back({ newSelectionEnd, newSelectionStart, getXFromPos(newSelectionEnd) });
+    cursors = batch.afterCursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+}
+void Document::moveLines(bool up) {
+    SessionRecorder::Scope rs(recorder, cursors, "movelines", { up ? 1 : 0 });
+    commitPadding();
+    if (cursors.empty()) return;
+    std::vector<int> lines = getSelectedLineIndices();
+    if (lines.empty()) return;
+    if (up && lines.front() == 0) return;
+    if (!up && lines.back() >= (int)lineStarts.size() - 1) return;
+    int startLine = lines.front();
+    int endLine = lines.back();
+    size_t rangeStart = lineStarts[startLine];
+    size_t rangeEnd = (endLine + 1 < (int)lineStarts.size()) ? lineStarts[endLine + 1] : pt.length();
+    std::string textToMove = pt.getRange(rangeStart, rangeEnd - rangeStart);
+    bool isLastLineNoNewline = (rangeEnd == pt.length()) && (textToMove.empty() || textToMove.back() != '\n');
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    if (up) {
+        int targetLineIdx = startLine - 1;
+        size_t targetStart = lineStarts[targetLineIdx];
+        size_t targetEnd = rangeStart;
+        std::string lineAbove = pt.getRange(targetStart, targetEnd - targetStart);
+        long long diff = -(long long)(rangeStart - targetStart);
+        if (isLastLineNoNewline) {
+            textToMove += newlineStr;
+            if (!lineAbove.empty() && lineAbove.back() == '\n') {
+                if (lineAbove.size() >= 2 && lineAbove[lineAbove.size() - 2] == '\r') lineAbove.pop_back(), lineAbove.pop_back();
+                else lineAbove.pop_back();
+            }
+        }
+        size_t deleteLen = rangeEnd - targetStart;
+        std::string deletedAll = pt.getRange(targetStart, deleteLen);
+        pt.erase(targetStart, deleteLen);
+        batch.ops.push_back({ EditOp::Erase, targetStart, deletedAll });
+        std::string newText = textToMove + lineAbove;
+        pt.insert(targetStart, newText);
+        batch.ops.push_back({ EditOp::Insert, targetStart, newText });
+        for (auto& c : cursors) {
+            c.head = (size_t)((long long)c.head + diff);
+            c.anchor = (size_t)((long long)c.anchor + diff);
+            c.desiredX = getXFromPos(c.head);
+        }
+    }
+    else {
+        int targetLineIdx = endLine + 1;
+        size_t targetStart = rangeEnd;
+        size_t targetEnd = (targetLineIdx + 1 < (int)lineStarts.size()) ? lineStarts[targetLineIdx + 1] : pt.length();
+        std::string lineBelow = pt.getRange(targetStart, targetEnd - targetStart);
+        if (targetEnd == pt.length() && (lineBelow.empty() || lineBelow.back() != '\n')) {
+            lineBelow += newlineStr;
+            if (!textToMove.empty() && textToMove.back() == '\n') {
+                if (textToMove.size() >= 2 && textToMove[textToMove.size() - 2] == '\r') textToMove.pop_back(), textToMove.pop_back();
+                else textToMove.pop_back();
+            }
+        }
+        size_t deleteLen = targetEnd - rangeStart;
+        std::string deletedAll = pt.getRange(rangeStart, deleteLen);
+        pt.erase(rangeStart, deleteLen);
+        batch.ops.push_back({ EditOp::Erase, rangeStart, deletedAll });
+        std::string newText = lineBelow + textToMove;
+        pt.insert(rangeStart, newText);
+        batch.ops.push_back({ EditOp::Insert, rangeStart, newText });
+        long long diff = (long long)lineBelow.size();
+        for (auto& c : cursors) {
+            c.head = (size_t)((long long)c.head + diff);
+            c.anchor = (size_t)((long long)c.anchor + diff);
+            c.desiredX = getXFromPos(c.head);
+        }
+    }
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+}
+void Document::deleteLines() {
+    SessionRecorder::Scope rs(recorder, cursors, "deletelines");
+    rollbackPadding();
+    std::vector<Cursor> originalCursors = cursors;
+    std::vector<Cursor> delRanges;
+    bool hasSelection = false;
+    for (const auto& c : cursors) if (c.hasSelection()) hasSelection = true;
+    if (hasSelection) {
+        for (const auto& c : cursors) {
+            int sLine = getLineIdx(c.start());
+            int eLine = getLineIdx(c.end());
+            if (c.hasSelection() && c.end() > 0 && pt.charAt(c.end() - 1) == '\n' && eLine > sLine) {
+                eLine--;
+            }
+            size_t start = lineStarts[sLine];
+            size_t end = (eLine + 1 < (int)lineStarts.size()) ? lineStarts[eLine + 1] : pt.length();
+            if (end == pt.length() && start > 0) {
+                char prev = pt.charAt(start - 1);
+                if (prev == '\n') {
+                    start--;
+                    if (start > 0 && pt.charAt(start - 1) == '\r') start--;
+                }
+                else if (prev == '\r') start--;
+            }
+            delRanges.push_back({ end, start, 0.0f });
+        }
+    }
+    else {
+        for (const auto& c : cursors) {
+            int lineIdx = getLineIdx(c.head);
+            size_t start = lineStarts[lineIdx];
+            size_t end = (lineIdx + 1 < (int)lineStarts.size()) ? lineStarts[lineIdx + 1] : pt.length();
+            if (end == pt.length() && start > 0) {
+                char prev = pt.charAt(start - 1);
+                if (prev == '\n') {
+                    start--;
+                    if (start > 0 && pt.charAt(start - 1) == '\r') start--;
+                }
+                else if (prev == '\r') start--;
+            }
+            delRanges.push_back({ end, start, 0.0f });
+        }
+    }
+    cursors = delRanges;
+    mergeCursors();
+    insertAtCursors("");
+    if (!undo.undoStack.empty()) {
+        undo.setLastBeforeCursors(originalCursors);
+    }
+}
+void Document::indentLines(bool forceLineIndent) {
+    SessionRecorder::Scope rs(recorder, cursors, "indent", { forceLineIndent ? 1 : 0 });
+    bool hasSelection = false;
+    for (const auto& c : cursors) if (c.hasSelection()) hasSelection = true;
+    if (!hasSelection && !forceLineIndent) {
+        insertAtCursors("\t");
+        return;
+    }
+    commitPadding();
+    transformSelectedLines(EditOp::Indent);
+}
+void Document::unindentLines() {
+    SessionRecorder::Scope rs(recorder, cursors, "unindent");
+    commitPadding();
+    transformSelectedLines(EditOp::Unindent);
+}
+// 選択行を連続したブロックごとにまとめ、ブロックを 1 回の erase/insert で置き換える (1 ブロック 1 op、新しいピースも 1 つ)
+// カーソルは変更位置の一覧から一度に動かし、桁位置も最後に 1 回だけ計算する
+void Document::transformSelectedLines(EditOp::Type type) {
+    TRACE_SCOPE(type == EditOp::Indent ? "indentLines" : "unindentLines");
+    std::vector<int> lines = getSelectedLineIndices();
+    if (lines.empty()) return;
+    struct Block { size_t start, end; };
+    std::vector<Block> blocks;
+    for (size_t i = 0; i < lines.size();) {
+        size_t j = i; while (j + 1 < lines.size() && lines[j + 1] == lines[j] + 1) j++;
+        size_t start = lineStarts[lines[i]];
+        bool hasNext = lines[j] + 1 < (int)lineStarts.size();
+        size_t end = hasNext ? lineStarts[lines[j] + 1] : pt.length();
+        if (hasNext && end > start) { PieceIterator it(pt, end - 1); if (*it == '\n') { end--; if (end > start && *--it == '\r') end--; } else if (*it == '\r') end--; }
+        blocks.push_back({ start, end });
+        i = j + 1;
+    }
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    std::vector<size_t> changed, blockChanged;
+    // 後ろのブロックから置き換えるので、前のブロックの位置も変更位置も元の文書の座標のまま使える
+    for (size_t k = blocks.size(); k-- > 0;) {
+        const Block& b = blocks[k];
+        std::string old = pt.getRange(b.start, b.end - b.start);
+        blockChanged.clear();
+        std::string out = TransformLineBlock(type, old, &blockChanged);
+        if (blockChanged.empty()) continue;
+        pt.erase(b.start, old.size());
+        pt.insert(b.start, out);
+        for (size_t off : blockChanged) changed.push_back(b.start + off);
+        batch.ops.push_back({ type, b.start, std::move(old) });
+    }
+    if (batch.ops.empty()) return;
+    std::sort(changed.begin(), changed.end());
+    // Indent は位置 p の手前に 1 文字入るので p 以降が、Unindent は p の 1 文字が消えるので p より後ろがずれる
+    auto shift = [&](size_t q) {
+        size_t n = (type == EditOp::Indent) ? std::upper_bound(changed.begin(), changed.end(), q) - changed.begin() : std::lower_bound(changed.begin(), changed.end(), q) - changed.begin();
+        return type == EditOp::Indent ? q + n : q - n;
+    };
+    for (auto& c : cursors) { c.head = shift(c.head); c.anchor = shift(c.anchor); }
+    for (auto& c : cursors) c.desiredX = getXFromPos(c.head);
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+}
+bool Document::getLineBlockRange(size_t& start, size_t& end) {
+    bool hasSelection = false;
+    for (const auto& c : cursors) if (c.hasSelection()) hasSelection = true;
+    if (!hasSelection) { start = 0; end = pt.length(); return end > 0; }
+    std::vector<int> lines = getSelectedLineIndices();
+    if (lines.empty()) return false;
+    start = lineStarts[lines.front()];
+    end = (lines.back() + 1 < (int)lineStarts.size()) ? lineStarts[lines.back() + 1] : pt.length();
+    return end > start;
+}
+void Document::rearrangeLines(LineOperation op, uint64_t seed) {
+    TRACE_SCOPE("rearrangeLines");
+    SessionRecorder::Scope rs(recorder, cursors, "rearrange", { (long long)op, (long long)seed });
+    commitPadding();
+    size_t start, end;
+    if (!getLineBlockRange(start, end)) return;
+    // 行はピースの中を指す string_view で並べ替え、ピースをまたぐ行だけを写す
+    std::vector<std::string_view> lines;
+    LineSplitter splitter(lines);
+    pt.forEachChunk(start, end - start, [&](std::string_view v) { splitter.feed(v); return true; });
+    splitter.finish();
+    if (lines.size() < 2) return;
+    bool trailingNewline = LineContent(lines.back()).size() != lines.back().size();
+    std::vector<const char*> order(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) order[i] = lines[i].data();
+    RearrangeLines(lines, op, seed);
+    if (lines.size() == order.size() && std::equal(order.begin(), order.end(), lines.begin(), [](const char* p, std::string_view l) { return p == l.data(); })) return;
+    order = std::vector<const char*>();
+    // 結果は追加バッファの空きへ直接書く。書いたところは動かないので、並べ替えた行はそのまま読める
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    auto snapshot = std::make_shared<PieceSnapshot>();
+    snapshot->before = pt.pieces;
+    size_t newLen = JoinLines(lines, trailingNewline, nullptr);
+    uint32_t chunk = 0; size_t addStart = 0;
+    JoinLines(lines, trailingNewline, pt.addBuf.reserve(newLen, chunk, addStart));
+    lines = std::vector<std::string_view>();
+    pt.erase(start, end - start);
+    pt.insertAdded(start, chunk, addStart, newLen);
+    snapshot->after = pt.pieces;
+    batch.pieces = snapshot;
+    size_t newEnd = start + newLen;
+    cursors.assign(1, { newEnd, start, getXFromPos(newEnd) });
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+}
+void Document::convertCase(bool toUpper) {
+    TRACE_SCOPE("convertCase");
+    SessionRecorder::Scope rs(recorder, cursors, "case", { toUpper ? 1 : 0 });
+    commitPadding();
+    if (cursors.empty()) return;
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    auto snapshot = std::make_shared<PieceSnapshot>();
+    snapshot->before = pt.pieces;
+    bool isChanged = false;
+    std::vector<int> indices(cursors.size());
+    for (size_t i = 0; i < cursors.size(); ++i) indices[i] = (int)i;
+    std::sort(indices.begin(), indices.end(), [&](int a, int b) { return cursors[a].start() > cursors[b].start(); });
+    for (int idx : indices) {
+        Cursor& c = cursors[idx];
+        if (!c.hasSelection()) continue;
+        size_t start = c.start(), len = c.end() - start;
+        // 選択が 1 つのピースに収まっていればその場で読み、またがるときだけ取り出す
+        std::string copy; std::string_view text; int chunks = 0;
+        pt.forEachChunk(start, len, [&](std::string_view v) { text = v; return ++chunks < 2; });
+        if (chunks > 1) { copy = pt.getRange(start, len); text = copy; }
+        uint32_t chunk = 0; size_t addStart = 0, newLen = 0;
+        if (!MapCase(text, toUpper, [&](size_t n) { newLen = n; return pt.addBuf.reserve(n, chunk, addStart); })) continue;
+        isChanged = true;
+        pt.erase(start, len);
+        pt.insertAdded(start, chunk, addStart, newLen);
+        if (c.head > c.anchor) { c.head = start + newLen; c.anchor = start; }
+        else { c.head = start; c.anchor = start + newLen; }
+        long long diff = (long long)newLen - (long long)len;
+        if (diff == 0) continue;
+        for (size_t k = 0; k < cursors.size(); ++k) {
+            if ((int)k == idx) continue;
+            Cursor& other = cursors[k];
+            if (other.start() > start) {
+                if (other.head > start) other.head = (size_t)((long long)other.head + diff);
+                if (other.anchor > start) other.anchor = (size_t)((long long)other.anchor + diff);
+            }
+        }
+    }
+    if (!isChanged) return;
+    snapshot->after = pt.pieces;
+    batch.pieces = snapshot;
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    rebuildLineStarts();
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+}
+size_t Document::transformWhitespace(WhitespaceOperation op, bool wholeDocument) {
+    TRACE_SCOPE("transformWhitespace");
+    SessionRecorder::Scope rs(recorder, cursors, "whitespace", { (long long)op, wholeDocument ? 1 : 0 });
+    commitPadding();
+    size_t start = 0, end = pt.length();
+    if (!wholeDocument && !getLineBlockRange(start, end)) return 0;
+    // 書き換わる行の範囲だけを置き換える (保存時の行末の空白の削除で、1 行のために文書全体を書き直さない)
+    std::string out; size_t from = 0, to = 0;
+    size_t changed = TransformWhitespace(pt.getRange(start, end - start), op, kTabColumns, out, from, to);
+    if (changed == 0) return 0;
+    // 行の数は変わらないので、カーソルは行と見た目の桁で覚えておく
+    struct Place { int headLine, anchorLine; float headX, anchorX; };
+    std::vector<Place> places;
+    for (const auto& c : cursors) places.push_back({ getLineIdx(c.head), getLineIdx(c.anchor), getXFromPos(c.head), getXFromPos(c.anchor) });
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    auto snapshot = std::make_shared<PieceSnapshot>();
+    snapshot->before = pt.pieces;
+    pt.erase(start + from, to - from);
+    pt.insert(start + from, out);
+    snapshot->after = pt.pieces;
+    batch.pieces = snapshot;
+    out = std::string();
+    rebuildLineStarts();
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        cursors[i].head = getPosFromLineAndX(places[i].headLine, places[i].headX);
+        cursors[i].anchor = getPosFromLineAndX(places[i].anchorLine, places[i].anchorX);
+        cursors[i].desiredX = getXFromPos(cursors[i].head);
+    }
+    mergeCursors();
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+    return changed;
+}
+size_t Document::filterLines(bool keepMatching) {
+    TRACE_SCOPE("filterLines");
+    SessionRecorder::Scope rs(recorder, cursors, "filter", { keepMatching ? 1 : 0, searchMatchCase ? 1 : 0, searchWholeWord ? 1 : 0, searchRegex ? 1 : 0 }, { searchQuery });
+    if (searchQuery.empty()) return std::string::npos;
+    commitPadding();
+    size_t start, end;
+    if (!getLineBlockRange(start, end)) return 0;
+    size_t docLen = pt.length();
+    size_t first = (size_t)getLineIdx(start), last = first;
+    while (last < lineStarts.size() && lineStarts[last] < end) last++;
+    auto lineEnd = [&](size_t i) { return std::min(i + 1 < lineStarts.size() ? lineStarts[i + 1] : docLen, end); };
+    // 一致を含む行に印を付ける。1 行に 1 つ見つかれば十分なので、次は次の行頭から探す
+    std::vector<char> matched(last - first, 0);
+    if (!ForEachMatch(pt, start, end, searchQuery, searchMatchCase, searchWholeWord, searchRegex, [&](size_t pos, size_t) { size_t i = (size_t)getLineIdx(pos); matched[i - first] = 1; return lineEnd(i); })) return std::string::npos;
+    // 残す行をつなげた区間と、消した分だけ前にずらした行頭を同じ走査で作る
+    std::vector<std::pair<size_t, size_t>> keep;
+    std::vector<size_t> starts; starts.reserve(lineStarts.size());
+    starts.assign(lineStarts.begin(), lineStarts.begin() + first);
+    // 消した行をはさんで \r で終わる行と \n で始まる行が隣り合うと \r\n になり、行頭が 1 つ減る。位置は増える一方なので 1 本のイテレータで読む
+    PieceIterator it(pt, start);
+    auto byteAt = [&](size_t pos) { while (it.position() < pos) ++it; return *it; };
+    bool lastCR = start > 0 && pt.charAt(start - 1) == '\r', joinsCR = false;
+    size_t removed = 0, removedLines = 0;
+    for (size_t i = first; i < last; ++i) {
+        size_t b = lineStarts[i], e = lineEnd(i);
+        if ((matched[i - first] != 0) != keepMatching) { removed += e - b; removedLines++; joinsCR = lastCR; continue; }
+        if (!(joinsCR && byteAt(b) == '\n')) starts.push_back(b - removed);
+        joinsCR = false; lastCR = byteAt(e - 1) == '\r';
+        if (!keep.empty() && keep.back().second == b) keep.back().second = e; else keep.push_back({ b, e });
+    }
+    if (removedLines == 0) return 0;
+    bool rangeIsTail = (last == lineStarts.size());
+    // 最終行を消したとき、改行のない行だったなら残った最後の行 (範囲の行をすべて消したなら範囲の前) の改行も落として文書の終わり方を保つ
+    if (rangeIsTail && (keep.empty() || keep.back().second < end)) {
+        size_t e = keep.empty() ? start : keep.back().second;
+        if (e > 0 && pt.charAt(end - 1) != '\n' && pt.charAt(end - 1) != '\r') {
+            size_t nl = (e >= 2 && pt.charAt(e - 1) == '\n' && pt.charAt(e - 2) == '\r') ? 2 : 1;
+            (keep.empty() ? start : keep.back().second) -= nl; removed += nl;
+        }
+        else starts.push_back(docLen - removed);
+    }
+    size_t tailFrom = (joinsCR && last < lineStarts.size() && byteAt(lineStarts[last]) == '\n') ? last + 1 : last;
+    for (size_t i = tailFrom; i < lineStarts.size(); ++i) starts.push_back(lineStarts[i] - removed);
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    auto snapshot = std::make_shared<PieceSnapshot>();
+    snapshot->before = pt.pieces;
+    pt.keepRanges(start, end, keep);
+    snapshot->after = pt.pieces;
+    batch.pieces = snapshot;
+    size_t newLen = docLen - removed, maxBytes = 0;
+    // 落とした \n が前の行の \r とつながっていたときは \r で終わるので、その後ろの空行が要る
+    if (newLen > 0 && starts.back() < newLen && (pt.charAt(newLen - 1) == '\r' || pt.charAt(newLen - 1) == '\n')) starts.push_back(newLen);
+    for (size_t i = 0; i < starts.size(); ++i) maxBytes = std::max(maxBytes, (i + 1 < starts.size() ? starts[i + 1] : newLen) - starts[i]);
+    lineStarts.swap(starts); maxLineBytes = maxBytes;
+    newlineCounts = CountLineEnds(pt, lineStarts);
+    ChangeSpan change = pt.takeChange();
+    bracketIndex.update(pt, change);
+    if (change.any()) {
+        size_t from = (size_t)FindLineIndex(starts, change.from), oldEnd = (size_t)FindLineIndex(starts, change.oldLength - change.tail) + 1, newEnd = (size_t)getLineIdx(change.newLength - change.tail) + 1;
+        if (lineFilter.active) lineFilter.update(pt, lineStarts, from, oldEnd, newEnd);
+        syntax.update(lineStarts.size(), from, oldEnd, newEnd);
+    }
+    sampleMemory();
+    lineStartsChanged();
+    size_t newEnd = end - removed;
+    cursors.assign(1, { newEnd, start, getXFromPos(newEnd) });
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+    return removedLines;
+}
+size_t Document::convertNewlines(const std::string& nl) {
+    TRACE_SCOPE("convertNewlines");
+    SessionRecorder::Scope rs(recorder, cursors, "newlines", { nl == "\n" ? 1 : nl == "\r" ? 2 : 0 }, {});
+    commitPadding();
+    newlineStr = nl;
+    size_t converted = newlineCounts.total() - (nl == "\r\n" ? newlineCounts.crlf : nl == "\n" ? newlineCounts.lf : newlineCounts.cr);
+    if (converted == 0) return 0;
+    // 書いたブロックは追加バッファの中で動かないので、読んでいるピースのポインタはそのまま使える
+    const size_t kBlock = AddBuffer::kChunkBytes;
+    std::vector<Piece> pieces;
+    std::vector<size_t> starts; starts.reserve(lineStarts.size()); starts.push_back(0);
+    std::string block; block.reserve(kBlock);
+    size_t outLen = 0, maxBytes = 0;
+    auto flush = [&]() {
+        if (block.empty()) return;
+        Piece p = { false, 0, 0, block.size() }; pt.addBuf.append(block.data(), block.size(), p.chunk, p.start);
+        pieces.push_back(p); block.clear();
+    };
+    auto put = [&](const char* s, size_t n) {
+        while (n > 0) { size_t take = std::min(n, kBlock - block.size()); block.append(s, take); s += take; n -= take; outLen += take; if (block.size() == kBlock) flush(); }
+    };
+    auto lineEnd = [&]() { put(nl.data(), nl.size()); maxBytes = std::max(maxBytes, outLen - starts.back()); starts.push_back(outLen); };
+    // \r の次が \n かはピースをまたいで決まるので、\r を見たら次のバイトまで保留する
+    bool pendingCR = false;
+    for (const Piece& p : pt.pieces) {
+        const char* s = pt.pieceData(p); const char* end = s + p.len;
+        if (pendingCR && s < end) { pendingCR = false; lineEnd(); if (*s == '\n') s++; }
+        while (s < end) {
+            const char* brk = s; while (brk < end && *brk != '\r' && *brk != '\n') brk++;
+            put(s, brk - s);
+            if (brk == end) break;
+            if (*brk == '\r' && brk + 1 == end) { pendingCR = true; break; }
+            lineEnd(); s = brk + ((*brk == '\r' && brk[1] == '\n') ? 2 : 1);
+        }
+    }
+    if (pendingCR) lineEnd();
+    flush();
+    if (outLen > starts.back()) maxBytes = std::max(maxBytes, outLen - starts.back());
+    EditBatch batch;
+    batch.beforeCursors = cursors;
+    auto snapshot = std::make_shared<PieceSnapshot>();
+    snapshot->before = pt.pieces;
+    pt.replacePieces(pieces);
+    snapshot->after = std::move(pieces);
+    batch.pieces = snapshot;
+    // 改行の種類は行頭の状態に関わらないので、色分けの状態はそのまま使える
+    bracketIndex.update(pt, pt.takeChange());
+    // 行の数は変わらないので、カーソルは行と桁で移す。改行の途中にあれば行末に寄せる
+    lineStarts.swap(starts); maxLineBytes = maxBytes;
+    auto mapPos = [&](size_t pos) {
+        size_t i = (size_t)FindLineIndex(starts, pos), p = lineStarts[i] + (pos - starts[i]);
+        return i + 1 < lineStarts.size() ? std::min(p, lineStarts[i + 1] - nl.size()) : std::min(p, outLen);
+    };
+    for (auto& c : cursors) { c.head = mapPos(c.head); c.anchor = mapPos(c.anchor); c.desiredX = getXFromPos(c.head); }
+    newlineCounts = NewlineCounts();
+    (nl == "\r\n" ? newlineCounts.crlf : nl == "\n" ? newlineCounts.lf : newlineCounts.cr) = lineStarts.size() - 1;
+    if (lineFilter.active) lineFilter.update(pt, lineStarts, 0, starts.size(), lineStarts.size());
+    sampleMemory();
+    lineStartsChanged();
+    batch.afterCursors = cursors;
+    undo.push(batch);
+    ensureCaretVisible();
+    updateDirtyFlag();
+    invalidate();
+    return converted;
+}
+#ifdef _WIN32
+bool Document::loadFile(const wchar_t* path) {
+#else
+bool Document::loadFile(const char* path) {
+#endif
+    TRACE_SCOPE("loadFile");
+    std::unique_ptr<MappedFile> map(new MappedFile());
+    if (!map->open(path)) return false;
+    fileMap = std::move(map);
+    currentEncoding = DetectEncoding(fileMap->ptr, fileMap->size);
+    convertedBuffer.clear();
+    const char* ptr = fileMap->ptr;
+    size_t size = fileMap->size;
+    switch (currentEncoding) {
+    case ENC_UTF8_BOM: if (size >= 3) { ptr += 3; size -= 3; } break;
+    case ENC_UTF16LE: convertedBuffer = Utf16ToUtf8(ptr, size, false); break;
+    case ENC_UTF16BE: convertedBuffer = Utf16ToUtf8(ptr, size, true); break;
+    case ENC_ANSI: convertedBuffer = AnsiToUtf8(ptr, size); break;
+    default: break;
+    }
+    if (currentEncoding == ENC_UTF16LE || currentEncoding == ENC_UTF16BE || currentEncoding == ENC_ANSI) { ptr = convertedBuffer.data(); size = convertedBuffer.size(); }
+    pt.initFromFile(ptr, size);
+    lineFilter = LineFilter();
+    bracketIndex.reset();
+    syntax.reset(SyntaxLanguageForPath(path));
+    undo.clear();
+    undo.markSaved();
+    pendingPadding = EditBatch();
+    cursors.clear();
+    cursors.push_back({ 0, 0, 0.0f });
+    rebuildLineStarts();
+    // 入力する改行は先頭だけで決めず、文書全体でいちばん多いものにする
+    newlineStr = newlineCounts.dominant();
+    return true;
+}
+// 末尾で途切れた UTF-8 シーケンスを除いた長さ
+static size_t CompleteUtf8Prefix(const std::string& s) {
+    size_t n = s.size();
+    for (size_t back = 1; back <= 4 && back <= n; ++back) {
+        unsigned char c = (unsigned char)s[n - back];
+        if ((c & 0xC0) == 0x80) continue;
+        size_t need = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+        return need > back ? n - back : n;
+    }
+    return n;
+}
+bool Document::writeEncoded(Encoding enc, const std::function<bool(const char*, size_t)>& sink) const {
+    TRACE_SCOPE("writeEncoded");
+    static const char bomUtf8[] = "\xEF\xBB\xBF", bomLE[] = "\xFF\xFE", bomBE[] = "\xFE\xFF";
+    if (enc == ENC_UTF8_BOM && !sink(bomUtf8, 3)) return false;
+    if (enc == ENC_UTF16LE && !sink(bomLE, 2)) return false;
+    if (enc == ENC_UTF16BE && !sink(bomBE, 2)) return false;
+    bool raw = (enc == ENC_UTF8_NOBOM || enc == ENC_UTF8_BOM);
+    const size_t kSlice = (size_t)1 << 20;
+    std::string carry, out;
+    auto convert = [&](const std::string& utf8) { return enc == ENC_ANSI ? Utf8ToAnsi(utf8) : Utf8ToUtf16Bytes(utf8, enc == ENC_UTF16BE); };
+    for (const Piece& p : pt.pieces) {
+        const char* data = pt.pieceData(p);
+        for (size_t off = 0; off < p.len; off += kSlice) {
+            size_t n = std::min(kSlice, p.len - off);
+            if (raw) { if (!sink(data + off, n)) return false; continue; }
+            carry.append(data + off, n);
+            size_t cut = CompleteUtf8Prefix(carry);
+            out = convert(carry.substr(0, cut));
+            carry.erase(0, cut);
+            if (!out.empty() && !sink(out.data(), out.size())) return false;
+        }
+    }
+    if (!carry.empty()) { out = convert(carry); if (!out.empty() && !sink(out.data(), out.size())) return false; }
+    return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Encoding.h"
+#include "MappedFile.h"
+#include "PieceTable.h"
+#include "Edit.h"
+#include "LineIndex.h"
+#include "LineFilter.h"
+#include "BracketIndex.h"
+#include "Syntax.h"
+#include "LineOps.h"
+#include "CaseMap.h"
+#include "Grapheme.h"
+#include "WordBreak.h"
+#include "Search.h"
+#include "Session.h"
+#include "MemoryStats.h"
+// 画面に出す文字列の断片。text の textOffset から len バイトは文書の docPos から。includesEnd なら docPos + len の位置も含む
+struct VisibleSpan { size_t textOffset; size_t docPos; size_t len; bool includesEnd; };
+// 文書の位置を text 上の位置にする。隠れた行の位置なら後ろで最初に見える位置 (なければ text の末尾) にして shown を false にする
+size_t VisibleOffsetOf(const std::vector<VisibleSpan>& spans, size_t pos, bool* shown = nullptr);
+size_t DocPosOfVisible(const std::vector<VisibleSpan>& spans, size_t offset);
+enum CaretMove { MOVE_LEFT, MOVE_RIGHT, MOVE_UP, MOVE_DOWN, MOVE_HOME, MOVE_END, MOVE_PAGEUP, MOVE_PAGEDOWN };
+// ウィンドウを持たない編集モデル。フロントエンドはレイアウトと描画まわりの仮想関数を上書きする
+struct Document {
+    PieceTable pt;
+    UndoManager undo;
+    std::vector<Cursor> cursors;
+    EditBatch pendingPadding;
+    std::vector<size_t> lineStarts; size_t maxLineBytes = 0;
+    // 行インデックスを作るときに数えた改行の種類ごとの数
+    NewlineCounts newlineCounts;
+    LineFilter lineFilter;
+    // 編集のたびに変わったブロックだけ読み直す。大きな文書では最初の索引をアイドル時に buildBracketIndex で作る
+    BracketIndex bracketIndex;
+    // 色分けの種類はファイルを開いたときに拡張子で決める
+    SyntaxCache syntax;
+    std::string searchQuery;
+    std::string replaceQuery;
+    bool searchMatchCase = false;
+    bool searchWholeWord = false;
+    bool searchRegex = false;
+    bool isOverwriteMode = false;
+    // 保存の前に文書全体の行末の空白を消す
+    bool trimTrailingOnSave = false;
+    std::string newlineStr = "\r\n";
+    SessionRecorder recorder;
+    std::unique_ptr<MappedFile> fileMap;
+    std::string convertedBuffer;
+    Encoding currentEncoding = ENC_UTF8_NOBOM;
+    MemoryStats memoryPeak; size_t memoryPeakTotal = 0;
+    virtual ~Document() {}
+    void rebuildLineStarts();
+    // lineStarts / maxLineBytes を作り直した後に呼ばれる
+    virtual void lineStartsChanged() {}
+    virtual float getXFromPos(size_t pos);
+    virtual size_t getPosFromLineAndX(int lineIdx, float targetX);
+    // 書記素クラスタ 1 つ分だけ進めた・戻した位置 (\r\n と絵文字の ZWJ 列・結合文字は 1 文字として扱う)
+    virtual size_t moveCaretVisual(size_t pos, bool forward);
+    virtual void ensureCaretVisible() {}
+    virtual void updateDirtyFlag() {}
+    virtual void invalidate() {}
+    virtual MemoryStats memoryUsage() const;
+    MemoryStats sampleMemory() { MemoryStats m = memoryUsage(); memoryPeak.takeMax(m); memoryPeakTotal = std::max(memoryPeakTotal, m.privateTotal()); return m; }
+    int getLineIdx(size_t pos) { return FindLineIndex(lineStarts, pos); }
+    // 表示上の行 (row) の数と、row と文書の行 (line) の対応。絞り込んでいなければ row == line
+    // viewRowOf は line が隠れていれば後ろで最初に見える行の row を返す
+    int viewLineCount() const { return (int)(lineFilter.active ? lineFilter.lines.size() : lineStarts.size()); }
+    int viewLineAt(int row) const { return !lineFilter.active ? row : (row < (int)lineFilter.lines.size()) ? (int)lineFilter.lines[row] : (int)lineStarts.size(); }
+    int viewRowOf(int line) const { return lineFilter.active ? (int)lineFilter.rowOf((size_t)line) : line; }
+    // 表示上の行 firstRow から numRows 行分の文字列。spans を渡すと text と文書の位置の対応を返す
+    std::string visibleText(size_t firstRow, int numRows, std::vector<VisibleSpan>* spans = nullptr) const;
+    // 検索語に一致する行だけを表示する (文書は変えない)。on が false なら解除。検索語が空か正規表現が不正なら false
+    // 編集のたびに変わった行だけを調べ直す
+    bool setLineFilter(bool on);
+    // 絞り込み中に隠れた行へ入った位置を、forward の向きにある表示行へ移す
+    size_t snapToView(size_t pos, bool forward);
+    void mergeCursors();
+    void selectWordAt(size_t pos);
+    void selectLineAt(size_t pos);
+    size_t moveWordLeft(size_t pos);
+    size_t moveWordRight(size_t pos);
+    void moveCursors(CaretMove move, bool shift, bool ctrl, int pageLines = 30);
+    void rollbackPadding();
+    void commitPadding();
+    void insertAtCursors(const std::string& text);
+    void deleteForwardAtCursors();
+    void backspaceAtCursors(bool allowCharDeletion = true);
+    void insertNewlineWithAutoIndent();
+    void selectNextOccurrence();
+    bool findNextMatch(bool forward);
+    size_t replaceAllMatches();
+    void performUndo();
+    void performRedo();
+    void recordOpen(const std::string& path);
+    // アイドル時のピース整理を budgetNs だけ進める。まだ続きがあれば true
+    bool compactPieces(uint64_t budgetNs);
+    // アイドル時に括弧の索引を budgetNs だけ作り進める。まだ続きがあれば true
+    bool buildBracketIndex(uint64_t budgetNs) { return bracketIndex.buildStep(pt, budgetNs); }
+    // pos に隣り合う括弧と対応する組、文字列の両端の " の組、なければ pos を囲む最も内側の括弧の組。括弧は索引ができるまで見つからない
+    bool bracketPairAt(size_t pos, size_t& open, size_t& close) const;
+    // 各カーソルを対応する括弧 (または文字列のもう一方の ") へ移す。隣になければ囲んでいる開き括弧へ
+    void jumpToMatchingBracket();
+    // visibleText で作った text の色分けを text 上の位置で返す。行頭の状態がまだ分からない行があれば (アイドル時に求めるまで) false
+    bool highlightVisible(const std::string& text, const std::vector<VisibleSpan>& spans, std::vector<SyntaxToken>& tokens);
+    // アイドル時に、描画が知りたかった行まで行頭の状態を budgetNs だけ求め進める。まだ続きがあれば true
+    bool buildSyntaxStates(uint64_t budgetNs) { return !syntax.advance(pt, lineStarts, syntax.wantedLine, budgetNs); }
+    std::vector<int> getSelectedLineIndices();
+    void duplicateLines(bool up);
+    void moveLines(bool up);
+    void deleteLines();
+    void indentLines(bool forceLineIndent = false);
+    void unindentLines();
+    void transformSelectedLines(EditOp::Type type);
+    // 選択範囲を大文字 (toUpper) か小文字にする。変換結果は追加バッファに直接書き、undo は前後のピース列だけを持つ
+    void convertCase(bool toUpper);
+    // 選択のある行全体 (選択がなければ文書全体) を [start, end) で返す。end は最終行の改行の後ろ
+    bool getLineBlockRange(size_t& start, size_t& end);
+    // 範囲の行を並べ替えて 1 つのピースに書き直す (undo は 1 回)。seed は LINES_SHUFFLE 用
+    void rearrangeLines(LineOperation op, uint64_t seed = 0);
+    // 範囲の行 (wholeDocument なら選択によらず文書全体) の空白を op で書き換え、1 つのピースに書き直す。書き換えた行の数を返す
+    // undo は前後のピース列だけを持つ。カーソルは同じ行の同じ見た目の桁に置く
+    size_t transformWhitespace(WhitespaceOperation op, bool wholeDocument = false);
+    // 範囲の行のうち検索語に一致する行だけ残す (keepMatching) か、一致する行を消す。消した行数を返し、検索語が空か正規表現が不正なら npos
+    // ピース列を 1 回の走査で組み直し、行インデックスも同じ走査でずらす。undo は前後のピース列だけを持つ
+    size_t filterLines(bool keepMatching);
+    // 文書中の改行をすべて nl にそろえ、以後入力する改行も nl にする。変えた改行の数を返す
+    // ピースを前から読んで変換結果を大きなブロックで追加バッファに書き、行インデックスも同じ走査で作る。undo は前後のピース列だけを持つ
+    size_t convertNewlines(const std::string& nl);
+    // ファイルをマップして文字コードを判定し、UTF-8 でなければ変換したバッファを元テキストにする
+#ifdef _WIN32
+    bool loadFile(const wchar_t* path);
+#else
+    bool loadFile(const char* path);
+#endif
+    // 文書を enc に変換しながらピース単位で sink に渡す (全体を 1 本の文字列にはしない)
+    bool writeEncoded(Encoding enc, const std::function<bool(const char*, size_t)>& sink) const;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include "PieceTable.h"
+struct Cursor {
+    size_t head; size_t anchor; float desiredX;
+    float originalAnchorX = 0.0f; bool isVirtual = false;
+    size_t start() const { return std::min(head, anchor); }
+    size_t end() const { return std::max(head, anchor); }
+    bool hasSelection() const { return head != anchor; }
+    void clearSelection() { anchor = head; }
+};
+// Indent / Unindent は pos から始まる変換前の行ブロックを text に持ち、変換後の内容は text から作り直す
+struct EditOp { enum Type { Insert, Erase, Indent, Unindent } type; size_t pos; std::string text; };
+// text (行頭から始まり最後の改行を含まない行のまとまり) の各行頭に '\t' を足す (Indent) か、行頭の '\t' / ' ' を 1 つ取る (Unindent)
+// changed があれば、足した・取った位置を text 内のオフセットで追加する
+inline std::string TransformLineBlock(EditOp::Type type, const std::string& text, std::vector<size_t>* changed = nullptr) {
+    std::string out; out.reserve(type == EditOp::Indent ? text.size() + text.size() / 32 + 1 : text.size());
+    size_t i = 0;
+    while (true) {
+        if (type == EditOp::Indent) { out += '\t'; if (changed) changed->push_back(i); }
+        else if (i < text.size() && (text[i] == '\t' || text[i] == ' ')) { if (changed) changed->push_back(i); i++; }
+        size_t nl = text.find_first_of("\r\n", i);
+        if (nl == std::string::npos) { out.append(text, i, std::string::npos); break; }
+        size_t next = nl + 1; if (text[nl] == '\r' && next < text.size() && text[next] == '\n') next++;
+        out.append(text, i, next - i); i = next;
+    }
+    return out;
+}
+// 行の絞り込みのように文書中に散らばった大量の削除は、消した文字列ではなく前後のピース列で持つ (ops は空)。
+// ピースは元ファイルと追加バッファを指すだけなので、消した量によらず小さい
+struct PieceSnapshot { std::vector<Piece> before, after; };
+struct EditBatch { std::vector<EditOp> ops; std::vector<Cursor> beforeCursors; std::vector<Cursor> afterCursors; std::shared_ptr<const PieceSnapshot> pieces; };
+inline size_t EditTextBytes(const EditBatch& b) { size_t n = b.ops.size() * sizeof(EditOp); for (const auto& o : b.ops) n += o.text.size(); if (b.pieces) n += (b.pieces->before.size() + b.pieces->after.size()) * sizeof(Piece); return n; }
+inline size_t EditCursorBytes(const EditBatch& b) { return (b.beforeCursors.size() + b.afterCursors.size()) * sizeof(Cursor); }
+struct UndoManager {
+    std::vector<EditBatch> undoStack; std::vector<EditBatch> redoStack; int savePoint = 0;
+    size_t undoTextBytes = 0; size_t undoCursorBytes = 0; size_t redoTextBytes = 0; size_t redoCursorBytes = 0;
+    void clear() { undoStack.clear(); redoStack.clear(); savePoint = 0; undoTextBytes = undoCursorBytes = redoTextBytes = redoCursorBytes = 0; }
+    void markSaved() { savePoint = (int)undoStack.size(); }
+    bool isModified() const { return (int)undoStack.size() != savePoint; }
+    void push(const EditBatch& batch) { if (savePoint > (int)undoStack.size()) savePoint = -1; undoStack.push_back(batch); undoTextBytes += EditTextBytes(batch); undoCursorBytes += EditCursorBytes(batch); redoStack.clear(); redoTextBytes = redoCursorBytes = 0; }
+    bool canUndo() const { return !undoStack.empty(); }
+    bool canRedo() const { return !redoStack.empty(); }
+    EditBatch popUndo() { EditBatch e = undoStack.back(); undoStack.pop_back(); redoStack.push_back(e); size_t t = EditTextBytes(e), c = EditCursorBytes(e); undoTextBytes -= t; undoCursorBytes -= c; redoTextBytes += t; redoCursorBytes += c; return e; }
+    EditBatch popRedo() { EditBatch e = redoStack.back(); redoStack.pop_back(); undoStack.push_back(e); size_t t = EditTextBytes(e), c = EditCursorBytes(e); redoTextBytes -= t; redoCursorBytes -= c; undoTextBytes += t; undoCursorBytes += c; return e; }
+    void setLastBeforeCursors(const std::vector<Cursor>& c) { EditBatch& b = undoStack.back(); undoCursorBytes -= EditCursorBytes(b); b.beforeCursors = c; undoCursorBytes += EditCursorBytes(b); }
+};
+inline void RevertBatch(PieceTable& pt, const EditBatch& b) {
+    if (b.pieces) pt.replacePieces(b.pieces->before);
+    for (size_t i = b.ops.size(); i-- > 0;) {
+        const auto& o = b.ops[i];
+        if (o.type == EditOp::Insert) pt.erase(o.pos, o.text.size());
+        else if (o.type == EditOp::Erase) pt.insert(o.pos, o.text);
+        else { pt.erase(o.pos, TransformLineBlock(o.type, o.text).size()); pt.insert(o.pos, o.text); }
+    }
+}
+inline void ReapplyBatch(PieceTable& pt, const EditBatch& b) {
+    if (b.pieces) pt.replacePieces(b.pieces->after);
+    for (const auto& o : b.ops) {
+        if (o.type == EditOp::Insert) pt.insert(o.pos, o.text);
+        else if (o.type == EditOp::Erase) pt.erase(o.pos, o.text.size());
+        else { pt.erase(o.pos, o.text.size()); pt.insert(o.pos, TransformLineBlock(o.type, o.text)); }
+    }
+}
@@ -0,0 +1,150 @@
+#include "Encoding.h"
+#include <algorithm>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+bool IsValidUtf8(const char* buf, size_t len) {
+    bool clipped = len > 4096;
+    if (clipped) len = 4096;
+    const unsigned char* s = (const unsigned char*)buf;
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = s[i];
+        if (c < 0x80) { i++; continue; }
+        size_t n; unsigned int cp;
+        if (c >= 0xC2 && c <= 0xDF) { n = 1; cp = c & 0x1F; }
+        else if ((c & 0xF0) == 0xE0) { n = 2; cp = c & 0x0F; }
+        else if (c >= 0xF0 && c <= 0xF4) { n = 3; cp = c & 0x07; }
+        else return false;
+        if (i + n >= len) return clipped;
+        for (size_t k = 1; k <= n; ++k) {
+            if ((s[i + k] & 0xC0) != 0x80) return false;
+            cp = (cp << 6) | (s[i + k] & 0x3F);
+        }
+        if ((n == 2 && cp < 0x800) || (n == 3 && (cp < 0x10000 || cp > 0x10FFFF)) || (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+        i += n + 1;
+    }
+    return true;
+}
+Encoding DetectEncoding(const char* buf, size_t len) {
+    if (len >= 3 && (unsigned char)buf[0] == 0xEF && (unsigned char)buf[1] == 0xBB && (unsigned char)buf[2] == 0xBF) {
+        return ENC_UTF8_BOM;
+    }
+    if (len >= 2) {
+        if ((unsigned char)buf[0] == 0xFF && (unsigned char)buf[1] == 0xFE) {
+            return ENC_UTF16LE;
+        }
+        if ((unsigned char)buf[0] == 0xFE && (unsigned char)buf[1] == 0xFF) {
+            return ENC_UTF16BE;
+        }
+    }
+    if (IsValidUtf8(buf, len)) {
+        return ENC_UTF8_NOBOM;
+    }
+    return ENC_ANSI;
+}
+static void AppendUtf8(std::string& out, unsigned int cp) {
+    if (cp < 0x80) out += (char)cp;
+    else if (cp < 0x800) { out += (char)(0xC0 | (cp >> 6)); out += (char)(0x80 | (cp & 0x3F)); }
+    else if (cp < 0x10000) { out += (char)(0xE0 | (cp >> 12)); out += (char)(0x80 | ((cp >> 6) & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+    else { out += (char)(0xF0 | (cp >> 18)); out += (char)(0x80 | ((cp >> 12) & 0x3F)); out += (char)(0x80 | ((cp >> 6) & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+}
+std::string Utf16ToUtf8(const char* data, size_t len, bool isBigEndian) {
+    if (len < 2) return "";
+    const unsigned char* p = (const unsigned char*)data + 2;
+    size_t units = (len - 2) / 2;
+    std::string ret;
+    ret.reserve(units * 3 / 2);
+    auto unitAt = [&](size_t i) -> unsigned int { return isBigEndian ? ((p[i * 2] << 8) | p[i * 2 + 1]) : (p[i * 2] | (p[i * 2 + 1] << 8)); };
+    for (size_t i = 0; i < units; ++i) {
+        unsigned int u = unitAt(i);
+        if (u >= 0xD800 && u <= 0xDBFF && i + 1 < units) {
+            unsigned int lo = unitAt(i + 1);
+            if (lo >= 0xDC00 && lo <= 0xDFFF) { AppendUtf8(ret, 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00)); i++; continue; }
+        }
+        if (u >= 0xD800 && u <= 0xDFFF) u = 0xFFFD;
+        AppendUtf8(ret, u);
+    }
+    return ret;
+}
+std::string Utf8ToUtf16Bytes(const std::string& utf8, bool isBigEndian) {
+    std::string ret;
+    ret.reserve(utf8.size() * 2);
+    auto put = [&](unsigned int u) {
+        if (isBigEndian) { ret += (char)(u >> 8); ret += (char)(u & 0xFF); }
+        else { ret += (char)(u & 0xFF); ret += (char)(u >> 8); }
+    };
+    const unsigned char* s = (const unsigned char*)utf8.data();
+    size_t len = utf8.size();
+    size_t i = 0;
+    while (i < len) {
+        unsigned char c = s[i];
+        unsigned int cp = 0xFFFD; size_t n = 0;
+        if (c < 0x80) cp = c;
+        else if (c >= 0xC2 && c <= 0xDF) { n = 1; cp = c & 0x1F; }
+        else if ((c & 0xF0) == 0xE0) { n = 2; cp = c & 0x0F; }
+        else if (c >= 0xF0 && c <= 0xF4) { n = 3; cp = c & 0x07; }
+        bool ok = (c < 0x80) || n > 0;
+        for (size_t k = 1; ok && k <= n; ++k) {
+            if (i + k >= len || (s[i + k] & 0xC0) != 0x80) ok = false;
+            else cp = (cp << 6) | (s[i + k] & 0x3F);
+        }
+        if (ok && ((n == 2 && cp < 0x800) || (n == 3 && (cp < 0x10000 || cp > 0x10FFFF)) || (cp >= 0xD800 && cp <= 0xDFFF))) ok = false;
+        if (!ok) { put(0xFFFD); i++; continue; }
+        if (cp >= 0x10000) { cp -= 0x10000; put(0xD800 + (cp >> 10)); put(0xDC00 + (cp & 0x3FF)); }
+        else put(cp);
+        i += n + 1;
+    }
+    return ret;
+}
+#ifdef _WIN32
+std::string AnsiToUtf8(const char* data, size_t len) {
+    if (len == 0) return "";
+    int wLen = MultiByteToWideChar(CP_ACP, 0, data, (int)len, NULL, 0);
+    if (wLen <= 0) return "";
+    std::vector<wchar_t> wBuf(wLen);
+    MultiByteToWideChar(CP_ACP, 0, data, (int)len, wBuf.data(), wLen);
+    int uLen = WideCharToMultiByte(CP_UTF8, 0, wBuf.data(), wLen, NULL, 0, NULL, NULL);
+    if (uLen <= 0) return "";
+    std::string ret; ret.resize(uLen);
+    WideCharToMultiByte(CP_UTF8, 0, wBuf.data(), wLen, &ret[0], uLen, NULL, NULL);
+    return ret;
+}
+std::string Utf8ToAnsi(const std::string& utf8) {
+    if (utf8.empty()) return "";
+    int wLen = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), NULL, 0);
+    if (wLen <= 0) return "";
+    std::vector<wchar_t> w(wLen);
+    MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), w.data(), wLen);
+    int len = WideCharToMultiByte(CP_ACP, 0, w.data(), wLen, NULL, 0, NULL, NULL);
+    if (len <= 0) return "";
+    std::string ret; ret.resize(len);
+    WideCharToMultiByte(CP_ACP, 0, w.data(), wLen, &ret[0], len, NULL, NULL);
+    return ret;
+}
+#else
+std::string AnsiToUtf8(const char* data, size_t len) {
+    std::string ret; ret.reserve(len);
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)data[i];
+        if (c < 0x80) ret += (char)c; else { ret += (char)(0xC0 | (c >> 6)); ret += (char)(0x80 | (c & 0x3F)); }
+    }
+    return ret;
+}
+std::string Utf8ToAnsi(const std::string& utf8) {
+    std::string ret; ret.reserve(utf8.size());
+    const unsigned char* s = (const unsigned char*)utf8.data(); size_t len = utf8.size();
+    for (size_t i = 0; i < len;) {
+        unsigned char c = s[i];
+        if (c < 0x80) { ret += (char)c; i++; continue; }
+        size_t n = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+        if (n == 2 && i + 1 < len && c <= 0xC3) ret += (char)(((c & 0x1F) << 6) | (s[i + 1] & 0x3F)); else ret += '?';
+        i += std::min(n, len - i);
+    }
+    return ret;
+}
+#endif
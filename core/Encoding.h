@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+enum Encoding {
+    ENC_UTF8_NOBOM = 0,
+    ENC_UTF8_BOM,
+    ENC_UTF16LE,
+    ENC_UTF16BE,
+    ENC_ANSI
+};
+bool IsValidUtf8(const char* buf, size_t len);
+Encoding DetectEncoding(const char* buf, size_t len);
+std::string Utf16ToUtf8(const char* data, size_t len, bool isBigEndian);
+std::string Utf8ToUtf16Bytes(const std::string& utf8, bool isBigEndian);
+// ANSI はシステムのコードページ (Windows 以外では Latin-1 とみなす)
+std::string AnsiToUtf8(const char* data, size_t len);
+std::string Utf8ToAnsi(const std::string& utf8);
@@ -0,0 +1,160 @@
+#include "Grapheme.h"
+#include <algorithm>
+// (先頭のコード点 << 4) | 区分 の並び。次の要素の手前までが同じ区分。Unicode 14.0 の Grapheme_Cluster_Break と
+// Extended_Pictographic (GB_PICTOGRAPHIC) から作った。ハングル音節 (LV / LVT) は計算で出すので GB_OTHER にしてある
+static const uint32_t kGraphemeRuns[] = {
+    0x3, 0xA2, 0xB3, 0xD1, 0xE3, 0x200, 0x7F3, 0xA00, 0xA9E, 0xAA0, 0xAD3, 0xAEE, 0xAF0, 0x3004, 0x3700, 0x4834, 0x48A0, 0x5914, 0x5BE0, 0x5BF4,
+    0x5C00, 0x5C14, 0x5C30, 0x5C44, 0x5C60, 0x5C74, 0x5C80, 0x6007, 0x6060, 0x6104, 0x61B0, 0x61C3, 0x61D0, 0x64B4, 0x6600, 0x6704, 0x6710, 0x6D64,
+    0x6DD7, 0x6DE0, 0x6DF4, 0x6E50, 0x6E74, 0x6E90, 0x6EA4, 0x6EE0, 0x70F7, 0x7100, 0x7114, 0x7120, 0x7304, 0x74B0, 0x7A64, 0x7B10, 0x7EB4, 0x7F40,
+    0x7FD4, 0x7FE0, 0x8164, 0x81A0, 0x81B4, 0x8240, 0x8254, 0x8280, 0x8294, 0x82E0, 0x8594, 0x85C0, 0x8907, 0x8920, 0x8984, 0x8A00, 0x8CA4, 0x8E27,
+    0x8E34, 0x9038, 0x9040, 0x93A4, 0x93B8, 0x93C4, 0x93D0, 0x93E8, 0x9414, 0x9498, 0x94D4, 0x94E8, 0x9500, 0x9514, 0x9580, 0x9624, 0x9640, 0x9814,
+    0x9828, 0x9840, 0x9BC4, 0x9BD0, 0x9BE4, 0x9BF8, 0x9C14, 0x9C50, 0x9C78, 0x9C90, 0x9CB8, 0x9CD4, 0x9CE0, 0x9D74, 0x9D80, 0x9E24, 0x9E40, 0x9FE4,
+    0x9FF0, 0xA014, 0xA038, 0xA040, 0xA3C4, 0xA3D0, 0xA3E8, 0xA414, 0xA430, 0xA474, 0xA490, 0xA4B4, 0xA4E0, 0xA514, 0xA520, 0xA704, 0xA720, 0xA754,
+    0xA760, 0xA814, 0xA838, 0xA840, 0xABC4, 0xABD0, 0xABE8, 0xAC14, 0xAC60, 0xAC74, 0xAC98, 0xACA0, 0xACB8, 0xACD4, 0xACE0, 0xAE24, 0xAE40, 0xAFA4,
+    0xB000, 0xB014, 0xB028, 0xB040, 0xB3C4, 0xB3D0, 0xB3E4, 0xB408, 0xB414, 0xB450, 0xB478, 0xB490, 0xB4B8, 0xB4D4, 0xB4E0, 0xB554, 0xB580, 0xB624,
+    0xB640, 0xB824, 0xB830, 0xBBE4, 0xBBF8, 0xBC04, 0xBC18, 0xBC30, 0xBC68, 0xBC90, 0xBCA8, 0xBCD4, 0xBCE0, 0xBD74, 0xBD80, 0xC004, 0xC018, 0xC044,
+    0xC050, 0xC3C4, 0xC3D0, 0xC3E4, 0xC418, 0xC450, 0xC464, 0xC490, 0xC4A4, 0xC4E0, 0xC554, 0xC570, 0xC624, 0xC640, 0xC814, 0xC828, 0xC840, 0xCBC4,
+    0xCBD0, 0xCBE8, 0xCBF4, 0xCC08, 0xCC24, 0xCC38, 0xCC50, 0xCC64, 0xCC78, 0xCC90, 0xCCA8, 0xCCC4, 0xCCE0, 0xCD54, 0xCD70, 0xCE24, 0xCE40, 0xD004,
+    0xD028, 0xD040, 0xD3B4, 0xD3D0, 0xD3E4, 0xD3F8, 0xD414, 0xD450, 0xD468, 0xD490, 0xD4A8, 0xD4D4, 0xD4E7, 0xD4F0, 0xD574, 0xD580, 0xD624, 0xD640,
+    0xD814, 0xD828, 0xD840, 0xDCA4, 0xDCB0, 0xDCF4, 0xDD08, 0xDD24, 0xDD50, 0xDD64, 0xDD70, 0xDD88, 0xDDF4, 0xDE00, 0xDF28, 0xDF40, 0xE314, 0xE320,
+    0xE338, 0xE344, 0xE3B0, 0xE474, 0xE4F0, 0xEB14, 0xEB20, 0xEB38, 0xEB44, 0xEBD0, 0xEC84, 0xECE0, 0xF184, 0xF1A0, 0xF354, 0xF360, 0xF374, 0xF380,
+    0xF394, 0xF3A0, 0xF3E8, 0xF400, 0xF714, 0xF7F8, 0xF804, 0xF850, 0xF864, 0xF880, 0xF8D4, 0xF980, 0xF994, 0xFBD0, 0xFC64, 0xFC70, 0x102D4, 0x10318,
+    0x10324, 0x10380, 0x10394, 0x103B8, 0x103D4, 0x103F0, 0x10568, 0x10584, 0x105A0, 0x105E4, 0x10610, 0x10714, 0x10750, 0x10824, 0x10830, 0x10848,
+    0x10854, 0x10870, 0x108D4, 0x108E0, 0x109D4, 0x109E0, 0x11009, 0x1160A, 0x11A8B, 0x12000, 0x135D4, 0x13600, 0x17124, 0x17158, 0x17160, 0x17324,
+    0x17348, 0x17350, 0x17524, 0x17540, 0x17724, 0x17740, 0x17B44, 0x17B68, 0x17B74, 0x17BE8, 0x17C64, 0x17C78, 0x17C94, 0x17D40, 0x17DD4, 0x17DE0,
+    0x180B4, 0x180E3, 0x180F4, 0x18100, 0x18854, 0x18870, 0x18A94, 0x18AA0, 0x19204, 0x19238, 0x19274, 0x19298, 0x192C0, 0x19308, 0x19324, 0x19338,
+    0x19394, 0x193C0, 0x1A174, 0x1A198, 0x1A1B4, 0x1A1C0, 0x1A558, 0x1A564, 0x1A578, 0x1A584, 0x1A5F0, 0x1A604, 0x1A610, 0x1A624, 0x1A630, 0x1A654,
+    0x1A6D8, 0x1A734, 0x1A7D0, 0x1A7F4, 0x1A800, 0x1AB04, 0x1ACF0, 0x1B004, 0x1B048, 0x1B050, 0x1B344, 0x1B3B8, 0x1B3C4, 0x1B3D8, 0x1B424, 0x1B438,
+    0x1B450, 0x1B6B4, 0x1B740, 0x1B804, 0x1B828, 0x1B830, 0x1BA18, 0x1BA24, 0x1BA68, 0x1BA84, 0x1BAA8, 0x1BAB4, 0x1BAE0, 0x1BE64, 0x1BE78, 0x1BE84,
+    0x1BEA8, 0x1BED4, 0x1BEE8, 0x1BEF4, 0x1BF28, 0x1BF40, 0x1C248, 0x1C2C4, 0x1C348, 0x1C364, 0x1C380, 0x1CD04, 0x1CD30, 0x1CD44, 0x1CE18, 0x1CE24,
+    0x1CE90, 0x1CED4, 0x1CEE0, 0x1CF44, 0x1CF50, 0x1CF78, 0x1CF84, 0x1CFA0, 0x1DC04, 0x1E000, 0x200B3, 0x200C4, 0x200D5, 0x200E3, 0x20100, 0x20283,
+    0x202F0, 0x203CE, 0x203D0, 0x2049E, 0x204A0, 0x20603, 0x20700, 0x20D04, 0x20F10, 0x2122E, 0x21230, 0x2139E, 0x213A0, 0x2194E, 0x219A0, 0x21A9E,
+    0x21AB0, 0x231AE, 0x231C0, 0x2328E, 0x23290, 0x2388E, 0x23890, 0x23CFE, 0x23D00, 0x23E9E, 0x23F40, 0x23F8E, 0x23FB0, 0x24C2E, 0x24C30, 0x25AAE,
+    0x25AC0, 0x25B6E, 0x25B70, 0x25C0E, 0x25C10, 0x25FBE, 0x25FF0, 0x2600E, 0x26060, 0x2607E, 0x26130, 0x2614E, 0x26860, 0x2690E, 0x27060, 0x2708E,
+    0x27130, 0x2714E, 0x27150, 0x2716E, 0x27170, 0x271DE, 0x271E0, 0x2721E, 0x27220, 0x2728E, 0x27290, 0x2733E, 0x27350, 0x2744E, 0x27450, 0x2747E,
+    0x27480, 0x274CE, 0x274D0, 0x274EE, 0x274F0, 0x2753E, 0x27560, 0x2757E, 0x27580, 0x2763E, 0x27680, 0x2795E, 0x27980, 0x27A1E, 0x27A20, 0x27B0E,
+    0x27B10, 0x27BFE, 0x27C00, 0x2934E, 0x29360, 0x2B05E, 0x2B080, 0x2B1BE, 0x2B1D0, 0x2B50E, 0x2B510, 0x2B55E, 0x2B560, 0x2CEF4, 0x2CF20, 0x2D7F4,
+    0x2D800, 0x2DE04, 0x2E000, 0x302A4, 0x3030E, 0x30310, 0x303DE, 0x303E0, 0x30994, 0x309B0, 0x3297E, 0x32980, 0x3299E, 0x329A0, 0xA66F4, 0xA6730,
+    0xA6744, 0xA67E0, 0xA69E4, 0xA6A00, 0xA6F04, 0xA6F20, 0xA8024, 0xA8030, 0xA8064, 0xA8070, 0xA80B4, 0xA80C0, 0xA8238, 0xA8254, 0xA8278, 0xA8280,
+    0xA82C4, 0xA82D0, 0xA8808, 0xA8820, 0xA8B48, 0xA8C44, 0xA8C60, 0xA8E04, 0xA8F20, 0xA8FF4, 0xA9000, 0xA9264, 0xA92E0, 0xA9474, 0xA9528, 0xA9540,
+    0xA9609, 0xA97D0, 0xA9804, 0xA9838, 0xA9840, 0xA9B34, 0xA9B48, 0xA9B64, 0xA9BA8, 0xA9BC4, 0xA9BE8, 0xA9C10, 0xA9E54, 0xA9E60, 0xAA294, 0xAA2F8,
+    0xAA314, 0xAA338, 0xAA354, 0xAA370, 0xAA434, 0xAA440, 0xAA4C4, 0xAA4D8, 0xAA4E0, 0xAA7C4, 0xAA7D0, 0xAAB04, 0xAAB10, 0xAAB24, 0xAAB50, 0xAAB74,
+    0xAAB90, 0xAABE4, 0xAAC00, 0xAAC14, 0xAAC20, 0xAAEB8, 0xAAEC4, 0xAAEE8, 0xAAF00, 0xAAF58, 0xAAF64, 0xAAF70, 0xABE38, 0xABE54, 0xABE68, 0xABE84,
+    0xABE98, 0xABEB0, 0xABEC8, 0xABED4, 0xABEE0, 0xD7B0A, 0xD7C70, 0xD7CBB, 0xD7FC0, 0xFB1E4, 0xFB1F0, 0xFE004, 0xFE100, 0xFE204, 0xFE300, 0xFEFF3,
+    0xFF000, 0xFF9E4, 0xFFA00, 0xFFF03, 0xFFFC0, 0x101FD4, 0x101FE0, 0x102E04, 0x102E10, 0x103764, 0x1037B0, 0x10A014, 0x10A040, 0x10A054, 0x10A070,
+    0x10A0C4, 0x10A100, 0x10A384, 0x10A3B0, 0x10A3F4, 0x10A400, 0x10AE54, 0x10AE70, 0x10D244, 0x10D280, 0x10EAB4, 0x10EAD0, 0x10F464, 0x10F510,
+    0x10F824, 0x10F860, 0x110008, 0x110014, 0x110028, 0x110030, 0x110384, 0x110470, 0x110704, 0x110710, 0x110734, 0x110750, 0x1107F4, 0x110828,
+    0x110830, 0x110B08, 0x110B34, 0x110B78, 0x110B94, 0x110BB0, 0x110BD7, 0x110BE0, 0x110C24, 0x110C30, 0x110CD7, 0x110CE0, 0x111004, 0x111030,
+    0x111274, 0x1112C8, 0x1112D4, 0x111350, 0x111458, 0x111470, 0x111734, 0x111740, 0x111804, 0x111828, 0x111830, 0x111B38, 0x111B64, 0x111BF8,
+    0x111C10, 0x111C27, 0x111C40, 0x111C94, 0x111CD0, 0x111CE8, 0x111CF4, 0x111D00, 0x1122C8, 0x1122F4, 0x112328, 0x112344, 0x112358, 0x112364,
+    0x112380, 0x1123E4, 0x1123F0, 0x112DF4, 0x112E08, 0x112E34, 0x112EB0, 0x113004, 0x113028, 0x113040, 0x1133B4, 0x1133D0, 0x1133E4, 0x1133F8,
+    0x113404, 0x113418, 0x113450, 0x113478, 0x113490, 0x1134B8, 0x1134E0, 0x113574, 0x113580, 0x113628, 0x113640, 0x113664, 0x1136D0, 0x113704,
+    0x113750, 0x114358, 0x114384, 0x114408, 0x114424, 0x114458, 0x114464, 0x114470, 0x1145E4, 0x1145F0, 0x114B04, 0x114B18, 0x114B34, 0x114B98,
+    0x114BA4, 0x114BB8, 0x114BD4, 0x114BE8, 0x114BF4, 0x114C18, 0x114C24, 0x114C40, 0x115AF4, 0x115B08, 0x115B24, 0x115B60, 0x115B88, 0x115BC4,
+    0x115BE8, 0x115BF4, 0x115C10, 0x115DC4, 0x115DE0, 0x116308, 0x116334, 0x1163B8, 0x1163D4, 0x1163E8, 0x1163F4, 0x116410, 0x116AB4, 0x116AC8,
+    0x116AD4, 0x116AE8, 0x116B04, 0x116B68, 0x116B74, 0x116B80, 0x1171D4, 0x117200, 0x117224, 0x117268, 0x117274, 0x1172C0, 0x1182C8, 0x1182F4,
+    0x118388, 0x118394, 0x1183B0, 0x119304, 0x119318, 0x119360, 0x119378, 0x119390, 0x1193B4, 0x1193D8, 0x1193E4, 0x1193F7, 0x119408, 0x119417,
+    0x119428, 0x119434, 0x119440, 0x119D18, 0x119D44, 0x119D80, 0x119DA4, 0x119DC8, 0x119E04, 0x119E10, 0x119E48, 0x119E50, 0x11A014, 0x11A0B0,
+    0x11A334, 0x11A398, 0x11A3A7, 0x11A3B4, 0x11A3F0, 0x11A474, 0x11A480, 0x11A514, 0x11A578, 0x11A594, 0x11A5C0, 0x11A847, 0x11A8A4, 0x11A978,
+    0x11A984, 0x11A9A0, 0x11C2F8, 0x11C304, 0x11C370, 0x11C384, 0x11C3E8, 0x11C3F4, 0x11C400, 0x11C924, 0x11CA80, 0x11CA98, 0x11CAA4, 0x11CB18,
+    0x11CB24, 0x11CB48, 0x11CB54, 0x11CB70, 0x11D314, 0x11D370, 0x11D3A4, 0x11D3B0, 0x11D3C4, 0x11D3E0, 0x11D3F4, 0x11D467, 0x11D474, 0x11D480,
+    0x11D8A8, 0x11D8F0, 0x11D904, 0x11D920, 0x11D938, 0x11D954, 0x11D968, 0x11D974, 0x11D980, 0x11EF34, 0x11EF58, 0x11EF70, 0x134303, 0x134390,
+    0x16AF04, 0x16AF50, 0x16B304, 0x16B370, 0x16F4F4, 0x16F500, 0x16F518, 0x16F880, 0x16F8F4, 0x16F930, 0x16FE44, 0x16FE50, 0x16FF08, 0x16FF20,
+    0x1BC9D4, 0x1BC9F0, 0x1BCA03, 0x1BCA40, 0x1CF004, 0x1CF2E0, 0x1CF304, 0x1CF470, 0x1D1654, 0x1D1668, 0x1D1674, 0x1D16A0, 0x1D16D8, 0x1D16E4,
+    0x1D1733, 0x1D17B4, 0x1D1830, 0x1D1854, 0x1D18C0, 0x1D1AA4, 0x1D1AE0, 0x1D2424, 0x1D2450, 0x1DA004, 0x1DA370, 0x1DA3B4, 0x1DA6D0, 0x1DA754,
+    0x1DA760, 0x1DA844, 0x1DA850, 0x1DA9B4, 0x1DAA00, 0x1DAA14, 0x1DAB00, 0x1E0004, 0x1E0070, 0x1E0084, 0x1E0190, 0x1E01B4, 0x1E0220, 0x1E0234,
+    0x1E0250, 0x1E0264, 0x1E02B0, 0x1E1304, 0x1E1370, 0x1E2AE4, 0x1E2AF0, 0x1E2EC4, 0x1E2F00, 0x1E8D04, 0x1E8D70, 0x1E9444, 0x1E94B0, 0x1F000E,
+    0x1F1000, 0x1F10DE, 0x1F1100, 0x1F12FE, 0x1F1300, 0x1F16CE, 0x1F1720, 0x1F17EE, 0x1F1800, 0x1F18EE, 0x1F18F0, 0x1F191E, 0x1F19B0, 0x1F1ADE,
+    0x1F1E66, 0x1F2000, 0x1F201E, 0x1F2100, 0x1F21AE, 0x1F21B0, 0x1F22FE, 0x1F2300, 0x1F232E, 0x1F23B0, 0x1F23CE, 0x1F2400, 0x1F249E, 0x1F3FB4,
+    0x1F400E, 0x1F53E0, 0x1F546E, 0x1F6500, 0x1F680E, 0x1F7000, 0x1F774E, 0x1F7800, 0x1F7D5E, 0x1F8000, 0x1F80CE, 0x1F8100, 0x1F848E, 0x1F8500,
+    0x1F85AE, 0x1F8600, 0x1F888E, 0x1F8900, 0x1F8AEE, 0x1F9000, 0x1F90CE, 0x1F93B0, 0x1F93CE, 0x1F9460, 0x1F947E, 0x1FB000, 0x1FC00E, 0x1FFFE0,
+    0xE00003, 0xE00204, 0xE00803, 0xE01004, 0xE01F03, 0xE10000,
+};
+GraphemeBreak GraphemeBreakOf(uint32_t cp) {
+    if (cp >= 0xAC00 && cp <= 0xD7A3) return (cp - 0xAC00) % 28 == 0 ? GB_LV : GB_LVT;
+    const uint32_t* end = kGraphemeRuns + sizeof(kGraphemeRuns) / sizeof(kGraphemeRuns[0]);
+    const uint32_t* r = std::upper_bound(kGraphemeRuns, end, cp, [](uint32_t c, uint32_t run) { return c < (run >> 4); });
+    return (GraphemeBreak)(r[-1] & 0xF);
+}
+uint32_t ReadCodePoint(PieceIterator& it, size_t len) {
+    unsigned char c = (unsigned char)*it; ++it;
+    if (c < 0x80) return c;
+    size_t n = (c >= 0xF0 && c <= 0xF4) ? 4 : (c >= 0xE0 && c < 0xF0) ? 3 : (c >= 0xC2 && c < 0xE0) ? 2 : 0;
+    if (n == 0 || it.position() + n - 1 > len) return kBadCodePoint;
+    PieceIterator probe = it; uint32_t cp = c & (0x7F >> n);
+    for (size_t i = 1; i < n; ++i, ++probe) { unsigned char b = (unsigned char)*probe; if ((b & 0xC0) != 0x80) return kBadCodePoint; cp = (cp << 6) | (b & 0x3F); }
+    if ((n == 3 && (cp < 0x800 || (cp >= 0xD800 && cp < 0xE000))) || (n == 4 && (cp < 0x10000 || cp > 0x10FFFF))) return kBadCodePoint;
+    it = probe;
+    return cp;
+}
+uint32_t ReadCodePointBackward(PieceIterator& it) {
+    PieceIterator start = it; --start;
+    unsigned char c = (unsigned char)*start;
+    if (c < 0x80) { it = start; return c; }
+    for (int k = 0; k < 3 && start.position() > 0 && ((unsigned char)*start & 0xC0) == 0x80; ++k) --start;
+    // 先頭から読んでちょうど it に届くときだけ 1 文字とみなす
+    PieceIterator probe = start; size_t end = it.position();
+    uint32_t cp = ReadCodePoint(probe, end);
+    if (probe.position() == end) { it = start; return cp; }
+    --it; return kBadCodePoint;
+}
+// 不正なバイトは制御文字と同じく前後で区切る
+static GraphemeBreak ReadForward(PieceIterator& it, size_t len) { uint32_t cp = ReadCodePoint(it, len); return cp == kBadCodePoint ? GB_CONTROL : GraphemeBreakOf(cp); }
+static GraphemeBreak ReadBackward(PieceIterator& it) { uint32_t cp = ReadCodePointBackward(it); return cp == kBadCodePoint ? GB_CONTROL : GraphemeBreakOf(cp); }
+// a と b の間で区切るか (GB3〜GB9b, GB999)。GB11 と GB12/13 は前の文脈が要るので呼び出し側で見る
+static bool BreaksBetween(GraphemeBreak a, GraphemeBreak b) {
+    if (a == GB_CR && b == GB_LF) return false;
+    if (a == GB_CR || a == GB_LF || a == GB_CONTROL || b == GB_CR || b == GB_LF || b == GB_CONTROL) return true;
+    if (a == GB_L && (b == GB_L || b == GB_V || b == GB_LV || b == GB_LVT)) return false;
+    if ((a == GB_LV || a == GB_V) && (b == GB_V || b == GB_T)) return false;
+    if ((a == GB_LVT || a == GB_T) && b == GB_T) return false;
+    if (b == GB_EXTEND || b == GB_ZWJ || b == GB_SPACING_MARK || a == GB_PREPEND) return false;
+    return true;
+}
+bool IsGraphemeBoundary(const PieceIterator& it, size_t len) {
+    size_t pos = it.position();
+    if (pos == 0 || pos >= len) return true;
+    PieceIterator before = it; --before;
+    unsigned char cb = (unsigned char)*before, ca = (unsigned char)*it;
+    // ASCII どうしは \r\n の間だけがつながる
+    if (cb < 0x80 && ca < 0x80) return !(cb == '\r' && ca == '\n');
+    // UTF-8 の 1 文字の途中は境目ではない
+    if ((ca & 0xC0) == 0x80) {
+        PieceIterator lead = it;
+        for (int k = 0; k < 3 && lead.position() > 0 && ((unsigned char)*lead & 0xC0) == 0x80; ++k) --lead;
+        ReadForward(lead, len);
+        if (lead.position() > pos) return false;
+    }
+    PieceIterator after = it;
+    GraphemeBreak b = ReadForward(after, len);
+    PieceIterator back = it;
+    GraphemeBreak a = ReadBackward(back);
+    if (!BreaksBetween(a, b)) return false;
+    // GB11: 絵文字 Extend* ZWJ × 絵文字
+    if (a == GB_ZWJ && b == GB_PICTOGRAPHIC) {
+        GraphemeBreak p = GB_OTHER;
+        while (back.position() > 0 && (p = ReadBackward(back)) == GB_EXTEND) {}
+        return p != GB_PICTOGRAPHIC;
+    }
+    // GB12/13: 地域指示子は前から 2 つずつ組にする。直前に続く個数が奇数ならつながる
+    if (a == GB_REGIONAL && b == GB_REGIONAL) {
+        size_t count = 1;
+        while (back.position() > 0) { PieceIterator p = back; if (ReadBackward(p) != GB_REGIONAL) break; back = p; count++; }
+        return count % 2 == 0;
+    }
+    return true;
+}
+size_t NextGraphemeBoundary(const PieceTable& pt, size_t pos) {
+    size_t len = pt.length();
+    if (pos >= len) return len;
+    PieceIterator it(pt, pos);
+    do ReadForward(it, len); while (it.position() < len && !IsGraphemeBoundary(it, len));
+    return it.position();
+}
+size_t PrevGraphemeBoundary(const PieceTable& pt, size_t pos) {
+    if (pos == 0) return 0;
+    size_t len = pt.length();
+    PieceIterator it(pt, std::min(pos, len));
+    do ReadBackward(it); while (it.position() > 0 && !IsGraphemeBoundary(it, len));
+    return it.position();
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "PieceTable.h"
+// UAX #29 の拡張書記素クラスタ (ユーザーが 1 文字と見なす単位) の境目。表示のレイアウトは使わない
+// 不正な UTF-8 のバイトは 1 バイトずつ独立した区切りにする。\r\n は 1 つのクラスタ
+enum GraphemeBreak { GB_OTHER, GB_CR, GB_LF, GB_CONTROL, GB_EXTEND, GB_ZWJ, GB_REGIONAL, GB_PREPEND, GB_SPACING_MARK, GB_L, GB_V, GB_T, GB_LV, GB_LVT, GB_PICTOGRAPHIC };
+GraphemeBreak GraphemeBreakOf(uint32_t cp);
+// it から UTF-8 の 1 文字を読んで次の文字へ進める。不正なバイトは 1 バイトだけ進めて kBadCodePoint を返す
+const uint32_t kBadCodePoint = 0xFFFFFFFF;
+uint32_t ReadCodePoint(PieceIterator& it, size_t len);
+// it の直前の 1 文字を読み、その先頭へ戻す
+uint32_t ReadCodePointBackward(PieceIterator& it);
+// it の位置 (文書長 len) がクラスタの境目か。前後の ASCII だけで決まるときは表を引かない
+bool IsGraphemeBoundary(const PieceIterator& it, size_t len);
+// pos より後ろ・前で最も近いクラスタの境目。pos が文書の端ならそのまま
+size_t NextGraphemeBoundary(const PieceTable& pt, size_t pos);
+size_t PrevGraphemeBoundary(const PieceTable& pt, size_t pos);
@@ -0,0 +1,72 @@
+#include "LineFilter.h"
+#include <algorithm>
+#include <atomic>
+#include "LineIndex.h"
+#include "Search.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+// これより小さい文書は 1 区間で調べる
+static const size_t kFilterChunk = (size_t)4 << 20;
+// 検索語が何行にわたりうるか。改行そのものと、正規表現の \n・\r を数える (\r\n や \r\\n は 1 つ)
+static size_t QueryLineBreaks(const std::string& q) {
+    size_t n = 0;
+    for (size_t i = 0; i < q.size(); ++i) {
+        if (q[i] == '\n') n++;
+        else if (q[i] == '\r') { n++; if (i + 1 < q.size() && q[i + 1] == '\n') i++; }
+        else if (q[i] == '\\' && i + 1 < q.size()) {
+            if (q[i + 1] == 'n') n++;
+            else if (q[i + 1] == 'r') { n++; if (q.compare(i + 2, 2, "\\n") == 0) i += 2; }
+            i++;
+        }
+    }
+    return n;
+}
+// 行 [first, last) のうち一致を含む行の番号を out に足す。1 行に 1 つ見つかれば次の行頭から探す
+static bool ScanLines(const LineFilter& f, const PieceTable& pt, const std::vector<size_t>& lineStarts, size_t first, size_t last, std::vector<size_t>& out) {
+    if (first >= last) return true;
+    size_t docLen = pt.length();
+    auto startOf = [&](size_t line) { return (line < lineStarts.size()) ? lineStarts[line] : docLen; };
+    size_t line = first;
+    return ForEachMatch(pt, startOf(first), startOf(last), f.query, f.matchCase, f.wholeWord, f.isRegex, [&](size_t pos, size_t) {
+        while (line + 1 < last && lineStarts[line + 1] <= pos) line++;
+        out.push_back(line);
+        return startOf(line + 1);
+    }, startOf(last + QueryLineBreaks(f.query)));
+}
+bool LineFilter::build(const PieceTable& pt, const std::vector<size_t>& lineStarts) {
+    TRACE_SCOPE("lineFilterBuild");
+    lines.clear();
+    if (query.empty() || lineStarts.empty()) return !query.empty();
+    // 区間の境目はおよそ kFilterChunk バイトおきの行頭
+    std::vector<size_t> bounds(1, 0);
+    size_t docLen = pt.length();
+    for (size_t b = kFilterChunk; b < docLen; b += kFilterChunk) {
+        size_t line = (size_t)FindLineIndex(lineStarts, b) + 1;
+        if (line >= lineStarts.size()) break;
+        if (line > bounds.back()) bounds.push_back(line);
+    }
+    bounds.push_back(lineStarts.size());
+    std::vector<std::vector<size_t>> parts(bounds.size() - 1);
+    std::atomic<bool> ok{ true };
+    ParallelFor(SharedThreadPool(), parts.size(), [&](size_t i) {
+        if (!ScanLines(*this, pt, lineStarts, bounds[i], bounds[i + 1], parts[i])) ok.store(false, std::memory_order_relaxed);
+    });
+    if (!ok.load()) return false;
+    size_t n = 0; for (const auto& p : parts) n += p.size();
+    lines.reserve(n);
+    for (const auto& p : parts) lines.insert(lines.end(), p.begin(), p.end());
+    return true;
+}
+void LineFilter::update(const PieceTable& pt, const std::vector<size_t>& lineStarts, size_t firstLine, size_t oldEnd, size_t newEnd) {
+    TRACE_SCOPE("lineFilterUpdate");
+    // \r と \n の間で分かれた改行を編集したときは、直前の行の終わり方も変わる
+    size_t back = QueryLineBreaks(query) + 1;
+    firstLine = (firstLine > back) ? firstLine - back : 0;
+    std::vector<size_t> found;
+    ScanLines(*this, pt, lineStarts, firstLine, std::min(newEnd, lineStarts.size()), found);
+    size_t lo = rowOf(firstLine), hi = rowOf(oldEnd);
+    for (size_t r = hi; r < lines.size(); ++r) lines[r] = lines[r] + newEnd - oldEnd;
+    lines.erase(lines.begin() + lo, lines.begin() + hi);
+    lines.insert(lines.begin() + lo, found.begin(), found.end());
+}
+size_t LineFilter::rowOf(size_t line) const { return std::lower_bound(lines.begin(), lines.end(), line) - lines.begin(); }
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "PieceTable.h"
+// 検索語に一致する行だけを表示するための射影。文書は変えず、一致する行の番号を昇順で持つ
+// 表示上の何番目か (row) から文書の行 (line) へは lines[row]、逆は二分探索
+struct LineFilter {
+    bool active = false;
+    std::string query; bool matchCase = false, wholeWord = false, isRegex = false;
+    std::vector<size_t> lines;
+    // 文書全体を調べ直す。大きな文書は行境界で区間に分けて共有プールで並列に探す。正規表現が不正なら false
+    // 一致は始まった行のものとし、検索語に含まれる改行 (\n, \r) の数だけ後ろの行まで延びるものを拾う
+    bool build(const PieceTable& pt, const std::vector<size_t>& lineStarts);
+    // 編集で行 [firstLine, oldEnd) が [firstLine, newEnd) に置き換わったときに呼ぶ (lineStarts は編集後)
+    // その行と、一致がそこまで延びうる手前の行だけ調べ直し、後ろの行番号は行数の増減分ずらす
+    void update(const PieceTable& pt, const std::vector<size_t>& lineStarts, size_t firstLine, size_t oldEnd, size_t newEnd);
+    // line 以降で最初に表示される行の row (なければ lines.size())
+    size_t rowOf(size_t line) const;
+    bool contains(size_t line) const { size_t r = rowOf(line); return r < lines.size() && lines[r] == line; }
+};
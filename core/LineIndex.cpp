@@ -0,0 +1,150 @@
+#include "LineIndex.h"
+#include <algorithm>
+#include "ThreadPool.h"
+// 大きな文書は区間に分けて共有プールで走査する。区間の境目では \r\n を割らない
+static const size_t kParallelLineScan = (size_t)8 << 20;
+static const size_t kLineScanChunk = (size_t)2 << 20;
+struct LineScanSegment { const char* data; size_t len; size_t offset; std::vector<size_t> starts; NewlineCounts counts; };
+static void ScanSegment(LineScanSegment& seg) {
+    const char* ptr = seg.data; const char* end = seg.data + seg.len;
+    seg.starts.reserve(seg.len / 40 + 1);
+    while (ptr < end) {
+        char c = *ptr;
+        if (c == '\n') { seg.starts.push_back(seg.offset + (ptr - seg.data) + 1); seg.counts.lf++; ptr++; }
+        else if (c == '\r') {
+            size_t step = (ptr + 1 < end && *(ptr + 1) == '\n') ? 2 : 1;
+            if (step == 2) seg.counts.crlf++; else seg.counts.cr++;
+            seg.starts.push_back(seg.offset + (ptr - seg.data) + step); ptr += step;
+        }
+        else ptr++;
+    }
+}
+static size_t BuildLineStartsParallel(const PieceTable& pt, size_t totalLen, std::vector<size_t>& lineStarts, NewlineCounts& counts) {
+    std::vector<LineScanSegment> segs;
+    size_t globalOffset = 0;
+    for (const auto& p : pt.pieces) {
+        const char* buf = pt.pieceData(p);
+        size_t off = 0;
+        while (off < p.len) {
+            size_t n = std::min(kLineScanChunk, p.len - off);
+            if (off + n < p.len && buf[off + n - 1] == '\r' && buf[off + n] == '\n') n++;
+            segs.push_back({ buf + off, n, globalOffset + off, {}, {} });
+            off += n;
+        }
+        globalOffset += p.len;
+    }
+    ParallelFor(SharedThreadPool(), segs.size(), [&](size_t i) { ScanSegment(segs[i]); });
+    // ピースの境目で分かれた \r\n は 1 つの改行
+    for (size_t i = 0; i + 1 < segs.size(); ++i)
+        if (segs[i].len && segs[i].data[segs[i].len - 1] == '\r' && segs[i + 1].len && segs[i + 1].data[0] == '\n') { segs[i].starts.pop_back(); segs[i].counts.cr--; segs[i + 1].counts.lf--; segs[i].counts.crlf++; }
+    size_t count = 1;
+    counts = NewlineCounts();
+    for (const auto& seg : segs) { count += seg.starts.size(); counts.crlf += seg.counts.crlf; counts.lf += seg.counts.lf; counts.cr += seg.counts.cr; }
+    lineStarts.clear();
+    lineStarts.reserve(count);
+    lineStarts.push_back(0);
+    for (const auto& seg : segs) lineStarts.insert(lineStarts.end(), seg.starts.begin(), seg.starts.end());
+    size_t maxBytes = 0;
+    for (size_t i = 1; i < lineStarts.size(); ++i) maxBytes = std::max(maxBytes, lineStarts[i] - lineStarts[i - 1]);
+    if (lineStarts.back() < totalLen) maxBytes = std::max(maxBytes, totalLen - lineStarts.back());
+    return maxBytes;
+}
+size_t BuildLineStarts(const PieceTable& pt, std::vector<size_t>& lineStarts, NewlineCounts* counts) {
+    size_t totalLen = pt.length();
+    NewlineCounts n;
+    if (totalLen >= kParallelLineScan && std::thread::hardware_concurrency() > 1) { size_t maxBytes = BuildLineStartsParallel(pt, totalLen, lineStarts, n); if (counts) *counts = n; return maxBytes; }
+    lineStarts.clear();
+    if (totalLen > 0) lineStarts.reserve(totalLen / 40 + 1);
+    lineStarts.push_back(0);
+    size_t globalOffset = 0;
+    size_t maxBytes = 0;
+    bool prevEndsWithCR = false;
+    for (const auto& p : pt.pieces) {
+        const char* buf = pt.pieceData(p);
+        const char* ptr = buf;
+        const char* end = buf + p.len;
+        while (ptr < end) {
+            char c = *ptr;
+            if (c == '\n') {
+                size_t offsetInPiece = ptr - buf;
+                // 前のピースの末尾の \r と合わせて 1 つの改行 (\r\n) にする
+                if (offsetInPiece == 0 && prevEndsWithCR) {
+                    lineStarts.back()++; n.cr--; n.crlf++;
+                    size_t prevLen = lineStarts.back() - (lineStarts.size() >= 2 ? lineStarts[lineStarts.size() - 2] : 0);
+                    if (prevLen > maxBytes) maxBytes = prevLen;
+                    ptr++;
+                    continue;
+                }
+                n.lf++;
+                size_t nextLineStart = globalOffset + offsetInPiece + 1;
+                size_t currentLineLen = nextLineStart - lineStarts.back();
+                if (currentLineLen > maxBytes) maxBytes = currentLineLen;
+                lineStarts.push_back(nextLineStart);
+                ptr++;
+            }
+            else if (c == '\r') {
+                size_t offsetInPiece = ptr - buf;
+                size_t step = 1;
+                if (ptr + 1 < end && *(ptr + 1) == '\n') {
+                    step = 2;
+                }
+                if (step == 2) n.crlf++; else n.cr++;
+                size_t nextLineStart = globalOffset + offsetInPiece + step;
+                size_t currentLineLen = nextLineStart - lineStarts.back();
+                if (currentLineLen > maxBytes) maxBytes = currentLineLen;
+                lineStarts.push_back(nextLineStart);
+                ptr += step;
+            }
+            else {
+                ptr++;
+            }
+        }
+        if (p.len > 0) prevEndsWithCR = (buf[p.len - 1] == '\r');
+        globalOffset += p.len;
+    }
+    size_t lastStart = lineStarts.back();
+    if (lastStart < totalLen) {
+        size_t lastLineLen = totalLen - lastStart;
+        if (lastLineLen > maxBytes) maxBytes = lastLineLen;
+    }
+    if (counts) *counts = n;
+    return maxBytes;
+}
+NewlineCounts CountLineEnds(const PieceTable& pt, const std::vector<size_t>& lineStarts) {
+    NewlineCounts n;
+    // 読む位置は増える一方なので、ピースを前から 1 回たどるだけで済む
+    size_t idx = 0, pieceStart = 0;
+    auto byteAt = [&](size_t pos) {
+        while (idx < pt.pieces.size() && pieceStart + pt.pieces[idx].len <= pos) pieceStart += pt.pieces[idx++].len;
+        return idx < pt.pieces.size() ? pt.pieceData(pt.pieces[idx])[pos - pieceStart] : '\0';
+    };
+    for (size_t i = 1; i < lineStarts.size(); ++i) {
+        size_t s = lineStarts[i];
+        char before = s >= 2 ? byteAt(s - 2) : '\0';
+        char last = byteAt(s - 1);
+        if (last == '\r') n.cr++; else if (before == '\r') n.crlf++; else n.lf++;
+    }
+    return n;
+}
+std::string NewlineCounts::dominant(const std::string& fallback) const {
+    if (total() == 0) return fallback;
+    if (crlf >= lf && crlf >= cr) return "\r\n";
+    return lf >= cr ? "\n" : "\r";
+}
+std::string NewlineCounts::describe() const {
+    const struct { const char* name; size_t count; } kinds[] = { { "CRLF", crlf }, { "LF", lf }, { "CR", cr } };
+    int used = 0; for (const auto& k : kinds) if (k.count) used++;
+    std::string out;
+    for (const auto& k : kinds) {
+        if (!k.count) continue;
+        if (!out.empty()) out += ", ";
+        out += k.name;
+        if (used > 1) out += " " + std::to_string(k.count);
+    }
+    return out;
+}
+int FindLineIndex(const std::vector<size_t>& lineStarts, size_t pos) {
+    if (lineStarts.empty()) return 0;
+    auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), pos); int idx = (int)std::distance(lineStarts.begin(), it) - 1;
+    if (idx < 0) idx = 0; if (idx >= (int)lineStarts.size()) idx = (int)lineStarts.size() - 1; return idx;
+}
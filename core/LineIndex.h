@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "PieceTable.h"
+// 文書中の改行の種類ごとの数
+struct NewlineCounts {
+    size_t crlf = 0, lf = 0, cr = 0;
+    size_t total() const { return crlf + lf + cr; }
+    // いちばん多い改行 (同数なら CRLF, LF, CR の順)。改行がなければ fallback
+    std::string dominant(const std::string& fallback = "\r\n") const;
+    // 1 種類なら "CRLF" のように名前だけ、混ざっていれば "CRLF 120, LF 3" のように数も付ける。改行がなければ空
+    std::string describe() const;
+};
+// 行頭の一覧を作り直し、最も長い行のバイト数を返す。counts があれば同じ走査で改行の種類も数える
+size_t BuildLineStarts(const PieceTable& pt, std::vector<size_t>& lineStarts, NewlineCounts* counts = nullptr);
+// 出来ている行頭の一覧から、各行頭の直前のバイトを見て改行の種類を数える (文書全体は読まない)
+NewlineCounts CountLineEnds(const PieceTable& pt, const std::vector<size_t>& lineStarts);
+int FindLineIndex(const std::vector<size_t>& lineStarts, size_t pos);
@@ -0,0 +1,180 @@
+#include "LineOps.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include "ThreadPool.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIU_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+size_t JoinLines(const std::vector<std::string_view>& lines, bool trailingNewline, char* out) {
+    std::string_view lastBreak = lines.empty() ? std::string_view() : lines.back().substr(LineContent(lines.back()).size());
+    size_t n = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string_view content = LineContent(lines[i]), lineBreak = lines[i].substr(content.size());
+        if (!trailingNewline) lineBreak = (i + 1 == lines.size()) ? std::string_view() : lineBreak.empty() ? lastBreak : lineBreak;
+        if (out) { memcpy(out + n, content.data(), content.size()); memcpy(out + n + content.size(), lineBreak.data(), lineBreak.size()); }
+        n += content.size() + lineBreak.size();
+    }
+    return n;
+}
+static double LeadingNumber(std::string_view s) {
+    size_t i = 0; while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) i++;
+    bool neg = false; if (i < s.size() && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+    double v = 0.0; while (i < s.size() && s[i] >= '0' && s[i] <= '9') v = v * 10.0 + (s[i++] - '0');
+    if (i < s.size() && s[i] == '.') { double scale = 0.1; for (++i; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i, scale *= 0.1) v += (s[i] - '0') * scale; }
+    return neg ? -v : v;
+}
+static bool LessIgnoreCase(std::string_view a, std::string_view b) {
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char x = (unsigned char)a[i], y = (unsigned char)b[i];
+        if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+        if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+        if (x != y) return x < y;
+    }
+    return a.size() < b.size();
+}
+// 区間ごとに stable_sort してから、隣り合う区間を並列にマージしていく
+template <class Less>
+static void ParallelStableSort(std::vector<std::string_view>& v, Less less) {
+    const size_t kMinPart = (size_t)1 << 15;
+    ThreadPool& pool = SharedThreadPool();
+    size_t parts = std::min<size_t>(pool.threadCount() + 1, v.size() / kMinPart);
+    if (parts < 2) { std::stable_sort(v.begin(), v.end(), less); return; }
+    std::vector<size_t> bounds(parts + 1);
+    for (size_t i = 0; i <= parts; ++i) bounds[i] = v.size() * i / parts;
+    ParallelFor(pool, parts, [&](size_t i) { std::stable_sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], less); });
+    std::vector<std::string_view> tmp(v.size());
+    std::vector<std::string_view>* src = &v; std::vector<std::string_view>* dst = &tmp;
+    while (bounds.size() > 2) {
+        size_t runs = bounds.size() - 1;
+        ParallelFor(pool, (runs + 1) / 2, [&](size_t k) {
+            size_t a = bounds[2 * k], m = bounds[2 * k + 1], b = (2 * k + 2 < bounds.size()) ? bounds[2 * k + 2] : m;
+            std::merge(src->begin() + a, src->begin() + m, src->begin() + m, src->begin() + b, dst->begin() + a, less);
+        });
+        std::vector<size_t> next;
+        for (size_t i = 0; i < bounds.size(); i += 2) next.push_back(bounds[i]);
+        if (next.back() != v.size()) next.push_back(v.size());
+        bounds.swap(next); std::swap(src, dst);
+    }
+    if (src != &v) v.swap(tmp);
+}
+// 開番地法のハッシュ表に残した行の番号 + 1 を入れながら前に詰める。ノードを確保しないので数千万行でも速い
+static void UniqueLines(std::vector<std::string_view>& lines) {
+    size_t cap = 16; while (cap < lines.size() * 2) cap <<= 1;
+    std::vector<size_t> table(cap, 0);
+    std::hash<std::string_view> hash;
+    size_t kept = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::string_view l = LineContent(lines[i]);
+        size_t slot = hash(l) & (cap - 1); bool dup = false;
+        while (table[slot]) { if (LineContent(lines[table[slot] - 1]) == l) { dup = true; break; } slot = (slot + 1) & (cap - 1); }
+        if (dup) continue;
+        lines[kept] = lines[i]; table[slot] = ++kept;
+    }
+    lines.resize(kept);
+}
+void RearrangeLines(std::vector<std::string_view>& lines, LineOperation op, uint64_t seed) {
+    switch (op) {
+    case LINES_SORT: ParallelStableSort(lines, [](std::string_view a, std::string_view b) { return LineContent(a) < LineContent(b); }); break;
+    case LINES_SORT_ICASE: ParallelStableSort(lines, [](std::string_view a, std::string_view b) { return LessIgnoreCase(LineContent(a), LineContent(b)); }); break;
+    case LINES_SORT_NUMERIC: ParallelStableSort(lines, [](std::string_view a, std::string_view b) { return LeadingNumber(LineContent(a)) < LeadingNumber(LineContent(b)); }); break;
+    case LINES_UNIQUE: UniqueLines(lines); break;
+    case LINES_REVERSE: std::reverse(lines.begin(), lines.end()); break;
+    case LINES_SHUFFLE: { std::mt19937_64 rng(seed); std::shuffle(lines.begin(), lines.end(), rng); break; }
+    }
+}
+// 次の \r か \n (なければ end)。SSE2 があれば 16 バイトずつ比べる
+static const char* FindLineBreak(const char* p, const char* end) {
+#ifdef MIU_SSE2
+    const __m128i cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        if (!m) continue;
+#ifdef _MSC_VER
+        unsigned long i; _BitScanForward(&i, m); return p + i;
+#else
+        return p + __builtin_ctz(m);
+#endif
+    }
+#endif
+    while (p < end && *p != '\r' && *p != '\n') p++;
+    return p;
+}
+void LineSplitter::feed(std::string_view chunk) {
+    const char* p = chunk.data(); const char* end = p + chunk.size();
+    // 前の断片から続く行。\r で終わっていれば、この断片の先頭の \n までがその改行
+    if (!partial.empty()) {
+        if (partial.back() == '\r') { if (p < end && *p == '\n') partial += *p++; emitPartial(); }
+        else {
+            const char* eol = FindLineBreak(p, end);
+            if (eol == end || (eol + 1 == end && *eol == '\r')) { partial.append(p, end - p); return; }
+            const char* next = eol + ((*eol == '\r' && eol[1] == '\n') ? 2 : 1);
+            partial.append(p, next - p); emitPartial(); p = next;
+        }
+    }
+    while (p < end) {
+        const char* eol = FindLineBreak(p, end);
+        // 改行がないか断片の最後の \r で終わる行は、次の断片とつなぐために写しておく
+        if (eol == end || (eol + 1 == end && *eol == '\r')) { partial.assign(p, end - p); return; }
+        const char* next = eol + ((*eol == '\r' && eol[1] == '\n') ? 2 : 1);
+        lines.emplace_back(p, next - p); p = next;
+    }
+}
+// [p, eol) の 1 行 (改行を除く) を op で書き換えて out の後ろに足す。書き換わったら true
+static bool TransformLine(const char* p, const char* eol, WhitespaceOperation op, int tabColumns, std::string& out) {
+    bool lineChanged = false;
+    if (op == WS_TRIM_TRAILING) {
+        const char* e = eol; while (e > p && (e[-1] == ' ' || e[-1] == '\t')) e--;
+        lineChanged = e != eol; out.append(p, e - p);
+    }
+    else if (op == WS_TABS_TO_SPACES) {
+        size_t col = 0;
+        for (const char* q = p; q < eol;) {
+            const char* tab = (const char*)memchr(q, '\t', eol - q); if (!tab) tab = eol;
+            for (const char* c = q; c < tab; ++c) if (((unsigned char)*c & 0xC0) != 0x80) col++;
+            out.append(q, tab - q);
+            if (tab == eol) break;
+            size_t n = tabColumns - col % tabColumns; out.append(n, ' '); col += n;
+            lineChanged = true; q = tab + 1;
+        }
+    }
+    else {
+        size_t col = 0; const char* q = p;
+        for (; q < eol && (*q == ' ' || *q == '\t'); ++q) col = (*q == '\t') ? (col / tabColumns + 1) * tabColumns : col + 1;
+        size_t before = out.size();
+        out.append(col / tabColumns, '\t'); out.append(col % tabColumns, ' ');
+        lineChanged = std::string_view(out.data() + before, out.size() - before) != std::string_view(p, q - p);
+        out.append(q, eol - q);
+    }
+    return lineChanged;
+}
+static const char* NextLine(const char* eol, const char* end) { return eol < end ? eol + ((*eol == '\r' && eol + 1 < end && eol[1] == '\n') ? 2 : 1) : eol; }
+size_t TransformWhitespace(std::string_view text, WhitespaceOperation op, int tabColumns, std::string& out, size_t& from, size_t& to) {
+    const char* begin = text.data(); const char* end = begin + text.size();
+    size_t changed = 0;
+    // 1 回目は書き換わる行を数えて、最初の行頭と最後の行末を求めるだけ (行ごとの結果は捨てる)
+    std::string line;
+    for (const char* p = begin; p < end;) {
+        const char* eol = FindLineBreak(p, end);
+        line.clear();
+        if (TransformLine(p, eol, op, tabColumns, line)) { if (changed++ == 0) from = p - begin; to = eol - begin; }
+        p = NextLine(eol, end);
+    }
+    if (changed == 0) return 0;
+    // 2 回目はその範囲だけを書く。範囲の最後の行の改行は範囲に含めない
+    out.clear(); out.reserve(to - from);
+    for (const char* p = begin + from; p < begin + to;) {
+        const char* eol = FindLineBreak(p, end);
+        TransformLine(p, eol, op, tabColumns, out);
+        const char* next = NextLine(eol, end);
+        if (eol < begin + to) out.append(eol, next - eol);
+        p = next;
+    }
+    return changed;
+}
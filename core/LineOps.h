@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+// 行の並べ替え・重複削除など、行のまとまりを丸ごと組み替える操作。行は末尾の改行 (\r\n / \n / \r) ごと string_view で扱い、比べるときだけ改行を除く
+enum LineOperation { LINES_SORT, LINES_SORT_ICASE, LINES_SORT_NUMERIC, LINES_UNIQUE, LINES_REVERSE, LINES_SHUFFLE };
+inline std::string_view LineContent(std::string_view line) {
+    size_t n = line.size();
+    if (n && line[n - 1] == '\n') n--;
+    if (n && line[n - 1] == '\r') n--;
+    return line.substr(0, n);
+}
+// 続けて渡される断片 (ピースごとの文字列) を行に分けて lines に足す。行は断片の中を指し、断片をまたぐ行だけをコピーして持つ
+// 断片は行を使い終わるまで動かないこと
+struct LineSplitter {
+    std::vector<std::string_view>& lines;
+    explicit LineSplitter(std::vector<std::string_view>& out) : lines(out) {}
+    void feed(std::string_view chunk);
+    void finish() { if (!partial.empty()) emitPartial(); }
+private:
+    std::deque<std::string> copies; std::string partial;
+    void emitPartial() { copies.push_back(std::move(partial)); partial.clear(); lines.push_back(copies.back()); }
+};
+// lines をつないで out に書き、長さを返す (out が nullptr なら長さだけ)。各行は自分の改行のまま写す
+// trailingNewline でなければ (元の最後の行に改行がなかったなら)、最後になった行の改行を改行のない行へ移して文書の終わり方を保つ
+size_t JoinLines(const std::vector<std::string_view>& lines, bool trailingNewline, char* out);
+// 並べ替えは安定 (同じ順位の行は元の順)。大きいときは共有スレッドプールで並列にマージソートする
+// 数値順は行頭の数値 (空白・符号・小数点を含む) で比べ、数値のない行は 0 とみなす。大文字小文字の無視は ASCII のみ
+// LINES_UNIQUE は最初に出てきた行だけを残し、LINES_SHUFFLE は seed で決まる順に混ぜる
+void RearrangeLines(std::vector<std::string_view>& lines, LineOperation op, uint64_t seed = 0);
+// 行ごとの空白の書き換え。改行はそのまま残す
+// WS_TRIM_TRAILING は行末の空白とタブを消し、WS_TABS_TO_SPACES はすべてのタブを次のタブ位置までの空白にする
+// WS_SPACES_TO_TABS は行頭の空白とタブを、見た目の幅が同じになるタブ (端数は空白) に置き換える
+enum WhitespaceOperation { WS_TRIM_TRAILING, WS_TABS_TO_SPACES, WS_SPACES_TO_TABS };
+// text を op で書き換え、書き換えた行の数を返す。桁は UTF-8 の文字単位で数える
+// 書き換わる最初の行の先頭から最後の行の末尾 (改行の手前) までを text 上の [from, to) とし、その範囲を書き換えた結果だけを out に入れる (0 なら out と from・to は使わない)
+size_t TransformWhitespace(std::string_view text, WhitespaceOperation op, int tabColumns, std::string& out, size_t& from, size_t& to);
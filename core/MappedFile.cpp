@@ -0,0 +1,77 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+bool MappedFile::open(const wchar_t* path) {
+    hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER li; if (!GetFileSizeEx(hFile, &li)) return false; size = (size_t)li.QuadPart;
+    if (size == 0) { ptr = nullptr; return true; }
+    hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMap) return false; ptr = (const char*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0); return !!ptr;
+}
+void MappedFile::close() { if (ptr) { UnmapViewOfFile(ptr); ptr = nullptr; } if (hMap) { CloseHandle(hMap); hMap = NULL; } if (hFile != INVALID_HANDLE_VALUE) { CloseHandle(hFile); hFile = INVALID_HANDLE_VALUE; } }
+bool SpillFile::open() {
+    WCHAR dir[MAX_PATH], path[MAX_PATH];
+    DWORD n = GetTempPathW(MAX_PATH, dir);
+    if (n == 0 || n >= MAX_PATH || !GetTempFileNameW(dir, L"miu", 0, path)) return false;
+    hFile = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    return hFile != INVALID_HANDLE_VALUE;
+}
+char* SpillFile::grow(size_t bytes) {
+    if (hFile == INVALID_HANDLE_VALUE && !open()) return nullptr;
+    size_t n = (bytes + kGranularity - 1) / kGranularity * kGranularity; unsigned long long end = (unsigned long long)size + n;
+    // マッピングオブジェクトは作成時のサイズより伸ばせないので、伸ばすたびに作り直してその区間だけをマップする
+    HANDLE h = CreateFileMappingW(hFile, NULL, PAGE_READWRITE, (DWORD)(end >> 32), (DWORD)end, NULL);
+    if (!h) return nullptr;
+    char* p = (char*)MapViewOfFile(h, FILE_MAP_WRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, n);
+    if (!p) { CloseHandle(h); return nullptr; }
+    views.push_back({ h, p, n }); size += n;
+    return p;
+}
+void SpillFile::close() {
+    for (auto& v : views) { UnmapViewOfFile(v.ptr); CloseHandle(v.hMap); }
+    views.clear(); size = 0;
+    if (hFile != INVALID_HANDLE_VALUE) { CloseHandle(hFile); hFile = INVALID_HANDLE_VALUE; }
+}
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+bool MappedFile::open(const char* path) {
+    fd = ::open(path, O_RDONLY); if (fd == -1) return false;
+    struct stat sb; if (fstat(fd, &sb) == -1) { ::close(fd); fd = -1; return false; }
+    size = (size_t)sb.st_size; if (size == 0) { ptr = nullptr; return true; }
+    void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) { ptr = nullptr; return false; }
+    ptr = (const char*)p; return true;
+}
+void MappedFile::close() { if (ptr) { munmap((void*)ptr, size); ptr = nullptr; } if (fd != -1) { ::close(fd); fd = -1; } }
+bool SpillFile::open() {
+    const char* dir = getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/tmp") + "/miu-spill-XXXXXX";
+    fd = mkstemp(&path[0]); if (fd == -1) return false;
+    unlink(path.c_str());
+    return true;
+}
+char* SpillFile::grow(size_t bytes) {
+    if (fd == -1 && !open()) return nullptr;
+    size_t n = (bytes + kGranularity - 1) / kGranularity * kGranularity;
+    // ftruncate だけだと疎なファイルになり、ディスクが一杯のとき書き込みで SIGBUS になる。先に領域を確保する
+#ifdef __linux__
+    if (posix_fallocate(fd, (off_t)size, (off_t)n) != 0) return nullptr;
+#else
+    if (ftruncate(fd, (off_t)(size + n)) != 0) return nullptr;
+#endif
+    void* p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)size);
+    if (p == MAP_FAILED) return nullptr;
+    views.push_back({ (char*)p, n }); size += n;
+    return (char*)p;
+}
+void SpillFile::close() {
+    for (auto& v : views) munmap(v.ptr, v.size);
+    views.clear(); size = 0;
+    if (fd != -1) { ::close(fd); fd = -1; }
+}
+#endif
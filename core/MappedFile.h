@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+struct MappedFile {
+#ifdef _WIN32
+    HANDLE hFile = INVALID_HANDLE_VALUE; HANDLE hMap = NULL;
+#else
+    int fd = -1;
+#endif
+    const char* ptr = nullptr; size_t size = 0;
+#ifdef _WIN32
+    bool open(const wchar_t* path);
+#else
+    bool open(const char* path);
+#endif
+    void close();
+    ~MappedFile() { close(); }
+};
+// 一時ファイルを必要な分だけ伸ばして書き込み可能でマップする。ファイルは閉じると消える (作成直後に削除済み)
+// grow が返す領域は close まで動かない。一時ファイルが作れない場合は nullptr
+struct SpillFile {
+#ifdef _WIN32
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    struct View { HANDLE hMap; char* ptr; size_t size; };
+#else
+    int fd = -1;
+    struct View { char* ptr; size_t size; };
+#endif
+    std::vector<View> views; size_t size = 0;
+    // マップの開始位置はこの単位 (Windows の割り当て粒度) に揃える
+    static constexpr size_t kGranularity = (size_t)64 << 10;
+    char* grow(size_t bytes);
+    void close();
+    ~SpillFile() { close(); }
+private:
+    bool open();
+};
@@ -0,0 +1,30 @@
+#include "MemoryStats.h"
+#include <algorithm>
+#include <cstdio>
+#define MEMORY_STATS_FIELDS(X) X(mappedOriginal) X(convertedBuffer) X(addBuffer) X(addSpilled) X(pieceList) X(lineStarts) X(lineFilter) X(bracketIndex) X(syntaxStates) X(undoText) X(undoCursors) X(redoText) X(redoCursors) X(pendingPadding) X(renderCaches)
+void MemoryStats::takeMax(const MemoryStats& o) {
+#define TAKE_MAX(f) f = std::max(f, o.f);
+    MEMORY_STATS_FIELDS(TAKE_MAX)
+#undef TAKE_MAX
+}
+static void AppendRow(std::string& out, const char* name, size_t cur, size_t peak) {
+    char b[128]; snprintf(b, sizeof(b), "%-16s %12.2f MB %12.2f MB\n", name, cur / 1048576.0, peak / 1048576.0);
+    out += b;
+}
+std::string FormatMemoryStats(const MemoryStats& current, const MemoryStats& peak, size_t peakPrivateTotal) {
+    std::string out;
+    char b[128]; snprintf(b, sizeof(b), "%-16s %15s %15s\n", "", "current", "peak"); out += b;
+#define ROW(f) AppendRow(out, #f, current.f, peak.f);
+    MEMORY_STATS_FIELDS(ROW)
+#undef ROW
+    AppendRow(out, "privateTotal", current.privateTotal(), peakPrivateTotal);
+    return out;
+}
+std::string MemoryStatsJson(const MemoryStats& s) {
+    std::string out = "{";
+#define FIELD(f) out += "\"" #f "\": " + std::to_string(s.f) + ", ";
+    MEMORY_STATS_FIELDS(FIELD)
+#undef FIELD
+    out += "\"privateTotal\": " + std::to_string(s.privateTotal()) + "}";
+    return out;
+}
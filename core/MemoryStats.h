@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+struct MemoryStats {
+    size_t mappedOriginal = 0; size_t convertedBuffer = 0; size_t addBuffer = 0; size_t addSpilled = 0; size_t pieceList = 0; size_t lineStarts = 0; size_t lineFilter = 0; size_t bracketIndex = 0; size_t syntaxStates = 0;
+    size_t undoText = 0; size_t undoCursors = 0; size_t redoText = 0; size_t redoCursors = 0;
+    size_t pendingPadding = 0; size_t renderCaches = 0;
+    // mappedOriginal と addSpilled はファイルのページキャッシュなので private メモリの合計には含めない
+    size_t privateTotal() const { return convertedBuffer + addBuffer + pieceList + lineStarts + lineFilter + bracketIndex + syntaxStates + undoText + undoCursors + redoText + redoCursors + pendingPadding + renderCaches; }
+    void takeMax(const MemoryStats& o);
+};
+std::string FormatMemoryStats(const MemoryStats& current, const MemoryStats& peak, size_t peakPrivateTotal);
+std::string MemoryStatsJson(const MemoryStats& s);
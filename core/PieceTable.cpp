@@ -0,0 +1,198 @@
+#include "PieceTable.h"
+#include <algorithm>
+#include <cstring>
+#include "MappedFile.h"
+AddBuffer::AddBuffer() {}
+AddBuffer::~AddBuffer() {}
+void AddBuffer::clear() { chunks.clear(); current = UINT32_MAX; heapBytes = spilledBytes = 0; spill.reset(); }
+void AddBuffer::releaseUnused(const std::vector<bool>& live) {
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        Chunk& c = chunks[i];
+        if (live[i] || i == current || !c.heap) continue;
+        heapBytes -= c.capacity;
+        c.heap.reset(); c.data = nullptr; c.capacity = c.used = 0;
+    }
+}
+void AddBuffer::addChunk(size_t capacity) {
+    if (spillThreshold && heapBytes >= spillThreshold) {
+        if (!spill) spill.reset(new SpillFile());
+        size_t before = spill->size;
+        // 一時ファイルが作れない・伸ばせないときはヒープで続ける
+        if (char* p = spill->grow(capacity)) { spilledBytes += spill->size - before; chunks.push_back({ nullptr, p, spill->size - before, 0 }); return; }
+    }
+    chunks.push_back({ std::unique_ptr<char[]>(new char[capacity]), nullptr, capacity, 0 });
+    chunks.back().data = chunks.back().heap.get(); heapBytes += capacity;
+}
+void AddBuffer::append(const char* s, size_t n, uint32_t& chunk, size_t& start) {
+    memcpy(reserve(n, chunk, start), s, n);
+}
+char* AddBuffer::reserve(size_t n, uint32_t& chunk, size_t& start) {
+    if (n >= kLargeBytes) {
+        addChunk(n);
+        Chunk& c = chunks.back(); c.used = n;
+        chunk = (uint32_t)(chunks.size() - 1); start = 0;
+        return c.data;
+    }
+    if (current == UINT32_MAX || chunks[current].capacity - chunks[current].used < n) {
+        addChunk(kChunkBytes);
+        current = (uint32_t)(chunks.size() - 1);
+    }
+    Chunk& c = chunks[current];
+    chunk = current; start = c.used; c.used += n;
+    return c.data + start;
+}
+std::string PieceTable::getRange(size_t pos, size_t count) const {
+    std::string out; out.reserve(std::min(count, (size_t)4096));
+    size_t cur = 0;
+    for (const auto& p : pieces) {
+        if (cur + p.len <= pos) { cur += p.len; continue; }
+        size_t localStart = (pos > cur) ? (pos - cur) : 0;
+        size_t take = std::min(p.len - localStart, count - out.size());
+        if (take == 0) break;
+        out.append(pieceData(p) + localStart, take);
+        if (out.size() >= count) break;
+        cur += p.len;
+    }
+    return out;
+}
+void PieceTable::noteChange(size_t pos, size_t removed, size_t inserted) {
+    if (!change.any()) change.oldLength = change.newLength = change.tail = length();
+    removed = std::min(removed, change.newLength - std::min(pos, change.newLength));
+    change.from = std::min(change.from, pos);
+    change.tail = std::min(change.tail, change.newLength - std::min(change.newLength, pos + removed));
+    change.newLength = change.newLength - removed + inserted;
+}
+void PieceTable::replacePieces(const std::vector<Piece>& p) {
+    size_t len = 0; for (const auto& q : p) len += q.len;
+    noteChange(0, SIZE_MAX, len);
+    pieces = p; editsSinceCompaction++;
+}
+void PieceTable::insert(size_t pos, const std::string& s) {
+    if (s.empty()) return;
+    uint32_t chunk; size_t addStart; addBuf.append(s.data(), s.size(), chunk, addStart);
+    insertAdded(pos, chunk, addStart, s.size());
+}
+void PieceTable::insertAdded(size_t pos, uint32_t chunk, size_t addStart, size_t len) {
+    if (len == 0) return;
+    noteChange(pos, 0, len);
+    size_t cur = 0; size_t idx = 0;
+    while (idx < pieces.size() && cur + pieces[idx].len < pos) { cur += pieces[idx].len; ++idx; }
+    if (idx < pieces.size()) {
+        Piece p = pieces[idx];
+        size_t offsetInPiece = pos - cur;
+        if (offsetInPiece > 0 && offsetInPiece < p.len) {
+            pieces[idx] = { p.isOriginal, p.chunk, p.start, offsetInPiece };
+            pieces.insert(pieces.begin() + idx + 1, { p.isOriginal, p.chunk, p.start + offsetInPiece, p.len - offsetInPiece });
+            idx++;
+        }
+        else if (offsetInPiece == p.len) idx++;
+    }
+    else idx = pieces.size();
+    editsSinceCompaction++;
+    pieces.insert(pieces.begin() + idx, { false, chunk, addStart, len });
+    coalesceAround(idx);
+}
+void PieceTable::erase(size_t pos, size_t count) {
+    if (count == 0) return;
+    noteChange(pos, count, 0);
+    editsSinceCompaction++;
+    size_t cur = 0; size_t idx = 0;
+    while (idx < pieces.size() && cur + pieces[idx].len <= pos) { cur += pieces[idx].len; ++idx; }
+    size_t remaining = count;
+    if (idx >= pieces.size()) return;
+    if (pos > cur) {
+        Piece p = pieces[idx]; size_t leftLen = pos - cur;
+        pieces[idx] = { p.isOriginal, p.chunk, p.start, leftLen };
+        pieces.insert(pieces.begin() + idx + 1, { p.isOriginal, p.chunk, p.start + leftLen, p.len - leftLen });
+        idx++;
+    }
+    while (idx < pieces.size() && remaining > 0) {
+        if (pieces[idx].len <= remaining) { remaining -= pieces[idx].len; pieces.erase(pieces.begin() + idx); }
+        else { pieces[idx].start += remaining; pieces[idx].len -= remaining; remaining = 0; }
+    }
+    coalesceAround(idx > 0 ? idx - 1 : 0);
+}
+void PieceTable::coalesceAround(size_t idx) {
+    if (pieces.empty()) return;
+    if (idx >= pieces.size()) idx = pieces.size() - 1;
+    if (idx > 0) {
+        Piece& a = pieces[idx - 1]; Piece& b = pieces[idx];
+        if (!a.isOriginal && !b.isOriginal && a.chunk == b.chunk && (a.start + a.len == b.start)) { a.len += b.len; pieces.erase(pieces.begin() + idx); idx--; }
+    }
+    if (idx + 1 < pieces.size()) {
+        Piece& a = pieces[idx]; Piece& b = pieces[idx + 1];
+        if (!a.isOriginal && !b.isOriginal && a.chunk == b.chunk && (a.start + a.len == b.start)) { a.len += b.len; pieces.erase(pieces.begin() + idx + 1); }
+    }
+}
+void PieceTable::keepRanges(size_t from, size_t to, const std::vector<std::pair<size_t, size_t>>& keep) {
+    std::vector<Piece> out; out.reserve(pieces.size() + keep.size());
+    // 切り出した断片を足す。直前の断片と同じバッファで連続していればつなげる
+    auto emit = [&](const Piece& p, size_t off, size_t len) {
+        if (len == 0) return;
+        Piece q = { p.isOriginal, p.chunk, p.start + off, len };
+        if (!out.empty()) {
+            Piece& b = out.back();
+            if (b.isOriginal == q.isOriginal && (q.isOriginal || b.chunk == q.chunk) && b.start + b.len == q.start) { b.len += len; return; }
+        }
+        out.push_back(q);
+    };
+    size_t cur = 0, k = 0;
+    for (const auto& p : pieces) {
+        size_t pieceEnd = cur + p.len, a = cur;
+        while (a < pieceEnd) {
+            if (a < from) { size_t b = std::min(pieceEnd, from); emit(p, a - cur, b - a); a = b; continue; }
+            if (a >= to) { emit(p, a - cur, pieceEnd - a); break; }
+            while (k < keep.size() && keep[k].second <= a) k++;
+            size_t limit = std::min(pieceEnd, to);
+            if (k < keep.size() && keep[k].first < limit) {
+                size_t s = std::max(a, keep[k].first), e = std::min(limit, keep[k].second);
+                emit(p, s - cur, e - s); a = e;
+            }
+            else a = limit;
+        }
+        cur = pieceEnd;
+    }
+    size_t kept = 0; for (const auto& r : keep) kept += r.second - r.first;
+    noteChange(from, to - from, kept);
+    pieces.swap(out);
+    editsSinceCompaction += keep.size() + 1;
+}
+char PieceTable::charAt(size_t pos) const {
+    size_t cur = 0;
+    for (const auto& p : pieces) {
+        if (cur + p.len <= pos) { cur += p.len; continue; }
+        return pieceData(p)[pos - cur];
+    }
+    return ' ';
+}
+bool PieceTable::compactStep(size_t maxPieces, const std::vector<const std::vector<Piece>*>& retained) {
+    if (compactCursor >= pieces.size()) compactCursor = 0;
+    size_t begin = compactCursor, end = std::min(pieces.size(), begin + maxPieces);
+    std::vector<Piece> out; out.reserve(end - begin);
+    std::string run; size_t runBegin = begin;
+    auto flush = [&](size_t runEnd) {
+        if (runEnd - runBegin >= 2) { uint32_t chunk; size_t start; addBuf.append(run.data(), run.size(), chunk, start); out.push_back({ false, chunk, start, run.size() }); }
+        else if (runEnd > runBegin) out.push_back(pieces[runBegin]);
+        run.clear(); runBegin = runEnd;
+    };
+    for (size_t i = begin; i < end; ++i) {
+        const Piece& p = pieces[i];
+        if (p.len >= kSmallPiece) { flush(i); out.push_back(p); runBegin = i + 1; continue; }
+        if (run.size() + p.len > kCompactRunBytes) flush(i);
+        run.append(pieceData(p), p.len);
+    }
+    flush(end);
+    if (out.size() < end - begin) {
+        pieces.erase(pieces.begin() + begin, pieces.begin() + end);
+        pieces.insert(pieces.begin() + begin, out.begin(), out.end());
+    }
+    compactCursor = begin + out.size();
+    if (compactCursor < pieces.size()) return true;
+    std::vector<bool> live(addBuf.chunks.size(), false);
+    for (const auto& p : pieces) if (!p.isOriginal) live[p.chunk] = true;
+    for (const auto* v : retained) for (const auto& p : *v) if (!p.isOriginal) live[p.chunk] = true;
+    addBuf.releaseUnused(live);
+    pieces.shrink_to_fit();
+    compactCursor = 0; editsSinceCompaction = 0;
+    return false;
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+// 追加分のピースは (chunk, start) で追加バッファ内を指す。元ファイルのピースでは chunk は使わない
+struct Piece { bool isOriginal; uint32_t chunk; size_t start; size_t len; };
+struct SpillFile;
+// 挿入文字列を貯める領域。固定サイズのチャンクを足していくだけで既存のデータは動かさないので、
+// 追記は挿入バイト数分のコピーで済み、ピースを指すポインタや string_view も編集をまたいで有効なまま
+struct AddBuffer {
+    static constexpr size_t kChunkBytes = (size_t)1 << 20;
+    // これより大きい貼り付けは専用チャンクに入れる (書きかけのチャンクを捨てずに済む)
+    static constexpr size_t kLargeBytes = kChunkBytes / 4;
+    // ヒープ上のチャンクがこの量を超えたら、以降のチャンクは一時ファイルをマップして確保する (0 なら使わない)
+    size_t spillThreshold = (size_t)256 << 20;
+    // heap が空のチャンクは spill の中を指している
+    struct Chunk { std::unique_ptr<char[]> heap; char* data; size_t capacity; size_t used; };
+    std::vector<Chunk> chunks; uint32_t current = UINT32_MAX;
+    size_t heapBytes = 0, spilledBytes = 0;
+    std::unique_ptr<SpillFile> spill;
+    AddBuffer();
+    ~AddBuffer();
+    const char* data(uint32_t chunk, size_t start) const { return chunks[chunk].data + start; }
+    // s を連続領域にコピーし、その場所を (chunk, start) で返す
+    void append(const char* s, size_t n, uint32_t& chunk, size_t& start);
+    // n バイトの連続領域を確保して返す。中身は呼び出し側が書く (変換結果を直接書き込むとき用)
+    char* reserve(size_t n, uint32_t& chunk, size_t& start);
+    void clear();
+    // live[i] が false のヒープチャンクを解放する (番号は詰めないのでピースの chunk はそのまま使える)
+    void releaseUnused(const std::vector<bool>& live);
+    size_t size() const { size_t s = 0; for (auto& c : chunks) s += c.used; return s; }
+    size_t capacity() const { return heapBytes + spilledBytes; }
+private:
+    void addChunk(size_t capacity);
+};
+// 前回 takeChange() してから書き換わった範囲。先頭の from バイトと末尾の tail バイトは変わっていない
+// oldLength / newLength はその間の前後の文書長
+struct ChangeSpan {
+    size_t from = SIZE_MAX, tail = SIZE_MAX, oldLength = 0, newLength = 0;
+    bool any() const { return from != SIZE_MAX; }
+};
+struct PieceTable {
+    const char* origPtr = nullptr; size_t origSize = 0;
+    AddBuffer addBuf; std::vector<Piece> pieces;
+    // 前回のコンパクション完了後の編集回数と、途中まで進んだコンパクションの位置 (ピース番号)
+    size_t editsSinceCompaction = 0; size_t compactCursor = 0;
+    ChangeSpan change;
+    void initFromFile(const char* data, size_t size) { origPtr = data; origSize = size; pieces.clear(); addBuf.clear(); editsSinceCompaction = compactCursor = 0; change = {}; if (size > 0) pieces.push_back({ true, 0, 0, size }); }
+    void initEmpty() { origPtr = nullptr; origSize = 0; pieces.clear(); addBuf.clear(); editsSinceCompaction = compactCursor = 0; change = {}; }
+    // pos から removed バイトを消して inserted バイトを入れる編集を change に足す。書き換える前に呼ぶ
+    void noteChange(size_t pos, size_t removed, size_t inserted);
+    ChangeSpan takeChange() { ChangeSpan c = change; change = {}; return c; }
+    // ピース列をまるごと差し替える (undo のスナップショット用)。文書全体が変わったものとして扱う
+    void replacePieces(const std::vector<Piece>& p);
+    size_t length() const { size_t s = 0; for (auto& p : pieces) s += p.len; return s; }
+    const char* pieceData(const Piece& p) const { return p.isOriginal ? (origPtr + p.start) : addBuf.data(p.chunk, p.start); }
+    std::string getRange(size_t pos, size_t count) const;
+    void insert(size_t pos, const std::string& s);
+    // 追加バッファに書き込み済みの (chunk, start) から len バイトを pos に挿入する
+    void insertAdded(size_t pos, uint32_t chunk, size_t start, size_t len);
+    void erase(size_t pos, size_t count);
+    void coalesceAround(size_t idx);
+    char charAt(size_t pos) const;
+    // [from, to) のうち keep (昇順で重ならない [first, second) の並び) に含まれない部分を消す。
+    // ピースを切り分け直すだけで文字列はコピーしない。ピース列は 1 回の走査で作り直す
+    void keepRanges(size_t from, size_t to, const std::vector<std::pair<size_t, size_t>>& keep);
+    // 細かいピースが続く区間を追加バッファの新しい連続ブロックにコピーして 1 ピースにまとめる。アイドル時に少しずつ呼ぶ
+    // 1 回で最大 maxPieces 個を見る。一巡したら参照されなくなったチャンクを解放して false を返す
+    // 文書の内容と位置は変わらない (undo の文字列はコピーなので影響しない) が、それまでの pieceData のポインタは無効になりうる
+    // retained には undo が持っているピース列のスナップショットを渡す。そこから指されているチャンクは解放しない
+    static constexpr size_t kCompactMinEdits = 1024;
+    static constexpr size_t kSmallPiece = 4096;
+    static constexpr size_t kCompactRunBytes = (size_t)64 << 10;
+    bool needsCompaction() const { return editsSinceCompaction >= kCompactMinEdits && pieces.size() >= kCompactMinEdits; }
+    bool compactStep(size_t maxPieces = 4096, const std::vector<const std::vector<Piece>*>& retained = {});
+    // [pos, pos+count) をピース単位の連続領域として fn(std::string_view) に渡す。fn が false を返したら打ち切る
+    template <class F> void forEachChunk(size_t pos, size_t count, F fn) const {
+        size_t cur = 0;
+        for (const auto& p : pieces) {
+            if (count == 0) return;
+            if (cur + p.len <= pos) { cur += p.len; continue; }
+            size_t off = (pos > cur) ? (pos - cur) : 0; size_t take = std::min(p.len - off, count);
+            if (!fn(std::string_view(pieceData(p) + off, take))) return;
+            count -= take; cur += p.len;
+        }
+    }
+};
+// 現在のピースを覚えたまま 1 バイトずつ前後に動くイテレータ。位置合わせ (seek) だけが O(ピース数) で、移動は O(1)
+// 範囲外 (先頭より前・末尾) での * は charAt と同じく ' ' を返す
+struct PieceIterator {
+    const PieceTable* pt = nullptr; size_t pos = 0; size_t idx = 0; size_t pieceStart = 0;
+    PieceIterator() {}
+    PieceIterator(const PieceTable& t, size_t p) : pt(&t) { seek(p); }
+    void seek(size_t p) {
+        pos = p; idx = 0; pieceStart = 0;
+        while (idx < pt->pieces.size() && pieceStart + pt->pieces[idx].len <= p) { pieceStart += pt->pieces[idx].len; ++idx; }
+    }
+    size_t position() const { return pos; }
+    char operator*() const { return idx < pt->pieces.size() ? pt->pieceData(pt->pieces[idx])[pos - pieceStart] : ' '; }
+    PieceIterator& operator++() {
+        ++pos;
+        while (idx < pt->pieces.size() && pos >= pieceStart + pt->pieces[idx].len) { pieceStart += pt->pieces[idx].len; ++idx; }
+        return *this;
+    }
+    PieceIterator& operator--() {
+        --pos;
+        while (idx > 0 && pos < pieceStart) { --idx; pieceStart -= pt->pieces[idx].len; }
+        return *this;
+    }
+    // 今の位置から n バイトをピースの断片ごとに fn(p, m) に渡して進める。fn が false を返したらそこで止めて false
+    template <class F> bool forEachSpan(size_t n, F fn) {
+        while (n > 0 && idx < pt->pieces.size()) {
+            const Piece& p = pt->pieces[idx];
+            size_t off = pos - pieceStart, take = std::min(p.len - off, n);
+            if (!fn(pt->pieceData(p) + off, take)) return false;
+            pos += take; n -= take;
+            if (off + take == p.len) { pieceStart += p.len; ++idx; }
+        }
+        return true;
+    }
+};
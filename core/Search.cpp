@@ -0,0 +1,258 @@
+#include "Search.h"
+#include <regex>
+#include "Grapheme.h"
+#include "Trace.h"
+#include "WordBreak.h"
+std::string PreprocessRegexQuery(const std::string& query) {
+    std::string processed;
+    processed.reserve(query.size() * 4);
+    for (size_t i = 0; i < query.size(); ++i) {
+        char c = query[i];
+        if (c == '\\') {
+            if (i + 1 < query.size()) {
+                char next = query[i + 1];
+                if (next == 'n') {
+                    bool isPrecededByCR = (i >= 2 && query[i - 2] == '\\' && query[i - 1] == 'r');
+                    if (!isPrecededByCR) {
+                        processed += "(?:\\r\\n|[\\r\\n])";
+                        i++; continue;
+                    }
+                }
+                processed += c; processed += next; i++; continue;
+            }
+        }
+        else if (c == '^') {
+            bool inClass = false;
+            if (i > 0 && query[i - 1] == '[') inClass = true;
+            if (!inClass) {
+                processed += "(?:^|(?:\\r\\n|[\\r\\n]))";
+                continue;
+            }
+        }
+        processed += c;
+    }
+    return processed;
+}
+std::string UnescapeString(const std::string& s, const std::string& newline) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\\' && i + 1 < s.size()) {
+            switch (s[i + 1]) {
+            case 'n': out += newline; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case '\\': out += '\\'; break;
+            default: out += s[i]; out += s[i + 1]; break;
+            }
+            i++;
+        }
+        else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+static char LowerAscii(char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; }
+// it の位置から query が一致するか。単語単位の判定 (前後が単語の境目か) と、書記素クラスタの途中で終わる一致 (直後に結合文字や ZWJ が続くなど) の除外も行う
+static bool MatchLiteralAt(const PieceIterator& it, size_t len, const std::string& query, bool matchCase, bool wholeWord) {
+    size_t cur = it.position(), qLen = query.length();
+    char c0 = *it; if (!matchCase) c0 = LowerAscii(c0);
+    char first = matchCase ? query[0] : LowerAscii(query[0]);
+    if (c0 != first || cur + qLen > len) return false;
+    PieceIterator probe = it;
+    for (size_t i = 1; i < qLen; ++i) {
+        char c1 = *++probe; char c2 = query[i];
+        if (!matchCase) { c1 = LowerAscii(c1); c2 = LowerAscii(c2); }
+        if (c1 != c2) return false;
+    }
+    if (wholeWord) {
+        if (!IsWordBoundary(it, len)) return false;
+        if (cur + qLen < len) { PieceIterator e = probe; if (!IsWordBoundary(++e, len)) return false; }
+    }
+    if (cur + qLen < len) { PieceIterator e = probe; if (!IsGraphemeBoundary(++e, len)) return false; }
+    return true;
+}
+size_t FindText(const PieceTable& pt, size_t startPos, const std::string& query, bool forward, bool matchCase, bool wholeWord, bool isRegex, size_t* outLen) {
+    TRACE_SCOPE("findText");
+    if (query.empty()) return std::string::npos;
+    size_t len = pt.length();
+    std::string actualQuery = query;
+    if (isRegex) actualQuery = PreprocessRegexQuery(query);
+    if (isRegex) {
+        std::string fullText = pt.getRange(0, len);
+        try {
+            std::regex_constants::syntax_option_type flags = std::regex_constants::ECMAScript;
+            if (!matchCase) flags |= std::regex_constants::icase;
+            std::regex re(actualQuery, flags);
+            std::smatch m;
+            size_t foundPos = std::string::npos;
+            size_t foundLen = 0;
+            bool startsWithCaret = (!query.empty() && query[0] == '^');
+            if (forward) {
+                if (startPos >= fullText.size()) startPos = 0;
+                size_t searchStartIdx = startPos;
+                std::regex_constants::match_flag_type searchFlags = std::regex_constants::match_default;
+                if (searchStartIdx > 0) {
+                    searchFlags |= std::regex_constants::match_not_bol;
+                    char prevChar = fullText[searchStartIdx - 1];
+                    if (prevChar == '\n') {
+                        searchStartIdx--;
+                        if (searchStartIdx > 0 && fullText[searchStartIdx - 1] == '\r') {
+                            searchStartIdx--;
+                        }
+                    }
+                    else if (prevChar == '\r') {
+                        searchStartIdx--;
+                    }
+                }
+                std::string::const_iterator searchStartIter = fullText.begin() + searchStartIdx;
+                if (std::regex_search(searchStartIter, fullText.cend(), m, re, searchFlags)) {
+                    foundPos = searchStartIdx + m.position();
+                    foundLen = m.length();
+                }
+                else if (startPos > 0) {
+                    if (std::regex_search(fullText.cbegin(), fullText.cend(), m, re)) {
+                        foundPos = m.position();
+                        foundLen = m.length();
+                    }
+                }
+            }
+            else {
+                auto words_begin = std::sregex_iterator(fullText.begin(), fullText.end(), re);
+                auto words_end = std::sregex_iterator();
+                size_t bestPos = std::string::npos;
+                size_t limit = (startPos == 0) ? len : startPos;
+                for (auto i = words_begin; i != words_end; ++i) {
+                    if (i->position() < (std::ptrdiff_t)limit) {
+                        bestPos = i->position();
+                        foundLen = i->length();
+                    }
+                }
+                if (bestPos != std::string::npos) foundPos = bestPos;
+            }
+            if (foundPos != std::string::npos) {
+                if (foundPos > 0 && startsWithCaret) {
+                    std::string matchStr = fullText.substr(foundPos, foundLen);
+                    size_t adj = 0;
+                    if (matchStr.size() >= 2 && matchStr[0] == '\r' && matchStr[1] == '\n') {
+                        adj = 2;
+                    }
+                    else if (matchStr.size() >= 1 && (matchStr[0] == '\n' || matchStr[0] == '\r')) {
+                        adj = 1;
+                    }
+                    foundPos += adj;
+                    foundLen -= adj;
+                }
+                if (outLen) *outLen = foundLen;
+                return foundPos;
+            }
+        }
+        catch (...) { return std::string::npos; }
+        return std::string::npos;
+    }
+    if (outLen) *outLen = query.length();
+    size_t cur = startPos;
+    if (forward) { if (cur >= len) cur = 0; }
+    else { if (cur == 0) cur = len; else cur--; }
+    // it は cur を指したまま 1 バイトずつ動かす (charAt のように毎回ピースを先頭から探さない)
+    PieceIterator it(pt, cur);
+    size_t count = 0;
+    while (count < len) {
+        if (MatchLiteralAt(it, len, query, matchCase, wholeWord)) return cur;
+        if (forward) { cur++; if (cur >= len) { cur = 0; it.seek(0); } else ++it; }
+        else { if (cur == 0) { cur = len - 1; it.seek(cur); } else { cur--; --it; } }
+        count++;
+    }
+    return std::string::npos;
+}
+bool ForEachMatch(const PieceTable& pt, size_t from, size_t to, const std::string& query, bool matchCase, bool wholeWord, bool isRegex, const std::function<size_t(size_t, size_t)>& fn, size_t windowEnd) {
+    if (query.empty() || from >= to) return true;
+    if (isRegex) {
+        // 正規表現は連続した文字列が要るので範囲だけ取り出す。from は行頭なので ^ の扱いは文書全体で探すときと変わらない
+        std::string text = pt.getRange(from, std::max(to, windowEnd) - from);
+        try {
+            std::regex_constants::syntax_option_type flags = std::regex_constants::ECMAScript;
+            if (!matchCase) flags |= std::regex_constants::icase;
+            std::regex re(PreprocessRegexQuery(query), flags);
+            bool startsWithCaret = (query[0] == '^');
+            size_t next = from;
+            for (auto i = std::sregex_iterator(text.begin(), text.end(), re); i != std::sregex_iterator(); ++i) {
+                size_t pos = from + i->position(), len = i->length();
+                if (startsWithCaret && len > 0 && (text[i->position()] == '\r' || text[i->position()] == '\n')) {
+                    size_t adj = (len >= 2 && text[i->position()] == '\r' && text[i->position() + 1] == '\n') ? 2 : 1;
+                    pos += adj; len -= adj;
+                }
+                if (pos < next) continue;
+                if (pos >= to) break;
+                next = fn(pos, len);
+                if (next >= to) break;
+            }
+        }
+        catch (...) { return false; }
+        return true;
+    }
+    // FindText と違って折り返さず、to より先は見ない
+    size_t len = pt.length();
+    PieceIterator it(pt, from);
+    for (size_t cur = from; cur < to;) {
+        if (!MatchLiteralAt(it, len, query, matchCase, wholeWord)) { ++cur; ++it; continue; }
+        size_t next = fn(cur, query.length());
+        if (next >= to) break;
+        // 次の行頭までは歩いて進める (seek はピース数に比例する)
+        do { ++cur; ++it; } while (cur < next);
+    }
+    return true;
+}
+bool CollectReplaceMatches(const PieceTable& pt, const std::string& query, const std::string& replacement, const std::string& newline, bool matchCase, bool wholeWord, bool isRegex, std::vector<ReplaceMatch>& matches) {
+    matches.clear();
+    if (query.empty()) return false;
+    size_t docLen = pt.length();
+    if (isRegex) {
+        std::string actualQuery = PreprocessRegexQuery(query);
+        std::string fullText = pt.getRange(0, docLen);
+        std::string fmt = UnescapeString(replacement, newline);
+        try {
+            std::regex_constants::syntax_option_type flags = std::regex_constants::ECMAScript;
+            if (!matchCase) flags |= std::regex_constants::icase;
+            std::regex re(actualQuery, flags);
+            bool startsWithCaret = (query[0] == '^');
+            auto begin = std::sregex_iterator(fullText.begin(), fullText.end(), re);
+            auto end = std::sregex_iterator();
+            for (auto i = begin; i != end; ++i) {
+                size_t pos = i->position();
+                size_t len = i->length();
+                std::string rText = i->format(fmt);
+                if (startsWithCaret) {
+                    std::string matchStr = i->str();
+                    size_t adj = 0;
+                    if (matchStr.size() >= 2 && matchStr[0] == '\r' && matchStr[1] == '\n') adj = 2;
+                    else if (matchStr.size() >= 1 && (matchStr[0] == '\n' || matchStr[0] == '\r')) adj = 1;
+                    if (adj > 0) { pos += adj; len -= adj; }
+                }
+                matches.push_back({ pos, len, rText });
+            }
+        }
+        catch (...) { matches.clear(); return false; }
+        return true;
+    }
+    size_t currentPos = 0;
+    while (true) {
+        size_t matchLen = 0;
+        size_t pos = FindText(pt, currentPos, query, true, matchCase, wholeWord, false, &matchLen);
+        if (pos == std::string::npos || pos < currentPos) break;
+        matches.push_back({ pos, matchLen, replacement });
+        currentPos = pos + matchLen;
+        if (currentPos > docLen) break;
+    }
+    return true;
+}
+void ApplyReplaceMatches(PieceTable& pt, const std::vector<ReplaceMatch>& matches, std::vector<EditOp>& ops) {
+    for (auto it = matches.rbegin(); it != matches.rend(); ++it) {
+        std::string deleted = pt.getRange(it->start, it->len);
+        pt.erase(it->start, it->len);
+        ops.push_back({ EditOp::Erase, it->start, deleted });
+        pt.insert(it->start, it->replacementText);
+        ops.push_back({ EditOp::Insert, it->start, it->replacementText });
+    }
+}
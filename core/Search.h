@@ -0,0 +1,15 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "PieceTable.h"
+#include "Edit.h"
+struct ReplaceMatch { size_t start; size_t len; std::string replacementText; };
+std::string PreprocessRegexQuery(const std::string& query);
+std::string UnescapeString(const std::string& s, const std::string& newline);
+size_t FindText(const PieceTable& pt, size_t startPos, const std::string& query, bool forward, bool matchCase, bool wholeWord, bool isRegex, size_t* outLen = nullptr);
+// [from, to) で始まる一致を前から順に fn(pos, len) に渡す。fn は次に探し始める位置を返す (to 以上なら打ち切り)
+// 正規表現は [from, max(to, windowEnd)) の中で探す (一致の終わりは to を越えてよい)。正規表現が不正なら false
+bool ForEachMatch(const PieceTable& pt, size_t from, size_t to, const std::string& query, bool matchCase, bool wholeWord, bool isRegex, const std::function<size_t(size_t, size_t)>& fn, size_t windowEnd = 0);
+bool CollectReplaceMatches(const PieceTable& pt, const std::string& query, const std::string& replacement, const std::string& newline, bool matchCase, bool wholeWord, bool isRegex, std::vector<ReplaceMatch>& matches);
+void ApplyReplaceMatches(PieceTable& pt, const std::vector<ReplaceMatch>& matches, std::vector<EditOp>& ops);
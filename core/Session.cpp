@@ -0,0 +1,97 @@
+#include "Session.h"
+#include <cstdlib>
+static void AppendEscaped(std::string& out, const std::string& s) {
+    for (unsigned char c : s) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case ' ': out += "\\s"; break;
+        default:
+            if (c < 0x20 || c == 0x7F) { char b[8]; snprintf(b, sizeof(b), "\\x%02X", c); out += b; }
+            else out += (char)c;
+        }
+    }
+}
+static std::string Unescape(const char* p, const char* end) {
+    std::string out; out.reserve(end - p);
+    while (p < end) {
+        if (*p == '\\' && p + 1 < end) {
+            char n = p[1]; p += 2;
+            if (n == 'n') out += '\n'; else if (n == 'r') out += '\r'; else if (n == 't') out += '\t'; else if (n == 's') out += ' ';
+            else if (n == 'x' && p + 2 <= end) { out += (char)strtol(std::string(p, 2).c_str(), nullptr, 16); p += 2; }
+            else out += n;
+        }
+        else out += *p++;
+    }
+    return out;
+}
+std::string FormatSessionEvent(const SessionEvent& e) {
+    char b[32]; snprintf(b, sizeof(b), "%.3f", e.timeMs);
+    std::string line = b; line += ' '; line += e.command;
+    for (long long a : e.args) { line += ' '; line += std::to_string(a); }
+    for (const auto& t : e.texts) { line += " :"; AppendEscaped(line, t); }
+    return line;
+}
+bool ParseSessionEvent(const std::string& line, SessionEvent& e) {
+    e = SessionEvent();
+    if (line.empty() || line[0] == '#') return false;
+    const char* p = line.c_str(); const char* end = p + line.size();
+    std::vector<std::pair<const char*, const char*>> tokens;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\r')) p++;
+        const char* s = p;
+        while (p < end && *p != ' ' && *p != '\r') p++;
+        if (p > s) tokens.push_back({ s, p });
+    }
+    if (tokens.size() < 2) return false;
+    e.timeMs = strtod(std::string(tokens[0].first, tokens[0].second).c_str(), nullptr);
+    e.command.assign(tokens[1].first, tokens[1].second);
+    for (size_t i = 2; i < tokens.size(); ++i) {
+        if (*tokens[i].first == ':') e.texts.push_back(Unescape(tokens[i].first + 1, tokens[i].second));
+        else e.args.push_back(strtoll(std::string(tokens[i].first, tokens[i].second).c_str(), nullptr, 10));
+    }
+    return true;
+}
+bool ReadSessionFile(const char* path, std::vector<SessionEvent>& events) {
+    FILE* f = fopen(path, "rb"); if (!f) return false;
+    std::string line; int ch;
+    while (true) {
+        ch = fgetc(f);
+        if (ch == '\n' || ch == EOF) {
+            SessionEvent e; if (ParseSessionEvent(line, e)) events.push_back(e);
+            line.clear();
+            if (ch == EOF) break;
+        }
+        else line += (char)ch;
+    }
+    fclose(f); return true;
+}
+#ifdef _WIN32
+bool SessionRecorder::open(const wchar_t* path) { close(); file = _wfopen(path, L"wb");
+#else
+bool SessionRecorder::open(const char* path) { close(); file = fopen(path, "wb");
+#endif
+    if (!file) return false;
+    startTime = std::chrono::steady_clock::now(); depth = 0; lastCursors.clear();
+    fputs("#miu-session 1\n", file);
+    return true;
+}
+void SessionRecorder::close() { if (file) { fclose(file); file = nullptr; } }
+void SessionRecorder::write(const char* command, const std::vector<long long>& args, const std::vector<std::string>& texts) {
+    if (!file) return;
+    SessionEvent e; e.command = command; e.args = args; e.texts = texts;
+    e.timeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::string line = FormatSessionEvent(e); line += '\n';
+    fwrite(line.data(), 1, line.size(), file); fflush(file);
+}
+void SessionRecorder::syncCursors(const std::vector<Cursor>& cursors) {
+    bool same = cursors.size() == lastCursors.size();
+    for (size_t i = 0; same && i < cursors.size(); ++i) same = cursors[i].head == lastCursors[i].head && cursors[i].anchor == lastCursors[i].anchor;
+    if (same) return;
+    std::vector<long long> args;
+    for (const auto& c : cursors) { args.push_back((long long)c.head); args.push_back((long long)c.anchor); }
+    write("cursors", args);
+    lastCursors = cursors;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Edit.h"
+struct SessionEvent { double timeMs = 0.0; std::string command; std::vector<long long> args; std::vector<std::string> texts; };
+std::string FormatSessionEvent(const SessionEvent& e);
+bool ParseSessionEvent(const std::string& line, SessionEvent& e);
+bool ReadSessionFile(const char* path, std::vector<SessionEvent>& events);
+struct SessionRecorder {
+    FILE* file = nullptr; int depth = 0;
+    std::chrono::steady_clock::time_point startTime;
+    std::vector<Cursor> lastCursors;
+#ifdef _WIN32
+    bool open(const wchar_t* path);
+#else
+    bool open(const char* path);
+#endif
+    void close();
+    bool isOpen() const { return file != nullptr; }
+    void write(const char* command, const std::vector<long long>& args = {}, const std::vector<std::string>& texts = {});
+    void syncCursors(const std::vector<Cursor>& cursors);
+    ~SessionRecorder() { close(); }
+    // 最外側のコマンドだけを記録し、入れ子の呼び出し (cut -> insertAtCursors 等) は無視する
+    struct Scope {
+        SessionRecorder& rec; const std::vector<Cursor>& cursors; bool outer; bool keepsCursors;
+        Scope(SessionRecorder& r, const std::vector<Cursor>& c, const char* command, const std::vector<long long>& args = {}, const std::vector<std::string>& texts = {}, bool isMove = false)
+            : rec(r), cursors(c), outer(r.depth == 0 && r.isOpen()), keepsCursors(!isMove) {
+            if (outer) { rec.syncCursors(cursors); rec.write(command, args, texts); }
+            rec.depth++;
+        }
+        ~Scope() { rec.depth--; if (outer && keepsCursors) rec.lastCursors = cursors; }
+    };
+};
@@ -0,0 +1,323 @@
+#include "Syntax.h"
+#include <algorithm>
+#include <string>
+#include "Trace.h"
+// 拡張子 (小文字にしたもの) と種類。app.log.1 のように数字だけの拡張子はその前の拡張子で決める
+static const struct { std::string_view ext; SyntaxLanguage lang; } kSyntaxExtensions[] = {
+    { "c", SYNTAX_CPP }, { "h", SYNTAX_CPP }, { "cc", SYNTAX_CPP }, { "cpp", SYNTAX_CPP }, { "cxx", SYNTAX_CPP }, { "c++", SYNTAX_CPP },
+    { "hh", SYNTAX_CPP }, { "hpp", SYNTAX_CPP }, { "hxx", SYNTAX_CPP }, { "h++", SYNTAX_CPP }, { "inl", SYNTAX_CPP }, { "ipp", SYNTAX_CPP },
+    { "m", SYNTAX_CPP }, { "mm", SYNTAX_CPP },
+    { "json", SYNTAX_JSON }, { "jsonc", SYNTAX_JSON },
+    { "log", SYNTAX_LOG },
+    { "ini", SYNTAX_INI }, { "cfg", SYNTAX_INI }, { "conf", SYNTAX_INI }, { "inf", SYNTAX_INI }, { "properties", SYNTAX_INI }, { "toml", SYNTAX_INI },
+    { "editorconfig", SYNTAX_INI }, { "gitconfig", SYNTAX_INI },
+    { "yml", SYNTAX_YAML }, { "yaml", SYNTAX_YAML },
+};
+template <class C> static SyntaxLanguage LanguageForPath(const C* path) {
+    size_t n = 0; while (path[n]) n++;
+    size_t end = n;
+    while (true) {
+        size_t dot = end;
+        while (dot > 0 && path[dot - 1] != '.' && path[dot - 1] != '/' && path[dot - 1] != '\\') dot--;
+        if (dot == 0 || path[dot - 1] != '.' || dot == end) return SYNTAX_PLAIN;
+        std::string ext; bool digits = true;
+        for (size_t i = dot; i < end; ++i) {
+            if ((uint32_t)path[i] >= 128) return SYNTAX_PLAIN;
+            char c = (char)path[i]; if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            ext += c; digits = digits && c >= '0' && c <= '9';
+        }
+        if (!digits) {
+            for (const auto& e : kSyntaxExtensions) if (e.ext == ext) return e.lang;
+            return SYNTAX_PLAIN;
+        }
+        end = dot - 1;
+    }
+}
+SyntaxLanguage SyntaxLanguageForPath(const char* path) { return LanguageForPath(path); }
+#ifdef _WIN32
+SyntaxLanguage SyntaxLanguageForPath(const wchar_t* path) { return LanguageForPath(path); }
+#endif
+static constexpr std::string_view kCppKeywords[] = {
+    "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "char8_t", "class", "co_await", "co_return",
+    "co_yield", "concept", "const", "const_cast", "consteval", "constexpr", "constinit", "continue", "decltype", "default", "delete", "do", "double",
+    "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable",
+    "namespace", "new", "noexcept", "nullptr", "operator", "private", "protected", "public", "register", "reinterpret_cast", "requires", "restrict",
+    "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw",
+    "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while",
+};
+static constexpr bool CppKeywordsSorted() {
+    for (size_t i = 1; i < sizeof(kCppKeywords) / sizeof(kCppKeywords[0]); ++i) if (!(kCppKeywords[i - 1] < kCppKeywords[i])) return false;
+    return true;
+}
+static_assert(CppKeywordsSorted(), "kCppKeywords は昇順");
+// ログの重要度を表す語 (大文字小文字は問わない)
+static const struct { std::string_view word; TokenKind kind; } kLogLevels[] = {
+    { "fatal", TOKEN_ERROR }, { "critical", TOKEN_ERROR }, { "crit", TOKEN_ERROR }, { "error", TOKEN_ERROR }, { "err", TOKEN_ERROR },
+    { "severe", TOKEN_ERROR }, { "panic", TOKEN_ERROR }, { "emerg", TOKEN_ERROR }, { "alert", TOKEN_ERROR }, { "fail", TOKEN_ERROR },
+    { "failed", TOKEN_ERROR }, { "failure", TOKEN_ERROR }, { "exception", TOKEN_ERROR },
+    { "warning", TOKEN_WARNING }, { "warn", TOKEN_WARNING },
+    { "info", TOKEN_INFO }, { "notice", TOKEN_INFO },
+    { "debug", TOKEN_DEBUG }, { "dbg", TOKEN_DEBUG }, { "trace", TOKEN_DEBUG }, { "verbose", TOKEN_DEBUG }, { "fine", TOKEN_DEBUG },
+    { "finer", TOKEN_DEBUG }, { "finest", TOKEN_DEBUG },
+};
+static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+static bool IsIdentStart(char c) { return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+static bool IsIdentChar(char c) { return IsIdentStart(c) || IsDigit(c); }
+static bool IsBlank(char c) { return c == ' ' || c == '\t'; }
+static bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) { char c = a[i]; if (c >= 'A' && c <= 'Z') c += 'a' - 'A'; if (c != b[i]) return false; }
+    return true;
+}
+// 行を読む間の共通の道具。n は末尾の改行を除いた長さ
+struct LineLexer {
+    std::string_view s; size_t n; std::vector<SyntaxToken>* tokens;
+    void emit(size_t b, size_t e, TokenKind kind) { if (tokens && e > b) tokens->push_back({ b, e - b, kind }); }
+    size_t skipBlanks(size_t i) const { while (i < n && IsBlank(s[i])) i++; return i; }
+    size_t identEnd(size_t i) const { while (i < n && IsIdentChar(s[i])) i++; return i; }
+    // i は開きの引用符の次。閉じの引用符の次を返す。閉じずに行が終われば n、行末の \ で終わっていれば n + 1
+    size_t quotedEnd(size_t i, char q) const {
+        while (i < n) { if (s[i] == '\\') i += 2; else if (s[i++] == q) return i; }
+        return i;
+    }
+    size_t numberEnd(size_t i) const {
+        for (i++; i < n; ++i) {
+            char c = s[i];
+            if (IsIdentChar(c) || c == '.' || c == '\'') continue;
+            if ((c == '+' || c == '-') && ((s[i - 1] | 0x20) == 'e' || (s[i - 1] | 0x20) == 'p')) continue;
+            break;
+        }
+        return i;
+    }
+    // i から /* で始まるコメントを読む。閉じれば */ の次、閉じなければ npos (行末までコメント)
+    size_t blockCommentEnd(size_t i) const { size_t e = s.substr(0, n).find("*/", i); return e == std::string_view::npos ? e : e + 2; }
+};
+enum { CPP_CODE, CPP_BLOCK_COMMENT, CPP_STRING, CPP_LINE_COMMENT };
+static uint8_t LexCpp(LineLexer& lx, uint8_t state) {
+    size_t i = 0, n = lx.n;
+    bool continued = n > 0 && lx.s[n - 1] == '\\';
+    if (state == CPP_BLOCK_COMMENT) {
+        size_t e = lx.blockCommentEnd(0);
+        if (e == std::string_view::npos) { lx.emit(0, n, TOKEN_COMMENT); return CPP_BLOCK_COMMENT; }
+        lx.emit(0, e, TOKEN_COMMENT); i = e;
+    }
+    else if (state == CPP_STRING) {
+        size_t e = lx.quotedEnd(0, '"');
+        lx.emit(0, std::min(e, n), TOKEN_STRING);
+        if (e >= n) return e > n ? CPP_STRING : CPP_CODE;
+        i = e;
+    }
+    else if (state == CPP_LINE_COMMENT) { lx.emit(0, n, TOKEN_COMMENT); return continued ? CPP_LINE_COMMENT : CPP_CODE; }
+    else {
+        // 行頭の # はプリプロセッサ指令。#include の <...> は文字列として塗る
+        size_t j = lx.skipBlanks(0);
+        if (j < n && lx.s[j] == '#') {
+            size_t e = lx.identEnd(lx.skipBlanks(j + 1));
+            lx.emit(j, e, TOKEN_PREPROCESSOR); i = e;
+            size_t k = lx.skipBlanks(e);
+            if (lx.s.substr(j, e - j).find("include") != std::string_view::npos && k < n && lx.s[k] == '<') {
+                size_t close = lx.s.substr(0, n).find('>', k);
+                i = close == std::string_view::npos ? n : close + 1;
+                lx.emit(k, i, TOKEN_STRING);
+            }
+        }
+    }
+    while (i < n) {
+        char c = lx.s[i], next = i + 1 < n ? lx.s[i + 1] : 0;
+        if (c == '/' && next == '/') { lx.emit(i, n, TOKEN_COMMENT); return continued ? CPP_LINE_COMMENT : CPP_CODE; }
+        if (c == '/' && next == '*') {
+            size_t e = lx.blockCommentEnd(i + 2);
+            if (e == std::string_view::npos) { lx.emit(i, n, TOKEN_COMMENT); return CPP_BLOCK_COMMENT; }
+            lx.emit(i, e, TOKEN_COMMENT); i = e;
+        }
+        else if (c == '"' || c == '\'') {
+            size_t e = lx.quotedEnd(i + 1, c);
+            lx.emit(i, std::min(e, n), TOKEN_STRING);
+            if (e > n && c == '"') return CPP_STRING;
+            i = std::min(e, n);
+        }
+        else if (IsDigit(c) || (c == '.' && IsDigit(next))) { size_t e = lx.numberEnd(i); lx.emit(i, e, TOKEN_NUMBER); i = e; }
+        else if (IsIdentStart(c)) {
+            size_t e = lx.identEnd(i);
+            if (std::binary_search(std::begin(kCppKeywords), std::end(kCppKeywords), lx.s.substr(i, e - i))) lx.emit(i, e, TOKEN_KEYWORD);
+            i = e;
+        }
+        else i++;
+    }
+    return CPP_CODE;
+}
+// JSON (// と /* */ のコメントも読む)。: が続く文字列はキー
+enum { JSON_CODE, JSON_BLOCK_COMMENT };
+static uint8_t LexJson(LineLexer& lx, uint8_t state) {
+    size_t i = 0, n = lx.n;
+    if (state == JSON_BLOCK_COMMENT) {
+        size_t e = lx.blockCommentEnd(0);
+        if (e == std::string_view::npos) { lx.emit(0, n, TOKEN_COMMENT); return JSON_BLOCK_COMMENT; }
+        lx.emit(0, e, TOKEN_COMMENT); i = e;
+    }
+    while (i < n) {
+        char c = lx.s[i], next = i + 1 < n ? lx.s[i + 1] : 0;
+        if (c == '/' && next == '/') { lx.emit(i, n, TOKEN_COMMENT); break; }
+        if (c == '/' && next == '*') {
+            size_t e = lx.blockCommentEnd(i + 2);
+            if (e == std::string_view::npos) { lx.emit(i, n, TOKEN_COMMENT); return JSON_BLOCK_COMMENT; }
+            lx.emit(i, e, TOKEN_COMMENT); i = e;
+        }
+        else if (c == '"') {
+            size_t e = std::min(lx.quotedEnd(i + 1, '"'), n), k = lx.skipBlanks(e);
+            lx.emit(i, e, k < n && lx.s[k] == ':' ? TOKEN_KEY : TOKEN_STRING); i = e;
+        }
+        else if (IsDigit(c) || (c == '-' && IsDigit(next))) { size_t e = lx.numberEnd(i); lx.emit(i, e, TOKEN_NUMBER); i = e; }
+        else if (IsIdentStart(c)) {
+            size_t e = lx.identEnd(i); std::string_view w = lx.s.substr(i, e - i);
+            if (w == "true" || w == "false" || w == "null") lx.emit(i, e, TOKEN_LITERAL);
+            i = e;
+        }
+        else i++;
+    }
+    return JSON_CODE;
+}
+// ログは重要度の語、数字で始まる語 (日時を含む)、引用符の中を塗る。重要度の語は小文字だけのものは [error] や level=error の形のときに限る
+static void LexLog(LineLexer& lx) {
+    size_t i = 0, n = lx.n;
+    while (i < n) {
+        char c = lx.s[i];
+        if (c == '"') { size_t e = std::min(lx.quotedEnd(i + 1, '"'), n); lx.emit(i, e, TOKEN_STRING); i = e; }
+        else if (IsDigit(c)) {
+            size_t e = i;
+            while (e < n && (IsIdentChar(lx.s[e]) || ((lx.s[e] == '.' || lx.s[e] == ':' || lx.s[e] == '-' || lx.s[e] == '/' || lx.s[e] == ',') && e + 1 < n && IsDigit(lx.s[e + 1])))) e++;
+            lx.emit(i, e, TOKEN_NUMBER); i = e;
+        }
+        else if (IsIdentStart(c)) {
+            size_t e = lx.identEnd(i); std::string_view w = lx.s.substr(i, e - i);
+            bool lower = std::all_of(w.begin(), w.end(), [](char ch) { return !(ch >= 'A' && ch <= 'Z'); });
+            bool tagged = i > 0 && (lx.s[i - 1] == '[' || lx.s[i - 1] == '=' || lx.s[i - 1] == '<' || lx.s[i - 1] == '|');
+            if (!lower || tagged)
+                for (const auto& l : kLogLevels) if (EqualsIgnoreCase(w, l.word)) { lx.emit(i, e, l.kind); break; }
+            i = e;
+        }
+        else i++;
+    }
+}
+// INI と YAML の値。引用符の中は文字列、それ以外は値全体が数字か true などのときだけ塗る。前に空白のある comment の文字から後ろはコメント
+static void LexValue(LineLexer& lx, size_t i, std::string_view commentChars) {
+    size_t n = lx.n;
+    i = lx.skipBlanks(i);
+    size_t valueStart = i;
+    while (i < n) {
+        char c = lx.s[i];
+        if (commentChars.find(c) != std::string_view::npos && (i == 0 || IsBlank(lx.s[i - 1]))) { lx.emit(i, n, TOKEN_COMMENT); break; }
+        if ((c == '"' || c == '\'') && i == valueStart) { size_t e = std::min(lx.quotedEnd(i + 1, c), n); lx.emit(i, e, TOKEN_STRING); i = e; valueStart = n; continue; }
+        i++;
+    }
+    if (valueStart >= n) return;
+    size_t e = i; while (e > valueStart && IsBlank(lx.s[e - 1])) e--;
+    std::string_view v = lx.s.substr(valueStart, e - valueStart);
+    if (v.empty()) return;
+    if (IsDigit(v[0]) || ((v[0] == '-' || v[0] == '+' || v[0] == '.') && v.size() > 1 && IsDigit(v[1]))) {
+        if (lx.numberEnd(valueStart) >= e) lx.emit(valueStart, e, TOKEN_NUMBER);
+    }
+    else for (std::string_view lit : { "true", "false", "yes", "no", "on", "off", "null", "~" })
+        if (EqualsIgnoreCase(v, lit)) { lx.emit(valueStart, e, TOKEN_LITERAL); break; }
+}
+static void LexIni(LineLexer& lx) {
+    size_t n = lx.n, j = lx.skipBlanks(0);
+    if (j >= n) return;
+    char c = lx.s[j];
+    if (c == ';' || c == '#') { lx.emit(j, n, TOKEN_COMMENT); return; }
+    if (c == '[') {
+        size_t close = lx.s.substr(0, n).find(']', j), e = close == std::string_view::npos ? n : close + 1;
+        lx.emit(j, e, TOKEN_SECTION); LexValue(lx, e, ";#");
+        return;
+    }
+    size_t k = j; while (k < n && lx.s[k] != '=' && lx.s[k] != ':') k++;
+    if (k == n) return;
+    size_t e = k; while (e > j && IsBlank(lx.s[e - 1])) e--;
+    lx.emit(j, e, TOKEN_KEY);
+    LexValue(lx, k + 1, ";#");
+}
+static void LexYaml(LineLexer& lx) {
+    size_t n = lx.n;
+    if (n >= 3 && (lx.s.substr(0, 3) == "---" || lx.s.substr(0, 3) == "...") && (n == 3 || IsBlank(lx.s[3]))) { lx.emit(0, 3, TOKEN_KEYWORD); LexValue(lx, 3, "#"); return; }
+    size_t j = lx.skipBlanks(0);
+    while (j < n && lx.s[j] == '-' && (j + 1 == n || IsBlank(lx.s[j + 1]))) j = lx.skipBlanks(j + 1);
+    if (j >= n) return;
+    if (lx.s[j] == '#') { lx.emit(j, n, TOKEN_COMMENT); return; }
+    // キーは : と空白 (か行末) の手前まで。引用符の中の : は見ない
+    size_t k = j, key = std::string_view::npos;
+    while (k < n) {
+        char c = lx.s[k];
+        if (c == '"' || c == '\'') { k = std::min(lx.quotedEnd(k + 1, c), n); continue; }
+        if (c == '#' && k > j && IsBlank(lx.s[k - 1])) break;
+        if (c == ':' && (k + 1 == n || IsBlank(lx.s[k + 1]))) { key = k; break; }
+        k++;
+    }
+    size_t v = j;
+    if (key != std::string_view::npos) { lx.emit(j, key, TOKEN_KEY); v = lx.skipBlanks(key + 1); }
+    // アンカー・エイリアス・タグとブロックスカラーの指示子
+    if (v < n && (lx.s[v] == '&' || lx.s[v] == '*' || lx.s[v] == '!' || lx.s[v] == '|' || lx.s[v] == '>')) {
+        size_t e = v + 1; while (e < n && !IsBlank(lx.s[e])) e++;
+        lx.emit(v, e, TOKEN_KEYWORD); v = e;
+    }
+    LexValue(lx, v, "#");
+}
+uint8_t LexLine(SyntaxLanguage lang, std::string_view line, uint8_t state, std::vector<SyntaxToken>* tokens) {
+    size_t n = line.size();
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) n--;
+    LineLexer lx = { line, n, tokens };
+    switch (lang) {
+    case SYNTAX_CPP: return LexCpp(lx, state);
+    case SYNTAX_JSON: return LexJson(lx, state);
+    case SYNTAX_LOG: LexLog(lx); break;
+    case SYNTAX_INI: LexIni(lx); break;
+    case SYNTAX_YAML: LexYaml(lx); break;
+    default: break;
+    }
+    return 0;
+}
+void SyntaxCache::update(size_t lineCount, size_t first, size_t oldEnd, size_t newEnd) {
+    if (!SyntaxHasLineState(language)) return;
+    // \r と \n の間で分かれた改行を編集したときは、直前の行の終わり方も変わる (つながると newEnd == first にもなる)
+    first = std::min({ first ? first - 1 : 0, oldEnd - 1, newEnd - 1 });
+    // 変わった行の後ろは行番号をずらして残し、読み直した行頭の状態が一致したら使う
+    oldEnd = std::min(oldEnd, lineStates.size());
+    if (first + 1 < oldEnd) lineStates.erase(lineStates.begin() + first + 1, lineStates.begin() + oldEnd);
+    if (first + 1 < newEnd && first + 1 <= lineStates.size()) lineStates.insert(lineStates.begin() + first + 1, newEnd - first - 1, (uint8_t)0);
+    lineStates.resize(lineCount);
+    // 使える値は 1 続きでなければならない。確かな行が編集の後ろまであればその部分を、なければ編集前から残っていた範囲を使う
+    if (validLines > oldEnd) { reuseFrom = newEnd; cachedLines = validLines + newEnd - oldEnd; }
+    else {
+        reuseFrom = reuseFrom >= oldEnd ? reuseFrom + newEnd - oldEnd : newEnd;
+        cachedLines = cachedLines >= oldEnd ? cachedLines + newEnd - oldEnd : std::min(cachedLines, first + 1);
+    }
+    validLines = std::min(validLines, first + 1);
+    cachedLines = std::min(std::max(cachedLines, validLines), lineCount);
+}
+bool SyntaxCache::advance(const PieceTable& pt, const std::vector<size_t>& lineStarts, size_t line, uint64_t budgetNs) {
+    if (!SyntaxHasLineState(language) || lineStarts.empty()) return true;
+    size_t count = lineStarts.size();
+    if (lineStates.size() != count) { lineStates.resize(count); validLines = std::min(validLines, count); cachedLines = std::min(cachedLines, count); }
+    if (validLines == 0) { lineStates[0] = 0; validLines = 1; cachedLines = std::max<size_t>(cachedLines, 1); }
+    line = std::min(line, count - 1);
+    if (validLines > line) return true;
+    TRACE_SCOPE("syntaxStates");
+    uint64_t t0 = TraceNowNs();
+    std::string buf;
+    PieceIterator it(pt, lineStarts[validLines - 1]);
+    while (validLines <= line) {
+        size_t b = lineStarts[validLines - 1], e = lineStarts[validLines];
+        buf.clear();
+        it.forEachSpan(e - b, [&](const char* data, size_t m) { buf.append(data, m); return true; });
+        uint8_t s = LexLine(language, buf, lineStates[validLines - 1], nullptr);
+        if (validLines >= reuseFrom && validLines < cachedLines && lineStates[validLines] == s) {
+            // ここから先は編集前の値のまま正しい
+            validLines = cachedLines;
+            if (validLines <= line) it.seek(lineStarts[validLines - 1]);
+            continue;
+        }
+        lineStates[validLines++] = s;
+        cachedLines = std::max(cachedLines, validLines);
+        if ((validLines & 63) == 0 && validLines <= line && TraceNowNs() - t0 >= budgetNs) return false;
+    }
+    return true;
+}
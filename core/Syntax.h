@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "PieceTable.h"
+// 拡張子で決める色分けの種類。どれも 1 行ずつ読む字句解析で、行をまたぐ状態 (ブロックコメントなど) は行頭の状態として持つ
+enum SyntaxLanguage { SYNTAX_PLAIN, SYNTAX_CPP, SYNTAX_JSON, SYNTAX_LOG, SYNTAX_INI, SYNTAX_YAML };
+enum TokenKind : uint8_t { TOKEN_TEXT, TOKEN_KEYWORD, TOKEN_STRING, TOKEN_NUMBER, TOKEN_COMMENT, TOKEN_PREPROCESSOR, TOKEN_KEY, TOKEN_SECTION, TOKEN_LITERAL, TOKEN_ERROR, TOKEN_WARNING, TOKEN_INFO, TOKEN_DEBUG, TOKEN_COUNT };
+// offset は読んだ行 (描画では見えている text) の中のバイト位置
+struct SyntaxToken { size_t offset; size_t len; TokenKind kind; };
+SyntaxLanguage SyntaxLanguageForPath(const char* path);
+#ifdef _WIN32
+SyntaxLanguage SyntaxLanguageForPath(const wchar_t* path);
+#endif
+// 行頭の状態をまたいで持つ種類か (C/C++ と JSON のブロックコメント、C/C++ の行末の \ で続く文字列と行コメント)
+inline bool SyntaxHasLineState(SyntaxLanguage lang) { return lang == SYNTAX_CPP || lang == SYNTAX_JSON; }
+// line (末尾の改行を含んでよい) を行頭の状態 state から読み、色の付く範囲を tokens に足す (nullptr なら状態だけ求める)。行末の状態を返す
+uint8_t LexLine(SyntaxLanguage lang, std::string_view line, uint8_t state, std::vector<SyntaxToken>* tokens);
+// 行ごとの行頭の状態。編集では変わった行から読み直し、行頭の状態が編集前に求めた値と一致した所で残りはそのまま使う
+// 求めるのは描画に要る行までで、その先は見に行くまで求めない
+struct SyntaxCache {
+    // 描画に要る行までに読む量がこれ以下ならその場で求め、多ければアイドル時に求める (それまでは状態 0 とみなして塗る)
+    static constexpr size_t kSyncBytes = (size_t)1 << 20;
+    SyntaxLanguage language = SYNTAX_PLAIN;
+    // 行 i の行頭の状態。[0, validLines) は確か。[reuseFrom, cachedLines) は編集前に求めた値で、読み直した状態が一致すればそのまま使える
+    std::vector<uint8_t> lineStates;
+    size_t validLines = 0, reuseFrom = 0, cachedLines = 0;
+    // 描画が状態を知りたかった最後の行 (アイドル時にここまで求める)
+    size_t wantedLine = 0;
+    void reset(SyntaxLanguage lang) { language = lang; lineStates.clear(); validLines = reuseFrom = cachedLines = wantedLine = 0; }
+    // 行 [first, oldEnd) が [first, newEnd) に置き換わった
+    void update(size_t lineCount, size_t first, size_t oldEnd, size_t newEnd);
+    // line 行目の行頭まで状態を求める。budgetNs を使い切ってまだ届かなければ false
+    bool advance(const PieceTable& pt, const std::vector<size_t>& lineStarts, size_t line, uint64_t budgetNs);
+    // まだ求めていない行は状態 0 とみなす
+    uint8_t stateAt(size_t line) const { return line < validLines ? lineStates[line] : 0; }
+    size_t memoryBytes() const { return lineStates.capacity(); }
+};
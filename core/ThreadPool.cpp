@@ -0,0 +1,105 @@
+#include "ThreadPool.h"
+static thread_local ThreadPool* t_pool = nullptr;
+static thread_local size_t t_workerIndex = (size_t)-1;
+void MainThreadQueue::post(std::function<void()> fn) {
+    bool needWake = false;
+    {
+        std::lock_guard<std::mutex> g(lock);
+        items.push_back(std::move(fn));
+        if (!wakePending) { wakePending = true; needWake = true; }
+    }
+    if (needWake && wake) wake();
+}
+size_t MainThreadQueue::drain() {
+    std::vector<std::function<void()>> batch;
+    { std::lock_guard<std::mutex> g(lock); batch.swap(items); wakePending = false; }
+    for (auto& fn : batch) fn();
+    return batch.size();
+}
+ThreadPool::ThreadPool(unsigned n) {
+    for (unsigned i = 0; i < n; ++i) workers.emplace_back(new Worker());
+    for (unsigned i = 0; i < n; ++i) threads.emplace_back([this, i] { workerLoop(i); });
+}
+ThreadPool::~ThreadPool() {
+    { std::lock_guard<std::mutex> g(sleepLock); stopping = true; }
+    wakeCv.notify_all();
+    for (auto& t : threads) t.join();
+}
+void ThreadPool::submit(TaskPriority prio, std::function<void()> fn) {
+    if (workers.empty()) { fn(); return; }
+    // ワーカー自身が投げたタスクは自分のキューへ (キャッシュが温かいうちに LIFO で処理する)
+    size_t q = (t_pool == this) ? t_workerIndex : nextQueue.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    { std::lock_guard<std::mutex> g(workers[q]->lock); workers[q]->queues[prio].push_back(std::move(fn)); }
+    pending.fetch_add(1, std::memory_order_release);
+    { std::lock_guard<std::mutex> g(sleepLock); }
+    wakeCv.notify_one();
+}
+bool ThreadPool::popTask(size_t self, TaskPriority maxPrio, std::function<void()>& out) {
+    size_t n = workers.size();
+    for (int prio = 0; prio <= (int)maxPrio; ++prio) {
+        if (self < n) {
+            Worker& w = *workers[self];
+            std::lock_guard<std::mutex> g(w.lock);
+            auto& q = w.queues[prio];
+            if (!q.empty()) { out = std::move(q.back()); q.pop_back(); pending.fetch_sub(1, std::memory_order_relaxed); return true; }
+        }
+        for (size_t k = 1; k <= n; ++k) {
+            size_t victim = (self < n ? self + k : k) % n;
+            if (victim == self) continue;
+            Worker& w = *workers[victim];
+            std::lock_guard<std::mutex> g(w.lock);
+            auto& q = w.queues[prio];
+            if (!q.empty()) { out = std::move(q.front()); q.pop_front(); pending.fetch_sub(1, std::memory_order_relaxed); return true; }
+        }
+    }
+    return false;
+}
+bool ThreadPool::runOne(TaskPriority maxPrio) {
+    std::function<void()> fn;
+    if (!popTask(t_pool == this ? t_workerIndex : (size_t)-1, maxPrio, fn)) return false;
+    // 結果を待つ側がいるタスク (TaskGroup) は自分で例外を受け取るので、ここに来るのは投げっぱなしのタスクの例外だけ
+    try { fn(); } catch (...) {}
+    return true;
+}
+void ThreadPool::workerLoop(size_t index) {
+    t_pool = this; t_workerIndex = index;
+    std::function<void()> fn;
+    while (true) {
+        if (popTask(index, TASK_IDLE, fn)) {
+            try { fn(); } catch (...) {}
+            fn = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(sleepLock);
+        wakeCv.wait(lk, [this] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+        if (stopping) return;
+    }
+}
+ThreadPool& SharedThreadPool() {
+    static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1);
+    return pool;
+}
+void TaskGroup::run(std::function<void()> fn) {
+    remaining.fetch_add(1, std::memory_order_relaxed);
+    pool.submit(prio, [this, fn] {
+        std::exception_ptr e;
+        try { fn(); } catch (...) { e = std::current_exception(); }
+        // 減らすのと通知はロックの中で行う (待つ側が述語を見てから眠るまでの間に通知が抜けない)
+        std::lock_guard<std::mutex> g(lock);
+        if (e && !error) error = e;
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) done.notify_all();
+    });
+}
+void TaskGroup::join() {
+    while (remaining.load(std::memory_order_acquire) > 0 && pool.runOne(prio)) {}
+    // 手伝えるタスクがなくなったら、残りを実行中のスレッドが終えるまで眠る
+    // 必ずロックを取ってから戻るので、最後のタスクが通知し終える前にグループが消えることはない
+    std::unique_lock<std::mutex> l(lock);
+    done.wait(l, [this] { return remaining.load(std::memory_order_acquire) == 0; });
+}
+void TaskGroup::wait() {
+    join();
+    std::exception_ptr e;
+    { std::lock_guard<std::mutex> g(lock); e.swap(error); }
+    if (e) std::rethrow_exception(e);
+}
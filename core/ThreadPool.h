@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+// 優先度付きのワークスティーリング・スレッドプール。各ワーカーは自分のキューを後ろから、他人のキューを前から取る
+enum TaskPriority { TASK_INTERACTIVE = 0, TASK_BACKGROUND, TASK_IDLE, TASK_PRIORITY_COUNT };
+struct CancellationToken {
+    std::shared_ptr<std::atomic<bool>> flag = std::make_shared<std::atomic<bool>>(false);
+    void cancel() const { flag->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return flag->load(std::memory_order_relaxed); }
+};
+// ワーカーから UI スレッドへ結果を渡すキュー。wake は最初の 1 件でだけ呼ばれる (Windows では PostMessage)
+struct MainThreadQueue {
+    std::function<void()> wake;
+    void post(std::function<void()> fn);
+    size_t drain();
+private:
+    std::mutex lock; std::vector<std::function<void()>> items; bool wakePending = false;
+};
+struct ThreadPool {
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+    unsigned threadCount() const { return (unsigned)threads.size(); }
+    void submit(TaskPriority prio, std::function<void()> fn);
+    // work(token) をワーカーで実行し、取り消されていなければ done(result) を UI スレッドで呼ぶ
+    template <class Work, class Done>
+    void submit(TaskPriority prio, const CancellationToken& token, MainThreadQueue& ui, Work work, Done done) {
+        submit(prio, [token, &ui, work, done]() mutable {
+            if (token.isCancelled()) return;
+            auto result = std::make_shared<decltype(work(token))>(work(token));
+            if (token.isCancelled()) return;
+            ui.post([token, done, result]() mutable { if (!token.isCancelled()) done(std::move(*result)); });
+        });
+    }
+    // maxPrio 以下 (より急ぎ) のタスクを 1 つ呼び出し元で実行する。待つ側が手伝うために使う
+    bool runOne(TaskPriority maxPrio);
+private:
+    struct Worker { std::mutex lock; std::deque<std::function<void()>> queues[TASK_PRIORITY_COUNT]; };
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex sleepLock; std::condition_variable wakeCv; bool stopping = false;
+    std::atomic<size_t> pending{ 0 }; std::atomic<unsigned> nextQueue{ 0 };
+    bool popTask(size_t self, TaskPriority maxPrio, std::function<void()>& out);
+    void workerLoop(size_t index);
+};
+// 共有プール (論理コア数 - 1 スレッド、最低 1)
+ThreadPool& SharedThreadPool();
+// まとめて投げたタスクの完了を待つ。待っている間は同じ優先度までのタスクを手伝い、手伝えるものがなくなったら眠る
+// タスクが投げた例外は最初の 1 つを取っておき、wait() で投げ直す (デストラクタは待つだけで投げない)
+struct TaskGroup {
+    ThreadPool& pool; TaskPriority prio; std::atomic<size_t> remaining{ 0 };
+    explicit TaskGroup(ThreadPool& p, TaskPriority pr = TASK_INTERACTIVE) : pool(p), prio(pr) {}
+    ~TaskGroup() { join(); }
+    void run(std::function<void()> fn);
+    void wait();
+private:
+    std::mutex lock; std::condition_variable done; std::exception_ptr error;
+    void join();
+};
+// fn(0..count-1) を並列に呼ぶ。0 番は呼び出し元スレッドで実行する。fn が投げた例外は全部終わってから呼び出し元へ投げる
+template <class F>
+void ParallelFor(ThreadPool& pool, size_t count, F fn) {
+    if (count <= 1 || pool.threadCount() == 0) { for (size_t i = 0; i < count; ++i) fn(i); return; }
+    TaskGroup group(pool);
+    for (size_t i = 1; i < count; ++i) group.run([&fn, i] { fn(i); });
+    fn(0);
+    group.wait();
+}
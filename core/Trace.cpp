@@ -0,0 +1,63 @@
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+std::atomic<bool> g_traceEnabled{ false };
+thread_local TraceSink* t_traceSink = nullptr;
+static const size_t kTraceCapacity = 1 << 16;
+struct TraceEvent { const char* name; uint64_t begin; uint64_t end; };
+struct TraceBuffer {
+    std::mutex lock; std::vector<TraceEvent> events; size_t next = 0; bool wrapped = false; uint32_t tid = 0;
+};
+static std::mutex g_traceRegistryLock;
+static std::vector<std::shared_ptr<TraceBuffer>> g_traceBuffers;
+static const std::chrono::steady_clock::time_point g_traceEpoch = std::chrono::steady_clock::now();
+static TraceBuffer& ThreadBuffer() {
+    thread_local std::shared_ptr<TraceBuffer> buf;
+    if (!buf) {
+        buf = std::make_shared<TraceBuffer>();
+        buf->events.resize(kTraceCapacity);
+        std::lock_guard<std::mutex> g(g_traceRegistryLock);
+        buf->tid = (uint32_t)g_traceBuffers.size() + 1;
+        g_traceBuffers.push_back(buf);
+    }
+    return *buf;
+}
+void TraceSetEnabled(bool enabled) { g_traceEnabled.store(enabled, std::memory_order_relaxed); }
+uint64_t TraceNowNs() { return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_traceEpoch).count() + 1; }
+void TraceRecord(const char* name, uint64_t beginNs, uint64_t endNs) {
+    TraceBuffer& b = ThreadBuffer();
+    std::lock_guard<std::mutex> g(b.lock);
+    b.events[b.next] = { name, beginNs, endNs };
+    if (++b.next == kTraceCapacity) { b.next = 0; b.wrapped = true; }
+}
+void TraceClear() {
+    std::lock_guard<std::mutex> g(g_traceRegistryLock);
+    for (auto& b : g_traceBuffers) { std::lock_guard<std::mutex> bg(b->lock); b->next = 0; b->wrapped = false; }
+}
+static bool WriteChromeJson(FILE* f) {
+    if (!f) return false;
+    fputs("{\"traceEvents\":[\n", f);
+    bool first = true;
+    std::lock_guard<std::mutex> g(g_traceRegistryLock);
+    for (auto& b : g_traceBuffers) {
+        std::lock_guard<std::mutex> bg(b->lock);
+        size_t count = b->wrapped ? kTraceCapacity : b->next;
+        size_t start = b->wrapped ? b->next : 0;
+        for (size_t i = 0; i < count; ++i) {
+            const TraceEvent& e = b->events[(start + i) % kTraceCapacity];
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"miu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n", e.name, b->tid, e.begin / 1000.0, (e.end - e.begin) / 1000.0);
+            first = false;
+        }
+    }
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+    fclose(f);
+    return true;
+}
+bool TraceWriteChromeJson(const char* path) { return WriteChromeJson(fopen(path, "wb")); }
+#ifdef _WIN32
+bool TraceWriteChromeJson(const wchar_t* path) { return WriteChromeJson(_wfopen(path, L"wb")); }
+#endif
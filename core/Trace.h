@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+// 実行時に有効化できるスパン計測。スレッドごとのリングバッファに溜め、Chrome/Perfetto の trace JSON で書き出す
+extern std::atomic<bool> g_traceEnabled;
+void TraceSetEnabled(bool enabled);
+inline bool TraceIsEnabled() { return g_traceEnabled.load(std::memory_order_relaxed); }
+uint64_t TraceNowNs();
+void TraceRecord(const char* name, uint64_t beginNs, uint64_t endNs);
+void TraceClear();
+bool TraceWriteChromeJson(const char* path);
+#ifdef _WIN32
+bool TraceWriteChromeJson(const wchar_t* path);
+#endif
+// 計測の有効/無効に関係なくスパンを受け取る監視者 (ウォッチドッグ用)。登録したスレッドのスコープだけが届く
+struct TraceSink {
+    virtual void spanBegin(const char* name) = 0;
+    virtual void spanEnd(const char* name, uint64_t beginNs, uint64_t endNs) = 0;
+protected:
+    ~TraceSink() = default;
+};
+extern thread_local TraceSink* t_traceSink;
+struct TraceScope {
+    const char* name; uint64_t begin; TraceSink* sink;
+    explicit TraceScope(const char* n) : name(n), begin(0), sink(t_traceSink) {
+        if (sink) sink->spanBegin(n);
+        if (sink || TraceIsEnabled()) begin = TraceNowNs();
+    }
+    ~TraceScope() {
+        if (!begin) return;
+        uint64_t end = TraceNowNs();
+        if (TraceIsEnabled()) TraceRecord(name, begin, end);
+        if (sink) sink->spanEnd(name, begin, end);
+    }
+};
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
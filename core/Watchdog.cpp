@@ -0,0 +1,115 @@
+#include "Watchdog.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+static const size_t kMaxSpans = 48;
+#ifdef _WIN32
+static FILE* OpenLog(const std::wstring& p) { return _wfopen(p.c_str(), L"ab"); }
+static void RotateLog(const std::wstring& p) { std::wstring old = p + L".1"; _wremove(old.c_str()); _wrename(p.c_str(), old.c_str()); }
+#else
+static FILE* OpenLog(const std::string& p) { return fopen(p.c_str(), "ab"); }
+static void RotateLog(const std::string& p) { std::string old = p + ".1"; remove(old.c_str()); rename(p.c_str(), old.c_str()); }
+#endif
+static std::string Timestamp() {
+    time_t t = time(nullptr); struct tm tmv;
+#ifdef _WIN32
+    localtime_s(&tmv, &t);
+#else
+    localtime_r(&t, &tmv);
+#endif
+    char b[32]; strftime(b, sizeof(b), "%Y-%m-%d %H:%M:%S", &tmv);
+    return b;
+}
+static std::string Ms(uint64_t ns) { char b[32]; snprintf(b, sizeof(b), "%.1f ms", ns / 1e6); return b; }
+#ifdef _WIN32
+void Watchdog::start(const std::wstring& path) {
+#else
+void Watchdog::start(const std::string& path) {
+#endif
+    stop();
+    logPath = path; running = true; stopping = false;
+    t_traceSink = this;
+    monitor = std::thread([this] { monitorLoop(); });
+}
+void Watchdog::stop() {
+    if (!running) return;
+    { std::lock_guard<std::mutex> g(monitorLock); stopping = true; }
+    monitorCv.notify_all();
+    if (monitor.joinable()) monitor.join();
+    if (t_traceSink == this) t_traceSink = nullptr;
+    running = false; begin = 0;
+}
+void Watchdog::pause() {
+    if (pauseDepth++ == 0) { pauseBegin = TraceNowNs(); livePaused.store(true, std::memory_order_relaxed); }
+}
+void Watchdog::resume() {
+    if (pauseDepth == 0 || --pauseDepth > 0) return;
+    uint64_t d = TraceNowNs() - pauseBegin;
+    if (begin) { pausedNs += d; liveBegin.store(liveBegin.load(std::memory_order_relaxed) + d, std::memory_order_relaxed); }
+    livePaused.store(false, std::memory_order_relaxed);
+}
+void Watchdog::spanBegin(const char* name) {
+    opStack.push_back(name);
+    liveOp.store(name, std::memory_order_relaxed);
+}
+void Watchdog::spanEnd(const char* name, uint64_t beginNs, uint64_t endNs) {
+    if (!opStack.empty()) opStack.pop_back();
+    liveOp.store(opStack.empty() ? nullptr : opStack.back(), std::memory_order_relaxed);
+    if (!begin || pauseDepth > 0 || beginNs < begin) return;
+    int depth = (int)opStack.size();
+    // 同じ階層で続けて呼ばれたスコープ (ループ内の findText 等) は 1 行にまとめる
+    if (!spans.empty() && spans.back().name == name && spans.back().depth == depth) { spans.back().durNs += endNs - beginNs; spans.back().count++; return; }
+    if (spans.size() < kMaxSpans) spans.push_back({ name, beginNs, endNs - beginNs, depth, 1 });
+    else droppedSpans++;
+}
+std::string Watchdog::messageLabel(unsigned message) const {
+    const char* n = messageName ? messageName(message) : nullptr;
+    char b[64];
+    if (n) snprintf(b, sizeof(b), "%s", n); else snprintf(b, sizeof(b), "message 0x%04X", message);
+    return b;
+}
+void Watchdog::report(uint64_t elapsedNs) {
+    std::string s = "[" + Timestamp() + "] slow " + messageLabel(curMessage);
+    char b[64]; snprintf(b, sizeof(b), " wParam=0x%llX: ", (unsigned long long)curWParam);
+    s += b; s += Ms(elapsedNs); s += " (budget "; s += Ms(budgetNs); s += ")\n";
+    if (describe) { s += "  "; s += describe(); s += "\n"; }
+    std::sort(spans.begin(), spans.end(), [](const WatchdogSpan& a, const WatchdogSpan& b) { return a.begin != b.begin ? a.begin < b.begin : a.depth < b.depth; });
+    uint64_t traced = 0;
+    for (const auto& sp : spans) {
+        if (sp.depth == 0) traced += sp.durNs;
+        s.append(2 + sp.depth * 2, ' '); s += sp.name; s += ' '; s += Ms(sp.durNs);
+        if (sp.count > 1) { snprintf(b, sizeof(b), " (x%d)", sp.count); s += b; }
+        s += '\n';
+    }
+    if (droppedSpans) { snprintf(b, sizeof(b), "  ... %zu more spans\n", droppedSpans); s += b; }
+    if (elapsedNs >= traced + 100000) { s += "  (untraced "; s += Ms(elapsedNs - traced); s += ")\n"; }
+    writeLog(s);
+}
+// UI スレッドが戻ってこない (フリーズ) 場合に備え、別スレッドから実行中の操作名だけを書き残す
+void Watchdog::monitorLoop() {
+    uint64_t reportedSeq = 0;
+    std::unique_lock<std::mutex> lk(monitorLock);
+    while (!stopping) {
+        monitorCv.wait_for(lk, std::chrono::milliseconds(250));
+        if (stopping) break;
+        uint64_t b = liveBegin.load(std::memory_order_acquire), seq = liveSeq.load(std::memory_order_relaxed);
+        if (!b || livePaused.load(std::memory_order_relaxed) || seq == reportedSeq) continue;
+        uint64_t now = TraceNowNs();
+        if (now < b || now - b < hangNs) continue;
+        reportedSeq = seq;
+        const char* op = liveOp.load(std::memory_order_relaxed);
+        std::string s = "[" + Timestamp() + "] still running " + messageLabel(liveMessage.load(std::memory_order_relaxed)) + " after " + Ms(now - b);
+        s += op ? std::string(" in ") + op : std::string(" (untraced)");
+        s += '\n';
+        lk.unlock(); writeLog(s); lk.lock();
+    }
+}
+void Watchdog::writeLog(const std::string& text) {
+    std::lock_guard<std::mutex> g(logLock);
+    FILE* f = OpenLog(logPath);
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) >= maxLogBytes) { fclose(f); RotateLog(logPath); if (!(f = OpenLog(logPath))) return; }
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+}
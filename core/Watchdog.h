@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Trace.h"
+// UI スレッドのメッセージ処理を監視し、予算を超えたものを内訳付きで診断ログ (ローテーション付き) に残す
+struct WatchdogSpan { const char* name; uint64_t begin; uint64_t durNs; int depth; int count; };
+struct Watchdog : TraceSink {
+    uint64_t budgetNs = 50000000ull;
+    uint64_t hangNs = 2000000000ull;
+    long maxLogBytes = 1 << 20;
+    const char* (*messageName)(unsigned message) = nullptr;
+    std::function<std::string()> describe;
+    ~Watchdog() { stop(); }
+    // start を呼んだスレッドが監視対象になる
+#ifdef _WIN32
+    void start(const std::wstring& path);
+#else
+    void start(const std::string& path);
+#endif
+    void stop();
+    bool isRunning() const { return running; }
+    void beginMessage(unsigned message, uint64_t wParam) {
+        if (!running) return;
+        curMessage = message; curWParam = wParam; pausedNs = 0; spans.clear(); droppedSpans = 0;
+        begin = TraceNowNs();
+        liveMessage.store(message, std::memory_order_relaxed); liveSeq.fetch_add(1, std::memory_order_relaxed);
+        liveBegin.store(begin, std::memory_order_release);
+    }
+    void endMessage() {
+        if (!begin) return;
+        uint64_t elapsed = TraceNowNs() - begin - pausedNs;
+        liveBegin.store(0, std::memory_order_release);
+        if (elapsed >= budgetNs) report(elapsed);
+        begin = 0;
+    }
+    // モーダルダイアログやサイズ変更ループなど、ユーザー待ちの時間を計測から除く
+    void pause();
+    void resume();
+    void spanBegin(const char* name) override;
+    void spanEnd(const char* name, uint64_t beginNs, uint64_t endNs) override;
+    struct Message {
+        Watchdog& w;
+        Message(Watchdog& w, unsigned message, uint64_t wParam) : w(w) { w.beginMessage(message, wParam); }
+        ~Message() { w.endMessage(); }
+    };
+    struct Pause {
+        Watchdog& w;
+        explicit Pause(Watchdog& w) : w(w) { w.pause(); }
+        ~Pause() { w.resume(); }
+    };
+private:
+    bool running = false;
+    uint64_t begin = 0, pausedNs = 0, pauseBegin = 0; int pauseDepth = 0;
+    unsigned curMessage = 0; uint64_t curWParam = 0;
+    std::vector<WatchdogSpan> spans; size_t droppedSpans = 0;
+    std::vector<const char*> opStack;
+    std::atomic<uint64_t> liveBegin{ 0 }, liveSeq{ 0 };
+    std::atomic<unsigned> liveMessage{ 0 };
+    std::atomic<bool> livePaused{ false };
+    std::atomic<const char*> liveOp{ nullptr };
+    std::thread monitor; std::mutex monitorLock; std::condition_variable monitorCv; bool stopping = false;
+    std::mutex logLock;
+#ifdef _WIN32
+    std::wstring logPath;
+#else
+    std::string logPath;
+#endif
+    std::string messageLabel(unsigned message) const;
+    void report(uint64_t elapsedNs);
+    void monitorLoop();
+    void writeLog(const std::string& text);
+};
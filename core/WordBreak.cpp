@@ -0,0 +1,271 @@
+#include "WordBreak.h"
+#include <algorithm>
+#include "Grapheme.h"
+// (先頭のコード点 << 4) | 区分 の並び。次の要素の手前までが同じ区分。Unicode 14.0 の White_Space (WC_SPACE)、Word_Break の Extend / Format / ZWJ (WC_EXTEND) と
+// Katakana、Script の Hiragana、Ideographic と Han の文字 (WC_HAN)、General_Category の文字・数字・結合文字・連結句読点と未割り当て (WC_WORD) から作った。残りは WC_PUNCT
+static constexpr uint32_t kWordRuns[] = {
+    0x2, 0x90, 0xA1, 0xB0, 0xD1, 0xE2, 0x200, 0x212, 0x303, 0x3A2, 0x413, 0x5B2, 0x5F3, 0x602, 0x613, 0x7B2, 0x850, 0x862, 0xA00, 0xA12, 0xAA3, 0xAB2,
+    0xAD7, 0xAE2, 0xB23, 0xB42, 0xB53, 0xB62, 0xB93, 0xBB2, 0xBC3, 0xBF2, 0xC03, 0xD72, 0xD83, 0xF72, 0xF83, 0x2C22, 0x2C63, 0x2D22, 0x2E03, 0x2E52,
+    0x2EC3, 0x2ED2, 0x2EE3, 0x2EF2, 0x3007, 0x3703, 0x3752, 0x3763, 0x37E2, 0x37F3, 0x3842, 0x3863, 0x3872, 0x3883, 0x3F62, 0x3F73, 0x4822, 0x4837,
+    0x48A3, 0x55A2, 0x5603, 0x5892, 0x58B3, 0x58D2, 0x5903, 0x5917, 0x5BE2, 0x5BF7, 0x5C02, 0x5C17, 0x5C32, 0x5C47, 0x5C62, 0x5C77, 0x5C83, 0x5F32,
+    0x5F53, 0x6007, 0x6062, 0x6107, 0x61B2, 0x61C7, 0x61D2, 0x6203, 0x64B7, 0x6603, 0x66A2, 0x66E3, 0x6707, 0x6713, 0x6D42, 0x6D53, 0x6D67, 0x6DE2,
+    0x6DF7, 0x6E53, 0x6E77, 0x6E92, 0x6EA7, 0x6EE3, 0x6FD2, 0x6FF3, 0x7002, 0x70E3, 0x70F7, 0x7103, 0x7117, 0x7123, 0x7307, 0x74B3, 0x7A67, 0x7B13,
+    0x7EB7, 0x7F43, 0x7F62, 0x7FA3, 0x7FD7, 0x7FE2, 0x8003, 0x8167, 0x81A3, 0x81B7, 0x8243, 0x8257, 0x8283, 0x8297, 0x82E3, 0x8302, 0x83F3, 0x8597,
+    0x85C3, 0x85E2, 0x85F3, 0x8882, 0x8893, 0x8907, 0x8923, 0x8987, 0x8A03, 0x8CA7, 0x9043, 0x93A7, 0x93D3, 0x93E7, 0x9503, 0x9517, 0x9583, 0x9627,
+    0x9642, 0x9663, 0x9702, 0x9713, 0x9817, 0x9843, 0x9BC7, 0x9BD3, 0x9BE7, 0x9C53, 0x9C77, 0x9C93, 0x9CB7, 0x9CE3, 0x9D77, 0x9D83, 0x9E27, 0x9E43,
+    0x9F22, 0x9F43, 0x9FA2, 0x9FC3, 0x9FD2, 0x9FE7, 0x9FF3, 0xA017, 0xA043, 0xA3C7, 0xA3D3, 0xA3E7, 0xA433, 0xA477, 0xA493, 0xA4B7, 0xA4E3, 0xA517,
+    0xA523, 0xA707, 0xA723, 0xA757, 0xA762, 0xA773, 0xA817, 0xA843, 0xABC7, 0xABD3, 0xABE7, 0xAC63, 0xAC77, 0xACA3, 0xACB7, 0xACE3, 0xAE27, 0xAE43,
+    0xAF02, 0xAF23, 0xAFA7, 0xB003, 0xB017, 0xB043, 0xB3C7, 0xB3D3, 0xB3E7, 0xB453, 0xB477, 0xB493, 0xB4B7, 0xB4E3, 0xB557, 0xB583, 0xB627, 0xB643,
+    0xB702, 0xB713, 0xB827, 0xB833, 0xBBE7, 0xBC33, 0xBC67, 0xBC93, 0xBCA7, 0xBCE3, 0xBD77, 0xBD83, 0xBF32, 0xBFB3, 0xC007, 0xC053, 0xC3C7, 0xC3D3,
+    0xC3E7, 0xC453, 0xC467, 0xC493, 0xC4A7, 0xC4E3, 0xC557, 0xC573, 0xC627, 0xC643, 0xC772, 0xC783, 0xC7F2, 0xC803, 0xC817, 0xC842, 0xC853, 0xCBC7,
+    0xCBD3, 0xCBE7, 0xCC53, 0xCC67, 0xCC93, 0xCCA7, 0xCCE3, 0xCD57, 0xCD73, 0xCE27, 0xCE43, 0xD007, 0xD043, 0xD3B7, 0xD3D3, 0xD3E7, 0xD453, 0xD467,
+    0xD493, 0xD4A7, 0xD4E3, 0xD4F2, 0xD503, 0xD577, 0xD583, 0xD627, 0xD643, 0xD792, 0xD7A3, 0xD817, 0xD843, 0xDCA7, 0xDCB3, 0xDCF7, 0xDD53, 0xDD67,
+    0xDD73, 0xDD87, 0xDE03, 0xDF27, 0xDF42, 0xDF53, 0xE317, 0xE323, 0xE347, 0xE3B3, 0xE3F2, 0xE403, 0xE477, 0xE4F2, 0xE503, 0xE5A2, 0xE5C3, 0xEB17,
+    0xEB23, 0xEB47, 0xEBD3, 0xEC87, 0xECE3, 0xF012, 0xF187, 0xF1A2, 0xF203, 0xF342, 0xF357, 0xF362, 0xF377, 0xF382, 0xF397, 0xF3A2, 0xF3E7, 0xF403,
+    0xF717, 0xF852, 0xF867, 0xF883, 0xF8D7, 0xF983, 0xF997, 0xFBD3, 0xFBE2, 0xFC67, 0xFC72, 0xFCD3, 0xFCE2, 0xFDB3, 0x102B7, 0x103F3, 0x104A2,
+    0x10503, 0x10567, 0x105A3, 0x105E7, 0x10613, 0x10627, 0x10653, 0x10677, 0x106E3, 0x10717, 0x10753, 0x10827, 0x108E3, 0x108F7, 0x10903, 0x109A7,
+    0x109E2, 0x10A03, 0x10FB2, 0x10FC3, 0x135D7, 0x13602, 0x13693, 0x13902, 0x139A3, 0x14002, 0x14013, 0x166D2, 0x166F3, 0x16800, 0x16813, 0x169B2,
+    0x169D3, 0x16EB2, 0x16EE3, 0x17127, 0x17163, 0x17327, 0x17352, 0x17373, 0x17527, 0x17543, 0x17727, 0x17743, 0x17B47, 0x17D42, 0x17D73, 0x17D82,
+    0x17DC3, 0x17DD7, 0x17DE3, 0x18002, 0x180B7, 0x18103, 0x18857, 0x18873, 0x18A97, 0x18AA3, 0x19207, 0x192C3, 0x19307, 0x193C3, 0x19402, 0x19413,
+    0x19442, 0x19463, 0x19DE2, 0x1A003, 0x1A177, 0x1A1C3, 0x1A1E2, 0x1A203, 0x1A557, 0x1A5F3, 0x1A607, 0x1A7D3, 0x1A7F7, 0x1A803, 0x1AA02, 0x1AA73,
+    0x1AA82, 0x1AAE3, 0x1AB07, 0x1ACF3, 0x1B007, 0x1B053, 0x1B347, 0x1B453, 0x1B5A2, 0x1B6B7, 0x1B742, 0x1B7F3, 0x1B807, 0x1B833, 0x1BA17, 0x1BAE3,
+    0x1BE67, 0x1BF43, 0x1BFC2, 0x1C003, 0x1C247, 0x1C383, 0x1C3B2, 0x1C403, 0x1C7E2, 0x1C803, 0x1CC02, 0x1CC83, 0x1CD07, 0x1CD32, 0x1CD47, 0x1CE93,
+    0x1CED7, 0x1CEE3, 0x1CF47, 0x1CF53, 0x1CF77, 0x1CFA3, 0x1DC07, 0x1E003, 0x1FBD2, 0x1FBE3, 0x1FBF2, 0x1FC23, 0x1FCD2, 0x1FD03, 0x1FDD2, 0x1FE03,
+    0x1FED2, 0x1FF03, 0x1FFD2, 0x1FFF3, 0x20000, 0x200B2, 0x200C7, 0x20102, 0x20280, 0x202A7, 0x202F0, 0x20302, 0x203F3, 0x20412, 0x20543, 0x20552,
+    0x205F0, 0x20607, 0x20653, 0x20667, 0x20703, 0x207A2, 0x207F3, 0x208A2, 0x208F3, 0x20A02, 0x20C13, 0x20D07, 0x20F13, 0x21002, 0x21023, 0x21032,
+    0x21073, 0x21082, 0x210A3, 0x21142, 0x21153, 0x21162, 0x21193, 0x211E2, 0x21243, 0x21252, 0x21263, 0x21272, 0x21283, 0x21292, 0x212A3, 0x212E2,
+    0x212F3, 0x213A2, 0x213C3, 0x21402, 0x21453, 0x214A2, 0x214E3, 0x214F2, 0x21503, 0x218A2, 0x218C3, 0x21902, 0x24273, 0x24402, 0x244B3, 0x249C2,
+    0x24EA3, 0x25002, 0x27763, 0x27942, 0x2B743, 0x2B762, 0x2B963, 0x2B972, 0x2C003, 0x2CE52, 0x2CEB3, 0x2CEF7, 0x2CF23, 0x2CF92, 0x2CFD3, 0x2CFE2,
+    0x2D003, 0x2D702, 0x2D713, 0x2D7F7, 0x2D803, 0x2DE07, 0x2E002, 0x2E2F3, 0x2E302, 0x2E5E3, 0x2E802, 0x2E9A3, 0x2E9B2, 0x2EF43, 0x2F002, 0x2FD63,
+    0x2FF02, 0x2FFC3, 0x30000, 0x30012, 0x30056, 0x30082, 0x30216, 0x302A7, 0x30302, 0x30315, 0x30362, 0x30386, 0x303C3, 0x303D2, 0x30403, 0x30414,
+    0x30973, 0x30997, 0x309B5, 0x309D4, 0x30A05, 0x30FB2, 0x30FC5, 0x31003, 0x31902, 0x31923, 0x31962, 0x31A03, 0x31C02, 0x31E43, 0x31F05, 0x32002,
+    0x321F3, 0x322A2, 0x32483, 0x32502, 0x32513, 0x32602, 0x32803, 0x328A2, 0x32B13, 0x32C02, 0x32D05, 0x32FF2, 0x33005, 0x33582, 0x34006, 0x4DC02,
+    0x4E006, 0xA0003, 0xA4902, 0xA4C73, 0xA4FE2, 0xA5003, 0xA60D2, 0xA6103, 0xA66F7, 0xA6732, 0xA6747, 0xA67E2, 0xA67F3, 0xA69E7, 0xA6A03, 0xA6F07,
+    0xA6F22, 0xA6F83, 0xA7002, 0xA7173, 0xA7202, 0xA7223, 0xA7892, 0xA78B3, 0xA8027, 0xA8033, 0xA8067, 0xA8073, 0xA80B7, 0xA80C3, 0xA8237, 0xA8282,
+    0xA82C7, 0xA82D3, 0xA8362, 0xA83A3, 0xA8742, 0xA8783, 0xA8807, 0xA8823, 0xA8B47, 0xA8C63, 0xA8CE2, 0xA8D03, 0xA8E07, 0xA8F23, 0xA8F82, 0xA8FB3,
+    0xA8FC2, 0xA8FD3, 0xA8FF7, 0xA9003, 0xA9267, 0xA92E2, 0xA9303, 0xA9477, 0xA9543, 0xA95F2, 0xA9603, 0xA9807, 0xA9843, 0xA9B37, 0xA9C12, 0xA9CE3,
+    0xA9DE2, 0xA9E03, 0xA9E57, 0xA9E63, 0xAA297, 0xAA373, 0xAA437, 0xAA443, 0xAA4C7, 0xAA4E3, 0xAA5C2, 0xAA603, 0xAA772, 0xAA7A3, 0xAA7B7, 0xAA7E3,
+    0xAAB07, 0xAAB13, 0xAAB27, 0xAAB53, 0xAAB77, 0xAAB93, 0xAABE7, 0xAAC03, 0xAAC17, 0xAAC23, 0xAADE2, 0xAAE03, 0xAAEB7, 0xAAF02, 0xAAF23, 0xAAF57,
+    0xAAF73, 0xAB5B2, 0xAB5C3, 0xAB6A2, 0xAB6C3, 0xABE37, 0xABEB2, 0xABEC7, 0xABEE3, 0xD8002, 0xE0003, 0xF9006, 0xFA6E3, 0xFA706, 0xFADA3, 0xFB1E7,
+    0xFB1F3, 0xFB292, 0xFB2A3, 0xFBB22, 0xFBC33, 0xFD3E2, 0xFD503, 0xFDCF2, 0xFDD03, 0xFDFC2, 0xFE007, 0xFE102, 0xFE1A3, 0xFE207, 0xFE302, 0xFE333,
+    0xFE352, 0xFE4D3, 0xFE502, 0xFE533, 0xFE542, 0xFE673, 0xFE682, 0xFE6C3, 0xFEFF7, 0xFF003, 0xFF012, 0xFF103, 0xFF1A2, 0xFF213, 0xFF3B2, 0xFF3F3,
+    0xFF402, 0xFF413, 0xFF5B2, 0xFF665, 0xFF9E7, 0xFFA03, 0xFFE02, 0xFFE73, 0xFFE82, 0xFFEF3, 0xFFF97, 0xFFFC2, 0xFFFE3, 0x101002, 0x101033, 0x101372,
+    0x101403, 0x101792, 0x1018A3, 0x1018C2, 0x1018F3, 0x101902, 0x1019D3, 0x101A02, 0x101A13, 0x101D02, 0x101FD7, 0x101FE3, 0x102E07, 0x102E13,
+    0x103767, 0x1037B3, 0x1039F2, 0x103A03, 0x103D02, 0x103D13, 0x1056F2, 0x105703, 0x108572, 0x108583, 0x108772, 0x108793, 0x1091F2, 0x109203,
+    0x1093F2, 0x109403, 0x10A017, 0x10A043, 0x10A057, 0x10A073, 0x10A0C7, 0x10A103, 0x10A387, 0x10A3B3, 0x10A3F7, 0x10A403, 0x10A502, 0x10A593,
+    0x10A7F2, 0x10A803, 0x10AC82, 0x10AC93, 0x10AE57, 0x10AE73, 0x10AF02, 0x10AF73, 0x10B392, 0x10B403, 0x10B992, 0x10B9D3, 0x10D247, 0x10D283,
+    0x10EAB7, 0x10EAD2, 0x10EAE3, 0x10F467, 0x10F513, 0x10F552, 0x10F5A3, 0x10F827, 0x10F862, 0x10F8A3, 0x110007, 0x110033, 0x110387, 0x110472,
+    0x1104E3, 0x110707, 0x110713, 0x110737, 0x110753, 0x1107F7, 0x110833, 0x110B07, 0x110BB2, 0x110BD7, 0x110BE2, 0x110C27, 0x110C33, 0x110CD7,
+    0x110CE3, 0x111007, 0x111033, 0x111277, 0x111353, 0x111402, 0x111443, 0x111457, 0x111473, 0x111737, 0x111742, 0x111763, 0x111807, 0x111833,
+    0x111B37, 0x111C13, 0x111C52, 0x111C97, 0x111CD2, 0x111CE7, 0x111D03, 0x111DB2, 0x111DC3, 0x111DD2, 0x111E03, 0x1122C7, 0x112382, 0x1123E7,
+    0x1123F3, 0x112A92, 0x112AA3, 0x112DF7, 0x112EB3, 0x113007, 0x113043, 0x1133B7, 0x1133D3, 0x1133E7, 0x113453, 0x113477, 0x113493, 0x1134B7,
+    0x1134E3, 0x113577, 0x113583, 0x113627, 0x113643, 0x113667, 0x1136D3, 0x113707, 0x113753, 0x114357, 0x114473, 0x1144B2, 0x114503, 0x1145A2,
+    0x1145C3, 0x1145D2, 0x1145E7, 0x1145F3, 0x114B07, 0x114C43, 0x114C62, 0x114C73, 0x115AF7, 0x115B63, 0x115B87, 0x115C12, 0x115D83, 0x115DC7,
+    0x115DE3, 0x116307, 0x116412, 0x116443, 0x116602, 0x1166D3, 0x116AB7, 0x116B83, 0x116B92, 0x116BA3, 0x1171D7, 0x1172C3, 0x1173C2, 0x117403,
+    0x1182C7, 0x1183B2, 0x1183C3, 0x119307, 0x119363, 0x119377, 0x119393, 0x1193B7, 0x1193F3, 0x119407, 0x119413, 0x119427, 0x119442, 0x119473,
+    0x119D17, 0x119D83, 0x119DA7, 0x119E13, 0x119E22, 0x119E33, 0x119E47, 0x119E53, 0x11A017, 0x11A0B3, 0x11A337, 0x11A3A3, 0x11A3B7, 0x11A3F2,
+    0x11A477, 0x11A483, 0x11A517, 0x11A5C3, 0x11A8A7, 0x11A9A2, 0x11A9D3, 0x11A9E2, 0x11AA33, 0x11C2F7, 0x11C373, 0x11C387, 0x11C403, 0x11C412,
+    0x11C463, 0x11C702, 0x11C723, 0x11C927, 0x11CA83, 0x11CA97, 0x11CB73, 0x11D317, 0x11D373, 0x11D3A7, 0x11D3B3, 0x11D3C7, 0x11D3E3, 0x11D3F7,
+    0x11D463, 0x11D477, 0x11D483, 0x11D8A7, 0x11D8F3, 0x11D907, 0x11D923, 0x11D937, 0x11D983, 0x11EF37, 0x11EF72, 0x11EF93, 0x11FD52, 0x11FF23,
+    0x11FFF2, 0x120003, 0x124702, 0x124753, 0x12FF12, 0x12FF33, 0x134307, 0x134393, 0x16A6E2, 0x16A703, 0x16AF07, 0x16AF52, 0x16AF63, 0x16B307,
+    0x16B372, 0x16B403, 0x16B442, 0x16B463, 0x16E972, 0x16E9B3, 0x16F4F7, 0x16F503, 0x16F517, 0x16F883, 0x16F8F7, 0x16F933, 0x16FE22, 0x16FE36,
+    0x16FE47, 0x16FE53, 0x16FF07, 0x16FF23, 0x170006, 0x187F83, 0x188006, 0x18CD63, 0x18D006, 0x18D093, 0x1AFF05, 0x1AFF43, 0x1AFF55, 0x1AFFC3,
+    0x1AFFD5, 0x1AFFF3, 0x1B0005, 0x1B0014, 0x1B1205, 0x1B1233, 0x1B1504, 0x1B1533, 0x1B1645, 0x1B1683, 0x1B1706, 0x1B2FC3, 0x1BC9C2, 0x1BC9D7,
+    0x1BC9F2, 0x1BCA07, 0x1BCA43, 0x1CF007, 0x1CF2E3, 0x1CF307, 0x1CF473, 0x1CF502, 0x1CFC43, 0x1D0002, 0x1D0F63, 0x1D1002, 0x1D1273, 0x1D1292,
+    0x1D1657, 0x1D16A2, 0x1D16D7, 0x1D1832, 0x1D1857, 0x1D18C2, 0x1D1AA7, 0x1D1AE2, 0x1D1EB3, 0x1D2002, 0x1D2427, 0x1D2452, 0x1D2463, 0x1D3002,
+    0x1D3573, 0x1D6C12, 0x1D6C23, 0x1D6DB2, 0x1D6DC3, 0x1D6FB2, 0x1D6FC3, 0x1D7152, 0x1D7163, 0x1D7352, 0x1D7363, 0x1D74F2, 0x1D7503, 0x1D76F2,
+    0x1D7703, 0x1D7892, 0x1D78A3, 0x1D7A92, 0x1D7AA3, 0x1D7C32, 0x1D7C43, 0x1D8002, 0x1DA007, 0x1DA372, 0x1DA3B7, 0x1DA6D2, 0x1DA757, 0x1DA762,
+    0x1DA847, 0x1DA852, 0x1DA8C3, 0x1DA9B7, 0x1DAA03, 0x1DAA17, 0x1DAB03, 0x1E0007, 0x1E0073, 0x1E0087, 0x1E0193, 0x1E01B7, 0x1E0223, 0x1E0237,
+    0x1E0253, 0x1E0267, 0x1E02B3, 0x1E1307, 0x1E1373, 0x1E14F2, 0x1E1503, 0x1E2AE7, 0x1E2AF3, 0x1E2EC7, 0x1E2F03, 0x1E2FF2, 0x1E3003, 0x1E8D07,
+    0x1E8D73, 0x1E9447, 0x1E94B3, 0x1E95E2, 0x1E9603, 0x1ECAC2, 0x1ECAD3, 0x1ECB02, 0x1ECB13, 0x1ED2E2, 0x1ED2F3, 0x1EEF02, 0x1EEF23, 0x1F0002,
+    0x1F02C3, 0x1F0302, 0x1F0943, 0x1F0A02, 0x1F0AF3, 0x1F0B12, 0x1F0C03, 0x1F0C12, 0x1F0D03, 0x1F0D12, 0x1F0F63, 0x1F10D2, 0x1F1AE3, 0x1F1E62,
+    0x1F2033, 0x1F2102, 0x1F23C3, 0x1F2402, 0x1F2493, 0x1F2502, 0x1F2523, 0x1F2602, 0x1F2663, 0x1F3002, 0x1F3FB7, 0x1F4002, 0x1F6D83, 0x1F6DD2,
+    0x1F6ED3, 0x1F6F02, 0x1F6FD3, 0x1F7002, 0x1F7743, 0x1F7802, 0x1F7D93, 0x1F7E02, 0x1F7EC3, 0x1F7F02, 0x1F7F13, 0x1F8002, 0x1F80C3, 0x1F8102,
+    0x1F8483, 0x1F8502, 0x1F85A3, 0x1F8602, 0x1F8883, 0x1F8902, 0x1F8AE3, 0x1F8B02, 0x1F8B23, 0x1F9002, 0x1FA543, 0x1FA602, 0x1FA6E3, 0x1FA702,
+    0x1FA753, 0x1FA782, 0x1FA7D3, 0x1FA802, 0x1FA873, 0x1FA902, 0x1FAAD3, 0x1FAB02, 0x1FABB3, 0x1FAC02, 0x1FAC63, 0x1FAD02, 0x1FADA3, 0x1FAE02,
+    0x1FAE83, 0x1FAF02, 0x1FAF73, 0x1FB002, 0x1FB933, 0x1FB942, 0x1FBCB3, 0x200006, 0x2A6E03, 0x2A7006, 0x2B7393, 0x2B7406, 0x2B81E3, 0x2B8206,
+    0x2CEA23, 0x2CEB06, 0x2EBE13, 0x2F8006, 0x2FA1E3, 0x300006, 0x3134B3, 0xE00017, 0xE00023, 0xE00207, 0xE00803, 0xE01007, 0xE01F03,
+};
+static constexpr size_t kWordRunCount = sizeof(kWordRuns) / sizeof(kWordRuns[0]);
+static constexpr bool WordRunsSorted() {
+    for (size_t i = 1; i < kWordRunCount; ++i) if ((kWordRuns[i - 1] >> 4) >= (kWordRuns[i] >> 4)) return false;
+    return (kWordRuns[0] >> 4) == 0;
+}
+static_assert(WordRunsSorted(), "kWordRuns は U+0000 から昇順");
+// ASCII の区分はコンパイル時に表から引いておき、1 バイトごとに二分探索しない
+struct AsciiWordClasses { uint8_t c[128]; };
+static constexpr AsciiWordClasses MakeAsciiWordClasses() {
+    AsciiWordClasses t{};
+    size_t r = 0;
+    for (uint32_t cp = 0; cp < 128; ++cp) {
+        while (r + 1 < kWordRunCount && (kWordRuns[r + 1] >> 4) <= cp) ++r;
+        t.c[cp] = (uint8_t)(kWordRuns[r] & 0xF);
+    }
+    return t;
+}
+static constexpr AsciiWordClasses kAsciiWordClasses = MakeAsciiWordClasses();
+static_assert(kAsciiWordClasses.c['_'] == WC_WORD && kAsciiWordClasses.c['\t'] == WC_SPACE && kAsciiWordClasses.c['\r'] == WC_NEWLINE && kAsciiWordClasses.c['.'] == WC_PUNCT, "");
+WordClass WordClassOf(uint32_t cp) {
+    if (cp < 0x80) return (WordClass)kAsciiWordClasses.c[cp];
+    if (cp > 0x10FFFF) return WC_PUNCT;
+    const uint32_t* end = kWordRuns + kWordRunCount;
+    const uint32_t* r = std::upper_bound(kWordRuns, end, cp, [](uint32_t c, uint32_t run) { return c < (run >> 4); });
+    return (WordClass)(r[-1] & 0xF);
+}
+// it から 1 文字とそれに続く結合文字を読んで進め、土台の文字の区分を返す。土台がなければ WC_WORD
+static WordClass ReadForward(PieceIterator& it, size_t len) {
+    unsigned char c = (unsigned char)*it;
+    WordClass cls;
+    if (c < 0x80) { ++it; cls = (WordClass)kAsciiWordClasses.c[c]; }
+    else { cls = WordClassOf(ReadCodePoint(it, len)); if (cls == WC_EXTEND) cls = WC_WORD; }
+    if (cls == WC_NEWLINE) return cls;
+    while (it.position() < len && (unsigned char)*it >= 0x80) { PieceIterator p = it; if (WordClassOf(ReadCodePoint(p, len)) != WC_EXTEND) break; it = p; }
+    return cls;
+}
+// it の直前の文字 (結合文字なら土台まで) へ戻し、その区分を返す
+static WordClass ReadBackward(PieceIterator& it) {
+    PieceIterator p = it; --p;
+    unsigned char c = (unsigned char)*p;
+    if (c < 0x80) { it = p; return (WordClass)kAsciiWordClasses.c[c]; }
+    WordClass cls = WordClassOf(ReadCodePointBackward(it));
+    while (cls == WC_EXTEND && it.position() > 0) {
+        PieceIterator q = it; WordClass base = WordClassOf(ReadCodePointBackward(q));
+        if (base == WC_NEWLINE) break;
+        it = q; cls = base;
+    }
+    return cls == WC_EXTEND ? WC_WORD : cls;
+}
+// ASCII で cls の文字が続くあいだ、ピースのバイト列を直接なめて進める / 戻す
+static void SkipAsciiForward(PieceIterator& it, WordClass cls) {
+    const PieceTable& pt = *it.pt;
+    while (it.idx < pt.pieces.size()) {
+        const Piece& p = pt.pieces[it.idx];
+        const unsigned char* d = (const unsigned char*)pt.pieceData(p);
+        size_t i = it.pos - it.pieceStart;
+        while (i < p.len && d[i] < 0x80 && kAsciiWordClasses.c[d[i]] == cls) ++i;
+        it.pos = it.pieceStart + i;
+        if (i < p.len) return;
+        it.pieceStart += p.len; ++it.idx;
+    }
+}
+static void SkipAsciiBackward(PieceIterator& it, WordClass cls) {
+    const PieceTable& pt = *it.pt;
+    while (it.pos > 0) {
+        size_t idx = it.idx, start = it.pieceStart;
+        while (idx > 0 && it.pos <= start) { --idx; start -= pt.pieces[idx].len; }
+        const unsigned char* d = (const unsigned char*)pt.pieceData(pt.pieces[idx]);
+        size_t i = it.pos - start;
+        while (i > 0 && d[i - 1] < 0x80 && kAsciiWordClasses.c[d[i - 1]] == cls) --i;
+        if (start + i == it.pos) return;
+        it.pos = start + i; it.idx = idx; it.pieceStart = start;
+        if (i > 0) return;
+    }
+}
+// cls の文字 (と後ろに付く結合文字) が続くあいだ進める / 戻す
+static void SkipRunForward(PieceIterator& it, size_t len, WordClass cls) {
+    while (it.position() < len) {
+        SkipAsciiForward(it, cls);
+        if (it.position() >= len || (unsigned char)*it < 0x80) return;
+        PieceIterator p = it; WordClass c = WordClassOf(ReadCodePoint(p, len));
+        if (c != cls && c != WC_EXTEND) return;
+        it = p;
+    }
+}
+static void SkipRunBackward(PieceIterator& it, WordClass cls) {
+    while (it.position() > 0) {
+        SkipAsciiBackward(it, cls);
+        if (it.position() == 0) return;
+        PieceIterator p = it; --p;
+        if ((unsigned char)*p < 0x80) return;
+        p = it;
+        if (ReadBackward(p) != cls) return;
+        it = p;
+    }
+}
+WordClass WordClassAt(const PieceTable& pt, size_t pos) {
+    size_t len = pt.length();
+    if (pos >= len) return WC_SPACE;
+    PieceIterator it(pt, pos);
+    return ReadForward(it, len);
+}
+WordClass WordClassBefore(const PieceTable& pt, size_t pos) {
+    if (pos == 0) return WC_SPACE;
+    PieceIterator it(pt, std::min(pos, pt.length()));
+    return ReadBackward(it);
+}
+bool IsWordBoundary(const PieceIterator& it, size_t len) {
+    size_t pos = it.position();
+    if (pos == 0 || pos >= len) return true;
+    PieceIterator after = it;
+    WordClass b = WordClassOf(ReadCodePoint(after, len));
+    if (b == WC_EXTEND) return false;
+    PieceIterator before = it;
+    WordClass a = ReadBackward(before);
+    return a != b || !IsWordClass(a);
+}
+// s[pos] から始まる文字のコード点。不正なら kBadCodePoint
+static uint32_t CodePointAt(std::string_view s, size_t pos) {
+    unsigned char c = (unsigned char)s[pos];
+    if (c < 0x80) return c;
+    size_t n = (c >= 0xF0 && c <= 0xF4) ? 4 : (c >= 0xE0 && c < 0xF0) ? 3 : (c >= 0xC2 && c < 0xE0) ? 2 : 0;
+    if (n == 0 || pos + n > s.size()) return kBadCodePoint;
+    uint32_t cp = c & (0x7F >> n);
+    for (size_t i = 1; i < n; ++i) { unsigned char b = (unsigned char)s[pos + i]; if ((b & 0xC0) != 0x80) return kBadCodePoint; cp = (cp << 6) | (b & 0x3F); }
+    return cp;
+}
+bool IsWordBoundary(std::string_view s, size_t pos) {
+    if (pos == 0 || pos >= s.size()) return true;
+    WordClass b = WordClassOf(CodePointAt(s, pos));
+    if (b == WC_EXTEND) return false;
+    // 直前の文字は先頭バイトまで戻って読む。結合文字なら土台まで戻るが、改行は土台にしない
+    WordClass a = WC_EXTEND;
+    for (size_t p = pos; p > 0;) {
+        size_t q = p - 1;
+        for (int k = 0; k < 3 && q > 0 && ((unsigned char)s[q] & 0xC0) == 0x80; ++k) --q;
+        WordClass c = WordClassOf(CodePointAt(s, q));
+        if (c == WC_NEWLINE && p < pos) break;
+        a = c; p = q;
+        if (a != WC_EXTEND) break;
+    }
+    if (a == WC_EXTEND) a = WC_WORD;
+    return a != b || !IsWordClass(a);
+}
+void WordRangeAt(const PieceTable& pt, size_t pos, size_t& start, size_t& end) {
+    size_t len = pt.length();
+    if (pos >= len) { start = end = pos; return; }
+    // 結合文字や \r\n の途中を指していたらクラスタの先頭から
+    if (!IsGraphemeBoundary(PieceIterator(pt, pos), len)) pos = PrevGraphemeBoundary(pt, pos);
+    PieceIterator left(pt, pos), right = left;
+    char first = *right;
+    WordClass cls = ReadForward(right, len);
+    if (cls == WC_NEWLINE) { if (first == '\r' && right.position() < len && *right == '\n') ++right; }
+    else { SkipRunBackward(left, cls); SkipRunForward(right, len, cls); }
+    start = left.position(); end = right.position();
+}
+size_t NextWordStop(const PieceTable& pt, size_t pos) {
+    size_t len = pt.length();
+    if (pos >= len) return len;
+    PieceIterator it(pt, pos);
+    char first = *it;
+    WordClass cls = ReadForward(it, len);
+    if (cls == WC_NEWLINE) { if (first == '\r' && it.position() < len && *it == '\n') ++it; return it.position(); }
+    if (cls != WC_SPACE) SkipRunForward(it, len, cls);
+    SkipRunForward(it, len, WC_SPACE);
+    return it.position();
+}
+size_t PrevWordStop(const PieceTable& pt, size_t pos) {
+    pos = std::min(pos, pt.length());
+    if (pos == 0) return 0;
+    PieceIterator it(pt, pos), p = it;
+    WordClass cls = ReadBackward(p);
+    if (cls == WC_NEWLINE) {
+        if (*p == '\n' && p.position() > 0) { PieceIterator q = p; if (*--q == '\r') p = q; }
+        return p.position();
+    }
+    SkipRunBackward(it, WC_SPACE);
+    if (it.position() == 0) return 0;
+    p = it; cls = ReadBackward(p);
+    if (cls == WC_NEWLINE) return it.position();
+    it = p; SkipRunBackward(it, cls);
+    return it.position();
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "PieceTable.h"
+// 単語移動・単語選択・単語単位の検索に使う文字の区分。同じ区分の文字が続く範囲を 1 語とみなす
+// ひらがな・カタカナ・漢字は別の区分なので「日本語を書く」は 漢字 / ひらがな / 漢字 / ひらがな で区切れる
+// 結合文字 (WC_EXTEND) は直前の文字の区分に含める。不正な UTF-8 のバイトは WC_PUNCT
+enum WordClass { WC_SPACE, WC_NEWLINE, WC_PUNCT, WC_WORD, WC_HIRAGANA, WC_KATAKANA, WC_HAN, WC_EXTEND };
+WordClass WordClassOf(uint32_t cp);
+inline bool IsWordClass(WordClass c) { return c >= WC_WORD && c <= WC_HAN; }
+// pos から始まる文字・pos の直前の文字の区分 (結合文字なら土台の文字の区分)。文書の端では WC_SPACE
+WordClass WordClassAt(const PieceTable& pt, size_t pos);
+WordClass WordClassBefore(const PieceTable& pt, size_t pos);
+// 前後の文字の区分が違うか、どちらかが単語でなければ単語の境目。文書や文字列の端も境目
+bool IsWordBoundary(const PieceIterator& it, size_t len);
+bool IsWordBoundary(std::string_view s, size_t pos);
+// pos の文字と同じ区分が続く範囲 [start, end)。改行は \r\n もまとめて 1 つ
+void WordRangeAt(const PieceTable& pt, size_t pos, size_t& start, size_t& end);
+// 単語単位のキャレット移動先。同じ区分の並びとその後ろ (前) の空白を越える。改行は 1 つずつ越える
+size_t NextWordStop(const PieceTable& pt, size_t pos);
+size_t PrevWordStop(const PieceTable& pt, size_t pos);
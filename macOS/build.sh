@@ -15,7 +15,7 @@ mkdir -p "$APP_NAME.app/Contents/Resources"
 
 # 1. コンパイル
 echo "Compiling..."
-clang++ -o "$APP_NAME.app/Contents/MacOS/$APP_NAME" "$SOURCE" -std=c++17 -framework Cocoa -framework CoreText -framework CoreFoundation -O2
+clang++ -o "$APP_NAME.app/Contents/MacOS/$APP_NAME" "$SOURCE" ../core/*.cpp -std=c++17 -framework Cocoa -framework CoreText -framework CoreFoundation -O2
 
 if [ $? -ne 0 ]; then
     echo "Compilation failed."
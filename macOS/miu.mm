@@ -17,10 +17,17 @@
 #include <unistd.h>
 #import <Cocoa/Cocoa.h>
 #import <CoreText/CoreText.h>
+#include "../core/Encoding.h"
+#include "../core/PieceTable.h"
+#include "../core/Edit.h"
+#include "../core/MappedFile.h"
+#include "../core/LineIndex.h"
+#include "../core/Search.h"
+#include "../core/Grapheme.h"
+#include "../core/WordBreak.h"
 // --- 定数・列挙型 ---
 const std::wstring APP_VERSION = L"miu v1.0.15 (macOS)";
 const std::wstring APP_TITLE = L"miu";
-enum Encoding { ENC_UTF8_NOBOM = 0, ENC_UTF8_BOM, ENC_UTF16LE, ENC_UTF16BE, ENC_ANSI };
 static NSString *const kMiuRectangularSelectionType = @"com.kenji.miu.rectangular";
 // --- 1. 文字コード変換ヘルパー ---
 static std::string CFStringToStdString(CFStringRef cfStr) {
@@ -52,128 +59,18 @@ static std::wstring UTF8ToW(const std::string& s) {
     if (str) CFRelease(str);
     return res;
 }
-static std::string Utf16ToUtf8(const char* data, size_t len, bool isBigEndian) {
-    if (len < 2) return "";
-    CFStringRef str = CFStringCreateWithBytes(kCFAllocatorDefault, (const UInt8*)(data + 2), len - 2, isBigEndian ? kCFStringEncodingUTF16BE : kCFStringEncodingUTF16LE, false);
-    std::string res = CFStringToStdString(str);
-    if (str) CFRelease(str);
-    return res;
-}
 static std::string AnsiToUtf8(const char* data, size_t len) {
     CFStringRef str = CFStringCreateWithBytes(kCFAllocatorDefault, (const UInt8*)data, len, kCFStringEncodingWindowsLatin1, false);
     std::string res = CFStringToStdString(str);
     if (str) CFRelease(str);
     return res;
 }
-static Encoding DetectEncoding(const char* buf, size_t len) {
-    if (len >= 3 && (unsigned char)buf[0] == 0xEF && (unsigned char)buf[1] == 0xBB && (unsigned char)buf[2] == 0xBF) return ENC_UTF8_BOM;
-    if (len >= 2) {
-        if ((unsigned char)buf[0] == 0xFF && (unsigned char)buf[1] == 0xFE) return ENC_UTF16LE;
-        if ((unsigned char)buf[0] == 0xFE && (unsigned char)buf[1] == 0xFF) return ENC_UTF16BE;
-    }
-    return ENC_UTF8_NOBOM;
-}
 // --- 2. 前方宣言 ---
 @interface EditorView : NSView <NSTextInputClient>
 - (void)updateScrollers;
 - (void)applyZoom:(float)val relative:(bool)rel;
 @end
-// --- 3. データ構造 ---
-struct Piece { bool isOriginal; size_t start; size_t len; };
-struct PieceTable {
-    const char* origPtr = nullptr; size_t origSize = 0;
-    std::string addBuf; std::vector<Piece> pieces;
-    void initFromFile(const char* data, size_t size) { origPtr = data; origSize = size; pieces.clear(); addBuf.clear(); if (size > 0) pieces.push_back({ true, 0, size }); }
-    void initEmpty() { origPtr = nullptr; origSize = 0; pieces.clear(); addBuf.clear(); }
-    size_t length() const { size_t s = 0; for (auto& p : pieces) s += p.len; return s; }
-    std::string getRange(size_t pos, size_t count) const {
-        std::string out; out.reserve(std::min(count, (size_t)4096));
-        size_t cur = 0;
-        for (const auto& p : pieces) {
-            if (cur + p.len <= pos) { cur += p.len; continue; }
-            size_t localStart = (pos > cur) ? (pos - cur) : 0;
-            size_t take = std::min(p.len - localStart, count - out.size());
-            if (take == 0) break;
-            p.isOriginal ? out.append(origPtr + p.start + localStart, take) : out.append(addBuf.data() + p.start + localStart, take);
-            if (out.size() >= count) break;
-            cur += p.len;
-        }
-        return out;
-    }
-    char charAt(size_t pos) const {
-        size_t cur = 0;
-        for (const auto& p : pieces) {
-            if (cur + p.len <= pos) { cur += p.len; continue; }
-            return p.isOriginal ? origPtr[p.start + pos - cur] : addBuf[p.start + pos - cur];
-        }
-        return ' ';
-    }
-    void insert(size_t pos, const std::string& s) {
-        if (s.empty()) return;
-        size_t cur = 0, idx = 0;
-        while (idx < pieces.size() && cur + pieces[idx].len < pos) { cur += pieces[idx].len; ++idx; }
-        if (idx < pieces.size()) {
-            Piece p = pieces[idx]; size_t offset = pos - cur;
-            if (offset > 0 && offset < p.len) {
-                pieces[idx] = { p.isOriginal, p.start, offset };
-                pieces.insert(pieces.begin() + idx + 1, { p.isOriginal, p.start + offset, p.len - offset });
-                idx++;
-            } else if (offset == p.len) idx++;
-        }
-        size_t addStart = addBuf.size(); addBuf.append(s);
-        pieces.insert(pieces.begin() + idx, { false, addStart, (size_t)s.size() });
-    }
-    void erase(size_t pos, size_t count) {
-        if (count == 0) return;
-        size_t cur = 0, idx = 0;
-        while (idx < pieces.size() && cur + pieces[idx].len <= pos) { cur += pieces[idx].len; ++idx; }
-        if (idx >= pieces.size()) return;
-        if (pos > cur) {
-            Piece p = pieces[idx]; size_t leftLen = pos - cur;
-            pieces[idx] = { p.isOriginal, p.start, leftLen };
-            pieces.insert(pieces.begin() + idx + 1, { p.isOriginal, p.start + leftLen, p.len - leftLen });
-            idx++;
-        }
-        size_t remaining = count;
-        while (idx < pieces.size() && remaining > 0) {
-            if (pieces[idx].len <= remaining) { remaining -= pieces[idx].len; pieces.erase(pieces.begin() + idx); }
-            else { pieces[idx].start += remaining; pieces[idx].len -= remaining; remaining = 0; }
-        }
-    }
-};
-struct Cursor {
-    size_t head, anchor;
-    float desiredX;
-    float originalAnchorX;
-    bool isVirtual; // 仮想スペースモードフラグ
-    size_t start() const { return std::min(head, anchor); }
-    size_t end() const { return std::max(head, anchor); }
-    bool hasSelection() const { return head != anchor; }
-};
-struct EditOp { enum Type { Insert, Erase } type; size_t pos; std::string text; };
-struct EditBatch { std::vector<EditOp> ops; std::vector<Cursor> beforeCursors, afterCursors; };
-struct UndoManager {
-    std::vector<EditBatch> undoStack, redoStack; int savePoint = 0;
-    void clear() { undoStack.clear(); redoStack.clear(); savePoint = 0; }
-    void markSaved() { savePoint = (int)undoStack.size(); }
-    bool isModified() const { return (int)undoStack.size() != savePoint; }
-    void push(const EditBatch& b) { undoStack.push_back(b); redoStack.clear(); }
-    EditBatch popUndo() { EditBatch e = undoStack.back(); undoStack.pop_back(); redoStack.push_back(e); return e; }
-    EditBatch popRedo() { EditBatch e = redoStack.back(); redoStack.pop_back(); undoStack.push_back(e); return e; }
-};
-
-struct MappedFile {
-    int fd = -1; char* ptr = nullptr; size_t size = 0;
-    bool open(const char* path) {
-        fd = ::open(path, O_RDONLY); if (fd == -1) return false;
-        struct stat sb; if (fstat(fd, &sb) == -1) { ::close(fd); return false; }
-        size = sb.st_size; if (size == 0) { ptr = nullptr; return true; }
-        ptr = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0); return (ptr != MAP_FAILED);
-    }
-    void close() { if (ptr && ptr != MAP_FAILED) munmap(ptr, size); if (fd != -1) ::close(fd); ptr = nullptr; fd = -1; }
-    ~MappedFile() { close(); }
-};
-
+// --- 3. データ構造 (core/ に共通化) ---
 // --- 4. Editor Core ---
 struct Editor {
     EditorView* view = nullptr;
@@ -722,30 +619,16 @@ struct Editor {
         size_t pos = c.head;
         size_t len = pt.length();
         if (pos > len) pos = len;
-        bool charRight = (pos < len && isWordChar(pt.charAt(pos)));
-        bool charLeft = (pos > 0 && isWordChar(pt.charAt(pos - 1)));
+        bool charRight = IsWordClass(WordClassAt(pt, pos));
+        bool charLeft = IsWordClass(WordClassBefore(pt, pos));
         if (!charRight && !charLeft) return { "", true };
-        size_t start = pos, end = pos;
-        while (start > 0 && isWordChar(pt.charAt(start - 1))) start--;
-        while (end < len && isWordChar(pt.charAt(end))) end++;
+        size_t start, end; WordRangeAt(pt, charRight ? pos : PrevGraphemeBoundary(pt, pos), start, end);
         if (end > start) return { pt.getRange(start, end - start), true };
         return { "", true };
     }
     
     size_t findText(size_t startPos, const std::string& query, bool forward) {
-        if (query.empty()) return std::string::npos;
-        size_t len = pt.length();
-        size_t cur = startPos;
-        for (size_t count = 0; count < len; ++count) {
-            bool match = true;
-            for (size_t i = 0; i < query.length(); ++i) {
-                if (cur + i >= len || pt.charAt(cur + i) != query[i]) { match = false; break; }
-            }
-            if (match) return cur;
-            if (forward) { cur++; if (cur >= len) cur = 0; }
-            else { if (cur == 0) cur = len - 1; else cur--; }
-        }
-        return std::string::npos;
+        return FindText(pt, startPos, query, forward, true, false, false);
     }
     
     void selectNextOccurrence() {
@@ -803,18 +686,12 @@ struct Editor {
         if (view) updateScrollBars();
     }
     void rebuildLineStarts() {
-        lineStarts.clear(); lineStarts.push_back(0);
-        size_t go = 0;
-        for (const auto& p : pt.pieces) {
-            const char* b = p.isOriginal ? (pt.origPtr + p.start) : (pt.addBuf.data() + p.start);
-            for (size_t i = 0; i < p.len; ++i) if (b[i] == '\n') lineStarts.push_back(go + i + 1);
-            go += p.len;
-        }
+        BuildLineStarts(pt, lineStarts);
         updateGutterWidth(); if (fontRef) updateMaxLineWidth();
         if (view) [view updateScrollers];
     }
     
-    int getLineIdx(size_t pos) { auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), pos); return std::max(0, (int)std::distance(lineStarts.begin(), it) - 1); }
+    int getLineIdx(size_t pos) { return FindLineIndex(lineStarts, pos); }
     float getXInLine(int li, size_t pos) {
         if (li < 0 || li >= (int)lineStarts.size()) return 0.0f;
         size_t s = lineStarts[li], e = (li + 1 < (int)lineStarts.size()) ? lineStarts[li + 1] : pt.length();
@@ -1123,8 +1000,8 @@ struct Editor {
         }
         if (view) [view setNeedsDisplay:YES];
     }
-    void performUndo() { if(!undo.undoStack.empty()){ auto b = undo.popUndo(); for(int i=(int)b.ops.size()-1;i>=0;--i){ if(b.ops[i].type==EditOp::Insert) pt.erase(b.ops[i].pos, (int)b.ops[i].text.size()); else pt.insert(b.ops[i].pos, b.ops[i].text); } cursors=b.beforeCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); } }
-    void performRedo() { if(!undo.redoStack.empty()){ auto b = undo.popRedo(); for(const auto& o:b.ops){ if(o.type==EditOp::Insert) pt.insert(o.pos, o.text); else pt.erase(o.pos, (int)o.text.size()); } cursors=b.afterCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); } }
+    void performUndo() { if(!undo.undoStack.empty()){ auto b = undo.popUndo(); RevertBatch(pt, b); cursors=b.beforeCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); } }
+    void performRedo() { if(!undo.redoStack.empty()){ auto b = undo.popRedo(); ReapplyBatch(pt, b); cursors=b.afterCursors; rebuildLineStarts(); ensureCaretVisible(); updateDirtyFlag(); } }
     
     // --- ファイル操作 ---
     bool checkUnsavedChanges() { if(!isDirty) return true; NSAlert *a = [NSAlert new]; [a setMessageText:@"Save changes?"]; [a addButtonWithTitle:@"Save"]; [a addButtonWithTitle:@"Cancel"]; [a addButtonWithTitle:@"Discard"]; NSModalResponse r = [a runModal]; if(r==NSAlertFirstButtonReturn) return currentFilePath.empty()?saveFileAs():saveFile(currentFilePath); if(r==NSAlertThirdButtonReturn){ isDirty=false; updateTitleBar(); return true; } return false; }
@@ -1140,12 +1017,11 @@ struct Editor {
     void newFile() { if(checkUnsavedChanges()){ pt.initEmpty(); currentFilePath.clear(); undo.clear(); isDirty=false; cursors.clear(); cursors.push_back({0,0,0.0f,0.0f,false}); rebuildLineStarts(); updateTitleBar(); } }
     
     // 単語判定
-    bool isWordChar(char c) { if (isalnum((unsigned char)c) || c == '_') return true; if ((unsigned char)c >= 0x80) return true; return false; }
     void getWordBoundaries(size_t pos, size_t& start, size_t& end) {
         size_t len = pt.length(); if (len == 0) { start = end = 0; return; }
         pos = std::min(pos, len); start = end = pos;
-        bool charRight = (pos < len && isWordChar(pt.charAt(pos))); bool charLeft = (pos > 0 && isWordChar(pt.charAt(pos - 1)));
-        if (charRight || charLeft) { if (!charRight && charLeft) { start--; end--; } while (start > 0 && isWordChar(pt.charAt(start - 1))) start--; while (end < len && isWordChar(pt.charAt(end))) end++; }
+        bool charRight = IsWordClass(WordClassAt(pt, pos)); bool charLeft = IsWordClass(WordClassBefore(pt, pos));
+        if (charRight || charLeft) WordRangeAt(pt, charRight ? pos : PrevGraphemeBoundary(pt, pos), start, end);
     }
     
     void initGraphics() { if (!fontRef) fontRef = CTFontCreateWithName(CFSTR("Menlo"), currentFontSize, NULL); rebuildLineStarts(); updateThemeColors(); if (cursors.empty()) cursors.push_back({0, 0, 0.0f, 0.0f, false}); updateTitleBar(); }
@@ -1183,8 +1059,7 @@ struct Editor {
             while ((searchPos = visibleText.find(autoStr, searchPos)) != std::string::npos) {
                 size_t docPos = searchRangeStart + searchPos; bool shouldHighlight = true;
                 if (isWholeWord) {
-                    if (docPos > 0 && isWordChar(pt.charAt(docPos - 1))) shouldHighlight = false;
-                    if (shouldHighlight && (docPos + autoStr.length() < pt.length()) && isWordChar(pt.charAt(docPos + autoStr.length()))) shouldHighlight = false;
+                    if (!IsWordBoundary(visibleText, searchPos) || !IsWordBoundary(visibleText, searchPos + autoStr.length())) shouldHighlight = false;
                 }
                 if (shouldHighlight) {
                     int li = getLineIdx(docPos);
@@ -1566,7 +1441,7 @@ Editor g_editor;
             if (code == 123) {
                 size_t p = c.head; int li = g_editor.getLineIdx(p); size_t lineStart = g_editor.lineStarts[li];
                 if (cmd) {
-                    if (p == lineStart && p > 0) p--; else { while (p > lineStart && !g_editor.isWordChar(g_editor.pt.charAt(p - 1))) p--; while (p > lineStart && g_editor.isWordChar(g_editor.pt.charAt(p - 1))) p--; }
+                    if (p == lineStart && p > 0) p--; else p = std::max(lineStart, PrevWordStop(g_editor.pt, p));
                     c.head = p;
                 } else c.head = g_editor.moveCaretVisual(c.head, false);
                 c.isVirtual = false;
@@ -1575,7 +1450,7 @@ Editor g_editor;
                 size_t lineStart = g_editor.lineStarts[li], lineEnd = (li + 1 < (int)g_editor.lineStarts.size()) ? g_editor.lineStarts[li + 1] : len;
                 size_t physEnd = lineEnd; if (physEnd > lineStart && g_editor.pt.charAt(physEnd - 1) == '\n') physEnd--; if (physEnd > lineStart && g_editor.pt.charAt(physEnd - 1) == '\r') physEnd--;
                 if (cmd) {
-                    if (p == physEnd && p < len) p = lineEnd; else { while (p < physEnd && g_editor.isWordChar(g_editor.pt.charAt(p))) p++; while (p < physEnd && !g_editor.isWordChar(g_editor.pt.charAt(p))) p++; }
+                    if (p == physEnd && p < len) p = lineEnd; else p = std::min(physEnd, NextWordStop(g_editor.pt, p));
                     c.head = p;
                 } else c.head = g_editor.moveCaretVisual(c.head, true);
                 c.isVirtual = false;
@@ -24,6 +24,24 @@
 #define IDS_FATAL_ERROR         118
 #define IDS_REOPEN_ERR          119
 #define IDS_OPEN_FAIL           120
+#define IDS_MEMORY_TITLE        121
+#define IDS_LINEOPS_TITLE       122
+#define IDS_LINEOPS_PROMPT      123
+#define IDS_LINES_SORT          124
+#define IDS_LINES_SORT_ICASE    125
+#define IDS_LINES_SORT_NUMERIC  126
+#define IDS_LINES_UNIQUE        127
+#define IDS_LINES_REVERSE       128
+#define IDS_LINES_SHUFFLE       129
+#define IDS_LINES_KEEP_MATCHING 130
+#define IDS_LINES_REMOVE_MATCHING 131
+#define IDS_NEWLINES_CRLF       132
+#define IDS_NEWLINES_LF         133
+#define IDS_NEWLINES_CR         134
+#define IDS_WS_TRIM_TRAILING    135
+#define IDS_WS_TABS_TO_SPACES   136
+#define IDS_WS_SPACES_TO_TABS   137
+#define IDS_TRIM_ON_SAVE        138
 
 #define IDC_FIND_EDIT                   1001
 #define IDC_FIND_NEXT                   1002
@@ -42,7 +60,7 @@
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        121
+#define _APS_NEXT_RESOURCE_VALUE        139
 #define _APS_NEXT_COMMAND_VALUE         40001
 #define _APS_NEXT_CONTROL_VALUE         1013
 #define _APS_NEXT_SYMED_VALUE           101